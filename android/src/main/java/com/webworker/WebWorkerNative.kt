@@ -1,6 +1,8 @@
 package com.webworker
 
+import android.content.res.AssetManager
 import android.util.Log
+import com.facebook.react.turbomodule.core.interfaces.BindingsInstallerHolder
 
 /**
  * Native JNI bridge for WebWorker Hermes runtime.
@@ -27,9 +29,6 @@ object WebWorkerNative {
      * This matches the callback system used in the shared C++ core.
      */
     interface WorkerCallback {
-        /** Called when a worker posts a message to the host */
-        fun onMessage(workerId: String, message: String)
-
         /** Called when a worker encounters an error */
         fun onError(workerId: String, error: String)
 
@@ -50,6 +49,15 @@ object WebWorkerNative {
         )
     }
 
+    /**
+     * Receives the outcome of evalScriptAsync and of the profiling calls,
+     * on the worker thread.
+     */
+    interface EvalCallback {
+        /** `error` is null when the script ran */
+        fun onResult(result: String?, error: String?)
+    }
+
     /**
      * Initialize the native WebWorkerCore with callbacks.
      * Must be called before any other native methods.
@@ -62,16 +70,66 @@ object WebWorkerNative {
         }
     }
 
+    /**
+     * Installer for the JSI binding that carries worker messages to and from
+     * the JS runtime. Must be called after initialize().
+     */
+    fun getBindingsInstaller(): BindingsInstallerHolder {
+        return nativeGetBindingsInstaller()
+    }
+
     /**
      * Create a new worker with the given script content.
+     * Heap sizes of 0 and an empty gcMode keep the Hermes defaults. A stack
+     * size of 0, an empty priority, mask or name keep the platform's.
+     * @return The worker ID on success
+     * @throws RuntimeException on failure
+     */
+    fun createWorker(
+        workerId: String,
+        scriptContent: String,
+        maxHeapSizeMB: Int = 0,
+        initialHeapSizeMB: Int = 0,
+        gcMode: String = "",
+        stackSizeKB: Int = 0,
+        priority: String = "",
+        cpuAffinityMask: Long = 0,
+        threadName: String = ""
+    ): String {
+        if (!isInitialized) {
+            throw RuntimeException("WebWorkerCore not initialized. Call initialize() first.")
+        }
+        return nativeCreateWorker(
+            workerId, scriptContent, maxHeapSizeMB, initialHeapSizeMB, gcMode,
+            stackSizeKB, priority, cpuAffinityMask, threadName
+        )
+    }
+
+    /**
+     * Create a new worker from a script file, mapped rather than read.
+     * With `assets`, `path` names an APK asset. Source or Hermes bytecode.
      * @return The worker ID on success
      * @throws RuntimeException on failure
      */
-    fun createWorker(workerId: String, scriptContent: String): String {
+    fun createWorkerFromFile(
+        workerId: String,
+        path: String,
+        assets: AssetManager? = null,
+        maxHeapSizeMB: Int = 0,
+        initialHeapSizeMB: Int = 0,
+        gcMode: String = "",
+        stackSizeKB: Int = 0,
+        priority: String = "",
+        cpuAffinityMask: Long = 0,
+        threadName: String = ""
+    ): String {
         if (!isInitialized) {
             throw RuntimeException("WebWorkerCore not initialized. Call initialize() first.")
         }
-        return nativeCreateWorker(workerId, scriptContent)
+        return nativeCreateWorkerFromFile(
+            workerId, path, assets, maxHeapSizeMB, initialHeapSizeMB, gcMode,
+            stackSizeKB, priority, cpuAffinityMask, threadName
+        )
     }
 
     /**
@@ -99,6 +157,30 @@ object WebWorkerNative {
         return nativeEvalScript(workerId, script)
     }
 
+    /**
+     * Evaluate a script as a task on the worker's event loop without
+     * blocking the calling thread.
+     */
+    fun evalScriptAsync(workerId: String, script: String, callback: EvalCallback) {
+        nativeEvalScriptAsync(workerId, script, callback)
+    }
+
+    /**
+     * Start the Hermes sampling profiler on the worker's thread.
+     * `callback` gets a null error once sampling runs.
+     */
+    fun startProfiling(workerId: String, callback: EvalCallback) {
+        nativeStartProfiling(workerId, callback)
+    }
+
+    /**
+     * Stop profiling a worker and write its samples to `path` as a .cpuprofile.
+     * `callback` gets the path.
+     */
+    fun stopProfiling(workerId: String, path: String, callback: EvalCallback) {
+        nativeStopProfiling(workerId, path, callback)
+    }
+
     /**
      * Check if a worker exists.
      */
@@ -114,7 +196,75 @@ object WebWorkerNative {
     }
 
     /**
-     * Send fetch response back to C++
+     * Start a WorkerPool of `size` workers (0 = one per hardware thread).
+     * Jobs are submitted through the JSI binding.
+     * @return The number of workers started
+     * @throws RuntimeException on failure
+     */
+    fun createPool(poolId: String, scriptContent: String, size: Int): Int {
+        if (!isInitialized) {
+            throw RuntimeException("WebWorkerCore not initialized. Call initialize() first.")
+        }
+        return nativeCreatePool(poolId, scriptContent, size)
+    }
+
+    /**
+     * Start a WorkerPool from a script file, see createWorkerFromFile.
+     * @return The number of workers started
+     * @throws RuntimeException on failure
+     */
+    fun createPoolFromFile(poolId: String, path: String, assets: AssetManager?, size: Int): Int {
+        if (!isInitialized) {
+            throw RuntimeException("WebWorkerCore not initialized. Call initialize() first.")
+        }
+        return nativeCreatePoolFromFile(poolId, path, assets, size)
+    }
+
+    /**
+     * Terminate a WorkerPool by ID.
+     * @return true if the pool was found and terminated
+     */
+    fun terminatePool(poolId: String): Boolean {
+        return nativeTerminatePool(poolId)
+    }
+
+    /**
+     * Set how many pre-initialized runtimes to keep ready for createWorker.
+     */
+    fun setWarmPoolSize(size: Int) {
+        nativeSetWarmPoolSize(size)
+    }
+
+    /**
+     * Drop worker console output below `level` ("log", "info", "warn", "error" or "none").
+     */
+    fun setConsoleLevel(level: String) {
+        if (isInitialized) {
+            nativeSetConsoleLevel(level)
+        }
+    }
+
+    /**
+     * Keep cacheable fetch responses in `path`, shared by all workers.
+     */
+    fun setFetchCacheDirectory(path: String) {
+        if (isInitialized) {
+            nativeSetFetchCacheDirectory(path)
+        }
+    }
+
+    /**
+     * Ask every worker to collect garbage. `critical` also drops the warm pool.
+     */
+    fun onMemoryPressure(critical: Boolean) {
+        if (isInitialized) {
+            nativeOnMemoryPressure(critical)
+        }
+    }
+
+    /**
+     * Send fetch response back to C++.
+     * With `streaming`, `body` is ignored and the body follows through handleFetchChunk.
      */
     fun handleFetchResponse(
         workerId: String, 
@@ -123,9 +273,27 @@ object WebWorkerNative {
         headerKeys: Array<String>, 
         headerValues: Array<String>, 
         body: ByteArray?, 
-        error: String?
+        error: String?,
+        streaming: Boolean = false
     ) {
-        nativeHandleFetchResponse(workerId, requestId, status, headerKeys, headerValues, body, error)
+        nativeHandleFetchResponse(workerId, requestId, status, headerKeys, headerValues, body, error, streaming)
+    }
+
+    /**
+     * Send the first `length` bytes of `data` as the next piece of a streamed body.
+     * The last call has `done` set, with `error` if the download failed.
+     * Blocks while the worker is behind reading.
+     * @return false if the worker no longer wants the body
+     */
+    fun handleFetchChunk(
+        workerId: String,
+        requestId: String,
+        data: ByteArray?,
+        length: Int,
+        done: Boolean,
+        error: String?
+    ): Boolean {
+        return nativeHandleFetchChunk(workerId, requestId, data, length, done, error)
     }
 
     /**
@@ -140,13 +308,46 @@ object WebWorkerNative {
     // Native methods - implemented in WebWorkerJNI.cpp
 
     private external fun nativeInit(callback: WorkerCallback)
-    private external fun nativeCreateWorker(workerId: String, script: String): String
+    private external fun nativeGetBindingsInstaller(): BindingsInstallerHolder
+    private external fun nativeCreateWorker(
+        workerId: String,
+        script: String,
+        maxHeapSizeMB: Int,
+        initialHeapSizeMB: Int,
+        gcMode: String,
+        stackSizeKB: Int,
+        priority: String,
+        cpuAffinityMask: Long,
+        threadName: String
+    ): String
+    private external fun nativeCreateWorkerFromFile(
+        workerId: String,
+        path: String,
+        assets: AssetManager?,
+        maxHeapSizeMB: Int,
+        initialHeapSizeMB: Int,
+        gcMode: String,
+        stackSizeKB: Int,
+        priority: String,
+        cpuAffinityMask: Long,
+        threadName: String
+    ): String
     private external fun nativeTerminateWorker(workerId: String): Boolean
     private external fun nativePostMessage(workerId: String, message: String): Boolean
     private external fun nativeEvalScript(workerId: String, script: String): String
+    private external fun nativeEvalScriptAsync(workerId: String, script: String, callback: EvalCallback)
+    private external fun nativeStartProfiling(workerId: String, callback: EvalCallback)
+    private external fun nativeStopProfiling(workerId: String, path: String, callback: EvalCallback)
     private external fun nativeHasWorker(workerId: String): Boolean
     private external fun nativeIsWorkerRunning(workerId: String): Boolean
     private external fun nativeCleanup()
+    private external fun nativeSetWarmPoolSize(size: Int)
+    private external fun nativeOnMemoryPressure(critical: Boolean)
+    private external fun nativeSetFetchCacheDirectory(path: String)
+    private external fun nativeSetConsoleLevel(level: String)
+    private external fun nativeCreatePool(poolId: String, script: String, size: Int): Int
+    private external fun nativeCreatePoolFromFile(poolId: String, path: String, assets: AssetManager?, size: Int): Int
+    private external fun nativeTerminatePool(poolId: String): Boolean
     private external fun nativeHandleFetchResponse(
         workerId: String, 
         requestId: String, 
@@ -154,6 +355,15 @@ object WebWorkerNative {
         headerKeys: Array<String>, 
         headerValues: Array<String>, 
         body: ByteArray?, 
-        error: String?
+        error: String?,
+        streaming: Boolean
     )
+    private external fun nativeHandleFetchChunk(
+        workerId: String,
+        requestId: String,
+        data: ByteArray?,
+        length: Int,
+        done: Boolean,
+        error: String?
+    ): Boolean
 }
\ No newline at end of file
@@ -1,12 +1,18 @@
 package com.webworker
 
+import android.content.ComponentCallbacks2
+import android.content.res.AssetManager
+import android.content.res.Configuration
 import android.util.Log
 import com.facebook.react.bridge.Arguments
 import com.facebook.react.bridge.Promise
 import com.facebook.react.bridge.ReactApplicationContext
 import com.facebook.react.module.annotations.ReactModule
+import com.facebook.react.turbomodule.core.interfaces.BindingsInstallerHolder
+import com.facebook.react.turbomodule.core.interfaces.TurboModuleWithJSIBindings
 import okhttp3.Call
 import okhttp3.Callback
+import okhttp3.Dispatcher
 import okhttp3.MediaType
 import okhttp3.MediaType.Companion.toMediaTypeOrNull
 import okhttp3.OkHttpClient
@@ -14,6 +20,7 @@ import okhttp3.Request
 import okhttp3.RequestBody
 import okhttp3.RequestBody.Companion.toRequestBody
 import okhttp3.Response
+import java.io.File
 import java.io.IOException
 import java.util.concurrent.TimeUnit
 
@@ -22,32 +29,59 @@ import java.util.concurrent.TimeUnit
  *
  * This is a thin Android wrapper around the shared C++ WebWorkerCore.
  * Mirrors the iOS implementation in ios/Webworker.mm.
+ *
+ * Worker messages bypass this module: they travel through the JSI binding
+ * installed by getBindingsInstaller().
  */
 @ReactModule(name = WebworkerModule.NAME)
 class WebworkerModule(reactContext: ReactApplicationContext) :
-    NativeWebworkerSpec(reactContext), WebWorkerNative.WorkerCallback {
+    NativeWebworkerSpec(reactContext), WebWorkerNative.WorkerCallback, TurboModuleWithJSIBindings {
+
+    // streamBody holds its OkHttp callback thread while a worker reads
+    // slowly, and OkHttp counts such a call against the per-host limit
+    // (5 by default) until the body is done. Allow more per host so a few
+    // slow readers don't stall every other download from the same server.
+    private val client = OkHttpClient.Builder()
+        .dispatcher(Dispatcher().apply {
+            maxRequests = MAX_FETCH_REQUESTS
+            maxRequestsPerHost = MAX_FETCH_REQUESTS_PER_HOST
+        })
+        .build()
+
+    // Workers each hold a full Hermes heap, give memory back when asked to
+    private val memoryCallbacks = object : ComponentCallbacks2 {
+        override fun onTrimMemory(level: Int) {
+            when {
+                level >= ComponentCallbacks2.TRIM_MEMORY_COMPLETE ||
+                    level == ComponentCallbacks2.TRIM_MEMORY_RUNNING_CRITICAL ->
+                    WebWorkerNative.onMemoryPressure(true)
+                level != ComponentCallbacks2.TRIM_MEMORY_UI_HIDDEN ->
+                    WebWorkerNative.onMemoryPressure(false)
+            }
+        }
+
+        override fun onLowMemory() {
+            WebWorkerNative.onMemoryPressure(true)
+        }
 
-    private val client = OkHttpClient()
+        override fun onConfigurationChanged(newConfig: Configuration) {}
+    }
 
     init {
         // Initialize the native core with this module as the callback receiver
         WebWorkerNative.initialize(this)
+        WebWorkerNative.setFetchCacheDirectory(File(reactContext.cacheDir, "webworker-fetch").absolutePath)
+        reactContext.applicationContext.registerComponentCallbacks(memoryCallbacks)
     }
 
     override fun getName(): String = NAME
 
+    override fun getBindingsInstaller(): BindingsInstallerHolder = WebWorkerNative.getBindingsInstaller()
+
     // ============================================================================
     // Callback handlers - route events from C++ core to JavaScript
     // ============================================================================
 
-    override fun onMessage(workerId: String, message: String) {
-        Log.d(TAG, "[$workerId] Message from worker")
-        emitOnWorkerMessage(Arguments.createMap().apply {
-            putString("workerId", workerId)
-            putString("message", message)
-        })
-    }
-
     override fun onError(workerId: String, error: String) {
         Log.e(TAG, "[$workerId] Error: $error")
         emitOnWorkerError(Arguments.createMap().apply {
@@ -127,7 +161,6 @@ class WebworkerModule(reactContext: ReactApplicationContext) :
             }
 
             override fun onResponse(call: Call, response: Response) {
-                val responseBody = response.body?.bytes()
                 val headers = response.headers
                 val keys = mutableListOf<String>()
                 val values = mutableListOf<String>()
@@ -137,27 +170,77 @@ class WebworkerModule(reactContext: ReactApplicationContext) :
                     values.add(headers.value(i))
                 }
 
+                // The body follows in chunks, see streamBody
                 WebWorkerNative.handleFetchResponse(
                     workerId,
                     requestId,
                     response.code,
                     keys.toTypedArray(),
                     values.toTypedArray(),
-                    responseBody,
-                    null
+                    null,
+                    null,
+                    streaming = true
                 )
+
+                response.use { streamBody(call, it, workerId, requestId) }
             }
         })
     }
 
+    /**
+     * Push the response body to the worker as it downloads. Runs on the OkHttp
+     * callback thread, which the native side blocks while the worker's reader
+     * is behind; the call keeps its dispatcher slot until then, see `client`.
+     */
+    private fun streamBody(call: Call, response: Response, workerId: String, requestId: String) {
+        val body = response.body
+        if (body == null) {
+            WebWorkerNative.handleFetchChunk(workerId, requestId, null, 0, true, null)
+            return
+        }
+
+        try {
+            body.byteStream().use { input ->
+                val buffer = ByteArray(FETCH_CHUNK_SIZE)
+                while (true) {
+                    val read = input.read(buffer)
+                    if (read < 0) break
+                    if (read == 0) continue
+                    if (!WebWorkerNative.handleFetchChunk(workerId, requestId, buffer, read, false, null)) {
+                        // Nobody is reading anymore
+                        call.cancel()
+                        return
+                    }
+                }
+            }
+            WebWorkerNative.handleFetchChunk(workerId, requestId, null, 0, true, null)
+        } catch (e: IOException) {
+            WebWorkerNative.handleFetchChunk(workerId, requestId, null, 0, true, e.message ?: "Network error")
+        }
+    }
+
     // ============================================================================
     // TurboModule Methods - mirror iOS implementation
     // ============================================================================
 
-    override fun createWorker(workerId: String, scriptPath: String, promise: Promise) {
+    override fun createWorker(
+        workerId: String,
+        scriptPath: String,
+        maxHeapSizeMB: Double,
+        initialHeapSizeMB: Double,
+        gcMode: String,
+        stackSizeKB: Double,
+        priority: String,
+        cpuAffinityMask: Double,
+        threadName: String,
+        promise: Promise
+    ) {
         try {
-            val scriptContent = loadScriptFromPath(scriptPath)
-            val resultId = WebWorkerNative.createWorker(workerId, scriptContent)
+            val (path, assets) = resolveScriptPath(scriptPath)
+            val resultId = WebWorkerNative.createWorkerFromFile(
+                workerId, path, assets, maxHeapSizeMB.toInt(), initialHeapSizeMB.toInt(), gcMode,
+                stackSizeKB.toInt(), priority, cpuAffinityMask.toLong(), threadName
+            )
             promise.resolve(resultId)
         } catch (e: Exception) {
             Log.e(TAG, "Failed to create worker from path: ${e.message}")
@@ -165,9 +248,23 @@ class WebworkerModule(reactContext: ReactApplicationContext) :
         }
     }
 
-    override fun createWorkerWithScript(workerId: String, scriptContent: String, promise: Promise) {
+    override fun createWorkerWithScript(
+        workerId: String,
+        scriptContent: String,
+        maxHeapSizeMB: Double,
+        initialHeapSizeMB: Double,
+        gcMode: String,
+        stackSizeKB: Double,
+        priority: String,
+        cpuAffinityMask: Double,
+        threadName: String,
+        promise: Promise
+    ) {
         try {
-            val resultId = WebWorkerNative.createWorker(workerId, scriptContent)
+            val resultId = WebWorkerNative.createWorker(
+                workerId, scriptContent, maxHeapSizeMB.toInt(), initialHeapSizeMB.toInt(), gcMode,
+                stackSizeKB.toInt(), priority, cpuAffinityMask.toLong(), threadName
+            )
             promise.resolve(resultId)
         } catch (e: Exception) {
             Log.e(TAG, "Failed to create worker: ${e.message}")
@@ -196,35 +293,104 @@ class WebworkerModule(reactContext: ReactApplicationContext) :
     }
 
     override fun evalScript(workerId: String, script: String, promise: Promise) {
+        WebWorkerNative.evalScriptAsync(workerId, script, object : WebWorkerNative.EvalCallback {
+            override fun onResult(result: String?, error: String?) {
+                if (error == null) {
+                    promise.resolve(result)
+                } else {
+                    Log.e(TAG, "Failed to evaluate script: $error")
+                    promise.reject("EVAL_ERROR", "Failed to evaluate script: $error")
+                }
+            }
+        })
+    }
+
+    override fun startProfiling(workerId: String, promise: Promise) {
+        WebWorkerNative.startProfiling(workerId, object : WebWorkerNative.EvalCallback {
+            override fun onResult(result: String?, error: String?) {
+                if (error == null) {
+                    promise.resolve(null)
+                } else {
+                    Log.e(TAG, "Failed to start profiling: $error")
+                    promise.reject("PROFILER_ERROR", "Failed to start profiling: $error")
+                }
+            }
+        })
+    }
+
+    override fun stopProfiling(workerId: String, promise: Promise) {
+        val name = workerId.replace(Regex("[^A-Za-z0-9._-]"), "_")
+        val path = File(reactApplicationContext.cacheDir, "$name-${System.currentTimeMillis()}.cpuprofile").absolutePath
+        WebWorkerNative.stopProfiling(workerId, path, object : WebWorkerNative.EvalCallback {
+            override fun onResult(result: String?, error: String?) {
+                if (error == null) {
+                    promise.resolve(result)
+                } else {
+                    Log.e(TAG, "Failed to stop profiling: $error")
+                    promise.reject("PROFILER_ERROR", "Failed to stop profiling: $error")
+                }
+            }
+        })
+    }
+
+    override fun createPool(poolId: String, scriptPath: String, size: Double, promise: Promise) {
+        try {
+            val (path, assets) = resolveScriptPath(scriptPath)
+            val poolSize = WebWorkerNative.createPoolFromFile(poolId, path, assets, size.toInt().coerceAtLeast(0))
+            promise.resolve(poolSize.toDouble())
+        } catch (e: Exception) {
+            Log.e(TAG, "Failed to create pool from path: ${e.message}")
+            promise.reject("WORKER_ERROR", "Failed to create pool: ${e.message}", e)
+        }
+    }
+
+    override fun createPoolWithScript(poolId: String, scriptContent: String, size: Double, promise: Promise) {
+        try {
+            val poolSize = WebWorkerNative.createPool(poolId, scriptContent, size.toInt().coerceAtLeast(0))
+            promise.resolve(poolSize.toDouble())
+        } catch (e: Exception) {
+            Log.e(TAG, "Failed to create pool: ${e.message}")
+            promise.reject("WORKER_ERROR", "Failed to create pool: ${e.message}", e)
+        }
+    }
+
+    override fun terminatePool(poolId: String, promise: Promise) {
         try {
-            val result = WebWorkerNative.evalScript(workerId, script)
-            promise.resolve(result)
+            val success = WebWorkerNative.terminatePool(poolId)
+            promise.resolve(success)
         } catch (e: Exception) {
-            Log.e(TAG, "Failed to evaluate script: ${e.message}")
-            promise.reject("EVAL_ERROR", "Failed to evaluate script: ${e.message}", e)
+            Log.e(TAG, "Failed to terminate pool: ${e.message}")
+            promise.reject("WORKER_ERROR", "Failed to terminate pool: ${e.message}", e)
         }
     }
 
+    override fun setWarmPoolSize(size: Double) {
+        WebWorkerNative.setWarmPoolSize(size.toInt().coerceAtLeast(0))
+    }
+
+    override fun setConsoleLevel(level: String) {
+        WebWorkerNative.setConsoleLevel(level)
+    }
+
     // ============================================================================
     // Helper methods
     // ============================================================================
 
-    private fun loadScriptFromPath(scriptPath: String): String {
-        return try {
-            val context = reactApplicationContext
-            if (scriptPath.startsWith("assets://")) {
-                val assetPath = scriptPath.removePrefix("assets://")
-                context.assets.open(assetPath).bufferedReader().use { it.readText() }
-            } else {
-                java.io.File(scriptPath).readText()
-            }
-        } catch (e: Exception) {
-            throw RuntimeException("Failed to load script from path: $scriptPath", e)
+    /**
+     * Split an "assets://" path into the asset name and the AssetManager to
+     * open it with. Other paths are files and come back with no manager.
+     */
+    private fun resolveScriptPath(scriptPath: String): Pair<String, AssetManager?> {
+        return if (scriptPath.startsWith("assets://")) {
+            Pair(scriptPath.removePrefix("assets://"), reactApplicationContext.assets)
+        } else {
+            Pair(scriptPath, null)
         }
     }
 
     override fun invalidate() {
         super.invalidate()
+        reactApplicationContext.applicationContext.unregisterComponentCallbacks(memoryCallbacks)
         try {
             WebWorkerNative.cleanup()
             Log.d(TAG, "WebWorkerModule invalidated and cleaned up")
@@ -236,5 +402,8 @@ class WebworkerModule(reactContext: ReactApplicationContext) :
     companion object {
         const val NAME = "Webworker"
         private const val TAG = "WebworkerModule"
+        private const val FETCH_CHUNK_SIZE = 64 * 1024
+        private const val MAX_FETCH_REQUESTS = 64
+        private const val MAX_FETCH_REQUESTS_PER_HOST = 16
     }
 }
@@ -4,10 +4,17 @@
 //
 
 #include <jni.h>
+#include <cstring>
 #include <string>
 #include <memory>
+#include <stdexcept>
+#include <vector>
+#include <android/asset_manager.h>
+#include <android/asset_manager_jni.h>
 #include <android/log.h>
+#include <ReactCommon/BindingsInstallerHolder.h>
 #include "WebWorkerCore.h"
+#include "WebWorkerBinding.h"
 #include "networking/FetchTypes.h"
 
 #define LOG_TAG "WebWorkerJNI"
@@ -18,10 +25,10 @@
 static std::shared_ptr<webworker::WebWorkerCore> gCore;
 static JavaVM* gJavaVM = nullptr;
 static jobject gCallbackRef = nullptr;
-static jmethodID gOnMessageMethod = nullptr;
 static jmethodID gOnErrorMethod = nullptr;
 static jmethodID gOnConsoleMethod = nullptr;
 static jmethodID gOnFetchMethod = nullptr;
+static jclass gStringClass = nullptr;
 
 // Helper to convert jstring to std::string
 static std::string jstringToString(JNIEnv* env, jstring jstr) {
@@ -32,8 +39,25 @@ static std::string jstringToString(JNIEnv* env, jstring jstr) {
     return result;
 }
 
+// A thread we attach stays attached until it exits, so the core's
+// delivery and logging threads pay for AttachCurrentThread once
+namespace {
+struct ThreadAttachment {
+    JNIEnv* env = nullptr;
+    bool attached = false;
+
+    ~ThreadAttachment() {
+        if (attached && gJavaVM != nullptr) {
+            gJavaVM->DetachCurrentThread();
+        }
+    }
+};
+thread_local ThreadAttachment tAttachment;
+} // namespace
+
 // Helper to get JNIEnv* in any thread
 static JNIEnv* getJNIEnv() {
+    if (tAttachment.env != nullptr) return tAttachment.env;
     if (gJavaVM == nullptr) return nullptr;
 
     JNIEnv* env = nullptr;
@@ -43,8 +67,12 @@ static JNIEnv* getJNIEnv() {
         if (gJavaVM->AttachCurrentThread(&env, nullptr) != JNI_OK) {
             return nullptr;
         }
+        tAttachment.attached = true;
+    } else if (status != JNI_OK) {
+        return nullptr;
     }
 
+    tAttachment.env = env;
     return env;
 }
 
@@ -52,24 +80,7 @@ static JNIEnv* getJNIEnv() {
 static void setupCallbacks() {
     if (!gCore) return;
 
-    // Message callback
-    gCore->setMessageCallback([](const std::string& workerId, const std::string& message) {
-        JNIEnv* env = getJNIEnv();
-        if (env == nullptr || gCallbackRef == nullptr || gOnMessageMethod == nullptr) return;
-
-        jstring jWorkerId = env->NewStringUTF(workerId.c_str());
-        jstring jMessage = env->NewStringUTF(message.c_str());
-
-        env->CallVoidMethod(gCallbackRef, gOnMessageMethod, jWorkerId, jMessage);
-
-        env->DeleteLocalRef(jWorkerId);
-        env->DeleteLocalRef(jMessage);
-
-        if (env->ExceptionCheck()) {
-            env->ExceptionDescribe();
-            env->ExceptionClear();
-        }
-    });
+    // Messages are delivered by WebWorkerBinding straight into the JS runtime
 
     // Console callback
     gCore->setConsoleCallback([](const std::string& workerId, const std::string& level, const std::string& message) {
@@ -114,7 +125,7 @@ static void setupCallbacks() {
     // Fetch callback
     gCore->setFetchCallback([](const std::string& workerId, const webworker::FetchRequest& request) {
         JNIEnv* env = getJNIEnv();
-        if (env == nullptr || gCallbackRef == nullptr || gOnFetchMethod == nullptr) return;
+        if (env == nullptr || gCallbackRef == nullptr || gOnFetchMethod == nullptr || gStringClass == nullptr) return;
 
         jstring jWorkerId = env->NewStringUTF(workerId.c_str());
         jstring jRequestId = env->NewStringUTF(request.requestId.c_str());
@@ -123,9 +134,8 @@ static void setupCallbacks() {
         jstring jRedirect = env->NewStringUTF(request.redirect.c_str());
         jdouble jTimeout = (jdouble)request.timeout;
         
-        jclass strClass = env->FindClass("java/lang/String");
-        jobjectArray jHeaderKeys = env->NewObjectArray(request.headers.size(), strClass, nullptr);
-        jobjectArray jHeaderValues = env->NewObjectArray(request.headers.size(), strClass, nullptr);
+        jobjectArray jHeaderKeys = env->NewObjectArray(request.headers.size(), gStringClass, nullptr);
+        jobjectArray jHeaderValues = env->NewObjectArray(request.headers.size(), gStringClass, nullptr);
         
         int i = 0;
         for (const auto& header : request.headers) {
@@ -162,10 +172,122 @@ static void setupCallbacks() {
     });
 }
 
+// Wrap a Kotlin EvalCallback; the C++ callback must be called exactly once
+static webworker::EvalCallback makeEvalCallback(JNIEnv* env, jobject callback) {
+    jobject callbackRef = env->NewGlobalRef(callback);
+    jclass callbackClass = env->GetObjectClass(callback);
+    jmethodID onResult = env->GetMethodID(callbackClass, "onResult", "(Ljava/lang/String;Ljava/lang/String;)V");
+    env->DeleteLocalRef(callbackClass);
+
+    return [callbackRef, onResult](const std::string& result, const std::string& error) {
+        JNIEnv* env = getJNIEnv();
+        if (env == nullptr) return;
+
+        jstring jResult = error.empty() ? env->NewStringUTF(result.c_str()) : nullptr;
+        jstring jError = error.empty() ? nullptr : env->NewStringUTF(error.c_str());
+
+        env->CallVoidMethod(callbackRef, onResult, jResult, jError);
+
+        if (jResult) env->DeleteLocalRef(jResult);
+        if (jError) env->DeleteLocalRef(jError);
+        env->DeleteGlobalRef(callbackRef);
+
+        if (env->ExceptionCheck()) {
+            env->ExceptionDescribe();
+            env->ExceptionClear();
+        }
+    };
+}
+
+namespace {
+
+// An APK asset as a jsi::Buffer. Uncompressed assets are mapped straight
+// out of the APK, compressed ones are inflated once by the asset manager.
+class AssetBuffer : public facebook::jsi::Buffer {
+public:
+    explicit AssetBuffer(AAsset* asset)
+        : asset_(asset)
+        , data_(static_cast<const uint8_t*>(AAsset_getBuffer(asset)))
+        , size_(static_cast<size_t>(AAsset_getLength64(asset))) {}
+
+    ~AssetBuffer() override { AAsset_close(asset_); }
+
+    size_t size() const override { return size_; }
+    const uint8_t* data() const override { return data_; }
+
+private:
+    AAsset* asset_;
+    const uint8_t* data_;
+    size_t size_;
+};
+
+// Hermes only runs bytecode from 8 byte aligned memory, which an asset
+// stored at an arbitrary offset in the APK may not be
+class AlignedCopyBuffer : public facebook::jsi::Buffer {
+public:
+    AlignedCopyBuffer(const uint8_t* data, size_t size)
+        : storage_((size + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+        , size_(size) {
+        std::memcpy(storage_.data(), data, size);
+    }
+
+    size_t size() const override { return size_; }
+    const uint8_t* data() const override { return reinterpret_cast<const uint8_t*>(storage_.data()); }
+
+private:
+    std::vector<uint64_t> storage_;
+    size_t size_;
+};
+
+} // namespace
+
+// Open a worker script: `path` is an asset name when `assetManager` is set,
+// a file path otherwise. Bytecode isn't copied unless it needs aligning;
+// source is, since the compiler wants a NUL past its end.
+static std::shared_ptr<const facebook::jsi::Buffer> openScript(
+    JNIEnv* env,
+    jobject assetManager,
+    const std::string& path
+) {
+    if (assetManager == nullptr) {
+        return webworker::MappedBuffer::openScript(path);
+    }
+
+    AAssetManager* manager = AAssetManager_fromJava(env, assetManager);
+    AAsset* asset = manager ? AAssetManager_open(manager, path.c_str(), AASSET_MODE_BUFFER) : nullptr;
+    if (asset == nullptr) {
+        throw std::runtime_error("Cannot open asset " + path);
+    }
+    auto buffer = std::make_shared<AssetBuffer>(asset);
+    if (buffer->data() == nullptr) {
+        throw std::runtime_error("Cannot read asset " + path);
+    }
+
+    if (!facebook::hermes::HermesRuntime::isHermesBytecode(buffer->data(), buffer->size())) {
+        return std::make_shared<facebook::jsi::StringBuffer>(
+            std::string(reinterpret_cast<const char*>(buffer->data()), buffer->size()));
+    }
+    bool aligned = reinterpret_cast<uintptr_t>(buffer->data()) % alignof(uint64_t) == 0;
+    if (!aligned) {
+        return std::make_shared<AlignedCopyBuffer>(buffer->data(), buffer->size());
+    }
+    return buffer;
+}
+
 extern "C" {
 
 JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
     gJavaVM = vm;
+
+    // Resolved once here rather than on every fetch
+    JNIEnv* env = nullptr;
+    if (vm->GetEnv((void**)&env, JNI_VERSION_1_6) == JNI_OK) {
+        jclass stringClass = env->FindClass("java/lang/String");
+        if (stringClass != nullptr) {
+            gStringClass = static_cast<jclass>(env->NewGlobalRef(stringClass));
+            env->DeleteLocalRef(stringClass);
+        }
+    }
     return JNI_VERSION_1_6;
 }
 
@@ -189,27 +311,95 @@ Java_com_webworker_WebWorkerNative_nativeInit(
     if (callback != nullptr) {
         gCallbackRef = env->NewGlobalRef(callback);
         jclass callbackClass = env->GetObjectClass(callback);
-        gOnMessageMethod = env->GetMethodID(callbackClass, "onMessage", "(Ljava/lang/String;Ljava/lang/String;)V");
         gOnErrorMethod = env->GetMethodID(callbackClass, "onError", "(Ljava/lang/String;Ljava/lang/String;)V");
         gOnConsoleMethod = env->GetMethodID(callbackClass, "onConsole", "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;)V");
         gOnFetchMethod = env->GetMethodID(callbackClass, "onFetch", "(Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;Ljava/lang/String;[Ljava/lang/String;[Ljava/lang/String;[BDLjava/lang/String;)V");
+        env->DeleteLocalRef(callbackClass);
     }
 
     setupCallbacks();
 }
 
+JNIEXPORT jobject JNICALL
+Java_com_webworker_WebWorkerNative_nativeGetBindingsInstaller(
+    JNIEnv* env,
+    jobject thiz
+) {
+    auto installer = facebook::react::BindingsInstallerHolder::newObjectCxxArgs(
+        [](facebook::jsi::Runtime& runtime,
+           const std::shared_ptr<facebook::react::CallInvoker>& callInvoker) {
+            webworker::WebWorkerBinding::install(runtime, gCore, callInvoker);
+        });
+    return installer.release();
+}
+
 JNIEXPORT jstring JNICALL
 Java_com_webworker_WebWorkerNative_nativeCreateWorker(
     JNIEnv* env,
     jobject thiz,
     jstring workerId,
-    jstring script
+    jstring script,
+    jint maxHeapSizeMB,
+    jint initialHeapSizeMB,
+    jstring gcMode,
+    jint stackSizeKB,
+    jstring priority,
+    jlong cpuAffinityMask,
+    jstring threadName
 ) {
     if (!gCore) return nullptr;
     std::string id = jstringToString(env, workerId);
     std::string scriptStr = jstringToString(env, script);
+
+    webworker::WorkerConfig config;
+    config.maxHeapSizeMB = maxHeapSizeMB > 0 ? static_cast<uint32_t>(maxHeapSizeMB) : 0;
+    config.initialHeapSizeMB = initialHeapSizeMB > 0 ? static_cast<uint32_t>(initialHeapSizeMB) : 0;
+    config.gcMode = webworker::WorkerConfig::parseGCMode(jstringToString(env, gcMode));
+    config.stackSizeKB = stackSizeKB > 0 ? static_cast<uint32_t>(stackSizeKB) : 0;
+    config.thread.priority = webworker::ThreadOptions::parsePriority(jstringToString(env, priority));
+    config.thread.cpuAffinityMask = static_cast<uint64_t>(cpuAffinityMask);
+    config.thread.name = jstringToString(env, threadName);
+
     try {
-        std::string resultId = gCore->createWorker(id, scriptStr);
+        std::string resultId = gCore->createWorker(id, scriptStr, config);
+        return env->NewStringUTF(resultId.c_str());
+    } catch (const std::exception& e) {
+        jclass exClass = env->FindClass("java/lang/RuntimeException");
+        env->ThrowNew(exClass, e.what());
+        return nullptr;
+    }
+}
+
+JNIEXPORT jstring JNICALL
+Java_com_webworker_WebWorkerNative_nativeCreateWorkerFromFile(
+    JNIEnv* env,
+    jobject thiz,
+    jstring workerId,
+    jstring path,
+    jobject assetManager,
+    jint maxHeapSizeMB,
+    jint initialHeapSizeMB,
+    jstring gcMode,
+    jint stackSizeKB,
+    jstring priority,
+    jlong cpuAffinityMask,
+    jstring threadName
+) {
+    if (!gCore) return nullptr;
+    std::string id = jstringToString(env, workerId);
+
+    webworker::WorkerConfig config;
+    config.maxHeapSizeMB = maxHeapSizeMB > 0 ? static_cast<uint32_t>(maxHeapSizeMB) : 0;
+    config.initialHeapSizeMB = initialHeapSizeMB > 0 ? static_cast<uint32_t>(initialHeapSizeMB) : 0;
+    config.gcMode = webworker::WorkerConfig::parseGCMode(jstringToString(env, gcMode));
+    config.stackSizeKB = stackSizeKB > 0 ? static_cast<uint32_t>(stackSizeKB) : 0;
+    config.thread.priority = webworker::ThreadOptions::parsePriority(jstringToString(env, priority));
+    config.thread.cpuAffinityMask = static_cast<uint64_t>(cpuAffinityMask);
+    config.thread.name = jstringToString(env, threadName);
+
+    try {
+        auto script = openScript(env, assetManager, jstringToString(env, path));
+        std::string resultId = gCore->createWorker(id, std::move(script), config);
         return env->NewStringUTF(resultId.c_str());
     } catch (const std::exception& e) {
         jclass exClass = env->FindClass("java/lang/RuntimeException");
@@ -257,6 +447,45 @@ Java_com_webworker_WebWorkerNative_nativeEvalScript(
     }
 }
 
+JNIEXPORT void JNICALL
+Java_com_webworker_WebWorkerNative_nativeEvalScriptAsync(
+    JNIEnv* env,
+    jobject thiz,
+    jstring workerId,
+    jstring script,
+    jobject callback
+) {
+    if (!gCore || callback == nullptr) return;
+
+    // Called once, on the worker thread or right here if the worker is gone
+    gCore->evalScriptAsync(jstringToString(env, workerId), jstringToString(env, script),
+                           makeEvalCallback(env, callback));
+}
+
+JNIEXPORT void JNICALL
+Java_com_webworker_WebWorkerNative_nativeStartProfiling(
+    JNIEnv* env,
+    jobject thiz,
+    jstring workerId,
+    jobject callback
+) {
+    if (!gCore || callback == nullptr) return;
+    gCore->startProfiling(jstringToString(env, workerId), makeEvalCallback(env, callback));
+}
+
+JNIEXPORT void JNICALL
+Java_com_webworker_WebWorkerNative_nativeStopProfiling(
+    JNIEnv* env,
+    jobject thiz,
+    jstring workerId,
+    jstring path,
+    jobject callback
+) {
+    if (!gCore || callback == nullptr) return;
+    gCore->stopProfiling(jstringToString(env, workerId), jstringToString(env, path),
+                         makeEvalCallback(env, callback));
+}
+
 JNIEXPORT void JNICALL
 Java_com_webworker_WebWorkerNative_nativeCleanup(
     JNIEnv* env,
@@ -272,6 +501,100 @@ Java_com_webworker_WebWorkerNative_nativeCleanup(
     }
 }
 
+JNIEXPORT void JNICALL
+Java_com_webworker_WebWorkerNative_nativeSetWarmPoolSize(
+    JNIEnv* env,
+    jobject thiz,
+    jint size
+) {
+    if (!gCore) return;
+    gCore->setWarmPoolSize(size > 0 ? static_cast<size_t>(size) : 0);
+}
+
+JNIEXPORT void JNICALL
+Java_com_webworker_WebWorkerNative_nativeOnMemoryPressure(
+    JNIEnv* env,
+    jobject thiz,
+    jboolean critical
+) {
+    if (!gCore) return;
+    gCore->onMemoryPressure(critical ? webworker::MemoryPressure::Critical
+                                     : webworker::MemoryPressure::Moderate);
+}
+
+JNIEXPORT void JNICALL
+Java_com_webworker_WebWorkerNative_nativeSetConsoleLevel(
+    JNIEnv* env,
+    jobject thiz,
+    jstring level
+) {
+    if (!gCore) return;
+    gCore->setConsoleLevel(webworker::parseConsoleLevel(jstringToString(env, level)));
+}
+
+JNIEXPORT void JNICALL
+Java_com_webworker_WebWorkerNative_nativeSetFetchCacheDirectory(
+    JNIEnv* env,
+    jobject thiz,
+    jstring path
+) {
+    if (!gCore) return;
+    gCore->setFetchCacheDirectory(jstringToString(env, path));
+}
+
+JNIEXPORT jint JNICALL
+Java_com_webworker_WebWorkerNative_nativeCreatePool(
+    JNIEnv* env,
+    jobject thiz,
+    jstring poolId,
+    jstring script,
+    jint size
+) {
+    if (!gCore) return 0;
+    std::string id = jstringToString(env, poolId);
+    std::string scriptStr = jstringToString(env, script);
+    try {
+        size_t poolSize = gCore->createPool(id, scriptStr, size > 0 ? static_cast<size_t>(size) : 0);
+        return static_cast<jint>(poolSize);
+    } catch (const std::exception& e) {
+        jclass exClass = env->FindClass("java/lang/RuntimeException");
+        env->ThrowNew(exClass, e.what());
+        return 0;
+    }
+}
+
+JNIEXPORT jint JNICALL
+Java_com_webworker_WebWorkerNative_nativeCreatePoolFromFile(
+    JNIEnv* env,
+    jobject thiz,
+    jstring poolId,
+    jstring path,
+    jobject assetManager,
+    jint size
+) {
+    if (!gCore) return 0;
+    std::string id = jstringToString(env, poolId);
+    try {
+        auto script = openScript(env, assetManager, jstringToString(env, path));
+        size_t poolSize = gCore->createPool(id, std::move(script), size > 0 ? static_cast<size_t>(size) : 0);
+        return static_cast<jint>(poolSize);
+    } catch (const std::exception& e) {
+        jclass exClass = env->FindClass("java/lang/RuntimeException");
+        env->ThrowNew(exClass, e.what());
+        return 0;
+    }
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_webworker_WebWorkerNative_nativeTerminatePool(
+    JNIEnv* env,
+    jobject thiz,
+    jstring poolId
+) {
+    if (!gCore) return JNI_FALSE;
+    return gCore->terminatePool(jstringToString(env, poolId)) ? JNI_TRUE : JNI_FALSE;
+}
+
 JNIEXPORT jboolean JNICALL
 Java_com_webworker_WebWorkerNative_nativeHasWorker(
     JNIEnv* env,
@@ -302,12 +625,14 @@ Java_com_webworker_WebWorkerNative_nativeHandleFetchResponse(
     jobjectArray headerKeys,
     jobjectArray headerValues,
     jbyteArray body,
-    jstring error
+    jstring error,
+    jboolean streaming
 ) {
     if (!gCore) return;
 
     webworker::FetchResponse response;
     response.requestId = jstringToString(env, requestId);
+    response.streaming = streaming == JNI_TRUE;
     
     std::string errorStr = jstringToString(env, error);
     if (!errorStr.empty()) {
@@ -325,14 +650,41 @@ Java_com_webworker_WebWorkerNative_nativeHandleFetchResponse(
         }
         
         if (body != nullptr) {
+            // Copied once, straight into the storage that ends up in JS
             jsize len = env->GetArrayLength(body);
-            jbyte* bytes = env->GetByteArrayElements(body, nullptr);
-            response.body.assign(bytes, bytes + len);
-            env->ReleaseByteArrayElements(body, bytes, JNI_ABORT);
+            std::vector<uint8_t> bytes(static_cast<size_t>(len));
+            env->GetByteArrayRegion(body, 0, len, reinterpret_cast<jbyte*>(bytes.data()));
+            response.body = webworker::FetchBody(std::move(bytes));
         }
     }
     
-    gCore->handleFetchResponse(jstringToString(env, workerId), response);
+    gCore->handleFetchResponse(jstringToString(env, workerId), std::move(response));
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_webworker_WebWorkerNative_nativeHandleFetchChunk(
+    JNIEnv* env,
+    jobject thiz,
+    jstring workerId,
+    jstring requestId,
+    jbyteArray data,
+    jint length,
+    jboolean done,
+    jstring error
+) {
+    if (!gCore) return JNI_FALSE;
+
+    webworker::FetchChunk chunk;
+    chunk.requestId = jstringToString(env, requestId);
+    chunk.done = done == JNI_TRUE;
+    chunk.error = jstringToString(env, error);
+    if (data != nullptr && length > 0) {
+        std::vector<uint8_t> bytes(static_cast<size_t>(length));
+        env->GetByteArrayRegion(data, 0, length, reinterpret_cast<jbyte*>(bytes.data()));
+        chunk.data = webworker::FetchBody(std::move(bytes));
+    }
+
+    return gCore->handleFetchChunk(jstringToString(env, workerId), std::move(chunk)) ? JNI_TRUE : JNI_FALSE;
 }
 
 } // extern "C"
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "TaskQueue.h"
+
+using namespace webworker;
+
+namespace {
+
+constexpr int64_t kTasksPerIteration = 1 << 16;
+
+Task makeTask(uint64_t id, std::function<void()> execute = nullptr) {
+    Task task;
+    task.type = TaskType::Message;
+    task.id = id;
+    task.execute = std::move(execute);
+    return task;
+}
+
+} // namespace
+
+// Producers enqueue concurrently while the consumer drains, like a worker
+// receiving messages from several threads
+static void BM_TaskQueueThroughput(benchmark::State& state) {
+    const int producers = static_cast<int>(state.range(0));
+    const int64_t perProducer = kTasksPerIteration / producers;
+
+    for (auto _ : state) {
+        TaskQueue queue;
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&queue, p, perProducer]() {
+                for (int64_t i = 0; i < perProducer; i++) {
+                    queue.enqueue(makeTask(static_cast<uint64_t>(p * perProducer + i)));
+                }
+            });
+        }
+
+        int64_t received = 0;
+        while (received < perProducer * producers) {
+            if (queue.dequeue(std::chrono::milliseconds(100))) received++;
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        benchmark::DoNotOptimize(received);
+    }
+
+    state.SetItemsProcessed(state.iterations() * perProducer * producers);
+}
+BENCHMARK(BM_TaskQueueThroughput)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+
+// Uncontended enqueue/dequeue pairs on the consumer thread
+static void BM_TaskQueueEnqueueDequeue(benchmark::State& state) {
+    TaskQueue queue;
+    uint64_t id = 0;
+
+    for (auto _ : state) {
+        queue.enqueue(makeTask(id++));
+        benchmark::DoNotOptimize(queue.tryDequeueImmediate());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TaskQueueEnqueueDequeue);
+
+// Schedule and cancel a timer among `range(0)` pending ones, the pattern of
+// debounce and timeout helpers
+static void BM_TimerScheduleCancel(benchmark::State& state) {
+    const int64_t pending = state.range(0);
+    TaskQueue queue;
+    uint64_t id = 0;
+    for (int64_t i = 0; i < pending; i++) {
+        queue.enqueueDelayed(makeTask(id++), std::chrono::milliseconds(1000 + i % 60000));
+    }
+
+    for (auto _ : state) {
+        uint64_t timerId = id++;
+        queue.enqueueDelayed(makeTask(timerId), std::chrono::milliseconds(500));
+        benchmark::DoNotOptimize(queue.cancel(timerId));
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TimerScheduleCancel)->Arg(0)->Arg(1 << 10)->Arg(1 << 16);
+
+// Timers that come due together, scheduled and then all fired. Wall time
+// includes waiting for the next millisecond tick.
+static void BM_TimerExpire(benchmark::State& state) {
+    const int64_t timers = state.range(0);
+
+    for (auto _ : state) {
+        TaskQueue queue;
+        for (int64_t i = 0; i < timers; i++) {
+            queue.enqueueDelayed(makeTask(static_cast<uint64_t>(i)), std::chrono::milliseconds(0));
+        }
+        int64_t fired = 0;
+        while (fired < timers) {
+            if (queue.dequeue(std::chrono::milliseconds(100))) fired++;
+        }
+        benchmark::DoNotOptimize(fired);
+    }
+
+    state.SetItemsProcessed(state.iterations() * timers);
+}
+BENCHMARK(BM_TimerExpire)->Arg(1 << 10)->Arg(1 << 14);
@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "WebWorkerCore.h"
+
+using namespace webworker;
+
+namespace {
+
+constexpr const char* kEchoScript = R"(
+    self.onmessage = function(event) {
+        self.postMessage(event.data);
+    };
+)";
+
+// Counts messages coming back from workers
+class Replies {
+public:
+    MessageCallback callback() {
+        return [this](const std::string&, std::shared_ptr<SerializedMessage>) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                count_++;
+            }
+            condition_.notify_all();
+        };
+    }
+
+    bool waitFor(uint64_t count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return condition_.wait_for(lock, std::chrono::seconds(10), [&] { return count_ >= count; });
+    }
+
+private:
+    uint64_t count_{0};
+    std::mutex mutex_;
+    std::condition_variable condition_;
+};
+
+} // namespace
+
+// createWorker until the script ran, then terminateWorker. range(0) is the
+// warm pool size; with a pool the runtime is already booted.
+static void BM_WorkerCreateTerminate(benchmark::State& state) {
+    WebWorkerCore core;
+    core.setWarmPoolSize(static_cast<size_t>(state.range(0)));
+    uint64_t index = 0;
+
+    for (auto _ : state) {
+        std::string workerId = "bench-" + std::to_string(index++);
+        core.createWorker(workerId, "");
+        core.terminateWorker(workerId);
+
+        if (state.range(0) > 0) {
+            // Let the pool refill outside of the measurement
+            state.PauseTiming();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            state.ResumeTiming();
+        }
+    }
+}
+BENCHMARK(BM_WorkerCreateTerminate)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Host -> worker -> host with a string payload of range(0) bytes
+static void BM_EchoRoundTrip(benchmark::State& state) {
+    Replies replies;
+    WebWorkerCore core;
+    core.setMessageCallback(replies.callback());
+    core.createWorker("echo", kEchoScript);
+
+    std::string payload = "\"" + std::string(static_cast<size_t>(state.range(0)), 'x') + "\"";
+    uint64_t sent = 0;
+
+    for (auto _ : state) {
+        if (!core.postMessage("echo", payload)) {
+            state.SkipWithError("postMessage failed");
+            break;
+        }
+        if (!replies.waitFor(++sent)) {
+            state.SkipWithError("worker did not reply");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 2);
+    core.terminateAll();
+}
+BENCHMARK(BM_EchoRoundTrip)->RangeMultiplier(16)->Range(16, 1 << 20)->Unit(benchmark::kMicrosecond)->UseRealTime();
@@ -0,0 +1,625 @@
+#include "Atomics.h"
+#include "NativeArrayBuffer.h"
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <thread>
+
+namespace webworker {
+
+namespace {
+
+// Must match the order of `kinds` in kAtomicsScript
+enum class ElementKind : int {
+    Int8,
+    Uint8,
+    Int16,
+    Uint16,
+    Int32,
+    Uint32,
+};
+
+// Must match the codes used by kAtomicsScript
+enum class AtomicsOp : int {
+    Load,
+    Store,
+    Add,
+    Sub,
+    And,
+    Or,
+    Xor,
+    Exchange,
+    CompareExchange,
+};
+
+size_t elementSize(ElementKind kind) {
+    switch (kind) {
+    case ElementKind::Int8:
+    case ElementKind::Uint8:
+        return 1;
+    case ElementKind::Int16:
+    case ElementKind::Uint16:
+        return 2;
+    case ElementKind::Int32:
+    case ElementKind::Uint32:
+        return 4;
+    }
+    return 0;
+}
+
+double toInteger(double value) {
+    if (std::isnan(value)) return 0;
+    return std::trunc(value);
+}
+
+// ToUint32: the modular conversion every integer TypedArray store uses
+uint32_t toUint32(double value) {
+    if (!std::isfinite(value)) return 0;
+    double modulo = std::fmod(std::trunc(value), 4294967296.0);
+    if (modulo < 0) modulo += 4294967296.0;
+    return static_cast<uint32_t>(modulo);
+}
+
+template <typename T>
+double atomicOp(AtomicsOp op, uint8_t* address, double value, double replacement) {
+    T* target = reinterpret_cast<T*>(address);
+    T operand = static_cast<T>(toUint32(value));
+
+    switch (op) {
+    case AtomicsOp::Load:
+        return static_cast<double>(__atomic_load_n(target, __ATOMIC_SEQ_CST));
+    case AtomicsOp::Store:
+        __atomic_store_n(target, operand, __ATOMIC_SEQ_CST);
+        return toInteger(value);
+    case AtomicsOp::Add:
+        return static_cast<double>(__atomic_fetch_add(target, operand, __ATOMIC_SEQ_CST));
+    case AtomicsOp::Sub:
+        return static_cast<double>(__atomic_fetch_sub(target, operand, __ATOMIC_SEQ_CST));
+    case AtomicsOp::And:
+        return static_cast<double>(__atomic_fetch_and(target, operand, __ATOMIC_SEQ_CST));
+    case AtomicsOp::Or:
+        return static_cast<double>(__atomic_fetch_or(target, operand, __ATOMIC_SEQ_CST));
+    case AtomicsOp::Xor:
+        return static_cast<double>(__atomic_fetch_xor(target, operand, __ATOMIC_SEQ_CST));
+    case AtomicsOp::Exchange:
+        return static_cast<double>(__atomic_exchange_n(target, operand, __ATOMIC_SEQ_CST));
+    case AtomicsOp::CompareExchange: {
+        T expected = operand;
+        __atomic_compare_exchange_n(target, &expected, static_cast<T>(toUint32(replacement)),
+                                    false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        return static_cast<double>(expected);
+    }
+    }
+    return 0;
+}
+
+/**
+ * Resolve `buffer` + `byteIndex` to the address of an element of `size`
+ * bytes. The JS side already validated the index; this re-checks it so a
+ * hand-made call can't reach outside the buffer.
+ */
+uint8_t* elementAddress(Runtime& rt, const Value& buffer, const Value& byteIndex, size_t size,
+                        bool requireShared) {
+    if (!buffer.isObject() || !buffer.getObject(rt).isArrayBuffer(rt) || !byteIndex.isNumber()) {
+        throw JSError(rt, "TypeError: Atomics: invalid arguments");
+    }
+
+    ArrayBuffer arrayBuffer = buffer.getObject(rt).getArrayBuffer(rt);
+    uint8_t* data = arrayBuffer.data(rt);
+    size_t length = arrayBuffer.size(rt);
+
+    double index = byteIndex.getNumber();
+    if (!(index >= 0) || index + size > length || std::fmod(index, static_cast<double>(size)) != 0) {
+        throw JSError(rt, "RangeError: Atomics: index out of range");
+    }
+
+    if (requireShared) {
+        auto native = NativeArrayBuffer::find(data, length);
+        if (!native || !native->isShared()) {
+            throw JSError(rt, "TypeError: Atomics: expected a SharedArrayBuffer");
+        }
+    }
+
+    return data + static_cast<size_t>(index);
+}
+
+constexpr const char* kAtomicsScript = R"(
+(function(native) {
+    var global = globalThis;
+
+    if (typeof global.SharedArrayBuffer === 'undefined') {
+        var SharedArrayBuffer = function SharedArrayBuffer(length) {
+            return native.createShared(length === undefined ? 0 : Number(length));
+        };
+        Object.defineProperty(SharedArrayBuffer, Symbol.hasInstance, {
+            value: function(value) { return native.isShared(value); }
+        });
+        Object.defineProperty(global, 'SharedArrayBuffer', {
+            value: SharedArrayBuffer, writable: true, configurable: true
+        });
+    }
+
+    if (typeof global.Atomics !== 'undefined') {
+        return;
+    }
+
+    var kinds = [Int8Array, Uint8Array, Int16Array, Uint16Array, Int32Array, Uint32Array];
+    var INT32 = 4;
+
+    function kindOf(typedArray, waitable) {
+        for (var i = 0; i < kinds.length; i++) {
+            if (typedArray instanceof kinds[i]) {
+                if (waitable && i !== INT32) break;
+                return i;
+            }
+        }
+        throw new TypeError(waitable
+            ? 'Atomics: expected an Int32Array'
+            : 'Atomics: expected an integer TypedArray');
+    }
+
+    function byteIndex(typedArray, index) {
+        var i = index === undefined ? 0 : Number(index);
+        if (i !== Math.floor(i) || i < 0 || i >= typedArray.length) {
+            throw new RangeError('Atomics: index out of range');
+        }
+        return typedArray.byteOffset + i * typedArray.BYTES_PER_ELEMENT;
+    }
+
+    function timeoutOf(timeout) {
+        var t = Number(timeout);
+        return t !== t ? Infinity : Math.max(t, 0);
+    }
+
+    function operation(code) {
+        return function(typedArray, index, value, replacement) {
+            var kind = kindOf(typedArray, false);
+            return native.op(code, typedArray.buffer, byteIndex(typedArray, index), kind,
+                Number(value), Number(replacement));
+        };
+    }
+
+    var pending = new Map();
+    var nextPromiseId = 1;
+
+    Object.defineProperty(global, '__webworkerAtomicsSettle', {
+        value: function(id, result) {
+            var resolve = pending.get(id);
+            if (resolve) {
+                pending.delete(id);
+                resolve(result);
+            }
+        }
+    });
+
+    var Atomics = {
+        load: operation(0),
+        store: operation(1),
+        add: operation(2),
+        sub: operation(3),
+        and: operation(4),
+        or: operation(5),
+        xor: operation(6),
+        exchange: operation(7),
+        compareExchange: operation(8),
+        wait: function(typedArray, index, value, timeout) {
+            kindOf(typedArray, true);
+            return native.wait(typedArray.buffer, byteIndex(typedArray, index),
+                Number(value), timeoutOf(timeout));
+        },
+        waitAsync: function(typedArray, index, value, timeout) {
+            kindOf(typedArray, true);
+            var id = nextPromiseId++;
+            var result = native.waitAsync(typedArray.buffer, byteIndex(typedArray, index),
+                Number(value), timeoutOf(timeout), id);
+            if (result !== undefined) {
+                return { async: false, value: result };
+            }
+            return {
+                async: true,
+                value: new Promise(function(resolve) { pending.set(id, resolve); })
+            };
+        },
+        notify: function(typedArray, index, count) {
+            kindOf(typedArray, true);
+            var c = count === undefined ? Infinity : Math.max(Math.floor(Number(count)) || 0, 0);
+            return native.notify(typedArray.buffer, byteIndex(typedArray, index), c);
+        },
+        isLockFree: function(size) {
+            return size === 1 || size === 2 || size === 4;
+        }
+    };
+    Object.defineProperty(Atomics, Symbol.toStringTag, { value: 'Atomics' });
+
+    Object.defineProperty(global, 'Atomics', {
+        value: Atomics, writable: true, configurable: true
+    });
+})
+)";
+
+} // namespace
+
+// ============================================================================
+// WaiterList
+// ============================================================================
+
+/**
+ * Every runtime's waiters in one list, so a notify from any thread finds
+ * them. Sync waiters block on their own condition variable under mutex_;
+ * async waiters are settled through their context's scheduler.
+ */
+class WaiterList {
+public:
+    static WaiterList& instance() {
+        // Leaked on purpose: the timeout thread may outlive static destructors
+        static WaiterList* list = new WaiterList();
+        return *list;
+    }
+
+    const char* wait(AtomicsContext& context, const int32_t* address, int32_t expected,
+                     double timeoutMs);
+    const char* waitAsync(const std::shared_ptr<AtomicsContext>& context, const int32_t* address,
+                          int32_t expected, double timeoutMs, uint64_t promiseId);
+    size_t notify(const void* address, size_t count);
+    void removeAll(AtomicsContext* context);
+
+private:
+    struct Waiter {
+        const void* address;
+        AtomicsContext* owner;
+
+        // Atomics.wait
+        std::condition_variable* condition{nullptr};
+        bool woken{false};
+        bool interrupted{false};
+
+        // Atomics.waitAsync
+        std::weak_ptr<AtomicsContext> context;
+        uint64_t promiseId{0};
+        bool hasDeadline{false};
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void timeoutThreadMain();
+
+    std::mutex mutex_;
+    std::list<std::shared_ptr<Waiter>> waiters_;
+    std::condition_variable timeoutCondition_;
+    bool timeoutThreadStarted_{false};
+};
+
+const char* WaiterList::wait(
+    AtomicsContext& context,
+    const int32_t* address,
+    int32_t expected,
+    double timeoutMs
+) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    // Checked under mutex_ so a notify can't slip in between
+    if (__atomic_load_n(address, __ATOMIC_SEQ_CST) != expected) {
+        return "not-equal";
+    }
+    if (context.isClosed() || timeoutMs <= 0) {
+        return "timed-out";
+    }
+
+    std::condition_variable condition;
+    auto waiter = std::make_shared<Waiter>();
+    waiter->address = address;
+    waiter->owner = &context;
+    waiter->condition = &condition;
+    waiters_.push_back(waiter);
+
+    auto done = [&waiter] { return waiter->woken || waiter->interrupted; };
+    if (std::isinf(timeoutMs)) {
+        condition.wait(lock, done);
+    } else {
+        auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(timeoutMs));
+        condition.wait_until(lock, deadline, done);
+    }
+
+    if (waiter->woken) {
+        return "ok";
+    }
+    waiters_.remove(waiter);
+    return "timed-out";
+}
+
+const char* WaiterList::waitAsync(
+    const std::shared_ptr<AtomicsContext>& context,
+    const int32_t* address,
+    int32_t expected,
+    double timeoutMs,
+    uint64_t promiseId
+) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (__atomic_load_n(address, __ATOMIC_SEQ_CST) != expected) {
+        return "not-equal";
+    }
+    if (context->isClosed() || timeoutMs <= 0) {
+        return "timed-out";
+    }
+
+    auto waiter = std::make_shared<Waiter>();
+    waiter->address = address;
+    waiter->owner = context.get();
+    waiter->context = context;
+    waiter->promiseId = promiseId;
+    if (!std::isinf(timeoutMs)) {
+        waiter->hasDeadline = true;
+        waiter->deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double, std::milli>(timeoutMs));
+
+        if (!timeoutThreadStarted_) {
+            timeoutThreadStarted_ = true;
+            std::thread(&WaiterList::timeoutThreadMain, this).detach();
+        }
+        timeoutCondition_.notify_one();
+    }
+    waiters_.push_back(std::move(waiter));
+    return nullptr;
+}
+
+size_t WaiterList::notify(const void* address, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    size_t woken = 0;
+    for (auto it = waiters_.begin(); it != waiters_.end() && woken < count;) {
+        auto& waiter = *it;
+        if (waiter->address != address) {
+            ++it;
+            continue;
+        }
+
+        if (waiter->condition) {
+            waiter->woken = true;
+            waiter->condition->notify_one();
+        } else if (auto context = waiter->context.lock()) {
+            context->settle(waiter->promiseId, "ok");
+        }
+        it = waiters_.erase(it);
+        woken++;
+    }
+    return woken;
+}
+
+void WaiterList::removeAll(AtomicsContext* context) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto it = waiters_.begin(); it != waiters_.end();) {
+        auto& waiter = *it;
+        if (waiter->owner != context) {
+            ++it;
+            continue;
+        }
+        if (waiter->condition) {
+            waiter->interrupted = true;
+            waiter->condition->notify_one();
+        }
+        it = waiters_.erase(it);
+    }
+}
+
+void WaiterList::timeoutThreadMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        auto nextDeadline = std::chrono::steady_clock::time_point::max();
+
+        for (auto it = waiters_.begin(); it != waiters_.end();) {
+            auto& waiter = *it;
+            if (!waiter->hasDeadline) {
+                ++it;
+                continue;
+            }
+            if (waiter->deadline <= now) {
+                if (auto context = waiter->context.lock()) {
+                    context->settle(waiter->promiseId, "timed-out");
+                }
+                it = waiters_.erase(it);
+                continue;
+            }
+            nextDeadline = std::min(nextDeadline, waiter->deadline);
+            ++it;
+        }
+
+        if (nextDeadline == std::chrono::steady_clock::time_point::max()) {
+            timeoutCondition_.wait(lock);
+        } else {
+            timeoutCondition_.wait_until(lock, nextDeadline);
+        }
+    }
+}
+
+// ============================================================================
+// AtomicsContext
+// ============================================================================
+
+AtomicsContext::AtomicsContext(bool canBlock, AtomicsScheduler scheduler)
+    : canBlock_(canBlock)
+    , scheduler_(std::move(scheduler)) {
+}
+
+bool AtomicsContext::isClosed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+void AtomicsContext::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return;
+        closed_ = true;
+        scheduler_ = nullptr;
+    }
+    WaiterList::instance().removeAll(this);
+}
+
+void AtomicsContext::settle(uint64_t promiseId, const char* result) {
+    // Held while scheduling so close() can't return while a settle is in flight
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || !scheduler_) return;
+
+    scheduler_([promiseId, result](Runtime& rt) {
+        auto settle = rt.global().getProperty(rt, "__webworkerAtomicsSettle");
+        if (settle.isObject() && settle.getObject(rt).isFunction(rt)) {
+            settle.getObject(rt).getFunction(rt).call(
+                rt, static_cast<double>(promiseId), String::createFromAscii(rt, result));
+        }
+    });
+}
+
+std::shared_ptr<AtomicsContext> AtomicsContext::install(
+    Runtime& runtime,
+    bool canBlock,
+    AtomicsScheduler scheduler
+) {
+    auto context = std::make_shared<AtomicsContext>(canBlock, std::move(scheduler));
+    std::weak_ptr<AtomicsContext> weakContext = context;
+    Object native(runtime);
+
+    // op(code, buffer, byteIndex, kind, value, replacement)
+    native.setProperty(runtime, "op", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "op"),
+        6,
+        [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 6) {
+                throw JSError(rt, "TypeError: Atomics: invalid arguments");
+            }
+            auto op = static_cast<AtomicsOp>(static_cast<int>(args[0].asNumber()));
+            auto kind = static_cast<ElementKind>(static_cast<int>(args[3].asNumber()));
+            size_t size = elementSize(kind);
+            if (size == 0) {
+                throw JSError(rt, "TypeError: Atomics: invalid arguments");
+            }
+
+            uint8_t* address = elementAddress(rt, args[1], args[2], size, false);
+            double value = args[4].asNumber();
+            double replacement = args[5].asNumber();
+
+            switch (kind) {
+            case ElementKind::Int8: return atomicOp<int8_t>(op, address, value, replacement);
+            case ElementKind::Uint8: return atomicOp<uint8_t>(op, address, value, replacement);
+            case ElementKind::Int16: return atomicOp<int16_t>(op, address, value, replacement);
+            case ElementKind::Uint16: return atomicOp<uint16_t>(op, address, value, replacement);
+            case ElementKind::Int32: return atomicOp<int32_t>(op, address, value, replacement);
+            case ElementKind::Uint32: return atomicOp<uint32_t>(op, address, value, replacement);
+            }
+            return Value::undefined();
+        }
+    ));
+
+    // wait(buffer, byteIndex, value, timeout): "ok" | "not-equal" | "timed-out"
+    native.setProperty(runtime, "wait", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "wait"),
+        4,
+        [weakContext](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            auto context = weakContext.lock();
+            if (!context || count < 4) return Value::undefined();
+            if (!context->canBlock_) {
+                throw JSError(rt, "TypeError: Atomics.wait cannot be called in this context, use Atomics.waitAsync");
+            }
+
+            auto* address = reinterpret_cast<int32_t*>(
+                elementAddress(rt, args[0], args[1], sizeof(int32_t), true));
+            int32_t expected = static_cast<int32_t>(toUint32(args[2].asNumber()));
+            const char* result = WaiterList::instance().wait(*context, address, expected, args[3].asNumber());
+            return String::createFromAscii(rt, result);
+        }
+    ));
+
+    // waitAsync(buffer, byteIndex, value, timeout, promiseId): result, or undefined once queued
+    native.setProperty(runtime, "waitAsync", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "waitAsync"),
+        5,
+        [weakContext](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            auto context = weakContext.lock();
+            if (!context || count < 5) return Value::undefined();
+
+            auto* address = reinterpret_cast<int32_t*>(
+                elementAddress(rt, args[0], args[1], sizeof(int32_t), true));
+            int32_t expected = static_cast<int32_t>(toUint32(args[2].asNumber()));
+            auto promiseId = static_cast<uint64_t>(args[4].asNumber());
+            const char* result = WaiterList::instance().waitAsync(
+                context, address, expected, args[3].asNumber(), promiseId);
+            if (!result) return Value::undefined();
+            return String::createFromAscii(rt, result);
+        }
+    ));
+
+    // notify(buffer, byteIndex, count): number of woken waiters
+    native.setProperty(runtime, "notify", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "notify"),
+        3,
+        [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 3) return 0;
+
+            uint8_t* address = elementAddress(rt, args[0], args[1], sizeof(int32_t), false);
+
+            ArrayBuffer arrayBuffer = args[0].getObject(rt).getArrayBuffer(rt);
+            auto native = NativeArrayBuffer::find(arrayBuffer.data(rt), arrayBuffer.size(rt));
+            if (!native || !native->isShared()) {
+                // Nobody can be waiting on memory that isn't shared
+                return 0;
+            }
+
+            double limit = args[2].asNumber();
+            size_t maxCount = std::isinf(limit) ? std::numeric_limits<size_t>::max()
+                                                : static_cast<size_t>(limit);
+            return static_cast<double>(WaiterList::instance().notify(address, maxCount));
+        }
+    ));
+
+    // createShared(byteLength): ArrayBuffer
+    native.setProperty(runtime, "createShared", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "createShared"),
+        1,
+        [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            double length = count > 0 ? args[0].asNumber() : 0;
+            if (!(length >= 0) || length != std::trunc(length) ||
+                length > static_cast<double>(std::numeric_limits<uint32_t>::max())) {
+                throw JSError(rt, "RangeError: Invalid SharedArrayBuffer length");
+            }
+            return ArrayBuffer(rt, NativeArrayBuffer::createShared(static_cast<size_t>(length)));
+        }
+    ));
+
+    // isShared(value): boolean
+    native.setProperty(runtime, "isShared", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "isShared"),
+        1,
+        [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isObject() || !args[0].getObject(rt).isArrayBuffer(rt)) {
+                return false;
+            }
+            ArrayBuffer arrayBuffer = args[0].getObject(rt).getArrayBuffer(rt);
+            auto buffer = NativeArrayBuffer::find(arrayBuffer.data(rt), arrayBuffer.size(rt));
+            return buffer && buffer->isShared();
+        }
+    ));
+
+    runtime.evaluateJavaScript(std::make_shared<StringBuffer>(kAtomicsScript), "webworker-atomics.js")
+        .asObject(runtime)
+        .asFunction(runtime)
+        .call(runtime, native);
+
+    return context;
+}
+
+} // namespace webworker
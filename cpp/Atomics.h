@@ -0,0 +1,65 @@
+#pragma once
+
+#include <jsi/jsi.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace webworker {
+
+using namespace facebook::jsi;
+
+/**
+ * Runs a callback on the thread owning a runtime: the worker's event loop,
+ * or the React Native JS thread for the host runtime.
+ */
+using AtomicsScheduler = std::function<void(std::function<void(Runtime&)>)>;
+
+/**
+ * AtomicsContext - SharedArrayBuffer and Atomics for one runtime
+ *
+ * Hermes has neither, so install() provides a `SharedArrayBuffer`
+ * constructor backed by NativeArrayBuffer::createShared and an `Atomics`
+ * object whose operations are native atomics on the shared memory. Waiters
+ * are kept in one process-wide list keyed by address, so Atomics.notify in
+ * one runtime wakes Atomics.wait / Atomics.waitAsync in any other.
+ *
+ * Existing engine globals are left untouched.
+ */
+class AtomicsContext : public std::enable_shared_from_this<AtomicsContext> {
+public:
+    /**
+     * Install the globals into `runtime`. Must be called on its thread.
+     *
+     * @param canBlock Whether Atomics.wait may block the calling thread.
+     *                 False for the host JS thread, like a browser's main thread.
+     * @param scheduler Used to settle Atomics.waitAsync promises.
+     */
+    static std::shared_ptr<AtomicsContext> install(Runtime& runtime,
+                                                   bool canBlock,
+                                                   AtomicsScheduler scheduler);
+
+    AtomicsContext(bool canBlock, AtomicsScheduler scheduler);
+
+    /**
+     * Drop pending waitAsync promises and wake any Atomics.wait of this
+     * runtime, which then returns "timed-out". Safe to call from any thread;
+     * the worker calls it on terminate so a blocked thread can be joined.
+     */
+    void close();
+
+    bool isClosed() const;
+
+private:
+    friend class WaiterList;
+
+    // Schedule settling waitAsync promise `promiseId` with `result`
+    void settle(uint64_t promiseId, const char* result);
+
+    bool canBlock_;
+    AtomicsScheduler scheduler_;
+    bool closed_{false};
+    mutable std::mutex mutex_;
+};
+
+} // namespace webworker
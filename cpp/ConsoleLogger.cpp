@@ -0,0 +1,178 @@
+#include "ConsoleLogger.h"
+
+#include <algorithm>
+
+namespace webworker {
+
+const char* consoleLevelName(ConsoleLevel level) {
+    switch (level) {
+        case ConsoleLevel::Info: return "info";
+        case ConsoleLevel::Warn: return "warn";
+        case ConsoleLevel::Error: return "error";
+        case ConsoleLevel::None: return "none";
+        case ConsoleLevel::Log: break;
+    }
+    return "log";
+}
+
+ConsoleLevel parseConsoleLevel(const std::string& name) {
+    if (name == "info") return ConsoleLevel::Info;
+    if (name == "warn") return ConsoleLevel::Warn;
+    if (name == "error") return ConsoleLevel::Error;
+    if (name == "none") return ConsoleLevel::None;
+    return ConsoleLevel::Log;
+}
+
+// ============================================================================
+// ConsoleBuffer
+// ============================================================================
+
+ConsoleBuffer::ConsoleBuffer(std::string workerId)
+    : lines_(kCapacity)
+    , workerId_(std::move(workerId)) {
+}
+
+bool ConsoleBuffer::push(ConsoleLevel level, std::string message) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == kCapacity) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Line& line = lines_[tail & (kCapacity - 1)];
+    line.level = level;
+    line.message = std::move(message);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+void ConsoleBuffer::drain(std::vector<Line>& lines) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t tail = tail_.load(std::memory_order_acquire);
+    for (; head != tail; head++) {
+        lines.push_back(std::move(lines_[head & (kCapacity - 1)]));
+    }
+    head_.store(head, std::memory_order_release);
+}
+
+bool ConsoleBuffer::empty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
+
+void ConsoleBuffer::setWorkerId(std::string workerId) {
+    std::lock_guard<std::mutex> lock(workerIdMutex_);
+    workerId_ = std::move(workerId);
+}
+
+std::string ConsoleBuffer::workerId() const {
+    std::lock_guard<std::mutex> lock(workerIdMutex_);
+    return workerId_;
+}
+
+// ============================================================================
+// ConsoleLogger
+// ============================================================================
+
+ConsoleLogger::~ConsoleLogger() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ConsoleLogger::setCallback(ConsoleCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = std::move(callback);
+}
+
+void ConsoleLogger::setLevel(ConsoleLevel minimum) {
+    minimumLevel_.store(static_cast<uint8_t>(minimum), std::memory_order_relaxed);
+}
+
+std::shared_ptr<ConsoleBuffer> ConsoleLogger::attach(const std::string& workerId) {
+    auto buffer = std::make_shared<ConsoleBuffer>(workerId);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_.push_back(buffer);
+    if (!thread_.joinable() && !stopping_) {
+        thread_ = std::thread(&ConsoleLogger::threadMain, this);
+    }
+    return buffer;
+}
+
+void ConsoleLogger::detach(const std::shared_ptr<ConsoleBuffer>& buffer) {
+    if (!buffer) return;
+    buffer->closed_.store(true);
+    wake();
+}
+
+void ConsoleLogger::log(ConsoleBuffer& buffer, ConsoleLevel level, std::string message) {
+    if (!isEnabled(level)) return;
+    buffer.push(level, std::move(message));
+    wake();
+}
+
+void ConsoleLogger::wake() {
+    // Only the first line after a drain pays for the notification
+    if (pending_.exchange(true)) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    wakeup_.notify_one();
+}
+
+void ConsoleLogger::threadMain() {
+    std::vector<ConsoleBuffer::Line> lines;
+    std::vector<std::shared_ptr<ConsoleBuffer>> buffers;
+
+    while (true) {
+        ConsoleCallback callback;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this] { return stopping_ || pending_.load(); });
+            pending_.store(false);
+            stopping = stopping_;
+
+            // A closed buffer gets no more lines, forget it once it's read
+            buffers_.erase(std::remove_if(buffers_.begin(), buffers_.end(),
+                                          [](const std::shared_ptr<ConsoleBuffer>& buffer) {
+                                              return buffer->closed_.load() && buffer->empty();
+                                          }),
+                           buffers_.end());
+            buffers = buffers_;
+            callback = callback_;
+        }
+
+        for (auto& buffer : buffers) {
+            lines.clear();
+            buffer->drain(lines);
+            uint64_t dropped = buffer->dropped_.exchange(0);
+            droppedTotal_.fetch_add(dropped);
+            if (!callback || (lines.empty() && dropped == 0)) continue;
+
+            std::string workerId = buffer->workerId();
+            for (const auto& line : lines) {
+                callback(workerId, consoleLevelName(line.level), line.message);
+            }
+            if (dropped > 0) {
+                callback(workerId, "warn", std::to_string(dropped) + " console messages dropped");
+            }
+        }
+
+        // Closed buffers drained just now are pruned on the next pass
+        for (auto& buffer : buffers) {
+            if (buffer->closed_.load()) {
+                pending_.store(true);
+                break;
+            }
+        }
+        buffers.clear();
+
+        if (stopping) break;
+    }
+}
+
+} // namespace webworker
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace webworker {
+
+/**
+ * Callback type for console output from workers
+ */
+using ConsoleCallback = std::function<void(const std::string& workerId, const std::string& level, const std::string& message)>;
+
+/**
+ * Console levels, least severe first. None is only used as a threshold.
+ */
+enum class ConsoleLevel : uint8_t {
+    Log,
+    Info,
+    Warn,
+    Error,
+    None,
+};
+
+const char* consoleLevelName(ConsoleLevel level);
+
+/**
+ * "log", "info", "warn", "error" or "none"; anything else is Log.
+ */
+ConsoleLevel parseConsoleLevel(const std::string& name);
+
+/**
+ * ConsoleBuffer - One worker's console output on its way to the logger
+ *
+ * A fixed ring of kCapacity lines with a single producer, the worker
+ * thread, and a single consumer, the logging thread. Neither side takes a
+ * lock. When the ring is full the line is dropped and counted.
+ */
+class ConsoleBuffer {
+public:
+    static constexpr size_t kCapacity = 1024;
+
+    explicit ConsoleBuffer(std::string workerId);
+
+    ConsoleBuffer(const ConsoleBuffer&) = delete;
+    ConsoleBuffer& operator=(const ConsoleBuffer&) = delete;
+
+    /**
+     * Producer side. Takes the message over.
+     * @return false if the ring was full and the line was dropped
+     */
+    bool push(ConsoleLevel level, std::string message);
+
+    /** Lines are reported under this id from now on */
+    void setWorkerId(std::string workerId);
+
+private:
+    friend class ConsoleLogger;
+
+    struct Line {
+        ConsoleLevel level{ConsoleLevel::Log};
+        std::string message;
+    };
+
+    // Consumer side: move every published line into `lines`
+    void drain(std::vector<Line>& lines);
+    bool empty() const;
+    std::string workerId() const;
+
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "kCapacity must be a power of two");
+
+    std::vector<Line> lines_;
+    alignas(64) std::atomic<size_t> head_{0}; // Next line to read, consumer owned
+    alignas(64) std::atomic<size_t> tail_{0}; // Next line to write, producer owned
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> closed_{false};
+
+    std::string workerId_;
+    mutable std::mutex workerIdMutex_;
+};
+
+/**
+ * ConsoleLogger - Delivers every worker's console output from one thread
+ *
+ * Workers only append to their ConsoleBuffer; the logging thread wakes up,
+ * drains all buffers and calls the ConsoleCallback for the whole batch, so
+ * the platform's logging cost never lands on a worker thread. Lines below
+ * the level threshold are rejected before they are even formatted.
+ *
+ * Thread-safe. The thread starts with the first attached buffer.
+ */
+class ConsoleLogger {
+public:
+    ConsoleLogger() = default;
+    ~ConsoleLogger();
+
+    ConsoleLogger(const ConsoleLogger&) = delete;
+    ConsoleLogger& operator=(const ConsoleLogger&) = delete;
+
+    void setCallback(ConsoleCallback callback);
+
+    /** Drop lines below `minimum`. ConsoleLevel::None silences workers. */
+    void setLevel(ConsoleLevel minimum);
+
+    bool isEnabled(ConsoleLevel level) const {
+        return static_cast<uint8_t>(level) >= minimumLevel_.load(std::memory_order_relaxed);
+    }
+
+    /** A buffer for a new worker */
+    std::shared_ptr<ConsoleBuffer> attach(const std::string& workerId);
+
+    /** The worker is going away; its remaining lines are still delivered */
+    void detach(const std::shared_ptr<ConsoleBuffer>& buffer);
+
+    /** Append a line from the buffer's worker thread */
+    void log(ConsoleBuffer& buffer, ConsoleLevel level, std::string message);
+
+    /** Lines lost to full buffers so far */
+    uint64_t droppedCount() const { return droppedTotal_.load(); }
+
+private:
+    void wake();
+    void threadMain();
+
+    std::vector<std::shared_ptr<ConsoleBuffer>> buffers_;
+    ConsoleCallback callback_;
+    std::atomic<uint8_t> minimumLevel_{0};
+    std::atomic<bool> pending_{false};
+    std::atomic<uint64_t> droppedTotal_{0};
+    bool stopping_{false};
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::thread thread_;
+};
+
+} // namespace webworker
@@ -0,0 +1,35 @@
+#include "DeliveryThread.h"
+
+namespace webworker {
+
+DeliveryThread::DeliveryThread()
+    : thread_(&DeliveryThread::threadMain, this) {
+}
+
+DeliveryThread::~DeliveryThread() {
+    queue_.shutdown();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void DeliveryThread::post(std::function<void()> fn) {
+    Task task;
+    task.type = TaskType::Message;
+    task.id = nextTaskId_++;
+    task.execute = std::move(fn);
+    queue_.enqueue(std::move(task));
+}
+
+void DeliveryThread::threadMain() {
+    while (auto task = queue_.dequeue()) {
+        task->execute();
+    }
+
+    // Shut down: deliver what was posted before
+    while (auto task = queue_.tryDequeueImmediate()) {
+        task->execute();
+    }
+}
+
+} // namespace webworker
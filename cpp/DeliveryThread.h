@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "TaskQueue.h"
+
+namespace webworker {
+
+/**
+ * DeliveryThread - Runs platform callbacks off the worker threads
+ *
+ * Workers post outbound events (errors, network requests) here instead of
+ * calling into the platform themselves, so a slow upcall never stalls a
+ * JS runtime. Posting goes through the lock-free producer lane of a
+ * TaskQueue; one thread runs the callbacks in the order they were posted.
+ *
+ * Callbacks still queued on destruction run before it returns.
+ */
+class DeliveryThread {
+public:
+    DeliveryThread();
+    ~DeliveryThread();
+
+    DeliveryThread(const DeliveryThread&) = delete;
+    DeliveryThread& operator=(const DeliveryThread&) = delete;
+
+    /** Queue `fn`. Safe from any thread. */
+    void post(std::function<void()> fn);
+
+private:
+    void threadMain();
+
+    TaskQueue queue_;
+    std::atomic<uint64_t> nextTaskId_{1};
+    std::thread thread_;
+};
+
+} // namespace webworker
@@ -0,0 +1,76 @@
+#include "MappedBuffer.h"
+
+#include <hermes/hermes.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace webworker {
+
+namespace {
+
+// An empty file maps to nothing, give it a valid pointer anyway
+const uint8_t kEmpty[1] = {0};
+
+} // namespace
+
+std::shared_ptr<MappedBuffer> MappedBuffer::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(error));
+    }
+
+    auto size = static_cast<size_t>(info.st_size);
+    void* mapping = nullptr;
+    if (size > 0) {
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot map " + path + ": " + std::strerror(error));
+        }
+        // Parsing reads it front to back
+        madvise(mapping, size, MADV_SEQUENTIAL);
+    }
+
+    // The mapping outlives the descriptor
+    ::close(fd);
+    return std::shared_ptr<MappedBuffer>(new MappedBuffer(mapping, size));
+}
+
+std::shared_ptr<const Buffer> MappedBuffer::openScript(const std::string& path) {
+    auto mapped = open(path);
+    if (facebook::hermes::HermesRuntime::isHermesBytecode(mapped->data(), mapped->size())) {
+        return mapped;
+    }
+    // std::string keeps the terminator the source compiler reads up to
+    return std::make_shared<StringBuffer>(
+        std::string(reinterpret_cast<const char*>(mapped->data()), mapped->size()));
+}
+
+MappedBuffer::MappedBuffer(void* mapping, size_t size)
+    : mapping_(mapping)
+    , data_(mapping ? static_cast<const uint8_t*>(mapping) : kEmpty)
+    , size_(size) {
+}
+
+MappedBuffer::~MappedBuffer() {
+    if (mapping_) {
+        munmap(mapping_, size_);
+    }
+}
+
+} // namespace webworker
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <jsi/jsi.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace webworker {
+
+using namespace facebook::jsi;
+
+/**
+ * MappedBuffer - A read-only file mapped into memory, as a jsi::Buffer
+ *
+ * Hands a Hermes bytecode file to Hermes without reading it: pages are
+ * loaded on demand and shared with the page cache, and the same mapping can
+ * back any number of workers. Mappings start on a page boundary, so the
+ * bytecode is suitably aligned.
+ *
+ * Not for source: Hermes' source compiler expects a NUL byte past the end
+ * of the buffer, which a mapping only has when the file size isn't a
+ * multiple of the page size. openScript() takes care of it.
+ */
+class MappedBuffer : public Buffer {
+public:
+    /**
+     * Map the whole file at `path`.
+     * @throws std::runtime_error if it can't be opened or mapped
+     */
+    static std::shared_ptr<MappedBuffer> open(const std::string& path);
+
+    /**
+     * Open a worker script: Hermes bytecode is mapped, source is read into
+     * a NUL-terminated copy.
+     * @throws std::runtime_error if it can't be opened or mapped
+     */
+    static std::shared_ptr<const Buffer> openScript(const std::string& path);
+
+    ~MappedBuffer() override;
+
+    MappedBuffer(const MappedBuffer&) = delete;
+    MappedBuffer& operator=(const MappedBuffer&) = delete;
+
+    size_t size() const override { return size_; }
+    const uint8_t* data() const override { return data_; }
+
+private:
+    MappedBuffer(void* mapping, size_t size);
+
+    void* mapping_;
+    const uint8_t* data_;
+    size_t size_;
+};
+
+} // namespace webworker
@@ -0,0 +1,488 @@
+#include "MessagePort.h"
+#include "StructuredClone.h"
+#include "Trace.h"
+
+#include <atomic>
+#include <vector>
+
+namespace webworker {
+
+namespace {
+
+std::atomic<uint64_t> gNextPortId{1};
+
+/**
+ * What a JS MessagePort holds on to. Emptied when the port is transferred,
+ * which is what neuters the JS object left behind.
+ */
+class PortHandle : public HostObject {
+public:
+    explicit PortHandle(std::shared_ptr<MessagePort> port) : port_(std::move(port)) {}
+
+    const std::shared_ptr<MessagePort>& port() const { return port_; }
+    std::shared_ptr<MessagePort> take() { return std::move(port_); }
+
+private:
+    std::shared_ptr<MessagePort> port_;
+};
+
+std::shared_ptr<PortHandle> handleOf(Runtime& rt, const Value& value) {
+    if (!value.isObject()) return nullptr;
+    Object object = value.getObject(rt);
+    if (!object.isHostObject<PortHandle>(rt)) return nullptr;
+    return object.getHostObject<PortHandle>(rt);
+}
+
+std::shared_ptr<PortHandle> handleOf(Runtime& rt, const Object& port) {
+    return handleOf(rt, port.getProperty(rt, "_handle"));
+}
+
+// Must match the globals defined by kMessagePortScript
+constexpr const char* kAdoptFunction = "__webworkerPortAdopt";
+constexpr const char* kDispatchFunction = "__webworkerPortDispatch";
+constexpr const char* kDetachFunction = "__webworkerPortDetach";
+
+constexpr const char* kMessagePortScript = R"(
+(function(native) {
+    var global = globalThis;
+
+    // Ports owned by this runtime until they're closed or transferred, so
+    // an entangled port with a listener isn't collected
+    var ports = new Map();
+
+    function MessagePort() {
+        throw new TypeError('Illegal constructor');
+    }
+    Object.defineProperty(MessagePort.prototype, Symbol.toStringTag, { value: 'MessagePort' });
+
+    function wrap(handle) {
+        var port = Object.create(MessagePort.prototype);
+        Object.defineProperty(port, '_handle', { value: handle, writable: true });
+        port._id = native.bind(handle);
+        port._onmessage = null;
+        port._listeners = [];
+        ports.set(port._id, port);
+        return port;
+    }
+
+    function drop(port) {
+        ports.delete(port._id);
+        port._handle = null;
+    }
+
+    MessagePort.prototype.postMessage = function(message, transfer) {
+        if (transfer && !Array.isArray(transfer)) {
+            transfer = transfer.transfer;
+        }
+        if (this._handle) native.post(this._handle, message, transfer);
+    };
+    MessagePort.prototype.start = function() {
+        if (this._handle) native.start(this._handle);
+    };
+    MessagePort.prototype.close = function() {
+        if (!this._handle) return;
+        native.close(this._handle);
+        drop(this);
+    };
+    MessagePort.prototype.addEventListener = function(type, listener) {
+        if (type === 'message' && this._listeners.indexOf(listener) < 0) {
+            this._listeners.push(listener);
+        }
+    };
+    MessagePort.prototype.removeEventListener = function(type, listener) {
+        var index = this._listeners.indexOf(listener);
+        if (type === 'message' && index >= 0) this._listeners.splice(index, 1);
+    };
+    // Like in a browser, setting onmessage starts the port
+    Object.defineProperty(MessagePort.prototype, 'onmessage', {
+        get: function() { return this._onmessage; },
+        set: function(handler) {
+            this._onmessage = handler;
+            if (typeof handler === 'function') this.start();
+        }
+    });
+
+    Object.defineProperty(global, '__webworkerPortAdopt', { value: wrap });
+    Object.defineProperty(global, '__webworkerPortDetach', { value: drop });
+    Object.defineProperty(global, '__webworkerPortDispatch', {
+        value: function(id, data, closed) {
+            var port = ports.get(id);
+            if (!port) return;
+            if (closed) {
+                drop(port);
+                return;
+            }
+            var event = { data: data, type: 'message', target: port };
+            if (typeof port._onmessage === 'function') port._onmessage(event);
+            var listeners = port._listeners.slice();
+            for (var i = 0; i < listeners.length; i++) listeners[i].call(port, event);
+        }
+    });
+
+    function MessageChannel() {
+        if (!(this instanceof MessageChannel)) {
+            throw new TypeError("Constructor MessageChannel requires 'new'");
+        }
+        var pair = native.createChannel();
+        this.port1 = pair[0];
+        this.port2 = pair[1];
+    }
+
+    if (typeof global.MessagePort === 'undefined') {
+        Object.defineProperty(global, 'MessagePort', {
+            value: MessagePort, writable: true, configurable: true
+        });
+    }
+    if (typeof global.MessageChannel === 'undefined') {
+        Object.defineProperty(global, 'MessageChannel', {
+            value: MessageChannel, writable: true, configurable: true
+        });
+    }
+})
+)";
+
+} // namespace
+
+// ============================================================================
+// MessagePort
+// ============================================================================
+
+std::pair<std::shared_ptr<MessagePort>, std::shared_ptr<MessagePort>> MessagePort::createChannel() {
+    std::shared_ptr<MessagePort> port1(new MessagePort(gNextPortId.fetch_add(1, std::memory_order_relaxed)));
+    std::shared_ptr<MessagePort> port2(new MessagePort(gNextPortId.fetch_add(1, std::memory_order_relaxed)));
+    port1->peer_ = port2;
+    port2->peer_ = port1;
+    return {std::move(port1), std::move(port2)};
+}
+
+bool MessagePort::postMessage(std::shared_ptr<SerializedMessage> message) {
+    std::shared_ptr<MessagePort> peer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return false;
+        peer = peer_.lock();
+    }
+    if (!peer) return false;
+
+    peer->receive(std::move(message));
+    return true;
+}
+
+bool MessagePort::isClosed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+void MessagePort::close() {
+    std::shared_ptr<MessagePortContext> owner;
+    std::shared_ptr<MessagePort> peer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return;
+        closed_ = true;
+        queue_.clear();
+        owner = owner_.lock();
+        owner_.reset();
+        peer = peer_.lock();
+    }
+
+    // One port's mutex at a time, the other end may be closing as well
+    if (owner) owner->remove(id_);
+    if (peer) peer->disentangle();
+}
+
+void MessagePort::disentangle() {
+    std::shared_ptr<MessagePortContext> owner;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return;
+        closed_ = true;
+        queue_.clear();
+        owner = owner_.lock();
+        owner_.reset();
+    }
+
+    if (owner) {
+        owner->remove(id_);
+        owner->scheduleClose(id_);
+    }
+}
+
+void MessagePort::receive(std::shared_ptr<SerializedMessage> message) {
+    // From the sender's port.postMessage to the JS port taking it
+    uint64_t traceId = WEBWORKER_TRACE_NEW_ID();
+    WEBWORKER_TRACE_ASYNC_BEGIN("WebWorker port.postMessage", traceId);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+        WEBWORKER_TRACE_ASYNC_END("WebWorker port.postMessage", traceId);
+        return;
+    }
+    queue_.push_back({std::move(message), traceId});
+
+    if (started_) {
+        if (auto owner = owner_.lock()) {
+            owner->scheduleDelivery(shared_from_this());
+        }
+    }
+}
+
+bool MessagePort::bind(const std::shared_ptr<MessagePortContext>& owner) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_ || owner_.lock()) return false;
+        owner_ = owner;
+        started_ = false;
+    }
+    owner->add(shared_from_this());
+    return true;
+}
+
+void MessagePort::unbind() {
+    std::shared_ptr<MessagePortContext> owner;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        owner = owner_.lock();
+        owner_.reset();
+        started_ = false;
+    }
+    if (owner) owner->remove(id_);
+}
+
+void MessagePort::start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (started_ || closed_) return;
+    auto owner = owner_.lock();
+    if (!owner) return;
+
+    started_ = true;
+    auto self = shared_from_this();
+    for (size_t i = 0; i < queue_.size(); i++) {
+        owner->scheduleDelivery(self);
+    }
+}
+
+std::shared_ptr<SerializedMessage> MessagePort::takeNext(const MessagePortContext* owner) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Deliveries scheduled before a transfer find another owner, or none
+    if (!started_ || queue_.empty() || owner_.lock().get() != owner) return nullptr;
+
+    Queued next = std::move(queue_.front());
+    queue_.pop_front();
+    WEBWORKER_TRACE_ASYNC_END("WebWorker port.postMessage", next.traceId);
+    return std::move(next.message);
+}
+
+// ============================================================================
+// MessagePortContext
+// ============================================================================
+
+MessagePortContext::MessagePortContext(PortScheduler scheduler)
+    : scheduler_(std::move(scheduler)) {
+}
+
+bool MessagePortContext::isClosed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+}
+
+void MessagePortContext::close() {
+    std::unordered_map<uint64_t, std::weak_ptr<MessagePort>> ports;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) return;
+        closed_ = true;
+        scheduler_ = nullptr;
+        ports.swap(ports_);
+    }
+    for (auto& pair : ports) {
+        if (auto port = pair.second.lock()) port->close();
+    }
+}
+
+void MessagePortContext::add(const std::shared_ptr<MessagePort>& port) {
+    bool closed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed = closed_;
+        if (!closed) ports_[port->id()] = port;
+    }
+    // Adopted by a runtime that is going away
+    if (closed) port->close();
+}
+
+void MessagePortContext::remove(uint64_t portId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ports_.erase(portId);
+}
+
+void MessagePortContext::scheduleDelivery(const std::shared_ptr<MessagePort>& port) {
+    // Held while scheduling so close() can't return while a delivery is in flight
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || !scheduler_) return;
+
+    std::weak_ptr<MessagePort> weakPort = port;
+    std::weak_ptr<MessagePortContext> weakSelf = shared_from_this();
+    scheduler_([weakPort, weakSelf](Runtime& rt) {
+        auto port = weakPort.lock();
+        auto self = weakSelf.lock();
+        if (!port || !self) return;
+
+        auto message = port->takeNext(self.get());
+        if (!message) return;
+
+        // Ports in the message are adopted by this runtime as it's decoded
+        Value data = deserializeValue(rt, *message);
+        rt.global().getPropertyAsFunction(rt, kDispatchFunction)
+            .call(rt, static_cast<double>(port->id()), data);
+    });
+}
+
+void MessagePortContext::scheduleClose(uint64_t portId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || !scheduler_) return;
+
+    scheduler_([portId](Runtime& rt) {
+        rt.global().getPropertyAsFunction(rt, kDispatchFunction)
+            .call(rt, static_cast<double>(portId), Value::undefined(), true);
+    });
+}
+
+Array MessagePortContext::createChannel(Runtime& runtime) {
+    auto channel = MessagePort::createChannel();
+    Array ports(runtime, 2);
+    ports.setValueAtIndex(runtime, 0, adopt(runtime, std::move(channel.first)));
+    ports.setValueAtIndex(runtime, 1, adopt(runtime, std::move(channel.second)));
+    return ports;
+}
+
+std::shared_ptr<MessagePort> MessagePortContext::portOf(Runtime& runtime, const Object& value) {
+    auto handle = handleOf(runtime, value);
+    return handle ? handle->port() : nullptr;
+}
+
+std::shared_ptr<MessagePort> MessagePortContext::detach(Runtime& runtime, const Object& value) {
+    auto handle = handleOf(runtime, value);
+    if (!handle) return nullptr;
+
+    auto port = handle->take();
+    if (!port) return nullptr;
+    port->unbind();
+
+    Value drop = runtime.global().getProperty(runtime, kDetachFunction);
+    if (drop.isObject() && drop.getObject(runtime).isFunction(runtime)) {
+        drop.getObject(runtime).getFunction(runtime).call(runtime, Value(runtime, value));
+    }
+    return port;
+}
+
+Value MessagePortContext::adopt(Runtime& runtime, std::shared_ptr<MessagePort> port) {
+    Value wrap = runtime.global().getProperty(runtime, kAdoptFunction);
+    if (!wrap.isObject() || !wrap.getObject(runtime).isFunction(runtime)) {
+        throw JSError(runtime, "DataCloneError: MessagePort is not supported in this runtime");
+    }
+    return wrap.getObject(runtime).getFunction(runtime).call(
+        runtime, Object::createFromHostObject(runtime, std::make_shared<PortHandle>(std::move(port))));
+}
+
+std::shared_ptr<MessagePortContext> MessagePortContext::install(Runtime& runtime, PortScheduler scheduler) {
+    auto context = std::make_shared<MessagePortContext>(std::move(scheduler));
+    std::weak_ptr<MessagePortContext> weakContext = context;
+    Object native(runtime);
+
+    // bind(handle): port id, once this runtime owns the port
+    native.setProperty(runtime, "bind", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "bind"),
+        1,
+        [weakContext](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            auto context = weakContext.lock();
+            auto handle = count > 0 ? handleOf(rt, args[0]) : nullptr;
+            if (!context || !handle || !handle->port()) {
+                throw JSError(rt, "TypeError: MessagePort: invalid handle");
+            }
+            if (!handle->port()->bind(context)) {
+                throw JSError(rt, "DataCloneError: MessagePort was delivered already");
+            }
+            return static_cast<double>(handle->port()->id());
+        }
+    ));
+
+    // post(handle, message, transfer?)
+    native.setProperty(runtime, "post", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "post"),
+        3,
+        [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            auto handle = count > 0 ? handleOf(rt, args[0]) : nullptr;
+            if (!handle || !handle->port()) return Value::undefined();
+
+            // Throws a DataCloneError back into JS for uncloneable values
+            Value message = count > 1 ? Value(rt, args[1]) : Value::undefined();
+            Value transfer = count > 2 ? Value(rt, args[2]) : Value::undefined();
+
+            // Neither end can travel through its own channel
+            if (transfer.isObject() && transfer.getObject(rt).isArray(rt)) {
+                Array list = transfer.getObject(rt).getArray(rt);
+                auto peer = handle->port()->peer_.lock();
+                for (size_t i = 0; i < list.size(rt); i++) {
+                    Value entry = list.getValueAtIndex(rt, i);
+                    if (!entry.isObject()) continue;
+                    auto port = portOf(rt, entry.getObject(rt));
+                    if (port && (port == handle->port() || port == peer)) {
+                        throw JSError(rt, "DataCloneError: a port cannot be transferred through its own channel");
+                    }
+                }
+            }
+            handle->port()->postMessage(serializeValue(rt, message, transfer));
+            return Value::undefined();
+        }
+    ));
+
+    // start(handle)
+    native.setProperty(runtime, "start", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "start"),
+        1,
+        [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            auto handle = count > 0 ? handleOf(rt, args[0]) : nullptr;
+            if (handle && handle->port()) handle->port()->start();
+            return Value::undefined();
+        }
+    ));
+
+    // close(handle)
+    native.setProperty(runtime, "close", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "close"),
+        1,
+        [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            auto handle = count > 0 ? handleOf(rt, args[0]) : nullptr;
+            if (handle && handle->port()) handle->port()->close();
+            return Value::undefined();
+        }
+    ));
+
+    // createChannel(): [port1, port2]
+    native.setProperty(runtime, "createChannel", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "createChannel"),
+        0,
+        [weakContext](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            auto context = weakContext.lock();
+            if (!context) {
+                throw JSError(rt, "MessageChannel: runtime is shutting down");
+            }
+            return context->createChannel(rt);
+        }
+    ));
+
+    runtime.evaluateJavaScript(std::make_shared<StringBuffer>(kMessagePortScript), "webworker-messageport.js")
+        .asObject(runtime)
+        .asFunction(runtime)
+        .call(runtime, native);
+
+    return context;
+}
+
+} // namespace webworker
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <jsi/jsi.h>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace webworker {
+
+using namespace facebook::jsi;
+
+struct SerializedMessage;
+class MessagePortContext;
+
+/**
+ * Runs a callback on the thread owning a runtime, like AtomicsScheduler.
+ * Ports deliver their messages through it.
+ */
+using PortScheduler = std::function<void(std::function<void(Runtime&)>)>;
+
+/**
+ * MessagePort - One end of a native MessageChannel
+ *
+ * A message posted to a port is delivered to the other end, straight onto
+ * the event loop of the runtime that owns it: nothing goes through the host
+ * unless the host owns that end. Ports move between runtimes by being
+ * listed in a postMessage transfer list (see SerializedMessage::ports).
+ * Messages are queued on the port until its runtime adopted and started
+ * it, which keeps them across a transfer.
+ *
+ * Closing either end disentangles both. A port whose other end was
+ * destroyed drops what is posted to it.
+ *
+ * Thread-safe.
+ */
+class MessagePort : public std::enable_shared_from_this<MessagePort> {
+public:
+    /** Create two entangled ports, neither owned yet. */
+    static std::pair<std::shared_ptr<MessagePort>, std::shared_ptr<MessagePort>> createChannel();
+
+    MessagePort(const MessagePort&) = delete;
+    MessagePort& operator=(const MessagePort&) = delete;
+
+    /** Unique for the process lifetime */
+    uint64_t id() const { return id_; }
+
+    /**
+     * Deliver `message` to the other end.
+     * @return false if the channel is closed or the other end is gone
+     */
+    bool postMessage(std::shared_ptr<SerializedMessage> message);
+
+    /** Disentangle both ends; queued messages are dropped. */
+    void close();
+
+    bool isClosed() const;
+
+private:
+    friend class MessagePortContext;
+
+    explicit MessagePort(uint64_t id) : id_(id) {}
+
+    struct Queued {
+        std::shared_ptr<SerializedMessage> message;
+        uint64_t traceId;
+    };
+
+    // Called by the other end
+    void receive(std::shared_ptr<SerializedMessage> message);
+    void disentangle();
+
+    // Make `owner` the runtime receiving this port's messages. Fails if the
+    // port is owned already or closed.
+    bool bind(const std::shared_ptr<MessagePortContext>& owner);
+    // Give up the owner, messages queue while the port is being transferred
+    void unbind();
+    // Let the owner's JS port receive, queued messages first
+    void start();
+    // The next message for `owner`, null if it's no longer the owner
+    std::shared_ptr<SerializedMessage> takeNext(const MessagePortContext* owner);
+
+    const uint64_t id_;
+    std::weak_ptr<MessagePort> peer_; // Set by createChannel, never changes
+    std::weak_ptr<MessagePortContext> owner_;
+    bool started_{false}; // Reset by unbind, a transferred port starts again
+    bool closed_{false};
+
+    // Messages not handed to JS yet. Scheduled deliveries only name the
+    // port, so a transfer loses or reorders nothing.
+    std::deque<Queued> queue_;
+    mutable std::mutex mutex_;
+};
+
+/**
+ * MessagePortContext - MessageChannel and MessagePort for one runtime
+ *
+ * install() provides the `MessageChannel` and `MessagePort` globals, left
+ * alone if the engine has its own, whose ports are native MessagePorts.
+ * Messages are structured-cloned with serializeValue, so ports and
+ * ArrayBuffers can be transferred along with them.
+ *
+ * A port stays registered with its runtime, and reachable, until either
+ * end is closed or the runtime goes away.
+ */
+class MessagePortContext : public std::enable_shared_from_this<MessagePortContext> {
+public:
+    /**
+     * Install the globals into `runtime`. Must be called on its thread.
+     * @param scheduler Used to deliver messages to this runtime's ports.
+     */
+    static std::shared_ptr<MessagePortContext> install(Runtime& runtime, PortScheduler scheduler);
+
+    explicit MessagePortContext(PortScheduler scheduler);
+
+    /** A new channel owned by `runtime`, as an array of two JS MessagePorts. */
+    Array createChannel(Runtime& runtime);
+
+    /**
+     * Close every port this runtime owns, which disentangles their other
+     * ends, and stop delivering. Safe from any thread; the worker calls it
+     * on terminate.
+     */
+    void close();
+
+    bool isClosed() const;
+
+    /**
+     * The native port behind a JS MessagePort, nullptr if `value` isn't one
+     * or was transferred already.
+     */
+    static std::shared_ptr<MessagePort> portOf(Runtime& runtime, const Object& value);
+
+    /**
+     * Take a native port out of its JS MessagePort for a transfer. The JS
+     * port is neutered and messages queue until the port is adopted.
+     */
+    static std::shared_ptr<MessagePort> detach(Runtime& runtime, const Object& value);
+
+    /**
+     * Wrap a transferred port for `runtime`, which becomes its owner.
+     * @throws JSError if the runtime has no MessagePortContext or the port
+     *         was adopted already
+     */
+    static Value adopt(Runtime& runtime, std::shared_ptr<MessagePort> port);
+
+private:
+    friend class MessagePort;
+
+    void add(const std::shared_ptr<MessagePort>& port);
+    void remove(uint64_t portId);
+
+    // Have the JS port take `port`'s next message, one task per message.
+    // Called with the port's mutex held.
+    void scheduleDelivery(const std::shared_ptr<MessagePort>& port);
+    // Tell the JS port its channel was closed
+    void scheduleClose(uint64_t portId);
+
+    PortScheduler scheduler_;
+    std::unordered_map<uint64_t, std::weak_ptr<MessagePort>> ports_; // Owned ones
+    bool closed_{false};
+    mutable std::mutex mutex_;
+};
+
+} // namespace webworker
@@ -0,0 +1,74 @@
+#include "NativeArrayBuffer.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace webworker {
+
+namespace {
+
+// data pointer -> live buffer. Entries are removed by the buffer's destructor.
+std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::unordered_map<const uint8_t*, std::weak_ptr<NativeArrayBuffer>>& registry() {
+    static std::unordered_map<const uint8_t*, std::weak_ptr<NativeArrayBuffer>> buffers;
+    return buffers;
+}
+
+} // namespace
+
+NativeArrayBuffer::NativeArrayBuffer(size_t size, bool shared)
+    : storage_(size)
+    , shared_(shared) {
+}
+
+NativeArrayBuffer::NativeArrayBuffer(std::vector<uint8_t> storage, bool shared)
+    : storage_(std::move(storage))
+    , shared_(shared) {
+}
+
+NativeArrayBuffer::~NativeArrayBuffer() {
+    if (storage_.empty()) return;
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().erase(storage_.data());
+}
+
+std::shared_ptr<NativeArrayBuffer> NativeArrayBuffer::create(size_t size) {
+    return make(std::vector<uint8_t>(size), false);
+}
+
+std::shared_ptr<NativeArrayBuffer> NativeArrayBuffer::adopt(std::vector<uint8_t> data) {
+    return make(std::move(data), false);
+}
+
+std::shared_ptr<NativeArrayBuffer> NativeArrayBuffer::createShared(size_t size) {
+    return make(std::vector<uint8_t>(size), true);
+}
+
+std::shared_ptr<NativeArrayBuffer> NativeArrayBuffer::make(std::vector<uint8_t> storage, bool shared) {
+    auto buffer = std::make_shared<NativeArrayBuffer>(std::move(storage), shared);
+    // Empty buffers have no stable address and are never worth sharing
+    if (buffer->size() > 0) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        registry()[buffer->data()] = buffer;
+    }
+    return buffer;
+}
+
+std::shared_ptr<NativeArrayBuffer> NativeArrayBuffer::find(const uint8_t* data, size_t size) {
+    if (data == nullptr || size == 0) return nullptr;
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto it = registry().find(data);
+    if (it == registry().end()) return nullptr;
+
+    auto buffer = it->second.lock();
+    if (!buffer || buffer->size() != size) return nullptr;
+    return buffer;
+}
+
+} // namespace webworker
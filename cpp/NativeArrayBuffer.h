@@ -0,0 +1,71 @@
+#pragma once
+
+#include <jsi/jsi.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace webworker {
+
+using namespace facebook::jsi;
+
+/**
+ * NativeArrayBuffer - ArrayBuffer storage owned by native code
+ *
+ * Backs transferred ArrayBuffers. The same storage can be handed from one
+ * runtime to another without copying: the receiving runtime wraps it with
+ * jsi::ArrayBuffer(runtime, buffer) and the sender's ArrayBuffer is detached.
+ *
+ * Shared buffers (see createShared) are never moved: every runtime that
+ * receives one wraps the same storage, which is how SharedArrayBuffer is
+ * provided. The storage lives as long as any runtime still references it.
+ *
+ * Live buffers are indexed by their data pointer so that an ArrayBuffer that
+ * was itself received through a transfer can be transferred again for free,
+ * and so shared buffers can be recognized when they are posted.
+ */
+class NativeArrayBuffer : public MutableBuffer {
+public:
+    NativeArrayBuffer(size_t size, bool shared);
+    NativeArrayBuffer(std::vector<uint8_t> storage, bool shared);
+    ~NativeArrayBuffer() override;
+
+    NativeArrayBuffer(const NativeArrayBuffer&) = delete;
+    NativeArrayBuffer& operator=(const NativeArrayBuffer&) = delete;
+
+    size_t size() const override { return storage_.size(); }
+    uint8_t* data() override { return storage_.data(); }
+
+    bool isShared() const { return shared_; }
+
+    /**
+     * Find the live NativeArrayBuffer whose bytes start at `data`.
+     * Returns nullptr if `data` isn't native-backed.
+     */
+    static std::shared_ptr<NativeArrayBuffer> find(const uint8_t* data, size_t size);
+
+    /**
+     * Create a NativeArrayBuffer. Use this instead of the constructor so the
+     * buffer can be found again by find().
+     */
+    static std::shared_ptr<NativeArrayBuffer> create(size_t size);
+
+    /**
+     * Create a NativeArrayBuffer that takes over `data` without copying it.
+     */
+    static std::shared_ptr<NativeArrayBuffer> adopt(std::vector<uint8_t> data);
+
+    /**
+     * Create zero-initialized storage meant to be mapped into several
+     * runtimes at once.
+     */
+    static std::shared_ptr<NativeArrayBuffer> createShared(size_t size);
+
+private:
+    static std::shared_ptr<NativeArrayBuffer> make(std::vector<uint8_t> storage, bool shared);
+
+    std::vector<uint8_t> storage_;
+    bool shared_;
+};
+
+} // namespace webworker
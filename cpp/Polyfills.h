@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <cstddef>
+
 namespace webworker {
 
 constexpr const char* kPolyfillScript = R"POLYFILL(
@@ -32,4 +34,7 @@ __d(function(g,r,_i,a,m,e,d){
 __r(0);
 )POLYFILL";
 
+constexpr const unsigned char* kPolyfillBytecode = nullptr;
+constexpr size_t kPolyfillBytecodeSize = 0;
+
 } // namespace webworker
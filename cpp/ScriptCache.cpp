@@ -0,0 +1,99 @@
+#include "ScriptCache.h"
+
+#include <cstring>
+
+namespace webworker {
+
+uint64_t ScriptCache::hash(const Buffer& script) {
+    // FNV-1a, 64 bit
+    uint64_t hash = 1469598103934665603ull;
+    const uint8_t* data = script.data();
+    for (size_t i = 0, size = script.size(); i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool ScriptCache::sameScript(const Entry& entry, uint64_t hash, const Buffer& script, const std::string& sourceURL) {
+    if (entry.hash != hash || entry.sourceURL != sourceURL) return false;
+    if (entry.script.get() == &script) return true;
+    return entry.script->size() == script.size() &&
+           std::memcmp(entry.script->data(), script.data(), script.size()) == 0;
+}
+
+std::shared_ptr<const PreparedJavaScript> ScriptCache::prepare(
+    Runtime& runtime,
+    const std::shared_ptr<const Buffer>& script,
+    const std::string& sourceURL
+) {
+    // The workers of a pool share one buffer: find it by identity so the
+    // later ones don't touch every page of it to hash it
+    std::shared_ptr<Entry> entry = findByIdentity(*script, sourceURL);
+    if (entry) {
+        return prepared(runtime, *entry, sourceURL);
+    }
+
+    // Hash and compare outside of the lock, scripts can be megabytes
+    uint64_t scriptHash = hash(*script);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if ((*it)->hash == scriptHash) {
+                entry = *it;
+                entries_.splice(entries_.begin(), entries_, it);
+                break;
+            }
+        }
+        if (!entry) {
+            entry = std::make_shared<Entry>();
+            entry->hash = scriptHash;
+            entry->sourceURL = sourceURL;
+            entry->script = script;
+            entries_.push_front(entry);
+            if (entries_.size() > kMaxEntries) {
+                entries_.pop_back();
+            }
+        }
+    }
+
+    if (!sameScript(*entry, scriptHash, *script, sourceURL)) {
+        // A collision, or the same bytes under another URL: don't share
+        return runtime.prepareJavaScript(script, sourceURL);
+    }
+
+    return prepared(runtime, *entry, sourceURL);
+}
+
+std::shared_ptr<ScriptCache::Entry> ScriptCache::findByIdentity(const Buffer& script, const std::string& sourceURL) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if ((*it)->script.get() == &script && (*it)->sourceURL == sourceURL) {
+            entries_.splice(entries_.begin(), entries_, it);
+            return entries_.front();
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const PreparedJavaScript> ScriptCache::prepared(
+    Runtime& runtime,
+    Entry& entry,
+    const std::string& sourceURL
+) {
+    std::lock_guard<std::mutex> prepareLock(entry.prepareMutex);
+    if (!entry.prepared) {
+        entry.prepared = runtime.prepareJavaScript(entry.script, sourceURL);
+    }
+    return entry.prepared;
+}
+
+void ScriptCache::clear() {
+    std::list<std::shared_ptr<Entry>> entries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries.swap(entries_);
+    }
+}
+
+} // namespace webworker
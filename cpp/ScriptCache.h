@@ -0,0 +1,76 @@
+#pragma once
+
+#include <jsi/jsi.h>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace webworker {
+
+using namespace facebook::jsi;
+
+/**
+ * ScriptCache - Compiled worker scripts, shared by workers running the same source
+ *
+ * Entries are keyed by the script's content, so any number of workers
+ * started from the same bytes, by path or inline, parse and compile it once
+ * and evaluate the same PreparedJavaScript. A buffer that's already cached
+ * is recognised by its address and isn't hashed again. Hermes bytecode goes through
+ * unchanged; preparing it just wraps the buffer.
+ *
+ * Workers that miss at the same time wait for the first one to finish
+ * instead of compiling in parallel. The source stays referenced by its entry
+ * to tell hash collisions apart, so memory is one copy per distinct script
+ * rather than one per worker. The least recently used entries are dropped
+ * beyond kMaxEntries.
+ *
+ * Thread-safe.
+ */
+class ScriptCache {
+public:
+    static constexpr size_t kMaxEntries = 8;
+
+    ScriptCache() = default;
+
+    ScriptCache(const ScriptCache&) = delete;
+    ScriptCache& operator=(const ScriptCache&) = delete;
+
+    /**
+     * The prepared form of `script`, from the cache or compiled by `runtime`.
+     * Failures aren't cached.
+     * @throws whatever Runtime::prepareJavaScript throws
+     */
+    std::shared_ptr<const PreparedJavaScript> prepare(Runtime& runtime,
+                                                      const std::shared_ptr<const Buffer>& script,
+                                                      const std::string& sourceURL);
+
+    /** Drop every entry. Workers that evaluated them are unaffected. */
+    void clear();
+
+private:
+    struct Entry {
+        uint64_t hash{0};
+        std::string sourceURL;
+        std::shared_ptr<const Buffer> script;
+
+        std::mutex prepareMutex; // Held while compiling
+        std::shared_ptr<const PreparedJavaScript> prepared;
+    };
+
+    static uint64_t hash(const Buffer& script);
+    static bool sameScript(const Entry& entry, uint64_t hash, const Buffer& script, const std::string& sourceURL);
+
+    // The entry holding this very buffer, moved to the front
+    std::shared_ptr<Entry> findByIdentity(const Buffer& script, const std::string& sourceURL);
+
+    // Compiles the entry's script on first use
+    static std::shared_ptr<const PreparedJavaScript> prepared(Runtime& runtime, Entry& entry,
+                                                              const std::string& sourceURL);
+
+    std::list<std::shared_ptr<Entry>> entries_; // Most recently used first
+    std::mutex mutex_;
+};
+
+} // namespace webworker
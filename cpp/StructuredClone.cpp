@@ -0,0 +1,829 @@
+#include "StructuredClone.h"
+
+#include <cstring>
+#include <optional>
+#include <string>
+
+namespace webworker {
+
+namespace {
+
+constexpr uint8_t kFormatVersion = 1;
+
+// Guards the native stack against deeply nested (or hostile) payloads
+constexpr size_t kMaxDepth = 1000;
+
+enum class Tag : uint8_t {
+    Undefined = 'u',
+    Null = '0',
+    True = 'T',
+    False = 'F',
+    Number = 'N',
+    BigInt = 'I',
+    String = 'S',
+    Object = 'o',
+    Array = 'A',
+    Date = 'D',
+    RegExp = 'R',
+    Error = 'E',
+    Map = 'M',
+    Set = 's',
+    ArrayBuffer = 'B',
+    ArrayBufferView = 'V',
+    BackReference = 'r',
+    TransferredArrayBuffer = 't',
+    SharedArrayBuffer = 'H',
+    MessagePort = 'P',
+};
+
+enum class ViewType : uint8_t {
+    Int8,
+    Uint8,
+    Uint8Clamped,
+    Int16,
+    Uint16,
+    Int32,
+    Uint32,
+    Float32,
+    Float64,
+    BigInt64,
+    BigUint64,
+    DataView,
+};
+
+struct ViewInfo {
+    const char* tag;         // Object.prototype.toString() result
+    const char* constructor; // Global constructor name
+    ViewType type;
+};
+
+constexpr ViewInfo kViews[] = {
+    {"[object Int8Array]", "Int8Array", ViewType::Int8},
+    {"[object Uint8Array]", "Uint8Array", ViewType::Uint8},
+    {"[object Uint8ClampedArray]", "Uint8ClampedArray", ViewType::Uint8Clamped},
+    {"[object Int16Array]", "Int16Array", ViewType::Int16},
+    {"[object Uint16Array]", "Uint16Array", ViewType::Uint16},
+    {"[object Int32Array]", "Int32Array", ViewType::Int32},
+    {"[object Uint32Array]", "Uint32Array", ViewType::Uint32},
+    {"[object Float32Array]", "Float32Array", ViewType::Float32},
+    {"[object Float64Array]", "Float64Array", ViewType::Float64},
+    {"[object BigInt64Array]", "BigInt64Array", ViewType::BigInt64},
+    {"[object BigUint64Array]", "BigUint64Array", ViewType::BigUint64},
+    {"[object DataView]", "DataView", ViewType::DataView},
+};
+
+constexpr const char* kErrorConstructors[] = {
+    "Error", "EvalError", "RangeError", "ReferenceError", "SyntaxError", "TypeError", "URIError",
+};
+
+[[noreturn]] void throwDataCloneError(Runtime& rt, const std::string& message) {
+    throw JSError(rt, "DataCloneError: " + message);
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+class Writer {
+public:
+    explicit Writer(Runtime& rt) : rt_(rt) {
+        buffer_.push_back(kFormatVersion);
+    }
+
+    void write(const Value& value, size_t depth = 0);
+
+    /**
+     * Register the ArrayBuffers and MessagePorts of a transfer list. Must be
+     * called before write() so references to them are encoded by index.
+     */
+    void setTransferList(const Value& transferList);
+
+    /**
+     * Move the transferred buffers into native storage and detach them.
+     * Only called once the whole value was written successfully.
+     */
+    std::vector<std::shared_ptr<NativeArrayBuffer>> takeTransfers();
+
+    /** Detach the transferred ports from their JS MessagePorts, same as takeTransfers(). */
+    std::vector<std::shared_ptr<MessagePort>> takePorts();
+
+    std::vector<uint8_t> take() { return std::move(buffer_); }
+
+    std::vector<std::shared_ptr<NativeArrayBuffer>> takeSharedBuffers() {
+        return std::move(sharedBuffers_);
+    }
+
+private:
+    void writeTag(Tag tag) { buffer_.push_back(static_cast<uint8_t>(tag)); }
+
+    void writeVarint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer_.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<uint8_t>(value));
+    }
+
+    void writeDouble(double value) {
+        uint8_t bytes[sizeof(double)];
+        std::memcpy(bytes, &value, sizeof(double));
+        buffer_.insert(buffer_.end(), bytes, bytes + sizeof(double));
+    }
+
+    void writeBytes(const uint8_t* data, size_t size) {
+        writeVarint(size);
+        buffer_.insert(buffer_.end(), data, data + size);
+    }
+
+    void writeString(const std::string& value) {
+        writeBytes(reinterpret_cast<const uint8_t*>(value.data()), value.size());
+    }
+
+    /**
+     * Writes a back reference and returns true if `object` was already
+     * serialized, otherwise assigns it the next id and returns false.
+     */
+    bool writeBackReference(const Object& object);
+
+    void addTransferredPort(Object port);
+
+    void writeObject(const Object& object, size_t depth);
+    void writeArrayBufferView(const Object& object, const ViewInfo& view, size_t depth);
+
+    std::string toStringTag(const Object& object);
+
+    /**
+     * Detach `arrayBuffer` through ArrayBuffer.prototype.transfer.
+     * Returns false if the engine doesn't support it.
+     */
+    bool detach(const Object& arrayBuffer);
+
+    Runtime& rt_;
+    std::vector<uint8_t> buffer_;
+
+    // Object identity -> id. A JS Map is the only identity-keyed lookup JSI offers.
+    std::optional<Object> memory_;
+    std::optional<Function> memoryGet_;
+    std::optional<Function> memorySet_;
+    uint64_t nextId_{0};
+
+    // ArrayBuffer -> index in the transfer list
+    std::optional<Object> transferIndices_;
+    std::optional<Function> transferIndicesGet_;
+    std::vector<Object> transferred_;
+
+    // MessagePort -> index in `ports`
+    std::optional<Object> portIndices_;
+    std::optional<Function> portIndicesGet_;
+    std::vector<Object> transferredPorts_;
+
+    std::vector<std::shared_ptr<NativeArrayBuffer>> sharedBuffers_;
+
+    std::optional<Function> objectToString_;
+    std::optional<Function> arrayBufferTransfer_;
+};
+
+void Writer::write(const Value& value, size_t depth) {
+    if (depth > kMaxDepth) {
+        throwDataCloneError(rt_, "value is nested too deeply");
+    }
+
+    if (value.isUndefined()) {
+        writeTag(Tag::Undefined);
+    } else if (value.isNull()) {
+        writeTag(Tag::Null);
+    } else if (value.isBool()) {
+        writeTag(value.getBool() ? Tag::True : Tag::False);
+    } else if (value.isNumber()) {
+        writeTag(Tag::Number);
+        writeDouble(value.getNumber());
+    } else if (value.isString()) {
+        writeTag(Tag::String);
+        writeString(value.getString(rt_).utf8(rt_));
+    } else if (value.isBigInt()) {
+        writeTag(Tag::BigInt);
+        writeString(value.toString(rt_).utf8(rt_));
+    } else if (value.isSymbol()) {
+        throwDataCloneError(rt_, "Symbol could not be cloned");
+    } else {
+        writeObject(value.getObject(rt_), depth);
+    }
+}
+
+bool Writer::writeBackReference(const Object& object) {
+    if (!memory_) {
+        Object memory = rt_.global()
+            .getPropertyAsFunction(rt_, "Map")
+            .callAsConstructor(rt_)
+            .getObject(rt_);
+        memoryGet_ = memory.getPropertyAsFunction(rt_, "get");
+        memorySet_ = memory.getPropertyAsFunction(rt_, "set");
+        memory_ = std::move(memory);
+    }
+
+    Value id = memoryGet_->callWithThis(rt_, *memory_, Value(rt_, object));
+    if (id.isNumber()) {
+        writeTag(Tag::BackReference);
+        writeVarint(static_cast<uint64_t>(id.getNumber()));
+        return true;
+    }
+
+    memorySet_->callWithThis(rt_, *memory_, Value(rt_, object),
+                             Value(static_cast<double>(nextId_++)));
+    return false;
+}
+
+void Writer::setTransferList(const Value& transferList) {
+    if (transferList.isUndefined() || transferList.isNull()) return;
+
+    if (!transferList.isObject() || !transferList.getObject(rt_).isArray(rt_)) {
+        throwDataCloneError(rt_, "transfer list must be an array");
+    }
+
+    Array list = transferList.getObject(rt_).getArray(rt_);
+    size_t length = list.size(rt_);
+    if (length == 0) return;
+
+    Object indices = rt_.global()
+        .getPropertyAsFunction(rt_, "Map")
+        .callAsConstructor(rt_)
+        .getObject(rt_);
+    Function has = indices.getPropertyAsFunction(rt_, "has");
+    Function set = indices.getPropertyAsFunction(rt_, "set");
+
+    for (size_t i = 0; i < length; i++) {
+        Value entry = list.getValueAtIndex(rt_, i);
+        if (!entry.isObject() || entry.getObject(rt_).isHostObject(rt_)) {
+            throwDataCloneError(rt_, "value in transfer list is not transferable");
+        }
+        if (!entry.getObject(rt_).isArrayBuffer(rt_)) {
+            addTransferredPort(entry.getObject(rt_));
+            continue;
+        }
+        Object arrayBuffer = entry.getObject(rt_);
+        {
+            ArrayBuffer view = arrayBuffer.getArrayBuffer(rt_);
+            auto native = NativeArrayBuffer::find(view.data(rt_), view.size(rt_));
+            if (native && native->isShared()) {
+                throwDataCloneError(rt_, "SharedArrayBuffer could not be transferred");
+            }
+        }
+        if (has.callWithThis(rt_, indices, Value(rt_, arrayBuffer)).getBool()) {
+            throwDataCloneError(rt_, "ArrayBuffer is listed more than once in the transfer list");
+        }
+        set.callWithThis(rt_, indices, Value(rt_, arrayBuffer),
+                         Value(static_cast<double>(transferred_.size())));
+        transferred_.push_back(std::move(arrayBuffer));
+    }
+
+    transferIndicesGet_ = indices.getPropertyAsFunction(rt_, "get");
+    transferIndices_ = std::move(indices);
+}
+
+void Writer::addTransferredPort(Object port) {
+    if (!MessagePortContext::portOf(rt_, port)) {
+        throwDataCloneError(rt_, "value in transfer list is not transferable");
+    }
+
+    if (!portIndices_) {
+        Object indices = rt_.global()
+            .getPropertyAsFunction(rt_, "Map")
+            .callAsConstructor(rt_)
+            .getObject(rt_);
+        portIndicesGet_ = indices.getPropertyAsFunction(rt_, "get");
+        portIndices_ = std::move(indices);
+    }
+
+    if (portIndicesGet_->callWithThis(rt_, *portIndices_, Value(rt_, port)).isNumber()) {
+        throwDataCloneError(rt_, "MessagePort is listed more than once in the transfer list");
+    }
+    portIndices_->getPropertyAsFunction(rt_, "set")
+        .callWithThis(rt_, *portIndices_, Value(rt_, port),
+                      Value(static_cast<double>(transferredPorts_.size())));
+    transferredPorts_.push_back(std::move(port));
+}
+
+std::vector<std::shared_ptr<MessagePort>> Writer::takePorts() {
+    std::vector<std::shared_ptr<MessagePort>> ports;
+    ports.reserve(transferredPorts_.size());
+    for (const auto& port : transferredPorts_) {
+        ports.push_back(MessagePortContext::detach(rt_, port));
+    }
+    transferredPorts_.clear();
+    return ports;
+}
+
+std::vector<std::shared_ptr<NativeArrayBuffer>> Writer::takeTransfers() {
+    std::vector<std::shared_ptr<NativeArrayBuffer>> transfers;
+    transfers.reserve(transferred_.size());
+
+    for (const auto& object : transferred_) {
+        ArrayBuffer arrayBuffer = object.getArrayBuffer(rt_);
+        uint8_t* data = arrayBuffer.data(rt_);
+        size_t size = arrayBuffer.size(rt_);
+
+        // Sharing the storage is only safe if the sender loses access to it
+        auto buffer = NativeArrayBuffer::find(data, size);
+        if (buffer && detach(object)) {
+            transfers.push_back(std::move(buffer));
+            continue;
+        }
+
+        buffer = NativeArrayBuffer::create(size);
+        if (size > 0) {
+            std::memcpy(buffer->data(), data, size);
+        }
+        detach(object);
+        transfers.push_back(std::move(buffer));
+    }
+
+    transferred_.clear();
+    return transfers;
+}
+
+bool Writer::detach(const Object& arrayBuffer) {
+    if (!arrayBufferTransfer_) {
+        Value transfer = rt_.global()
+            .getPropertyAsObject(rt_, "ArrayBuffer")
+            .getPropertyAsObject(rt_, "prototype")
+            .getProperty(rt_, "transfer");
+        if (!transfer.isObject() || !transfer.getObject(rt_).isFunction(rt_)) {
+            return false;
+        }
+        arrayBufferTransfer_ = transfer.getObject(rt_).getFunction(rt_);
+    }
+
+    // transfer(0) detaches the source and returns an empty buffer
+    arrayBufferTransfer_->callWithThis(rt_, arrayBuffer, Value(0));
+    return true;
+}
+
+std::string Writer::toStringTag(const Object& object) {
+    if (!objectToString_) {
+        objectToString_ = rt_.global()
+            .getPropertyAsObject(rt_, "Object")
+            .getPropertyAsObject(rt_, "prototype")
+            .getPropertyAsFunction(rt_, "toString");
+    }
+    return objectToString_->callWithThis(rt_, object).getString(rt_).utf8(rt_);
+}
+
+void Writer::writeObject(const Object& object, size_t depth) {
+    if (object.isFunction(rt_)) {
+        throwDataCloneError(rt_, "function could not be cloned");
+    }
+    if (object.isHostObject(rt_)) {
+        throwDataCloneError(rt_, "host object could not be cloned");
+    }
+
+    if (writeBackReference(object)) {
+        return;
+    }
+
+    if (portIndices_) {
+        Value index = portIndicesGet_->callWithThis(rt_, *portIndices_, Value(rt_, object));
+        if (index.isNumber()) {
+            writeTag(Tag::MessagePort);
+            writeVarint(static_cast<uint64_t>(index.getNumber()));
+            return;
+        }
+    }
+
+    if (object.isArray(rt_)) {
+        Array array = object.getArray(rt_);
+        size_t length = array.size(rt_);
+        writeTag(Tag::Array);
+        writeVarint(length);
+        for (size_t i = 0; i < length; i++) {
+            write(array.getValueAtIndex(rt_, i), depth + 1);
+        }
+        return;
+    }
+
+    if (object.isArrayBuffer(rt_)) {
+        if (transferIndices_) {
+            Value index = transferIndicesGet_->callWithThis(rt_, *transferIndices_, Value(rt_, object));
+            if (index.isNumber()) {
+                writeTag(Tag::TransferredArrayBuffer);
+                writeVarint(static_cast<uint64_t>(index.getNumber()));
+                return;
+            }
+        }
+
+        ArrayBuffer arrayBuffer = object.getArrayBuffer(rt_);
+
+        auto native = NativeArrayBuffer::find(arrayBuffer.data(rt_), arrayBuffer.size(rt_));
+        if (native && native->isShared()) {
+            writeTag(Tag::SharedArrayBuffer);
+            writeVarint(sharedBuffers_.size());
+            sharedBuffers_.push_back(std::move(native));
+            return;
+        }
+
+        writeTag(Tag::ArrayBuffer);
+        writeBytes(arrayBuffer.data(rt_), arrayBuffer.size(rt_));
+        return;
+    }
+
+    std::string tag = toStringTag(object);
+
+    if (tag == "[object Object]") {
+        Array names = object.getPropertyNames(rt_);
+        size_t count = names.size(rt_);
+        writeTag(Tag::Object);
+        writeVarint(count);
+        for (size_t i = 0; i < count; i++) {
+            String name = names.getValueAtIndex(rt_, i).getString(rt_);
+            writeString(name.utf8(rt_));
+            write(object.getProperty(rt_, name), depth + 1);
+        }
+        return;
+    }
+
+    if (tag == "[object Date]") {
+        writeTag(Tag::Date);
+        writeDouble(object.getPropertyAsFunction(rt_, "getTime").callWithThis(rt_, object).getNumber());
+        return;
+    }
+
+    if (tag == "[object RegExp]") {
+        writeTag(Tag::RegExp);
+        writeString(object.getProperty(rt_, "source").toString(rt_).utf8(rt_));
+        writeString(object.getProperty(rt_, "flags").toString(rt_).utf8(rt_));
+        return;
+    }
+
+    if (tag == "[object Error]") {
+        writeTag(Tag::Error);
+        writeString(object.getProperty(rt_, "name").toString(rt_).utf8(rt_));
+        writeString(object.getProperty(rt_, "message").toString(rt_).utf8(rt_));
+        return;
+    }
+
+    if (tag == "[object Map]" || tag == "[object Set]") {
+        bool isMap = tag == "[object Map]";
+        // Array.from yields [key, value] pairs for a Map and values for a Set
+        Array entries = rt_.global()
+            .getPropertyAsObject(rt_, "Array")
+            .getPropertyAsFunction(rt_, "from")
+            .call(rt_, Value(rt_, object))
+            .getObject(rt_)
+            .getArray(rt_);
+        size_t count = entries.size(rt_);
+        writeTag(isMap ? Tag::Map : Tag::Set);
+        writeVarint(count);
+        for (size_t i = 0; i < count; i++) {
+            Value entry = entries.getValueAtIndex(rt_, i);
+            if (isMap) {
+                Array pair = entry.getObject(rt_).getArray(rt_);
+                write(pair.getValueAtIndex(rt_, 0), depth + 1);
+                write(pair.getValueAtIndex(rt_, 1), depth + 1);
+            } else {
+                write(entry, depth + 1);
+            }
+        }
+        return;
+    }
+
+    for (const auto& view : kViews) {
+        if (tag == view.tag) {
+            writeArrayBufferView(object, view, depth);
+            return;
+        }
+    }
+
+    throwDataCloneError(rt_, tag + " could not be cloned");
+}
+
+void Writer::writeArrayBufferView(const Object& object, const ViewInfo& view, size_t depth) {
+    const char* lengthProperty = view.type == ViewType::DataView ? "byteLength" : "length";
+
+    writeTag(Tag::ArrayBufferView);
+    buffer_.push_back(static_cast<uint8_t>(view.type));
+    writeVarint(static_cast<uint64_t>(object.getProperty(rt_, "byteOffset").getNumber()));
+    writeVarint(static_cast<uint64_t>(object.getProperty(rt_, lengthProperty).getNumber()));
+    // The backing buffer goes through write() so views sharing it stay shared
+    write(object.getProperty(rt_, "buffer"), depth + 1);
+}
+
+// ============================================================================
+// Reader
+// ============================================================================
+
+class Reader {
+public:
+    Reader(Runtime& rt, const SerializedMessage& message)
+        : rt_(rt)
+        , data_(message.data.data())
+        , end_(message.data.data() + message.data.size())
+        , transfers_(message.transfers)
+        , sharedBuffers_(message.sharedBuffers)
+        , ports_(message.ports) {}
+
+    Value read(size_t depth = 0);
+
+    void readHeader() {
+        if (readByte() != kFormatVersion) {
+            malformed();
+        }
+    }
+
+    bool atEnd() const { return data_ == end_; }
+
+private:
+    [[noreturn]] void malformed() { throwDataCloneError(rt_, "malformed message"); }
+
+    uint8_t readByte() {
+        if (data_ >= end_) {
+            malformed();
+        }
+        return *data_++;
+    }
+
+    uint64_t readVarint() {
+        uint64_t result = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = readByte();
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return result;
+            }
+        }
+        malformed();
+    }
+
+    double readDouble() {
+        if (static_cast<size_t>(end_ - data_) < sizeof(double)) {
+            malformed();
+        }
+        double value;
+        std::memcpy(&value, data_, sizeof(double));
+        data_ += sizeof(double);
+        return value;
+    }
+
+    const uint8_t* readBytes(size_t& size) {
+        size = static_cast<size_t>(readVarint());
+        if (static_cast<size_t>(end_ - data_) < size) {
+            malformed();
+        }
+        const uint8_t* bytes = data_;
+        data_ += size;
+        return bytes;
+    }
+
+    String readString() {
+        size_t size;
+        const uint8_t* bytes = readBytes(size);
+        return String::createFromUtf8(rt_, bytes, size);
+    }
+
+    std::string readStdString() {
+        size_t size;
+        const uint8_t* bytes = readBytes(size);
+        return std::string(reinterpret_cast<const char*>(bytes), size);
+    }
+
+    size_t remember(const Object& object) {
+        objects_.emplace_back(rt_, object);
+        return objects_.size() - 1;
+    }
+
+    Function constructor(const char* name) {
+        return rt_.global().getPropertyAsFunction(rt_, name);
+    }
+
+    Value readArrayBufferView(size_t depth);
+
+    Runtime& rt_;
+    const uint8_t* data_;
+    const uint8_t* end_;
+    const std::vector<std::shared_ptr<NativeArrayBuffer>>& transfers_;
+    const std::vector<std::shared_ptr<NativeArrayBuffer>>& sharedBuffers_;
+    const std::vector<std::shared_ptr<MessagePort>>& ports_;
+    std::vector<Value> objects_;
+};
+
+Value Reader::read(size_t depth) {
+    if (depth > kMaxDepth) {
+        malformed();
+    }
+
+    Tag tag = static_cast<Tag>(readByte());
+    switch (tag) {
+    case Tag::Undefined:
+        return Value::undefined();
+    case Tag::Null:
+        return Value::null();
+    case Tag::True:
+        return Value(true);
+    case Tag::False:
+        return Value(false);
+    case Tag::Number:
+        return Value(readDouble());
+    case Tag::String:
+        return readString();
+    case Tag::BigInt:
+        return constructor("BigInt").call(rt_, readString());
+    case Tag::BackReference: {
+        uint64_t id = readVarint();
+        if (id >= objects_.size() || objects_[id].isUndefined()) {
+            malformed();
+        }
+        return Value(rt_, objects_[id]);
+    }
+    case Tag::Object: {
+        Object object(rt_);
+        remember(object);
+        uint64_t count = readVarint();
+        for (uint64_t i = 0; i < count; i++) {
+            std::string key = readStdString();
+            Value value = read(depth + 1);
+            if (key == "__proto__") {
+                // A plain assignment would replace the prototype
+                Object descriptor(rt_);
+                descriptor.setProperty(rt_, "value", value);
+                descriptor.setProperty(rt_, "writable", true);
+                descriptor.setProperty(rt_, "enumerable", true);
+                descriptor.setProperty(rt_, "configurable", true);
+                rt_.global()
+                    .getPropertyAsObject(rt_, "Object")
+                    .getPropertyAsFunction(rt_, "defineProperty")
+                    .call(rt_, Value(rt_, object), String::createFromAscii(rt_, "__proto__"),
+                          descriptor);
+            } else {
+                object.setProperty(rt_, PropNameID::forUtf8(rt_, key), value);
+            }
+        }
+        return object;
+    }
+    case Tag::Array: {
+        uint64_t length = readVarint();
+        if (length > static_cast<uint64_t>(end_ - data_)) {
+            // Every element takes at least one byte
+            malformed();
+        }
+        Array array(rt_, static_cast<size_t>(length));
+        remember(array);
+        for (uint64_t i = 0; i < length; i++) {
+            array.setValueAtIndex(rt_, static_cast<size_t>(i), read(depth + 1));
+        }
+        return array;
+    }
+    case Tag::Date: {
+        Object date = constructor("Date").callAsConstructor(rt_, readDouble()).getObject(rt_);
+        remember(date);
+        return date;
+    }
+    case Tag::RegExp: {
+        String source = readString();
+        String flags = readString();
+        Object regExp = constructor("RegExp").callAsConstructor(rt_, source, flags).getObject(rt_);
+        remember(regExp);
+        return regExp;
+    }
+    case Tag::Error: {
+        std::string name = readStdString();
+        String message = readString();
+        const char* ctorName = "Error";
+        for (const char* candidate : kErrorConstructors) {
+            if (name == candidate) {
+                ctorName = candidate;
+                break;
+            }
+        }
+        Object error = constructor(ctorName).callAsConstructor(rt_, message).getObject(rt_);
+        remember(error);
+        return error;
+    }
+    case Tag::Map:
+    case Tag::Set: {
+        bool isMap = tag == Tag::Map;
+        Object collection =
+            constructor(isMap ? "Map" : "Set").callAsConstructor(rt_).getObject(rt_);
+        remember(collection);
+        Function insert = collection.getPropertyAsFunction(rt_, isMap ? "set" : "add");
+        uint64_t count = readVarint();
+        for (uint64_t i = 0; i < count; i++) {
+            if (isMap) {
+                Value key = read(depth + 1);
+                Value value = read(depth + 1);
+                insert.callWithThis(rt_, collection, key, value);
+            } else {
+                insert.callWithThis(rt_, collection, read(depth + 1));
+            }
+        }
+        return collection;
+    }
+    case Tag::ArrayBuffer: {
+        size_t size;
+        const uint8_t* bytes = readBytes(size);
+        ArrayBuffer arrayBuffer = constructor("ArrayBuffer")
+            .callAsConstructor(rt_, static_cast<double>(size))
+            .getObject(rt_)
+            .getArrayBuffer(rt_);
+        if (size > 0) {
+            std::memcpy(arrayBuffer.data(rt_), bytes, size);
+        }
+        remember(arrayBuffer);
+        return arrayBuffer;
+    }
+    case Tag::TransferredArrayBuffer: {
+        uint64_t index = readVarint();
+        if (index >= transfers_.size()) {
+            malformed();
+        }
+        // Wraps the native storage, no copy
+        ArrayBuffer arrayBuffer(rt_, transfers_[static_cast<size_t>(index)]);
+        remember(arrayBuffer);
+        return arrayBuffer;
+    }
+    case Tag::SharedArrayBuffer: {
+        uint64_t index = readVarint();
+        if (index >= sharedBuffers_.size()) {
+            malformed();
+        }
+        // Maps the same memory as the sender's buffer
+        ArrayBuffer arrayBuffer(rt_, sharedBuffers_[static_cast<size_t>(index)]);
+        remember(arrayBuffer);
+        return arrayBuffer;
+    }
+    case Tag::MessagePort: {
+        uint64_t index = readVarint();
+        if (index >= ports_.size() || !ports_[static_cast<size_t>(index)]) {
+            malformed();
+        }
+        // This runtime becomes the port's owner
+        Object port = MessagePortContext::adopt(rt_, ports_[static_cast<size_t>(index)]).getObject(rt_);
+        remember(port);
+        return port;
+    }
+    case Tag::ArrayBufferView:
+        return readArrayBufferView(depth);
+    }
+
+    malformed();
+}
+
+Value Reader::readArrayBufferView(size_t depth) {
+    auto type = static_cast<ViewType>(readByte());
+    const ViewInfo* view = nullptr;
+    for (const auto& candidate : kViews) {
+        if (candidate.type == type) {
+            view = &candidate;
+            break;
+        }
+    }
+    if (view == nullptr) {
+        malformed();
+    }
+
+    double byteOffset = static_cast<double>(readVarint());
+    double length = static_cast<double>(readVarint());
+
+    // The writer assigned the view its id before its buffer
+    objects_.emplace_back();
+    size_t id = objects_.size() - 1;
+
+    Value buffer = read(depth + 1);
+    if (!buffer.isObject() || !buffer.getObject(rt_).isArrayBuffer(rt_)) {
+        malformed();
+    }
+
+    Object result = constructor(view->constructor)
+        .callAsConstructor(rt_, buffer, byteOffset, length)
+        .getObject(rt_);
+    objects_[id] = Value(rt_, result);
+    return result;
+}
+
+} // namespace
+
+std::shared_ptr<SerializedMessage> serializeValue(
+    Runtime& runtime,
+    const Value& value,
+    const Value& transferList
+) {
+    Writer writer(runtime);
+    writer.setTransferList(transferList);
+    writer.write(value);
+
+    auto message = std::make_shared<SerializedMessage>();
+    message->transfers = writer.takeTransfers();
+    message->ports = writer.takePorts();
+    message->sharedBuffers = writer.takeSharedBuffers();
+    message->data = writer.take();
+    return message;
+}
+
+Value deserializeValue(Runtime& runtime, const SerializedMessage& message) {
+    Reader reader(runtime, message);
+    reader.readHeader();
+    Value value = reader.read();
+    if (!reader.atEnd()) {
+        throwDataCloneError(runtime, "malformed message");
+    }
+    return value;
+}
+
+} // namespace webworker
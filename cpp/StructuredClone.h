@@ -0,0 +1,66 @@
+#pragma once
+
+#include <jsi/jsi.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "MessagePort.h"
+#include "NativeArrayBuffer.h"
+
+namespace webworker {
+
+using namespace facebook::jsi;
+
+/**
+ * A value encoded with the structured clone algorithm.
+ *
+ * The encoding never leaves the process: it only travels between runtimes
+ * owned by this library, so it uses native byte order and carries a version
+ * byte purely as a sanity check.
+ *
+ * Transferred and shared ArrayBuffers don't go through `data`: their storage
+ * is referenced from `transfers` / `sharedBuffers` and the encoding only
+ * refers to them by index. So do transferred MessagePorts, in `ports`.
+ */
+struct SerializedMessage {
+    std::vector<uint8_t> data;
+    std::vector<std::shared_ptr<NativeArrayBuffer>> transfers;
+    std::vector<std::shared_ptr<NativeArrayBuffer>> sharedBuffers;
+    std::vector<std::shared_ptr<MessagePort>> ports;
+};
+
+/**
+ * Serialize a value living in `runtime`.
+ *
+ * Supports primitives (including BigInt), plain objects, arrays, Date, RegExp,
+ * Error, Map, Set, ArrayBuffer, typed arrays and DataView. Shared and cyclic
+ * references are preserved. SharedArrayBuffers are not copied: the receiver
+ * maps the same memory.
+ *
+ * `transferList` is an optional array of ArrayBuffers whose ownership moves
+ * to the message instead of being copied. That needs the source detached,
+ * and JSI's only way to do it is ArrayBuffer.prototype.transfer, which
+ * Hermes doesn't implement. So on Hermes a transfer is a copy: each buffer
+ * is copied once into native storage and the sender keeps its own,
+ * unchanged. Where transfer() exists, the sources are detached, and buffers
+ * that are already native-backed (received through an earlier transfer)
+ * are handed over without copying.
+ * It may also list MessagePorts, which must be transferred to be cloned:
+ * the sender's port is neutered and the receiver adopts it.
+ *
+ * @throws JSError (DataCloneError) for functions, symbols, host objects and
+ *         invalid transfer lists
+ */
+std::shared_ptr<SerializedMessage> serializeValue(Runtime& runtime,
+                                                  const Value& value,
+                                                  const Value& transferList = Value::undefined());
+
+/**
+ * Rebuild a value produced by serializeValue inside `runtime`.
+ *
+ * @throws JSError if the message is malformed
+ */
+Value deserializeValue(Runtime& runtime, const SerializedMessage& message);
+
+} // namespace webworker
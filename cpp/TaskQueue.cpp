@@ -1,122 +1,213 @@
 #include "TaskQueue.h"
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <thread>
 
 namespace webworker {
 
+TaskQueue::TaskQueue()
+    : head_(new Node())
+    , tail_(head_.load(std::memory_order_relaxed))
+    , timers_(std::make_unique<TimerWheel>()) {
+}
+
+TaskQueue::~TaskQueue() {
+    Node* node = tail_;
+    while (node) {
+        Node* next = node->next.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+    }
+}
+
 void TaskQueue::enqueue(Task task) {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        task.runAt = std::chrono::steady_clock::now();
-        immediateTasks_.push(std::move(task));
+    task.runAt = std::chrono::steady_clock::now();
+
+    auto* node = new Node();
+    node->task = std::move(task);
+
+    // Publish: claim the head, then link the previous head to us. Until the
+    // link lands the consumer sees the queue as busy and retries.
+    // Counted before publishing, so the consumer's decrement always follows
+    immediateCount_.fetch_add(1, std::memory_order_relaxed);
+    Node* previous = head_.exchange(node, std::memory_order_seq_cst);
+    previous->next.store(node, std::memory_order_seq_cst);
+
+    if (parked_.load(std::memory_order_seq_cst)) {
+        wakeConsumer();
     }
-    cv_.notify_one();
+}
+
+void TaskQueue::enqueueLocal(Task task) {
+    task.runAt = std::chrono::steady_clock::now();
+    localTasks_.push_back(std::move(task));
+    localCount_.store(localTasks_.size(), std::memory_order_relaxed);
 }
 
 void TaskQueue::enqueueDelayed(Task task, std::chrono::milliseconds delay) {
+    task.runAt = std::chrono::steady_clock::now() + delay;
+    timers_->schedule(std::move(task));
+    delayedCount_.store(timers_->size(), std::memory_order_relaxed);
+}
+
+bool TaskQueue::cancel(uint64_t taskId) {
+    bool cancelled = timers_->cancel(taskId);
+    delayedCount_.store(timers_->size(), std::memory_order_relaxed);
+    return cancelled;
+}
+
+bool TaskQueue::hasImmediate() const {
+    return head_.load(std::memory_order_seq_cst) != tail_;
+}
+
+std::optional<Task> TaskQueue::tryDequeueImmediate() {
+    // nullopt as well while the oldest node isn't fully published yet
+    Node* next = tail_->next.load(std::memory_order_acquire);
+    if (!next) {
+        return std::nullopt;
+    }
+
+    // `next` becomes the new stub once its task is moved out
+    Task task = std::move(next->task);
+    delete tail_;
+    tail_ = next;
+    immediateCount_.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+void TaskQueue::wakeConsumer() {
     {
-        std::lock_guard<std::mutex> lock(mutex_);
-        task.runAt = std::chrono::steady_clock::now() + delay;
-        delayedTasks_.push(std::move(task));
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        wakePending_ = true;
     }
     cv_.notify_one();
 }
 
-bool TaskQueue::cancel(uint64_t taskId) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    cancelledIds_.insert(taskId);
-    return true;
+TaskQueue::Clock::time_point TaskQueue::coalesce(Clock::time_point deadline, Clock::time_point now) const {
+    auto slack = std::min<Clock::duration>(timerSlack_, (deadline - now) / 8);
+    auto slackMs = std::chrono::duration_cast<std::chrono::milliseconds>(slack).count();
+    if (slackMs < 1) return deadline;
+
+    // Largest power of two that fits in the slack, so that queues picking
+    // similar slack land on the same boundaries
+    int64_t grid = 1;
+    while (grid * 2 <= slackMs) grid *= 2;
+    Clock::duration step = std::chrono::milliseconds(grid);
+
+    auto sinceEpoch = deadline.time_since_epoch();
+    auto remainder = sinceEpoch % step;
+    if (remainder == Clock::duration::zero()) return deadline;
+    return deadline + (step - remainder);
 }
 
-std::optional<Task> TaskQueue::dequeue(std::chrono::milliseconds maxWait) {
-    std::unique_lock<std::mutex> lock(mutex_);
+Task TaskQueue::takeLocal() {
+    Task task = std::move(localTasks_.front());
+    localTasks_.pop_front();
+    localCount_.store(localTasks_.size(), std::memory_order_relaxed);
+    return task;
+}
 
-    auto deadline = std::chrono::steady_clock::now() + maxWait;
+std::optional<Task> TaskQueue::dequeue() {
+    return dequeueUntil(std::nullopt);
+}
 
+std::optional<Task> TaskQueue::dequeue(std::chrono::milliseconds maxWait) {
+    auto now = Clock::now();
+    if (maxWait >= std::chrono::duration_cast<std::chrono::milliseconds>(Clock::time_point::max() - now)) {
+        return dequeueUntil(std::nullopt);
+    }
+    return dequeueUntil(now + maxWait);
+}
+
+std::optional<Task> TaskQueue::dequeueUntil(std::optional<Clock::time_point> deadline) {
     while (true) {
-        if (shuttingDown_) {
+        if (shuttingDown_.load(std::memory_order_acquire)) {
             return std::nullopt;
         }
 
-        auto now = std::chrono::steady_clock::now();
+        auto now = Clock::now();
 
-        // Check immediate tasks first (higher priority)
-        while (!immediateTasks_.empty()) {
-            Task task = std::move(immediateTasks_.front());
-            immediateTasks_.pop();
-
-            // Skip cancelled tasks
-            if (cancelledIds_.count(task.id) > 0) {
-                cancelledIds_.erase(task.id);
-                continue;
-            }
+        // The local lane waited a turn already: its share comes first
+        if (localPassedOver_ && !localTasks_.empty()) {
+            localPassedOver_ = false;
+            return takeLocal();
+        }
 
+        // Check immediate tasks first (higher priority)
+        if (auto task = tryDequeueImmediate()) {
+            localPassedOver_ = !localTasks_.empty();
             return task;
         }
 
         // Check delayed tasks that are ready to run
-        while (!delayedTasks_.empty()) {
-            const Task& top = delayedTasks_.top();
-
-            // Skip cancelled tasks
-            if (cancelledIds_.count(top.id) > 0) {
-                cancelledIds_.erase(top.id);
-                // Need to pop and continue (can't modify priority_queue in place)
-                Task discarded = std::move(const_cast<Task&>(delayedTasks_.top()));
-                delayedTasks_.pop();
-                continue;
-            }
-
-            // Check if it's time to run this task
-            if (top.runAt <= now) {
-                Task task = std::move(const_cast<Task&>(delayedTasks_.top()));
-                delayedTasks_.pop();
-                return task;
-            }
-
-            // Task not ready yet
-            break;
+        if (auto task = timers_->popExpired(now)) {
+            delayedCount_.store(timers_->size(), std::memory_order_relaxed);
+            localPassedOver_ = !localTasks_.empty();
+            return task;
         }
 
-        // Calculate how long to wait
-        auto waitUntil = deadline;
+        // Then whatever the consumer posted to itself
+        if (!localTasks_.empty()) {
+            localPassedOver_ = false;
+            return takeLocal();
+        }
 
-        if (!delayedTasks_.empty()) {
-            const auto& nextTask = delayedTasks_.top();
-            if (nextTask.runAt < waitUntil) {
-                waitUntil = nextTask.runAt;
-            }
+        // A producer is between claiming the head and linking its node
+        if (hasImmediate()) {
+            std::this_thread::yield();
+            continue;
         }
 
         // Check if we've exceeded our deadline
-        if (now >= deadline) {
+        if (deadline && now >= *deadline) {
             return std::nullopt;
         }
 
-        // Wait for new tasks or until next delayed task is ready
-        cv_.wait_until(lock, waitUntil);
+        // Sleep until the next timer, or indefinitely if there is none
+        std::optional<Clock::time_point> waitUntil = deadline;
+        if (auto nextTimer = timers_->nextDeadline()) {
+            auto wake = coalesce(*nextTimer, now);
+            if (!waitUntil || wake < *waitUntil) {
+                waitUntil = wake;
+            }
+        }
+
+        // Park. parked_ is published before the queue is re-checked, and
+        // producers publish their node before reading parked_, so either we
+        // see the new task here or the producer sees us parked and wakes us.
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        parked_.store(true, std::memory_order_seq_cst);
+        if (!hasImmediate() && !shuttingDown_.load(std::memory_order_seq_cst)) {
+            auto woken = [this] {
+                return wakePending_ || shuttingDown_.load(std::memory_order_acquire);
+            };
+            if (waitUntil) {
+                cv_.wait_until(lock, *waitUntil, woken);
+            } else {
+                cv_.wait(lock, woken);
+            }
+        }
+        parked_.store(false, std::memory_order_relaxed);
+        wakePending_ = false;
     }
 }
 
 std::chrono::milliseconds TaskQueue::timeUntilNext() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-
     // If there are immediate tasks, return 0
-    if (!immediateTasks_.empty()) {
+    if (hasImmediate() || !localTasks_.empty()) {
         return std::chrono::milliseconds(0);
     }
 
     // If there are delayed tasks, calculate time until the next one
-    if (!delayedTasks_.empty()) {
+    if (auto nextTimer = timers_->nextDeadline()) {
         auto now = std::chrono::steady_clock::now();
-        const auto& nextTask = delayedTasks_.top();
 
-        if (nextTask.runAt <= now) {
+        if (*nextTimer <= now) {
             return std::chrono::milliseconds(0);
         }
 
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(
-            nextTask.runAt - now
-        );
-        return duration;
+        return std::chrono::duration_cast<std::chrono::milliseconds>(*nextTimer - now);
     }
 
     // No tasks, return a large value
@@ -124,16 +215,20 @@ std::chrono::milliseconds TaskQueue::timeUntilNext() const {
 }
 
 bool TaskQueue::empty() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return immediateTasks_.empty() && delayedTasks_.empty();
+    return !hasImmediate() && localTasks_.empty() && timers_->empty();
+}
+
+TaskQueue::Depth TaskQueue::depth() const {
+    Depth depth;
+    depth.immediate = immediateCount_.load(std::memory_order_relaxed);
+    depth.local = localCount_.load(std::memory_order_relaxed);
+    depth.delayed = delayedCount_.load(std::memory_order_relaxed);
+    return depth;
 }
 
 void TaskQueue::shutdown() {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        shuttingDown_ = true;
-    }
-    cv_.notify_all();
+    shuttingDown_.store(true, std::memory_order_seq_cst);
+    wakeConsumer();
 }
 
 } // namespace webworker
@@ -1,13 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
-#include <queue>
-#include <unordered_set>
-#include <vector>
 #include <cstdint>
 
 namespace webworker {
@@ -31,57 +31,85 @@ struct Task {
     std::function<void()> execute;
     std::chrono::steady_clock::time_point runAt;
     bool cancelled{false};
+    std::optional<uint64_t> jobId; // The WorkerPool job it runs for, see WorkerRuntime::postJob
 };
 
-/**
- * Comparator for delayed tasks priority queue.
- * Earlier runAt = higher priority (min-heap).
- */
-struct CompareByRunTime {
-    bool operator()(const Task& a, const Task& b) const {
-        return a.runAt > b.runAt;
-    }
-};
+class TimerWheel;
 
 /**
- * Thread-safe task queue for the event loop.
+ * Task queue for the event loop.
  *
- * Manages both immediate tasks (FIFO) and delayed tasks (priority queue by time).
+ * Manages both immediate tasks (FIFO) and delayed tasks (a TimerWheel).
  * Following web semantics:
- * - Immediate tasks (messages, setTimeout(fn, 0)) have runAt = now
- * - Delayed tasks are ordered by their runAt time
+ * - Immediate tasks (messages, fetch completions) have runAt = now
+ * - Delayed tasks, including setTimeout(fn, 0), are ordered by their runAt
+ *   time
+ *
+ * Threading: any thread may enqueue() and shutdown(). Everything else,
+ * including enqueueDelayed() and cancel(), belongs to the single consumer
+ * (the worker thread), which owns the TimerWheel without locking.
+ *
+ * The immediate lane is a lock-free multi-producer/single-consumer linked
+ * queue. Producers only touch the wakeup mutex when the consumer is parked,
+ * so a busy worker never contends with its senders.
+ *
+ * The local lane holds tasks the consumer posts to itself (setImmediate,
+ * MessageChannel). It needs no synchronization at all, and it runs after
+ * messages and due timers so that yielding code can't starve either. A
+ * lane passed over on one dequeue() goes first on the next, so a flood of
+ * messages can't starve it in turn: between two dequeue() calls the event
+ * loop only drains one bounded batch.
+ *
+ * An idle consumer parks until the next timer deadline or until a producer
+ * wakes it; there is no polling. Timer wakeups get some slack and are
+ * rounded up onto a grid shared by every queue, so idle workers whose
+ * timers come due close together wake the CPU once instead of once each.
  */
 class TaskQueue {
 public:
-    TaskQueue() = default;
-    ~TaskQueue() = default;
+    TaskQueue();
+    ~TaskQueue();
 
     // Non-copyable
     TaskQueue(const TaskQueue&) = delete;
     TaskQueue& operator=(const TaskQueue&) = delete;
 
     /**
-     * Add a task to run immediately.
+     * Add a task to run immediately. Safe from any thread.
      * @param task The task to enqueue
      */
     void enqueue(Task task);
 
     /**
-     * Add a task to run after a delay.
+     * Add a task to the local lane. Consumer thread only.
+     * @param task The task to enqueue
+     */
+    void enqueueLocal(Task task);
+
+    /**
+     * Add a task to run after a delay. Consumer thread only.
      * @param task The task to enqueue
      * @param delay Time to wait before running
      */
     void enqueueDelayed(Task task, std::chrono::milliseconds delay);
 
     /**
-     * Cancel a pending task by ID.
+     * Cancel a pending delayed task by ID. Consumer thread only.
+     * The task is released right away.
      * @param taskId The ID of the task to cancel
      * @return true if task was found and cancelled
      */
     bool cancel(uint64_t taskId);
 
     /**
-     * Get the next task to execute.
+     * Get the next task to execute. Consumer thread only.
+     * Blocks until a task is available or the queue shuts down.
+     * @return The next task, or nullopt after shutdown()
+     */
+    std::optional<Task> dequeue();
+
+    /**
+     * Get the next task to execute. Consumer thread only.
      * Blocks until a task is available or timeout expires.
      * @param maxWait Maximum time to wait
      * @return The next task, or nullopt if timeout expired
@@ -89,13 +117,20 @@ public:
     std::optional<Task> dequeue(std::chrono::milliseconds maxWait);
 
     /**
-     * Get time until the next scheduled task.
+     * Take the next immediate task without blocking. Consumer thread only.
+     * Lets the event loop drain a burst of messages in one go.
+     * @return The next immediate task, or nullopt if there is none
+     */
+    std::optional<Task> tryDequeueImmediate();
+
+    /**
+     * Get time until the next scheduled task. Consumer thread only.
      * @return Time until next task, or max duration if no tasks
      */
     std::chrono::milliseconds timeUntilNext() const;
 
     /**
-     * Check if both queues are empty.
+     * Check if both queues are empty. Consumer thread only.
      * @return true if no pending tasks
      */
     bool empty() const;
@@ -106,19 +141,69 @@ public:
      */
     void shutdown();
 
-private:
-    // Immediate tasks (FIFO)
-    std::queue<Task> immediateTasks_;
+    /**
+     * Set how late a timer wakeup may be to share it with other queues.
+     * The slack actually used never exceeds 1/8 of the time left, so short
+     * timers stay precise. Consumer thread only.
+     */
+    void setTimerSlack(std::chrono::milliseconds slack) { timerSlack_ = slack; }
+
+    static constexpr std::chrono::milliseconds kDefaultTimerSlack{16};
 
-    // Delayed tasks (priority queue by runAt time)
-    std::priority_queue<Task, std::vector<Task>, CompareByRunTime> delayedTasks_;
+    struct Depth {
+        size_t immediate{0};
+        size_t local{0};
+        size_t delayed{0};
+    };
 
-    // Set of cancelled task IDs for quick lookup
-    std::unordered_set<uint64_t> cancelledIds_;
+    /**
+     * Tasks waiting in each lane. Safe from any thread; only a snapshot
+     * while producers are busy.
+     */
+    Depth depth() const;
 
-    mutable std::mutex mutex_;
+private:
+    struct Node {
+        Task task;
+        std::atomic<Node*> next{nullptr};
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    bool hasImmediate() const;
+    void wakeConsumer();
+    Task takeLocal();
+
+    // Shared by both dequeue() overloads; nullopt waits without a deadline
+    std::optional<Task> dequeueUntil(std::optional<Clock::time_point> deadline);
+
+    // When to wake up for a timer due at `deadline`
+    Clock::time_point coalesce(Clock::time_point deadline, Clock::time_point now) const;
+
+    // Immediate tasks: producers exchange head_, the consumer follows tail_.
+    // tail_ always points at a stub node whose task was already taken.
+    std::atomic<Node*> head_;
+    Node* tail_;
+    std::atomic<size_t> immediateCount_{0};
+
+    // Delayed tasks, consumer only
+    std::unique_ptr<TimerWheel> timers_;
+
+    // Local lane, consumer only
+    std::deque<Task> localTasks_;
+    bool localPassedOver_{false};
+    std::chrono::milliseconds timerSlack_{kDefaultTimerSlack};
+
+    // Lane sizes mirrored for depth(), written by the consumer only
+    std::atomic<size_t> localCount_{0};
+    std::atomic<size_t> delayedCount_{0};
+
+    // Wakeup, only used while the consumer is parked
+    std::atomic<bool> parked_{false};
+    std::atomic<bool> shuttingDown_{false};
+    bool wakePending_{false};
+    std::mutex wakeMutex_;
     std::condition_variable cv_;
-    bool shuttingDown_{false};
 };
 
 } // namespace webworker
@@ -0,0 +1,251 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace webworker {
+
+namespace {
+
+inline uint32_t countTrailingZeros(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<uint32_t>(__builtin_ctzll(bits));
+#else
+    uint32_t count = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        count++;
+    }
+    return count;
+#endif
+}
+
+} // namespace
+
+TimerWheel::TimerWheel() : epoch_(Clock::now()) {
+}
+
+TimerWheel::~TimerWheel() {
+    for (auto& pair : index_) {
+        delete pair.second;
+    }
+}
+
+uint64_t TimerWheel::toTick(Clock::time_point time, bool roundUp) const {
+    if (time <= epoch_) return 0;
+
+    auto elapsed = time - epoch_;
+    auto ticks = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+    if (roundUp && ticks < elapsed) {
+        ticks += std::chrono::milliseconds(1);
+    }
+    return static_cast<uint64_t>(ticks.count());
+}
+
+TimerWheel::Clock::time_point TimerWheel::toTime(uint64_t tick) const {
+    return epoch_ + std::chrono::milliseconds(tick);
+}
+
+TimerWheel::List& TimerWheel::listOf(const Node* node) {
+    if (node->level == kOverflowLevel) return overflow_;
+    if (node->level == kReadyLevel) return ready_;
+    return wheel_[node->level][node->slot];
+}
+
+void TimerWheel::pushBack(Node* node, uint32_t level, uint32_t slot) {
+    node->level = level;
+    node->slot = slot;
+    List& list = listOf(node);
+
+    node->prev = list.tail;
+    node->next = nullptr;
+    if (list.tail) {
+        list.tail->next = node;
+    } else {
+        list.head = node;
+    }
+    list.tail = node;
+
+    if (level < kLevels) {
+        occupied_[level] |= uint64_t(1) << slot;
+    }
+}
+
+void TimerWheel::unlink(Node* node) {
+    List& list = listOf(node);
+
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        list.head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        list.tail = node->prev;
+    }
+    node->prev = node->next = nullptr;
+
+    if (node->level < kLevels && list.empty()) {
+        occupied_[node->level] &= ~(uint64_t(1) << node->slot);
+    }
+}
+
+void TimerWheel::insert(Node* node) {
+    if (node->expiry < current_) {
+        node->expiry = current_;
+    }
+
+    // The lowest level whose current rotation contains the deadline. Above
+    // level 0 the deadline's slot is then always ahead of current_'s.
+    for (uint32_t level = 0; level < kLevels; level++) {
+        uint32_t rotationShift = kLevelBits * (level + 1);
+        if ((node->expiry >> rotationShift) == (current_ >> rotationShift)) {
+            uint32_t slot = (node->expiry >> (kLevelBits * level)) & (kSlots - 1);
+            pushBack(node, level, slot);
+            return;
+        }
+    }
+    pushBack(node, kOverflowLevel, 0);
+}
+
+void TimerWheel::schedule(Task task) {
+    cancel(task.id);
+
+    auto* node = new Node();
+    node->expiry = toTick(task.runAt, true);
+    node->sequence = nextSequence_++;
+    node->task = std::move(task);
+
+    index_[node->task.id] = node;
+    insert(node);
+}
+
+bool TimerWheel::cancel(uint64_t id) {
+    auto it = index_.find(id);
+    if (it == index_.end()) return false;
+
+    Node* node = it->second;
+    index_.erase(it);
+    unlink(node);
+    delete node;
+    return true;
+}
+
+std::optional<uint64_t> TimerWheel::nextEventTick() const {
+    std::optional<uint64_t> next;
+
+    for (uint32_t level = 0; level < kLevels; level++) {
+        uint32_t slotShift = kLevelBits * level;
+        uint32_t rotationShift = slotShift + kLevelBits;
+
+        // Slots behind current_ are empty, see insert()
+        uint32_t currentSlot = (current_ >> slotShift) & (kSlots - 1);
+        uint64_t ahead = occupied_[level] & (~uint64_t(0) << currentSlot);
+        if (!ahead) continue;
+
+        uint64_t slot = countTrailingZeros(ahead);
+        uint64_t tick = ((current_ >> rotationShift) << rotationShift) | (slot << slotShift);
+        tick = std::max(tick, current_);
+        if (!next || tick < *next) next = tick;
+    }
+
+    if (!overflow_.empty()) {
+        uint32_t topShift = kLevelBits * kLevels;
+        uint64_t tick = ((current_ >> topShift) + 1) << topShift;
+        if (!next || tick < *next) next = tick;
+    }
+
+    return next;
+}
+
+void TimerWheel::cascade(List list) {
+    for (Node* node = list.head; node;) {
+        Node* next = node->next;
+        node->prev = node->next = nullptr;
+        insert(node);
+        node = next;
+    }
+}
+
+void TimerWheel::advance(uint64_t now) {
+    std::vector<Node*> due;
+
+    while (true) {
+        auto tick = nextEventTick();
+        if (!tick || *tick > now) break;
+        current_ = *tick;
+
+        // Spread out every slot starting at this tick, highest level first,
+        // so timers due right now all land in level 0
+        uint32_t topShift = kLevelBits * kLevels;
+        if ((current_ & ((uint64_t(1) << topShift) - 1)) == 0 && !overflow_.empty()) {
+            List list = overflow_;
+            overflow_ = List();
+            cascade(list);
+        }
+        for (uint32_t level = kLevels - 1; level > 0; level--) {
+            uint32_t slotShift = kLevelBits * level;
+            if ((current_ & ((uint64_t(1) << slotShift) - 1)) != 0) continue;
+
+            uint32_t slot = (current_ >> slotShift) & (kSlots - 1);
+            if (!(occupied_[level] & (uint64_t(1) << slot))) continue;
+
+            List list = wheel_[level][slot];
+            wheel_[level][slot] = List();
+            occupied_[level] &= ~(uint64_t(1) << slot);
+            cascade(list);
+        }
+
+        uint32_t slot = current_ & (kSlots - 1);
+        if (occupied_[0] & (uint64_t(1) << slot)) {
+            List list = wheel_[0][slot];
+            wheel_[0][slot] = List();
+            occupied_[0] &= ~(uint64_t(1) << slot);
+
+            // Everything in the slot is due now; restore scheduling order
+            due.clear();
+            for (Node* node = list.head; node; node = node->next) {
+                due.push_back(node);
+            }
+            std::sort(due.begin(), due.end(), [](const Node* a, const Node* b) {
+                return a->sequence < b->sequence;
+            });
+            for (Node* node : due) {
+                pushBack(node, kReadyLevel, 0);
+            }
+        }
+
+        current_++;
+    }
+
+    // Nothing is pending before `now`, skip ahead
+    if (current_ <= now) {
+        current_ = now + 1;
+    }
+}
+
+std::optional<Task> TimerWheel::popExpired(Clock::time_point now) {
+    if (ready_.empty()) {
+        advance(toTick(now, false));
+        if (ready_.empty()) return std::nullopt;
+    }
+
+    Node* node = ready_.head;
+    unlink(node);
+    index_.erase(node->task.id);
+
+    Task task = std::move(node->task);
+    delete node;
+    return task;
+}
+
+std::optional<TimerWheel::Clock::time_point> TimerWheel::nextDeadline() const {
+    if (!ready_.empty()) return epoch_;
+
+    auto tick = nextEventTick();
+    if (!tick) return std::nullopt;
+    return toTime(*tick);
+}
+
+} // namespace webworker
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+
+#include "TaskQueue.h"
+
+namespace webworker {
+
+/**
+ * TimerWheel - Hashed hierarchical timer wheel with millisecond ticks
+ *
+ * Five levels of 64 slots cover 2^30 ms (about 12 days); later deadlines
+ * wait in an overflow list. A timer goes into the lowest level whose slot
+ * holds its deadline and moves down a level each time its slot comes up, so
+ * scheduling is O(1) and each timer is touched at most once per level.
+ *
+ * Timers are intrusive list nodes indexed by id: cancel() unlinks and frees
+ * the node right away, so nothing is left behind for the consumer to skip
+ * and memory is bounded by the number of live timers.
+ *
+ * Not thread-safe. Owned by TaskQueue's consumer.
+ */
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimerWheel();
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /**
+     * Schedule `task` to run at `task.runAt`. A pending timer with the same
+     * id is replaced.
+     */
+    void schedule(Task task);
+
+    /**
+     * Drop the pending timer `id`.
+     * @return true if it was pending
+     */
+    bool cancel(uint64_t id);
+
+    /**
+     * Take the next timer due at `now`. Timers due at the same millisecond
+     * come out in scheduling order.
+     */
+    std::optional<Task> popExpired(Clock::time_point now);
+
+    /**
+     * When popExpired should be called next. Can be earlier than the next
+     * deadline, when a higher level slot has to be spread out first.
+     * nullopt if no timer is pending.
+     */
+    std::optional<Clock::time_point> nextDeadline() const;
+
+    bool empty() const { return index_.empty(); }
+    size_t size() const { return index_.size(); }
+
+private:
+    static constexpr uint32_t kLevelBits = 6;
+    static constexpr uint32_t kSlots = 1u << kLevelBits;
+    static constexpr uint32_t kLevels = 5;
+    static constexpr uint32_t kOverflowLevel = kLevels;
+    static constexpr uint32_t kReadyLevel = kLevels + 1;
+
+    struct Node {
+        Task task;
+        uint64_t expiry;   // Tick the timer is due at
+        uint64_t sequence; // Scheduling order, breaks ties between equal expiries
+        Node* prev{nullptr};
+        Node* next{nullptr};
+        uint32_t level{0};
+        uint32_t slot{0};
+    };
+
+    struct List {
+        Node* head{nullptr};
+        Node* tail{nullptr};
+        bool empty() const { return head == nullptr; }
+    };
+
+    uint64_t toTick(Clock::time_point time, bool roundUp) const;
+    Clock::time_point toTime(uint64_t tick) const;
+
+    List& listOf(const Node* node);
+    void pushBack(Node* node, uint32_t level, uint32_t slot);
+    void unlink(Node* node);
+
+    // Place a node relative to current_
+    void insert(Node* node);
+
+    // Next tick at which a slot expires or cascades
+    std::optional<uint64_t> nextEventTick() const;
+
+    // Process every tick up to `now`, moving due timers to ready_
+    void advance(uint64_t now);
+    void cascade(List list);
+
+    Clock::time_point epoch_;
+    uint64_t current_{0};   // Next tick to process
+    uint64_t nextSequence_{0};
+
+    List wheel_[kLevels][kSlots];
+    uint64_t occupied_[kLevels]{}; // Bit per non-empty slot
+    List overflow_;
+    List ready_; // Due, waiting for popExpired
+
+    std::unordered_map<uint64_t, Node*> index_;
+};
+
+} // namespace webworker
@@ -0,0 +1,127 @@
+#include "Trace.h"
+
+#if WEBWORKER_TRACE
+
+#include <atomic>
+
+#if defined(__ANDROID__)
+#include <android/trace.h>
+#include <dlfcn.h>
+#elif defined(__APPLE__)
+#include <os/log.h>
+#include <os/signpost.h>
+#endif
+
+namespace webworker {
+namespace trace {
+
+namespace {
+std::atomic<uint64_t> gNextId{1};
+} // namespace
+
+uint64_t newId() {
+    return gNextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+#if defined(__ANDROID__)
+
+// Async sections only exist from API 29, minSdk is lower
+namespace {
+
+using AsyncSectionFn = void (*)(const char* name, int32_t cookie);
+
+struct AsyncSections {
+    AsyncSectionFn begin;
+    AsyncSectionFn end;
+};
+
+const AsyncSections& asyncSections() {
+    static const AsyncSections sections{
+        reinterpret_cast<AsyncSectionFn>(dlsym(RTLD_DEFAULT, "ATrace_beginAsyncSection")),
+        reinterpret_cast<AsyncSectionFn>(dlsym(RTLD_DEFAULT, "ATrace_endAsyncSection")),
+    };
+    return sections;
+}
+
+} // namespace
+
+bool isEnabled() {
+    return ATrace_isEnabled();
+}
+
+void beginSection(const char* name) {
+    ATrace_beginSection(name);
+}
+
+void endSection(const char*) {
+    ATrace_endSection();
+}
+
+void beginAsync(const char* name, uint64_t id) {
+    auto begin = asyncSections().begin;
+    if (begin && ATrace_isEnabled()) begin(name, static_cast<int32_t>(id));
+}
+
+void endAsync(const char* name, uint64_t id) {
+    auto end = asyncSections().end;
+    if (end && ATrace_isEnabled()) end(name, static_cast<int32_t>(id));
+}
+
+#elif defined(__APPLE__)
+
+// os_signpost wants literal names: intervals are "Section" or "Async"
+// signposts and carry their own name as the message
+namespace {
+
+os_log_t traceLog() {
+    static os_log_t log = os_log_create("com.webworker", "WebWorker");
+    return log;
+}
+
+// Open sections of this thread, innermost last
+constexpr size_t kMaxSectionDepth = 32;
+thread_local os_signpost_id_t tSectionIds[kMaxSectionDepth];
+thread_local size_t tSectionDepth = 0;
+
+} // namespace
+
+bool isEnabled() {
+    return os_signpost_enabled(traceLog());
+}
+
+void beginSection(const char* name) {
+    size_t depth = tSectionDepth++;
+    if (depth >= kMaxSectionDepth) return;
+    tSectionIds[depth] = os_signpost_id_generate(traceLog());
+    os_signpost_interval_begin(traceLog(), tSectionIds[depth], "Section", "%{public}s", name);
+}
+
+void endSection(const char* name) {
+    size_t depth = --tSectionDepth;
+    if (depth >= kMaxSectionDepth) return;
+    os_signpost_interval_end(traceLog(), tSectionIds[depth], "Section", "%{public}s", name);
+}
+
+void beginAsync(const char* name, uint64_t id) {
+    os_signpost_interval_begin(traceLog(), static_cast<os_signpost_id_t>(id), "Async", "%{public}s", name);
+}
+
+void endAsync(const char* name, uint64_t id) {
+    os_signpost_interval_end(traceLog(), static_cast<os_signpost_id_t>(id), "Async", "%{public}s", name);
+}
+
+#else
+
+// No platform profiler
+bool isEnabled() { return false; }
+void beginSection(const char*) {}
+void endSection(const char*) {}
+void beginAsync(const char*, uint64_t) {}
+void endAsync(const char*, uint64_t) {}
+
+#endif
+
+} // namespace trace
+} // namespace webworker
+
+#endif // WEBWORKER_TRACE
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Trace sections for the platform profilers: ATrace on Android (Perfetto,
+ * systrace), os_signpost on iOS (Instruments).
+ *
+ * Only built with WEBWORKER_TRACE=1; otherwise every macro compiles to
+ * nothing. Even when built in, a section costs one check for a recording
+ * profiler until one is attached.
+ *
+ * WEBWORKER_TRACE_SECTION(name)  A section until the end of the scope
+ * WEBWORKER_TRACE_ASYNC_BEGIN(name, id)
+ * WEBWORKER_TRACE_ASYNC_END(name, id)
+ *                                An interval that may begin and end on
+ *                                different threads, paired by name and id.
+ *                                Ids come from WEBWORKER_TRACE_NEW_ID().
+ *
+ * Names must outlive the section; string literals are what's used.
+ */
+
+#ifndef WEBWORKER_TRACE
+#define WEBWORKER_TRACE 0
+#endif
+
+namespace webworker {
+namespace trace {
+
+#if WEBWORKER_TRACE
+
+bool isEnabled();
+void beginSection(const char* name);
+void endSection(const char* name);
+void beginAsync(const char* name, uint64_t id);
+void endAsync(const char* name, uint64_t id);
+
+/** Unique and never 0 */
+uint64_t newId();
+
+class ScopedSection {
+public:
+    explicit ScopedSection(const char* name)
+        : name_(isEnabled() ? name : nullptr) {
+        if (name_) beginSection(name_);
+    }
+    ~ScopedSection() {
+        if (name_) endSection(name_);
+    }
+
+    ScopedSection(const ScopedSection&) = delete;
+    ScopedSection& operator=(const ScopedSection&) = delete;
+
+private:
+    const char* name_;
+};
+
+#endif
+
+} // namespace trace
+} // namespace webworker
+
+#define WEBWORKER_TRACE_CONCAT_(a, b) a##b
+#define WEBWORKER_TRACE_CONCAT(a, b) WEBWORKER_TRACE_CONCAT_(a, b)
+
+#if WEBWORKER_TRACE
+#define WEBWORKER_TRACE_SECTION(name) \
+    ::webworker::trace::ScopedSection WEBWORKER_TRACE_CONCAT(traceSection, __LINE__)(name)
+#define WEBWORKER_TRACE_NEW_ID() \
+    (::webworker::trace::isEnabled() ? ::webworker::trace::newId() : uint64_t{0})
+#define WEBWORKER_TRACE_ASYNC_BEGIN(name, id) \
+    do { if (id) ::webworker::trace::beginAsync(name, id); } while (0)
+#define WEBWORKER_TRACE_ASYNC_END(name, id) \
+    do { if (id) ::webworker::trace::endAsync(name, id); } while (0)
+#else
+#define WEBWORKER_TRACE_SECTION(name) do {} while (0)
+#define WEBWORKER_TRACE_NEW_ID() uint64_t{0}
+#define WEBWORKER_TRACE_ASYNC_BEGIN(name, id) ((void)(id))
+#define WEBWORKER_TRACE_ASYNC_END(name, id) ((void)(id))
+#endif
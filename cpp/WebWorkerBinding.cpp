@@ -0,0 +1,494 @@
+#include "WebWorkerBinding.h"
+#include "WebWorkerCore.h"
+#include "WorkerPool.h"
+#include "Trace.h"
+
+#include <exception>
+
+namespace webworker {
+
+void WebWorkerBinding::install(
+    Runtime& runtime,
+    const std::shared_ptr<WebWorkerCore>& core,
+    std::shared_ptr<facebook::react::CallInvoker> callInvoker
+) {
+    if (!core || !callInvoker) return;
+
+    auto binding = std::make_shared<WebWorkerBinding>(core, callInvoker);
+    auto mailbox = std::make_shared<Mailbox>(binding, std::move(callInvoker));
+    binding->mailbox_ = mailbox;
+
+    // The binding itself lives and dies with the JS runtime, see Mailbox
+    core->setMessageCallback([mailbox](const std::string& workerId,
+                                       std::shared_ptr<SerializedMessage> message) {
+        mailbox->postMessage(workerId, std::move(message));
+    });
+    core->setBindingErrorCallback([mailbox](const std::string& workerId, const std::string& error) {
+        mailbox->postError(workerId, error);
+    });
+    core->setPoolResultCallback([mailbox](const std::string& poolId,
+                                          uint64_t jobId,
+                                          std::shared_ptr<SerializedMessage> result,
+                                          const std::string& error) {
+        mailbox->postPoolResult(poolId, jobId, std::move(result), error);
+    });
+
+    runtime.global().setProperty(runtime, "__WebWorkerBinding", binding->createJSObject(runtime));
+
+    // The JS thread must never block, so only Atomics.waitAsync is available there
+    auto invoker = binding->callInvoker_;
+    binding->atomicsContext_ = AtomicsContext::install(runtime, false,
+        [invoker](std::function<void(Runtime&)> settle) {
+            invoker->invokeAsync(std::move(settle));
+        });
+
+    // Messages to host-owned ports ride along with the worker deliveries
+    binding->portContext_ = MessagePortContext::install(runtime,
+        [mailbox](std::function<void(Runtime&)> deliver) {
+            mailbox->post([deliver = std::move(deliver)](WebWorkerBinding&, Runtime& rt) {
+                deliver(rt);
+            });
+        });
+}
+
+WebWorkerBinding::WebWorkerBinding(
+    std::weak_ptr<WebWorkerCore> core,
+    std::shared_ptr<facebook::react::CallInvoker> callInvoker
+)
+    : core_(std::move(core))
+    , callInvoker_(std::move(callInvoker)) {
+}
+
+namespace {
+
+Object histogramToJS(Runtime& runtime, const LatencyHistogram::Snapshot& histogram) {
+    Object object(runtime);
+    object.setProperty(runtime, "count", static_cast<double>(histogram.count));
+    object.setProperty(runtime, "mean", histogram.count > 0
+        ? static_cast<double>(histogram.totalMicros) / static_cast<double>(histogram.count)
+        : 0.0);
+    object.setProperty(runtime, "p50", static_cast<double>(histogram.percentile(0.5)));
+    object.setProperty(runtime, "p90", static_cast<double>(histogram.percentile(0.9)));
+    object.setProperty(runtime, "p99", static_cast<double>(histogram.percentile(0.99)));
+    object.setProperty(runtime, "max", static_cast<double>(histogram.maxMicros));
+    return object;
+}
+
+Object statsToJS(Runtime& runtime, const WorkerStats& stats) {
+    Object queue(runtime);
+    queue.setProperty(runtime, "immediate", static_cast<double>(stats.immediateTasks));
+    queue.setProperty(runtime, "local", static_cast<double>(stats.localTasks));
+    queue.setProperty(runtime, "delayed", static_cast<double>(stats.delayedTasks));
+
+    Object heap(runtime);
+    for (const auto& pair : stats.heap) {
+        heap.setProperty(runtime, pair.first.c_str(), static_cast<double>(pair.second));
+    }
+
+    Object object(runtime);
+    object.setProperty(runtime, "queue", queue);
+    object.setProperty(runtime, "tasksRun", static_cast<double>(stats.tasksRun));
+    object.setProperty(runtime, "taskLatency", histogramToJS(runtime, stats.taskLatency));
+    object.setProperty(runtime, "taskDuration", histogramToJS(runtime, stats.taskDuration));
+    object.setProperty(runtime, "microtaskDrain", histogramToJS(runtime, stats.microtaskDrain));
+    object.setProperty(runtime, "messagesIn", static_cast<double>(stats.messagesIn));
+    object.setProperty(runtime, "messagesOut", static_cast<double>(stats.messagesOut));
+    object.setProperty(runtime, "bytesIn", static_cast<double>(stats.bytesIn));
+    object.setProperty(runtime, "bytesOut", static_cast<double>(stats.bytesOut));
+    object.setProperty(runtime, "pendingFetches", static_cast<double>(stats.pendingFetches));
+    object.setProperty(runtime, "streamingFetches", static_cast<double>(stats.streamingFetches));
+
+    Object thread(runtime);
+    thread.setProperty(runtime, "name", String::createFromUtf8(runtime, stats.threadName));
+    thread.setProperty(runtime, "priority", String::createFromUtf8(runtime, stats.threadPriority));
+    object.setProperty(runtime, "thread", thread);
+    object.setProperty(runtime, "heap", heap);
+    return object;
+}
+
+} // namespace
+
+Object WebWorkerBinding::createJSObject(Runtime& runtime) {
+    // The JS object's functions keep the binding alive for the runtime's lifetime
+    auto self = shared_from_this();
+    Object object(runtime);
+
+    // resolveWorker(workerId): handle, 0 if the worker doesn't exist
+    object.setProperty(runtime, "resolveWorker", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "resolveWorker"),
+        1,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isString()) {
+                throw JSError(rt, "resolveWorker: workerId must be a string");
+            }
+            auto core = self->core_.lock();
+            if (!core) return 0;
+
+            return static_cast<double>(core->getWorkerHandle(args[0].getString(rt).utf8(rt)));
+        }
+    ));
+
+    // postMessage(handle | workerId, value, transferList?): boolean
+    object.setProperty(runtime, "postMessage", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "postMessage"),
+        3,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !(args[0].isNumber() || args[0].isString())) {
+                throw JSError(rt, "postMessage: expected a worker handle or id");
+            }
+            auto core = self->core_.lock();
+            if (!core) return false;
+
+            auto message = count > 2 ? serializeValue(rt, args[1], args[2])
+                         : count > 1 ? serializeValue(rt, args[1])
+                                     : serializeValue(rt, Value::undefined());
+            if (args[0].isNumber()) {
+                auto handle = static_cast<WorkerHandle>(args[0].getNumber());
+                return core->postMessage(handle, std::move(message));
+            }
+            return core->postMessage(args[0].getString(rt).utf8(rt), std::move(message));
+        }
+    ));
+
+    // setWorkerMessageHandler(workerId, handler: ((data) => void) | null)
+    object.setProperty(runtime, "setWorkerMessageHandler", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "setWorkerMessageHandler"),
+        2,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isString()) {
+                throw JSError(rt, "setWorkerMessageHandler: workerId must be a string");
+            }
+            std::string workerId = args[0].getString(rt).utf8(rt);
+            if (count > 1 && args[1].isObject() && args[1].getObject(rt).isFunction(rt)) {
+                self->messageHandlers_[workerId] =
+                    std::make_shared<Function>(args[1].getObject(rt).getFunction(rt));
+            } else {
+                self->messageHandlers_.erase(workerId);
+            }
+            return Value::undefined();
+        }
+    ));
+
+    // setWorkerErrorHandler(workerId, handler: ((error: string) => void) | null)
+    object.setProperty(runtime, "setWorkerErrorHandler", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "setWorkerErrorHandler"),
+        2,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isString()) {
+                throw JSError(rt, "setWorkerErrorHandler: workerId must be a string");
+            }
+            std::string workerId = args[0].getString(rt).utf8(rt);
+            if (count > 1 && args[1].isObject() && args[1].getObject(rt).isFunction(rt)) {
+                self->errorHandlers_[workerId] =
+                    std::make_shared<Function>(args[1].getObject(rt).getFunction(rt));
+            } else {
+                self->errorHandlers_.erase(workerId);
+            }
+            return Value::undefined();
+        }
+    ));
+
+    // submitPoolJob(poolId, jobId, value, transferList?): boolean
+    object.setProperty(runtime, "submitPoolJob", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "submitPoolJob"),
+        4,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 2 || !args[0].isString() || !args[1].isNumber()) {
+                throw JSError(rt, "submitPoolJob: expected (poolId, jobId, data)");
+            }
+            auto core = self->core_.lock();
+            if (!core) return false;
+
+            std::string poolId = args[0].getString(rt).utf8(rt);
+            uint64_t jobId = static_cast<uint64_t>(args[1].getNumber());
+            auto payload = count > 3 ? serializeValue(rt, args[2], args[3])
+                         : count > 2 ? serializeValue(rt, args[2])
+                                     : serializeValue(rt, Value::undefined());
+            return core->submitPoolJob(poolId, jobId, std::move(payload));
+        }
+    ));
+
+    // cancelPoolJob(poolId, jobId): boolean
+    object.setProperty(runtime, "cancelPoolJob", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "cancelPoolJob"),
+        2,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 2 || !args[0].isString() || !args[1].isNumber()) {
+                throw JSError(rt, "cancelPoolJob: expected (poolId, jobId)");
+            }
+            auto core = self->core_.lock();
+            if (!core) return false;
+
+            return core->cancelPoolJob(args[0].getString(rt).utf8(rt),
+                                       static_cast<uint64_t>(args[1].getNumber()));
+        }
+    ));
+
+    // broadcastPool(poolId, value): boolean
+    object.setProperty(runtime, "broadcastPool", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "broadcastPool"),
+        2,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isString()) {
+                throw JSError(rt, "broadcastPool: poolId must be a string");
+            }
+            auto core = self->core_.lock();
+            if (!core) return false;
+
+            std::string poolId = args[0].getString(rt).utf8(rt);
+            auto message = count > 1 ? serializeValue(rt, args[1])
+                                     : serializeValue(rt, Value::undefined());
+            return core->broadcastPool(poolId, std::move(message));
+        }
+    ));
+
+    // setPoolResultHandler(handler: ((poolId, jobId, error, data) => void) | null)
+    object.setProperty(runtime, "setPoolResultHandler", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "setPoolResultHandler"),
+        1,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count > 0 && args[0].isObject() && args[0].getObject(rt).isFunction(rt)) {
+                self->poolResultHandler_ =
+                    std::make_unique<Function>(args[0].getObject(rt).getFunction(rt));
+            } else {
+                self->poolResultHandler_.reset();
+            }
+            return Value::undefined();
+        }
+    ));
+
+    // getWorkerStats(workerId): stats object, null if the worker doesn't exist
+    object.setProperty(runtime, "getWorkerStats", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "getWorkerStats"),
+        1,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isString()) {
+                throw JSError(rt, "getWorkerStats: workerId must be a string");
+            }
+            auto core = self->core_.lock();
+            if (!core) return Value::null();
+
+            auto stats = core->getWorkerStats(args[0].getString(rt).utf8(rt));
+            if (!stats) return Value::null();
+            return statsToJS(rt, *stats);
+        }
+    ));
+
+    // setStatsSampleInterval(interval): time one task in `interval`, 0 = none
+    object.setProperty(runtime, "setStatsSampleInterval", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "setStatsSampleInterval"),
+        1,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isNumber() || args[0].getNumber() < 0) {
+                throw JSError(rt, "setStatsSampleInterval: interval must be a non-negative number");
+            }
+            if (auto core = self->core_.lock()) {
+                core->setStatsSampleInterval(static_cast<uint32_t>(args[0].getNumber()));
+            }
+            return Value::undefined();
+        }
+    ));
+
+    // setFetchHighWaterMark(bytes): buffer of a streamed body, ahead of the reader
+    object.setProperty(runtime, "setFetchHighWaterMark", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "setFetchHighWaterMark"),
+        1,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 1 || !args[0].isNumber() || args[0].getNumber() < 1) {
+                throw JSError(rt, "setFetchHighWaterMark: bytes must be a positive number");
+            }
+            if (auto core = self->core_.lock()) {
+                core->setFetchHighWaterMark(static_cast<size_t>(args[0].getNumber()));
+            }
+            return Value::undefined();
+        }
+    ));
+
+    // setWorkerThreadOptions(workerId, priority, cpuAffinityMask, threadName): boolean
+    object.setProperty(runtime, "setWorkerThreadOptions", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "setWorkerThreadOptions"),
+        4,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (count < 4 || !args[0].isString() || !args[1].isString() ||
+                !args[2].isNumber() || args[2].getNumber() < 0 || !args[3].isString()) {
+                throw JSError(rt, "setWorkerThreadOptions: expected (workerId, priority, cpuAffinityMask, threadName)");
+            }
+            auto core = self->core_.lock();
+            if (!core) return false;
+
+            ThreadOptions options;
+            options.priority = ThreadOptions::parsePriority(args[1].getString(rt).utf8(rt));
+            options.cpuAffinityMask = static_cast<uint64_t>(args[2].getNumber());
+            options.name = args[3].getString(rt).utf8(rt);
+            return core->setWorkerThreadOptions(args[0].getString(rt).utf8(rt), options);
+        }
+    ));
+
+    // createMessageChannel(): [port1, port2], whose ports can be transferred to workers
+    object.setProperty(runtime, "createMessageChannel", Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "createMessageChannel"),
+        0,
+        [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+            if (!self->portContext_) {
+                throw JSError(rt, "createMessageChannel: MessageChannel is not installed");
+            }
+            return self->portContext_->createChannel(rt);
+        }
+    ));
+
+    // Default WorkerPool size
+    object.setProperty(runtime, "hardwareConcurrency",
+                       static_cast<double>(WorkerPool::defaultSize()));
+
+    return object;
+}
+
+// ============================================================================
+// Mailbox
+// ============================================================================
+
+WebWorkerBinding::Mailbox::Mailbox(
+    std::weak_ptr<WebWorkerBinding> binding,
+    std::shared_ptr<facebook::react::CallInvoker> callInvoker
+)
+    : binding_(std::move(binding))
+    , callInvoker_(std::move(callInvoker)) {
+}
+
+void WebWorkerBinding::Mailbox::post(Delivery delivery) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(delivery));
+        // Whatever arrives before the JS thread gets to it rides along
+        if (scheduled_) return;
+        scheduled_ = true;
+    }
+
+    auto self = shared_from_this();
+    callInvoker_->invokeAsync([self](Runtime& rt) {
+        self->deliverPending(rt);
+    });
+}
+
+void WebWorkerBinding::Mailbox::postMessage(
+    const std::string& workerId,
+    std::shared_ptr<SerializedMessage> message
+) {
+    // From the worker's postMessage to the JS thread handling it
+    uint64_t traceId = WEBWORKER_TRACE_NEW_ID();
+    WEBWORKER_TRACE_ASYNC_BEGIN("WebWorker postMessageToHost", traceId);
+
+    post([workerId, message = std::move(message), traceId](WebWorkerBinding& binding, Runtime& rt) {
+        WEBWORKER_TRACE_ASYNC_END("WebWorker postMessageToHost", traceId);
+        WEBWORKER_TRACE_SECTION("WebWorker onmessage");
+        binding.deliverMessage(rt, workerId, *message);
+    });
+}
+
+void WebWorkerBinding::Mailbox::postError(const std::string& workerId, const std::string& error) {
+    post([workerId, error](WebWorkerBinding& binding, Runtime& rt) {
+        binding.deliverError(rt, workerId, error);
+    });
+}
+
+void WebWorkerBinding::Mailbox::postPoolResult(
+    const std::string& poolId,
+    uint64_t jobId,
+    std::shared_ptr<SerializedMessage> result,
+    const std::string& error
+) {
+    post([poolId, jobId, result = std::move(result), error](WebWorkerBinding& binding, Runtime& rt) {
+        binding.deliverPoolResult(rt, poolId, jobId, result.get(), error);
+    });
+}
+
+void WebWorkerBinding::Mailbox::deliverPending(Runtime& runtime) {
+    std::vector<Delivery> deliveries;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deliveries.swap(pending_);
+        scheduled_ = false;
+    }
+
+    // On the JS thread, so this is where the binding may be released too
+    auto binding = binding_.lock();
+    if (!binding) return;
+
+    // A throwing handler must not swallow the rest of the batch; the first
+    // error is rethrown once everything was delivered
+    std::exception_ptr firstError;
+    for (auto& delivery : deliveries) {
+        try {
+            delivery(*binding, runtime);
+        } catch (...) {
+            if (!firstError) firstError = std::current_exception();
+        }
+    }
+
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+// ============================================================================
+// JS thread deliveries
+// ============================================================================
+
+void WebWorkerBinding::deliverMessage(
+    Runtime& runtime,
+    const std::string& workerId,
+    const SerializedMessage& message
+) {
+    auto it = messageHandlers_.find(workerId);
+    if (it == messageHandlers_.end()) return;
+
+    // The handler may unregister itself, keep it alive for the call
+    std::shared_ptr<Function> handler = it->second;
+    Value data = deserializeValue(runtime, message);
+    handler->call(runtime, data);
+}
+
+void WebWorkerBinding::deliverError(
+    Runtime& runtime,
+    const std::string& workerId,
+    const std::string& error
+) {
+    auto it = errorHandlers_.find(workerId);
+    if (it == errorHandlers_.end()) return;
+
+    std::shared_ptr<Function> handler = it->second;
+    handler->call(runtime, String::createFromUtf8(runtime, error));
+}
+
+void WebWorkerBinding::deliverPoolResult(
+    Runtime& runtime,
+    const std::string& poolId,
+    uint64_t jobId,
+    const SerializedMessage* result,
+    const std::string& error
+) {
+    if (!poolResultHandler_) return;
+
+    Value data = result ? deserializeValue(runtime, *result) : Value::undefined();
+    Value errorValue = result ? Value::null() : Value(String::createFromUtf8(runtime, error));
+    poolResultHandler_->call(runtime,
+                             String::createFromUtf8(runtime, poolId),
+                             static_cast<double>(jobId),
+                             errorValue,
+                             data);
+}
+
+} // namespace webworker
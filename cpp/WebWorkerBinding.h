@@ -0,0 +1,109 @@
+#pragma once
+
+#include <jsi/jsi.h>
+#include <ReactCommon/CallInvoker.h>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "StructuredClone.h"
+#include "Atomics.h"
+#include "MessagePort.h"
+
+namespace webworker {
+
+using namespace facebook::jsi;
+
+class WebWorkerCore;
+
+/**
+ * WebWorkerBinding - JSI interface installed into the host React Native runtime
+ *
+ * Exposed as `global.__WebWorkerBinding`. Messages are structured-cloned
+ * directly from and into jsi::Values on both ends, and worker -> host messages
+ * and errors are scheduled onto the JS thread through the CallInvoker instead
+ * of going through the platform event emitters.
+ *
+ * Also installs SharedArrayBuffer and Atomics (see AtomicsContext) so the
+ * host can share memory with its workers, and MessageChannel (see
+ * MessagePortContext) so it can connect them to each other.
+ */
+class WebWorkerBinding : public std::enable_shared_from_this<WebWorkerBinding> {
+public:
+    /**
+     * Install the binding into `runtime`. Must be called on the JS thread.
+     * Takes over the core's message callback, and chains onto its error
+     * callback so the platform still gets to log errors.
+     */
+    static void install(Runtime& runtime,
+                        const std::shared_ptr<WebWorkerCore>& core,
+                        std::shared_ptr<facebook::react::CallInvoker> callInvoker);
+
+    WebWorkerBinding(std::weak_ptr<WebWorkerCore> core,
+                     std::shared_ptr<facebook::react::CallInvoker> callInvoker);
+
+private:
+    using Delivery = std::function<void(WebWorkerBinding&, Runtime&)>;
+
+    /**
+     * Where worker and delivery threads leave messages for the binding.
+     * The core's callbacks hold this instead of the binding, so the
+     * binding, and with it the jsi::Functions it owns, is only ever
+     * referenced and released on the JS thread.
+     */
+    class Mailbox : public std::enable_shared_from_this<Mailbox> {
+    public:
+        Mailbox(std::weak_ptr<WebWorkerBinding> binding,
+                std::shared_ptr<facebook::react::CallInvoker> callInvoker);
+
+        // Any thread. Deliveries are coalesced so that a burst from any
+        // number of workers costs a single hop to the JS thread.
+        void post(Delivery delivery);
+        void postMessage(const std::string& workerId, std::shared_ptr<SerializedMessage> message);
+        void postError(const std::string& workerId, const std::string& error);
+        void postPoolResult(const std::string& poolId,
+                            uint64_t jobId,
+                            std::shared_ptr<SerializedMessage> result,
+                            const std::string& error);
+
+    private:
+        // JS thread
+        void deliverPending(Runtime& runtime);
+
+        std::weak_ptr<WebWorkerBinding> binding_; // Only locked on the JS thread
+        std::shared_ptr<facebook::react::CallInvoker> callInvoker_;
+        std::vector<Delivery> pending_;
+        bool scheduled_{false};
+        std::mutex mutex_;
+    };
+
+    Object createJSObject(Runtime& runtime);
+
+    // Called on the JS thread
+    void deliverMessage(Runtime& runtime, const std::string& workerId, const SerializedMessage& message);
+    void deliverError(Runtime& runtime, const std::string& workerId, const std::string& error);
+    void deliverPoolResult(Runtime& runtime,
+                           const std::string& poolId,
+                           uint64_t jobId,
+                           const SerializedMessage* result,
+                           const std::string& error);
+
+    std::weak_ptr<WebWorkerCore> core_;
+    std::shared_ptr<facebook::react::CallInvoker> callInvoker_;
+
+    std::shared_ptr<Mailbox> mailbox_;
+
+    std::shared_ptr<AtomicsContext> atomicsContext_;
+    std::shared_ptr<MessagePortContext> portContext_;
+
+    // JS thread only. Keyed by worker id so a message costs one lookup and
+    // is only deserialized if its Worker is listening.
+    std::unordered_map<std::string, std::shared_ptr<Function>> messageHandlers_;
+    std::unordered_map<std::string, std::shared_ptr<Function>> errorHandlers_;
+    std::unique_ptr<Function> poolResultHandler_;
+};
+
+} // namespace webworker
@@ -1,136 +1,757 @@
 #include "WebWorkerCore.h"
+#include "WorkerPool.h"
 #include "Polyfills.h"
+#include "Trace.h"
 #include "networking/ResponseHostObject.h"
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <cstring>
+#include <fstream>
+#include <future>
 
 namespace webworker {
 
+namespace {
+
+// The worker whose event loop runs on this thread, if any
+thread_local const WorkerRuntime* tCurrentWorker = nullptr;
+
+// Trace section names of the tasks, by TaskType
+const char* traceName(TaskType type) {
+    switch (type) {
+        case TaskType::Timer: return "WebWorker Timer";
+        case TaskType::Immediate: return "WebWorker Immediate";
+        case TaskType::Close: return "WebWorker Close";
+        case TaskType::Message: break;
+    }
+    return "WebWorker Message";
+}
+
+/**
+ * Non-owning Buffer over data with static storage duration.
+ * Lets the embedded prelude scripts reach Hermes without being copied.
+ */
+class StaticBuffer : public Buffer {
+public:
+    StaticBuffer(const void* data, size_t size)
+        : data_(static_cast<const uint8_t*>(data)), size_(size) {}
+
+    size_t size() const override { return size_; }
+    const uint8_t* data() const override { return data_; }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+};
+
+/**
+ * Prelude scripts are identical for every worker, so each one is compiled
+ * once per process. PreparedJavaScript can be evaluated by any Hermes runtime,
+ * which lets every worker after the first skip parsing and compilation.
+ */
+std::shared_ptr<const PreparedJavaScript> getPreparedPrelude(
+    const std::string& sourceURL,
+    const std::function<std::shared_ptr<const PreparedJavaScript>()>& prepare
+) {
+    static std::mutex cacheMutex;
+    static std::unordered_map<std::string, std::shared_ptr<const PreparedJavaScript>> cache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto it = cache.find(sourceURL);
+    if (it != cache.end()) {
+        return it->second;
+    }
+
+    auto prepared = prepare();
+    cache.emplace(sourceURL, prepared);
+    return prepared;
+}
+
+void evaluatePrelude(Runtime& runtime, const std::string& sourceURL, const char* source) {
+    auto prepared = getPreparedPrelude(sourceURL, [&]() {
+        return runtime.prepareJavaScript(
+            std::make_shared<StaticBuffer>(source, std::strlen(source)), sourceURL);
+    });
+    runtime.evaluatePreparedJavaScript(prepared);
+}
+
+void evaluatePolyfills(Runtime& runtime) {
+    auto prepared = getPreparedPrelude("polyfills.js", [&]() {
+        // Bytecode generated at build time is tied to the bytecode version of
+        // the hermesc that produced it. If the linked Hermes rejects it, fall
+        // back to compiling the source. The checked-in Polyfills.h is
+        // source-only; `yarn build` in packages/polyfills adds the bytecode
+        // when it finds a hermesc.
+        if (kPolyfillBytecodeSize > 0 &&
+            facebook::hermes::HermesRuntime::isHermesBytecode(kPolyfillBytecode,
+                                                              kPolyfillBytecodeSize)) {
+            try {
+                return runtime.prepareJavaScript(
+                    std::make_shared<StaticBuffer>(kPolyfillBytecode, kPolyfillBytecodeSize),
+                    "polyfills.js");
+            } catch (const JSIException&) {
+            }
+        }
+        return runtime.prepareJavaScript(
+            std::make_shared<StaticBuffer>(kPolyfillScript, std::strlen(kPolyfillScript)),
+            "polyfills.js");
+    });
+    runtime.evaluatePreparedJavaScript(prepared);
+}
+
+} // namespace
+
 // ============================================================================
 // WebWorkerCore Implementation
 // ============================================================================
 
 WebWorkerCore::WebWorkerCore()
     : messageCallback_(nullptr)
-    , consoleCallback_(nullptr)
+    , consoleLogger_(std::make_shared<ConsoleLogger>())
     , errorCallback_(nullptr)
-    , fetchCallback_(nullptr) {
+    , fetchCallback_(nullptr)
+    , scriptCache_(std::make_shared<ScriptCache>()) {
+    fetchCache_ = std::make_unique<FetchCache>(
+        [this](const std::string& workerId, FetchResponse response) {
+            deliverFetchResponse(workerId, std::move(response));
+        },
+        [this](const std::string& workerId, FetchChunk chunk) {
+            return deliverFetchChunk(workerId, std::move(chunk));
+        });
+    delivery_ = std::make_unique<DeliveryThread>();
 }
 
 WebWorkerCore::~WebWorkerCore() {
+    {
+        std::lock_guard<std::mutex> lock(warmPoolMutex_);
+        warmPoolStopping_ = true;
+    }
+    warmPoolCondition_.notify_all();
+    if (warmPoolThread_.joinable()) {
+        warmPoolThread_.join();
+    }
+    clearWarmPool();
+
     terminateAll();
+
+    // Its I/O thread may still call the fetcher, which posts to delivery_
+    fetchCache_.reset();
+}
+
+WorkerConfig::GCMode WorkerConfig::parseGCMode(const std::string& name) {
+    if (name == "compact") return GCMode::Compact;
+    if (name == "throughput") return GCMode::Throughput;
+    return GCMode::Default;
 }
 
 std::string WebWorkerCore::createWorker(
     const std::string& workerId,
-    const std::string& script
+    const std::string& script,
+    const WorkerConfig& config
 ) {
-    std::lock_guard<std::mutex> lock(workersMutex_);
+    return createWorker(workerId, std::make_shared<StringBuffer>(script), config);
+}
 
-    if (workers_.find(workerId) != workers_.end()) {
-        throw std::runtime_error("Worker already exists: " + workerId);
+std::string WebWorkerCore::createWorkerFromFile(
+    const std::string& workerId,
+    const std::string& path,
+    const WorkerConfig& config
+) {
+    return createWorker(workerId, MappedBuffer::openScript(path), config);
+}
+
+std::string WebWorkerCore::createWorker(
+    const std::string& workerId,
+    std::shared_ptr<const Buffer> script,
+    const WorkerConfig& config
+) {
+    {
+        std::lock_guard<std::mutex> lock(workersMutex_);
+        if (workerHandles_.count(workerId) > 0 || startingWorkers_.count(workerId) > 0) {
+            throw std::runtime_error("Worker already exists: " + workerId);
+        }
+        startingWorkers_.insert(workerId);
     }
 
-    auto worker = std::make_unique<WorkerRuntime>(
-        workerId,
-        messageCallback_,
-        consoleCallback_,
-        errorCallback_,
-        fetchCallback_
-    );
+    // Booting and running the script happen outside the registry lock
+    std::shared_ptr<WorkerRuntime> worker;
+    try {
+        // Warm runtimes were built with the default heap settings
+        std::unique_ptr<WorkerRuntime> runtime;
+        if (config.isDefault()) {
+            runtime = takeWarmRuntime();
+        }
+        if (runtime) {
+            runtime->assignId(workerId, config.thread);
+        } else {
+            runtime = std::make_unique<WorkerRuntime>(
+                workerId,
+                messageCallback_,
+                consoleLogger_,
+                workerErrorCallback(),
+                fetchCallback_,
+                config
+            );
+        }
+        worker = std::move(runtime);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(workersMutex_);
+        startingWorkers_.erase(workerId);
+        throw;
+    }
 
-    if (!worker->loadScript(script)) {
-        throw std::runtime_error("Failed to load script for worker: " + workerId);
+    bool loaded = worker->loadScript(std::move(script), scriptCache_);
+    WorkerHandle handle = loaded ? registry_.insert(worker) : 0;
+
+    {
+        std::lock_guard<std::mutex> lock(workersMutex_);
+        startingWorkers_.erase(workerId);
+        if (handle != 0) {
+            workerHandles_[workerId] = handle;
+        }
     }
 
-    workers_[workerId] = std::move(worker);
+    if (handle == 0) {
+        worker->terminate();
+        if (loaded) {
+            throw std::runtime_error("Too many workers, cannot create: " + workerId);
+        }
+        throw std::runtime_error("Failed to load script for worker: " + workerId);
+    }
     return workerId;
 }
 
-bool WebWorkerCore::terminateWorker(const std::string& workerId) {
+WorkerHandle WebWorkerCore::getWorkerHandle(const std::string& workerId) const {
     std::lock_guard<std::mutex> lock(workersMutex_);
+    auto it = workerHandles_.find(workerId);
+    return it != workerHandles_.end() ? it->second : 0;
+}
 
-    auto it = workers_.find(workerId);
-    if (it == workers_.end()) {
-        return false;
+std::shared_ptr<WorkerRuntime> WebWorkerCore::findWorker(const std::string& workerId) const {
+    return registry_.find(getWorkerHandle(workerId));
+}
+
+bool WebWorkerCore::terminateWorker(const std::string& workerId) {
+    WorkerHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex_);
+        auto it = workerHandles_.find(workerId);
+        if (it == workerHandles_.end()) {
+            return false;
+        }
+        handle = it->second;
+        workerHandles_.erase(it);
     }
 
-    it->second->terminate();
-    workers_.erase(it);
+    auto worker = registry_.remove(handle);
+    if (worker) {
+        worker->terminate();
+    }
     return true;
 }
 
 void WebWorkerCore::terminateAll() {
-    std::lock_guard<std::mutex> lock(workersMutex_);
+    std::unordered_map<std::string, WorkerHandle> handles;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex_);
+        handles.swap(workerHandles_);
+    }
+    for (auto& pair : handles) {
+        if (auto worker = registry_.remove(pair.second)) {
+            worker->terminate();
+        }
+    }
 
-    for (auto& pair : workers_) {
+    std::unordered_map<std::string, std::shared_ptr<WorkerPool>> pools;
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        pools.swap(pools_);
+    }
+    for (auto& pair : pools) {
         pair.second->terminate();
     }
-    workers_.clear();
+}
+
+bool WebWorkerCore::postMessage(
+    WorkerHandle handle,
+    std::shared_ptr<SerializedMessage> message
+) {
+    bool posted = false;
+    registry_.withWorker(handle, [&](WorkerRuntime& worker) {
+        posted = worker.postMessage(std::move(message));
+    });
+    return posted;
 }
 
 bool WebWorkerCore::postMessage(
     const std::string& workerId,
-    const std::string& message
+    std::shared_ptr<SerializedMessage> message
 ) {
-    std::lock_guard<std::mutex> lock(workersMutex_);
+    auto worker = findWorker(workerId);
+    if (!worker || !worker->isRunning()) {
+        return false;
+    }
+
+    return worker->postMessage(std::move(message));
+}
 
-    auto it = workers_.find(workerId);
-    if (it == workers_.end() || !it->second->isRunning()) {
+bool WebWorkerCore::postMessage(
+    const std::string& workerId,
+    const std::string& jsonMessage
+) {
+    auto worker = findWorker(workerId);
+    if (!worker || !worker->isRunning()) {
         return false;
     }
 
-    return it->second->postMessage(message);
+    return worker->postMessage(jsonMessage);
+}
+
+void WebWorkerCore::evalScriptAsync(
+    const std::string& workerId,
+    const std::string& script,
+    EvalCallback callback
+) {
+    auto worker = findWorker(workerId);
+    if (!worker || !worker->isRunning()) {
+        callback("", "Worker not found or not running: " + workerId);
+        return;
+    }
+
+    worker->evalScript(script, std::move(callback));
+}
+
+void WebWorkerCore::startProfiling(const std::string& workerId, EvalCallback callback) {
+    auto worker = findWorker(workerId);
+    if (!worker || !worker->isRunning()) {
+        callback("", "Worker not found or not running: " + workerId);
+        return;
+    }
+
+    worker->startProfiling(std::move(callback));
+}
+
+void WebWorkerCore::stopProfiling(const std::string& workerId, const std::string& path, EvalCallback callback) {
+    auto worker = findWorker(workerId);
+    if (!worker || !worker->isRunning()) {
+        callback("", "Worker not found or not running: " + workerId);
+        return;
+    }
+
+    worker->stopProfiling(path, std::move(callback));
 }
 
 std::string WebWorkerCore::evalScript(
     const std::string& workerId,
     const std::string& script
 ) {
-    std::lock_guard<std::mutex> lock(workersMutex_);
+    auto done = std::make_shared<std::promise<std::string>>();
+    auto future = done->get_future();
+
+    evalScriptAsync(workerId, script, [done](const std::string& result, const std::string& error) {
+        if (error.empty()) {
+            done->set_value(result);
+        } else {
+            done->set_exception(std::make_exception_ptr(std::runtime_error(error)));
+        }
+    });
+
+    return future.get();
+}
+
+// ============================================================================
+// Worker pools
+// ============================================================================
+
+// Pools are shared_ptr so a job can be submitted without holding poolsMutex_
+// while the pool's mutex is taken, and terminatePool can stop the workers
+// after the pool was unpublished.
+
+size_t WebWorkerCore::createPool(
+    const std::string& poolId,
+    const std::string& script,
+    size_t size
+) {
+    return createPool(poolId, std::make_shared<StringBuffer>(script), size);
+}
+
+size_t WebWorkerCore::createPoolFromFile(
+    const std::string& poolId,
+    const std::string& path,
+    size_t size
+) {
+    return createPool(poolId, MappedBuffer::openScript(path), size);
+}
+
+size_t WebWorkerCore::createPool(
+    const std::string& poolId,
+    std::shared_ptr<const Buffer> script,
+    size_t size
+) {
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        if (pools_.find(poolId) != pools_.end()) {
+            throw std::runtime_error("WorkerPool already exists: " + poolId);
+        }
+    }
+
+    // Starting the workers takes a while, don't block other pools meanwhile
+    auto pool = std::make_shared<WorkerPool>(
+        poolId,
+        std::move(script),
+        scriptCache_,
+        size,
+        consoleLogger_,
+        workerErrorCallback(),
+        fetchCallback_,
+        poolResultCallback_
+    );
+
+    std::lock_guard<std::mutex> lock(poolsMutex_);
+    if (!pools_.emplace(poolId, pool).second) {
+        pool->terminate();
+        throw std::runtime_error("WorkerPool already exists: " + poolId);
+    }
+    return pool->size();
+}
 
-    auto it = workers_.find(workerId);
-    if (it == workers_.end() || !it->second->isRunning()) {
-        throw std::runtime_error("Worker not found or not running: " + workerId);
+bool WebWorkerCore::submitPoolJob(
+    const std::string& poolId,
+    uint64_t jobId,
+    std::shared_ptr<SerializedMessage> payload
+) {
+    std::shared_ptr<WorkerPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        auto it = pools_.find(poolId);
+        if (it == pools_.end()) return false;
+        pool = it->second;
+    }
+    return pool->submit(jobId, std::move(payload));
+}
+
+bool WebWorkerCore::cancelPoolJob(const std::string& poolId, uint64_t jobId) {
+    std::shared_ptr<WorkerPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        auto it = pools_.find(poolId);
+        if (it == pools_.end()) return false;
+        pool = it->second;
+    }
+    return pool->cancel(jobId);
+}
+
+bool WebWorkerCore::broadcastPool(
+    const std::string& poolId,
+    std::shared_ptr<SerializedMessage> message
+) {
+    std::shared_ptr<WorkerPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        auto it = pools_.find(poolId);
+        if (it == pools_.end()) return false;
+        pool = it->second;
     }
+    pool->broadcast(std::move(message));
+    return true;
+}
 
-    return it->second->evalScript(script);
+bool WebWorkerCore::terminatePool(const std::string& poolId) {
+    std::shared_ptr<WorkerPool> pool;
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        auto it = pools_.find(poolId);
+        if (it == pools_.end()) return false;
+        pool = std::move(it->second);
+        pools_.erase(it);
+    }
+    pool->terminate();
+    return true;
 }
 
+// Warm runtimes capture the callbacks they were created with, so changing a
+// callback discards them and lets the pool refill with the new ones.
+
 void WebWorkerCore::setMessageCallback(MessageCallback callback) {
     messageCallback_ = callback;
+    clearWarmPool();
 }
 
 void WebWorkerCore::setConsoleCallback(ConsoleCallback callback) {
-    consoleCallback_ = callback;
+    // Shared through the logger, warm runtimes pick it up as well
+    consoleLogger_->setCallback(std::move(callback));
+}
+
+void WebWorkerCore::setConsoleLevel(ConsoleLevel minimum) {
+    consoleLogger_->setLevel(minimum);
 }
 
 void WebWorkerCore::setErrorCallback(ErrorCallback callback) {
     errorCallback_ = callback;
+    clearWarmPool();
+}
+
+void WebWorkerCore::setBindingErrorCallback(ErrorCallback callback) {
+    bindingErrorCallback_ = callback;
+    clearWarmPool();
 }
 
 void WebWorkerCore::setFetchCallback(FetchCallback callback) {
-    fetchCallback_ = callback;
+    // Workers fetch through the cache, which calls the platform on a miss
+    FetchCache* cache = fetchCache_.get();
+    fetchCallback_ = callback
+        ? FetchCallback([cache](const std::string& workerId, const FetchRequest& request) {
+              cache->fetch(workerId, request);
+          })
+        : nullptr;
+
+    DeliveryThread* delivery = delivery_.get();
+    fetchCache_->setFetcher(callback
+        ? FetchCache::Fetcher([delivery, callback](const std::string& workerId, const FetchRequest& request) {
+              // The body is shared, not copied
+              auto copy = std::make_shared<FetchRequest>();
+              copy->requestId = request.requestId;
+              copy->url = request.url;
+              copy->method = request.method;
+              copy->headers = request.headers;
+              copy->body = request.body.share();
+              copy->timeout = request.timeout;
+              copy->redirect = request.redirect;
+              copy->cache = request.cache;
+              delivery->post([callback, workerId, copy]() { callback(workerId, *copy); });
+          })
+        : nullptr);
+    clearWarmPool();
 }
 
-void WebWorkerCore::handleFetchResponse(const std::string& workerId, const FetchResponse& response) {
-    std::lock_guard<std::mutex> lock(workersMutex_);
-    auto it = workers_.find(workerId);
-    if (it != workers_.end() && it->second->isRunning()) {
-        it->second->handleFetchResponse(response);
+ErrorCallback WebWorkerCore::workerErrorCallback() const {
+    if (!errorCallback_ && !bindingErrorCallback_) return nullptr;
+
+    DeliveryThread* delivery = delivery_.get();
+    ErrorCallback platform = errorCallback_;
+    ErrorCallback binding = bindingErrorCallback_;
+    return [delivery, platform, binding](const std::string& workerId, const std::string& error) {
+        delivery->post([platform, binding, workerId, error]() {
+            if (platform) platform(workerId, error);
+            if (binding) binding(workerId, error);
+        });
+    };
+}
+
+void WebWorkerCore::setPoolResultCallback(PoolResultCallback callback) {
+    poolResultCallback_ = callback;
+}
+
+void WebWorkerCore::handleFetchResponse(const std::string& workerId, FetchResponse response) {
+    if (workerId == FetchCache::kWorkerId) {
+        fetchCache_->handleResponse(std::move(response));
+        return;
     }
+    deliverFetchResponse(workerId, std::move(response));
+}
+
+bool WebWorkerCore::handleFetchChunk(const std::string& workerId, FetchChunk chunk) {
+    if (workerId == FetchCache::kWorkerId) {
+        return fetchCache_->handleChunk(std::move(chunk));
+    }
+    return deliverFetchChunk(workerId, std::move(chunk));
+}
+
+void WebWorkerCore::setFetchCacheDirectory(const std::string& path) {
+    fetchCache_->setDirectory(path);
+}
+
+void WebWorkerCore::deliverFetchResponse(const std::string& workerId, FetchResponse response) {
+    if (auto worker = findWorker(workerId)) {
+        if (worker->isRunning()) {
+            worker->handleFetchResponse(std::move(response));
+        }
+        return;
+    }
+
+    // Pool workers are named "<poolId>#<index>"
+    std::lock_guard<std::mutex> lock(poolsMutex_);
+    for (auto& pair : pools_) {
+        WorkerRuntime* worker = pair.second->findWorker(workerId);
+        if (worker) {
+            if (worker->isRunning()) {
+                worker->handleFetchResponse(std::move(response));
+            }
+            return;
+        }
+    }
+}
+
+void WebWorkerCore::onMemoryPressure(MemoryPressure level) {
+    if (level == MemoryPressure::Critical) {
+        {
+            std::lock_guard<std::mutex> lock(warmPoolMutex_);
+            warmPoolSuspended_ = true;
+        }
+        clearWarmPool();
+        fetchCache_->trimMemory();
+        scriptCache_->clear();
+    }
+
+    std::vector<WorkerHandle> handles;
+    {
+        std::lock_guard<std::mutex> lock(workersMutex_);
+        handles.reserve(workerHandles_.size());
+        for (auto& pair : workerHandles_) {
+            handles.push_back(pair.second);
+        }
+    }
+    for (WorkerHandle handle : handles) {
+        registry_.withWorker(handle, [](WorkerRuntime& worker) { worker.collectGarbage(); });
+    }
+
+    std::lock_guard<std::mutex> lock(poolsMutex_);
+    for (auto& pair : pools_) {
+        pair.second->collectGarbage();
+    }
+}
+
+bool WebWorkerCore::deliverFetchChunk(const std::string& workerId, FetchChunk chunk) {
+    if (auto worker = findWorker(workerId)) {
+        return worker->handleFetchChunk(std::move(chunk));
+    }
+
+    // Hold on to the pool rather than poolsMutex_, pushing may block
+    std::shared_ptr<WorkerPool> pool;
+    WorkerRuntime* worker = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(poolsMutex_);
+        for (auto& pair : pools_) {
+            worker = pair.second->findWorker(workerId);
+            if (worker) {
+                pool = pair.second;
+                break;
+            }
+        }
+    }
+    return worker ? worker->handleFetchChunk(std::move(chunk)) : false;
 }
 
 bool WebWorkerCore::hasWorker(const std::string& workerId) const {
-    std::lock_guard<std::mutex> lock(workersMutex_);
-    return workers_.find(workerId) != workers_.end();
+    return getWorkerHandle(workerId) != 0;
 }
 
 bool WebWorkerCore::isWorkerRunning(const std::string& workerId) const {
-    std::lock_guard<std::mutex> lock(workersMutex_);
-    auto it = workers_.find(workerId);
-    return it != workers_.end() && it->second->isRunning();
+    auto worker = findWorker(workerId);
+    return worker && worker->isRunning();
+}
+
+std::optional<WorkerStats> WebWorkerCore::getWorkerStats(const std::string& workerId) const {
+    auto worker = findWorker(workerId);
+    if (!worker) return std::nullopt;
+    return worker->getStats();
+}
+
+void WebWorkerCore::setStatsSampleInterval(uint32_t interval) {
+    WorkerStatsRecorder::setSampleInterval(interval);
+}
+
+void WebWorkerCore::setFetchHighWaterMark(size_t bytes) {
+    FetchStream::setDefaultHighWaterMark(bytes);
+}
+
+bool WebWorkerCore::setWorkerThreadOptions(const std::string& workerId, const ThreadOptions& options) {
+    auto worker = findWorker(workerId);
+    if (!worker) return false;
+    worker->setThreadOptions(options);
+    return true;
+}
+
+void WebWorkerCore::setWarmPoolSize(size_t size) {
+    std::deque<std::unique_ptr<WorkerRuntime>> excess;
+    {
+        std::lock_guard<std::mutex> lock(warmPoolMutex_);
+        warmPoolSize_ = size;
+        while (warmRuntimes_.size() > warmPoolSize_) {
+            excess.push_back(std::move(warmRuntimes_.back()));
+            warmRuntimes_.pop_back();
+        }
+        if (warmPoolSize_ > 0 && !warmPoolThread_.joinable()) {
+            warmPoolThread_ = std::thread(&WebWorkerCore::warmPoolThreadMain, this);
+        }
+    }
+    warmPoolCondition_.notify_all();
+    // `excess` is destroyed here, outside the lock, since terminating a
+    // runtime joins its thread
+}
+
+size_t WebWorkerCore::getWarmPoolSize() const {
+    std::lock_guard<std::mutex> lock(warmPoolMutex_);
+    return warmPoolSize_;
+}
+
+std::unique_ptr<WorkerRuntime> WebWorkerCore::takeWarmRuntime() {
+    std::unique_ptr<WorkerRuntime> runtime;
+    {
+        std::lock_guard<std::mutex> lock(warmPoolMutex_);
+        // Demand is back, let the pool refill after memory pressure
+        warmPoolSuspended_ = false;
+        while (!warmRuntimes_.empty() && !runtime) {
+            runtime = std::move(warmRuntimes_.front());
+            warmRuntimes_.pop_front();
+            if (!runtime->isRunning()) {
+                runtime.reset();
+            }
+        }
+    }
+    warmPoolCondition_.notify_all();
+    return runtime;
+}
+
+void WebWorkerCore::clearWarmPool() {
+    std::deque<std::unique_ptr<WorkerRuntime>> discarded;
+    {
+        std::lock_guard<std::mutex> lock(warmPoolMutex_);
+        discarded.swap(warmRuntimes_);
+    }
+    warmPoolCondition_.notify_all();
+}
+
+void WebWorkerCore::warmPoolThreadMain() {
+    std::unique_lock<std::mutex> lock(warmPoolMutex_);
+
+    while (!warmPoolStopping_) {
+        if (warmPoolSuspended_ || warmRuntimes_.size() >= warmPoolSize_) {
+            warmPoolCondition_.wait(lock);
+            continue;
+        }
+
+        // Building a runtime takes tens of milliseconds, don't block takers
+        lock.unlock();
+        auto runtime = std::make_unique<WorkerRuntime>(
+            "",
+            messageCallback_,
+            consoleLogger_,
+            workerErrorCallback(),
+            fetchCallback_
+        );
+        lock.lock();
+
+        if (!runtime->isRunning()) {
+            // Runtime creation failed; retry once the pool is reconfigured
+            lock.unlock();
+            runtime.reset();
+            lock.lock();
+            warmPoolCondition_.wait(lock);
+            continue;
+        }
+
+        if (warmPoolStopping_ || warmPoolSuspended_ || warmRuntimes_.size() >= warmPoolSize_) {
+            lock.unlock();
+            runtime.reset();
+            lock.lock();
+            continue;
+        }
+
+        warmRuntimes_.push_back(std::move(runtime));
+    }
 }
 
 // ============================================================================
@@ -140,34 +761,96 @@ bool WebWorkerCore::isWorkerRunning(const std::string& workerId) const {
 WorkerRuntime::WorkerRuntime(
     const std::string& workerId,
     MessageCallback messageCallback,
-    ConsoleCallback consoleCallback,
+    std::shared_ptr<ConsoleLogger> consoleLogger,
     ErrorCallback errorCallback,
-    FetchCallback fetchCallback
+    FetchCallback fetchCallback,
+    const WorkerConfig& config
 )
     : workerId_(workerId)
+    , config_(config)
     , messageCallback_(messageCallback)
-    , consoleCallback_(consoleCallback)
+    , consoleLogger_(std::move(consoleLogger))
     , errorCallback_(errorCallback)
     , fetchCallback_(fetchCallback) {
 
+    if (consoleLogger_) {
+        consoleBuffer_ = consoleLogger_->attach(workerId_);
+    }
+
     // Start worker thread
-    workerThread_ = std::make_unique<std::thread>(&WorkerRuntime::workerThreadMain, this);
+    workerThread_ = std::make_unique<WorkerThread>(
+        static_cast<size_t>(config_.stackSizeKB) << 10,
+        [this]() { workerThreadMain(); });
 
     // Wait for runtime to be initialized
-    while (!initialized_.load()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
-    }
+    waitUntilInitialized();
 }
 
 WorkerRuntime::~WorkerRuntime() {
     terminate();
 }
 
+void WorkerRuntime::assignId(const std::string& workerId, ThreadOptions thread) {
+    workerId_ = workerId;
+    if (consoleBuffer_) consoleBuffer_->setWorkerId(workerId);
+
+    std::lock_guard<std::mutex> lock(pendingScriptMutex_);
+    pendingThreadOptions_ = std::move(thread);
+}
+
+void WorkerRuntime::recordThreadOptions() {
+    auto current = currentThreadOptions();
+    stats_.setThread(std::move(current.name), ThreadOptions::priorityName(current.priority));
+}
+
+void WorkerRuntime::markInitialized() {
+    {
+        std::lock_guard<std::mutex> lock(initMutex_);
+        initialized_ = true;
+    }
+    initCondition_.notify_all();
+}
+
+void WorkerRuntime::waitUntilInitialized() {
+    std::unique_lock<std::mutex> lock(initMutex_);
+    initCondition_.wait(lock, [this] { return initialized_.load(); });
+}
+
 void WorkerRuntime::workerThreadMain() {
+    tCurrentWorker = this;
+
+    // Before the runtime is built, so it all happens at the chosen priority
+    if (!config_.thread.isDefault()) {
+        applyThreadOptions(config_.thread);
+    }
+    if (config_.thread.name.empty()) {
+        setThreadName("webworker");
+    }
+    recordThreadOptions();
+
     try {
         // Create Hermes runtime
+        auto gcConfig = ::hermes::vm::GCConfig::Builder();
+        if (config_.maxHeapSizeMB > 0) {
+            gcConfig.withMaxHeapSize(config_.maxHeapSizeMB << 20);
+        }
+        if (config_.initialHeapSizeMB > 0) {
+            gcConfig.withInitHeapSize(config_.initialHeapSizeMB << 20);
+        }
+        switch (config_.gcMode) {
+            case WorkerConfig::GCMode::Compact:
+                gcConfig.withShouldReleaseUnused(::hermes::vm::kReleaseUnusedYoungAlways);
+                break;
+            case WorkerConfig::GCMode::Throughput:
+                gcConfig.withShouldReleaseUnused(::hermes::vm::kReleaseUnusedNone);
+                break;
+            case WorkerConfig::GCMode::Default:
+                break;
+        }
+
         auto runtimeConfig = ::hermes::vm::RuntimeConfig::Builder()
             .withIntl(false)
+            .withGCConfig(gcConfig.build())
             .build();
 
         hermesRuntime_ = facebook::hermes::makeHermesRuntime(runtimeConfig);
@@ -176,16 +859,19 @@ void WorkerRuntime::workerThreadMain() {
             if (errorCallback_) {
                 errorCallback_(workerId_, "Failed to create Hermes runtime");
             }
-            initialized_ = true;
+            markInitialized();
             return;
         }
 
         setupGlobalScope();
         installNativeFunctions();
         installTimerFunctions();
+        installAtomics();
+        installMessagePorts();
+        cacheGlobalHandles();
 
         running_ = true;
-        initialized_ = true;
+        markInitialized();
 
         // Wait for script to be loaded
         {
@@ -200,12 +886,19 @@ void WorkerRuntime::workerThreadMain() {
 
             // Execute the pending script
             if (hasPendingScript_) {
+                // A warm runtime only learns its options now
+                if (!pendingThreadOptions_.isDefault()) {
+                    applyThreadOptions(pendingThreadOptions_);
+                    recordThreadOptions();
+                }
                 try {
                     std::lock_guard<std::mutex> runtimeLock(runtimeMutex_);
-                    hermesRuntime_->evaluateJavaScript(
-                        std::make_shared<StringBuffer>(pendingScript_),
-                        "worker-script.js"
-                    );
+                    WEBWORKER_TRACE_SECTION("WebWorker loadScript");
+                    // Identical scripts are compiled once, see ScriptCache
+                    auto prepared = pendingScriptCache_
+                        ? pendingScriptCache_->prepare(*hermesRuntime_, pendingScript_, "worker-script.js")
+                        : hermesRuntime_->prepareJavaScript(pendingScript_, "worker-script.js");
+                    hermesRuntime_->evaluatePreparedJavaScript(prepared);
 
                     // Drain microtasks after script execution
                     static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get())
@@ -224,6 +917,8 @@ void WorkerRuntime::workerThreadMain() {
                     scriptExecuted_ = false;
                 }
                 hasPendingScript_ = false;
+                pendingScript_.reset();
+                pendingScriptCache_.reset();
             }
         }
         pendingScriptCondition_.notify_all();
@@ -231,74 +926,158 @@ void WorkerRuntime::workerThreadMain() {
         // Run the event loop
         eventLoop();
 
+        // self.close() leaves the runtime up until terminate, don't let
+        // evaluations wait for it
+        failPendingEvals("Worker closed");
+
     } catch (const std::exception& e) {
         if (errorCallback_) {
             errorCallback_(workerId_, "Worker thread exception: " + std::string(e.what()));
         }
-        initialized_ = true;
+        markInitialized();
     }
 }
 
 void WorkerRuntime::eventLoop() {
     while (running_.load() && !closeRequested_.load()) {
-        // Calculate wait time (until next timer or max wait)
-        auto waitTime = taskQueue_.timeUntilNext();
-
-        // Cap wait time to avoid very long waits
-        if (waitTime > std::chrono::milliseconds(1000)) {
-            waitTime = std::chrono::milliseconds(1000);
-        }
-
-        // Wait for and dequeue next task
-        auto task = taskQueue_.dequeue(waitTime);
+        // Parks until a task arrives, a timer is due or the queue shuts down
+        auto task = taskQueue_.dequeue();
 
         if (!task.has_value()) {
-            continue;  // Timeout or spurious wake, continue loop
+            continue;  // Shut down, the loop condition takes it from here
         }
 
         if (task->cancelled) {
             continue;  // Task was cancelled, skip it
         }
 
-        // Check if this timer was cancelled
-        if (task->type == TaskType::Timer) {
-            std::lock_guard<std::mutex> lock(cancelledTimersMutex_);
-            if (cancelledTimers_.count(task->id) > 0) {
-                continue;  // Timer was cancelled
-            }
+        // Run it together with whatever immediate tasks are already waiting,
+        // typically a burst of postMessage calls
+        taskBatch_.push_back(std::move(*task));
+        while (taskBatch_.size() < kMaxTaskBatch) {
+            auto next = taskQueue_.tryDequeueImmediate();
+            if (!next.has_value()) break;
+            if (next->cancelled) continue;
+            taskBatch_.push_back(std::move(*next));
         }
 
-        // Execute the macrotask
-        processTask(*task);
+        // Execute the macrotasks
+        processTasks(taskBatch_);
+        taskBatch_.clear();
     }
 }
 
-void WorkerRuntime::processTask(Task& task) {
+void WorkerRuntime::processTasks(std::vector<Task>& tasks) {
     if (!hermesRuntime_ || !running_.load()) {
         return;
     }
 
-    try {
-        std::lock_guard<std::mutex> lock(runtimeMutex_);
+    // One runtime lock for the whole batch
+    std::lock_guard<std::mutex> lock(runtimeMutex_);
+    auto* hermes = static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get());
 
-        // Execute the task
-        task.execute();
+    for (auto& task : tasks) {
+        if (!running_.load() || closeRequested_.load()) {
+            return;
+        }
 
-        // Drain microtasks after each macrotask
-        static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get())
-            ->drainMicrotasks();
+        WEBWORKER_TRACE_SECTION(traceName(task.type));
+        bool timed = stats_.beginTask();
+        std::chrono::steady_clock::time_point started;
+        if (timed) started = std::chrono::steady_clock::now();
 
-    } catch (const JSError& e) {
-        if (errorCallback_) {
-            errorCallback_(workerId_, "JSError in task: " + e.getMessage());
-        }
-    } catch (const std::exception& e) {
-        if (errorCallback_) {
-            errorCallback_(workerId_, "Exception in task: " + std::string(e.what()));
+        runningJob_ = task.jobId;
+
+        try {
+            // Execute the task
+            task.execute();
+            std::chrono::steady_clock::time_point executed;
+            if (timed) executed = std::chrono::steady_clock::now();
+
+            // Drain microtasks after each macrotask, batched or not
+            {
+                WEBWORKER_TRACE_SECTION("WebWorker drainMicrotasks");
+                hermes->drainMicrotasks();
+            }
+
+            // runAt is when it was queued, or when a timer was due
+            if (timed) stats_.recordTask(task.runAt, started, executed, std::chrono::steady_clock::now());
+
+        } catch (const JSError& e) {
+            reportTaskError("JSError in task: " + e.getMessage());
+        } catch (const std::exception& e) {
+            reportTaskError("Exception in task: " + std::string(e.what()));
         }
+        runningJob_.reset();
+    }
+
+    sampleHeap();
+}
+
+void WorkerRuntime::reportTaskError(const std::string& error) {
+    if (errorCallback_) {
+        errorCallback_(workerId_, error);
+    }
+
+    // Only the current job's own tasks fail it
+    if (runningJob_ && runningJob_ == currentJob_) {
+        failJob(*runningJob_, error);
     }
 }
 
+void WorkerRuntime::watchJobPromise(Runtime& runtime, uint64_t jobId, const Value& returned) {
+    // An async onmessage can only report its failure through its promise
+    if (!returned.isObject() || currentJob_ != jobId) return;
+    Object thenable = returned.getObject(runtime);
+    Value then = thenable.getProperty(runtime, "then");
+    if (!then.isObject() || !then.getObject(runtime).isFunction(runtime)) return;
+
+    auto onRejected = Function::createFromHostFunction(
+        runtime,
+        PropNameID::forAscii(runtime, "onJobRejected"),
+        1,
+        [this, jobId](Runtime& rt, const Value&, const Value* args, size_t count) -> Value {
+            if (currentJob_ != jobId) return Value::undefined();
+
+            std::string reason = "undefined";
+            if (count > 0 && args[0].isObject() && args[0].getObject(rt).hasProperty(rt, "message")) {
+                reason = args[0].getObject(rt).getProperty(rt, "message").toString(rt).utf8(rt);
+            } else if (count > 0) {
+                reason = args[0].toString(rt).utf8(rt);
+            }
+            std::string error = "Unhandled rejection in job: " + reason;
+            if (errorCallback_) {
+                errorCallback_(workerId_, error);
+            }
+            failJob(jobId, error);
+            return Value::undefined();
+        });
+    then.getObject(runtime).getFunction(runtime).callWithThis(runtime, thenable, Value::undefined(), onRejected);
+}
+
+void WorkerRuntime::failJob(uint64_t jobId, const std::string& error) {
+    // Only if it didn't answer yet
+    if (currentJob_ != jobId || !jobCallback_) return;
+    currentJob_.reset();
+    jobCallback_(jobId, nullptr, error);
+}
+
+void WorkerRuntime::sampleHeap() {
+    auto now = std::chrono::steady_clock::now();
+    if (!hermesRuntime_ || !stats_.heapSampleDue(now)) return;
+    stats_.setHeap(hermesRuntime_->instrumentation().getHeapInfo(false), now);
+}
+
+WorkerStats WorkerRuntime::getStats() const {
+    WorkerStats stats;
+    auto depth = taskQueue_.depth();
+    stats.immediateTasks = depth.immediate;
+    stats.localTasks = depth.local;
+    stats.delayedTasks = depth.delayed;
+    stats_.snapshot(stats);
+    return stats;
+}
+
 void WorkerRuntime::setupGlobalScope() {
     if (!hermesRuntime_) return;
 
@@ -306,21 +1085,21 @@ void WorkerRuntime::setupGlobalScope() {
         Runtime& runtime = *hermesRuntime_;
 
         // Execute polyfills first (TextEncoder, URL, AbortController, etc.)
-        runtime.evaluateJavaScript(
-            std::make_shared<StringBuffer>(kPolyfillScript),
-            "polyfills.js"
-        );
+        evaluatePolyfills(runtime);
 
-        std::string initScript = R"(
+        constexpr const char* initScript = R"(
             var self = this;
             var global = this;
             var messageHandlers = [];
 
             self.onmessage = null;
 
-            self.postMessage = function(message) {
+            self.postMessage = function(message, transfer) {
+                if (transfer && !Array.isArray(transfer)) {
+                    transfer = transfer.transfer;
+                }
                 if (typeof __nativePostMessageToHost !== 'undefined') {
-                    __nativePostMessageToHost(JSON.stringify(message));
+                    __nativePostMessageToHost(message, transfer);
                 }
             };
 
@@ -339,66 +1118,41 @@ void WorkerRuntime::setupGlobalScope() {
                 }
             };
 
-            self.__handleMessage = function(message) {
-                var data;
-                try {
-                    data = JSON.parse(message);
-                } catch (e) {
-                    data = message;
-                }
-
+            // Non-writable: the native side caches this function
+            Object.defineProperty(self, '__handleMessage', { value: function(data) {
                 var event = {
                     data: data,
                     type: 'message'
                 };
 
+                var returned;
                 if (typeof self.onmessage === 'function') {
-                    self.onmessage(event);
+                    returned = self.onmessage(event);
                 }
 
                 messageHandlers.forEach(function(handler) {
                     handler(event);
                 });
-            };
 
-            // Basic console
-            var console = {
-                log: function() {
-                    var args = Array.prototype.slice.call(arguments);
-                    var message = args.map(function(arg) {
-                        return typeof arg === 'object' ? JSON.stringify(arg) : String(arg);
-                    }).join(' ');
-                    if (typeof __nativeConsoleLog !== 'undefined') {
-                        __nativeConsoleLog('log', message);
-                    }
-                },
-                error: function() {
-                    var args = Array.prototype.slice.call(arguments);
-                    var message = args.map(function(arg) {
-                        return typeof arg === 'object' ? JSON.stringify(arg) : String(arg);
-                    }).join(' ');
-                    if (typeof __nativeConsoleLog !== 'undefined') {
-                        __nativeConsoleLog('error', message);
-                    }
-                },
-                warn: function() {
-                    var args = Array.prototype.slice.call(arguments);
-                    var message = args.map(function(arg) {
-                        return typeof arg === 'object' ? JSON.stringify(arg) : String(arg);
-                    }).join(' ');
-                    if (typeof __nativeConsoleLog !== 'undefined') {
-                        __nativeConsoleLog('warn', message);
-                    }
-                },
-                info: function() {
-                    var args = Array.prototype.slice.call(arguments);
-                    var message = args.map(function(arg) {
-                        return typeof arg === 'object' ? JSON.stringify(arg) : String(arg);
-                    }).join(' ');
+                // Lets a pool job fail when an async onmessage rejects
+                return returned;
+            } });
+
+            // Formatting and level filtering happen natively, a disabled
+            // level costs a single call
+            function consoleMethod(level) {
+                return function() {
                     if (typeof __nativeConsoleLog !== 'undefined') {
-                        __nativeConsoleLog('info', message);
+                        __nativeConsoleLog(level, arguments);
                     }
-                }
+                };
+            }
+
+            var console = {
+                log: consoleMethod('log'),
+                error: consoleMethod('error'),
+                warn: consoleMethod('warn'),
+                info: consoleMethod('info')
             };
 
             self.console = console;
@@ -414,10 +1168,7 @@ void WorkerRuntime::setupGlobalScope() {
             };
         )";
 
-        runtime.evaluateJavaScript(
-            std::make_shared<StringBuffer>(initScript),
-            "worker-init.js"
-        );
+        evaluatePrelude(runtime, "worker-init.js", initScript);
 
     } catch (const std::exception& e) {
         if (errorCallback_) {
@@ -437,12 +1188,13 @@ void WorkerRuntime::installNativeFunctions() {
         auto postMessageFunc = Function::createFromHostFunction(
             runtime,
             PropNameID::forAscii(runtime, "__nativePostMessageToHost"),
-            1,
+            2,
             [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
-                if (count > 0 && args[0].isString()) {
-                    std::string message = args[0].asString(rt).utf8(rt);
-                    self->handlePostMessageToHost(message);
-                }
+                // Throws a DataCloneError back into JS for uncloneable values
+                auto message = count > 1 ? serializeValue(rt, args[0], args[1])
+                             : count > 0 ? serializeValue(rt, args[0])
+                                         : serializeValue(rt, Value::undefined());
+                self->handlePostMessageToHost(std::move(message));
                 return Value::undefined();
             }
         );
@@ -454,14 +1206,29 @@ void WorkerRuntime::installNativeFunctions() {
             PropNameID::forAscii(runtime, "__nativeConsoleLog"),
             2,
             [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
-                if (count >= 2) {
-                    std::string level = args[0].toString(rt).utf8(rt);
-                    std::string message = args[1].toString(rt).utf8(rt);
-                    self->handleConsoleLog(level, message);
-                } else if (count >= 1) {
-                    std::string message = args[0].toString(rt).utf8(rt);
-                    self->handleConsoleLog("log", message);
+                if (count < 2 || !self->consoleLogger_) return Value::undefined();
+
+                ConsoleLevel level = parseConsoleLevel(args[0].toString(rt).utf8(rt));
+                if (!self->consoleLogger_->isEnabled(level)) return Value::undefined();
+
+                // Same as `args.map(a => typeof a === 'object' ? JSON.stringify(a) : String(a)).join(' ')`
+                std::string message;
+                if (args[1].isString()) {
+                    message = args[1].getString(rt).utf8(rt);
+                } else if (args[1].isObject()) {
+                    Object list = args[1].getObject(rt);
+                    size_t length = static_cast<size_t>(list.getProperty(rt, "length").asNumber());
+                    for (size_t i = 0; i < length; i++) {
+                        Value arg = list.getProperty(rt, std::to_string(i).c_str());
+                        if (i > 0) message += ' ';
+                        if (arg.isObject() && !arg.getObject(rt).isFunction(rt) && self->jsonStringify_) {
+                            message += self->jsonStringify_->call(rt, arg).toString(rt).utf8(rt);
+                        } else {
+                            message += arg.toString(rt).utf8(rt);
+                        }
+                    }
                 }
+                self->handleConsoleLog(level, std::move(message));
                 return Value::undefined();
             }
         );
@@ -487,26 +1254,32 @@ void WorkerRuntime::installNativeFunctions() {
             [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
                 if (count < 1) return Value::undefined();
 
-                std::string url = args[0].asString(rt).utf8(rt);
-                std::string method = "GET";
-                std::unordered_map<std::string, std::string> headers;
-                std::vector<uint8_t> bodyData;
-                double timeout = 0;
-                std::string redirect = "follow";
+                // Built in place and shared with the executor, so the body
+                // isn't copied again on its way to the platform
+                auto request = std::make_shared<FetchRequest>();
+                request->url = args[0].asString(rt).utf8(rt);
+                request->method = "GET";
+                request->timeout = 0;
+                request->redirect = "follow";
+                request->cache = "default";
 
                 if (count > 1 && args[1].isObject()) {
                     Object opts = args[1].asObject(rt);
 
                     if (opts.hasProperty(rt, "method")) {
-                        method = opts.getProperty(rt, "method").asString(rt).utf8(rt);
+                        request->method = opts.getProperty(rt, "method").asString(rt).utf8(rt);
                     }
 
                     if (opts.hasProperty(rt, "timeout")) {
-                        timeout = opts.getProperty(rt, "timeout").asNumber();
+                        request->timeout = opts.getProperty(rt, "timeout").asNumber();
+                    }
+
+                    if (opts.hasProperty(rt, "redirect")) {
+                         request->redirect = opts.getProperty(rt, "redirect").asString(rt).utf8(rt);
                     }
 
-                    if (opts.hasProperty(rt, "redirect")) {
-                         redirect = opts.getProperty(rt, "redirect").asString(rt).utf8(rt);
+                    if (opts.hasProperty(rt, "cache")) {
+                        request->cache = opts.getProperty(rt, "cache").asString(rt).utf8(rt);
                     }
 
                     if (opts.hasProperty(rt, "headers")) {
@@ -515,44 +1288,39 @@ void WorkerRuntime::installNativeFunctions() {
                         for (size_t i = 0; i < headerNames.size(rt); ++i) {
                             String key = headerNames.getValueAtIndex(rt, i).asString(rt);
                             String value = headersObj.getProperty(rt, key).asString(rt);
-                            headers[key.utf8(rt)] = value.utf8(rt);
+                            request->headers[key.utf8(rt)] = value.utf8(rt);
                         }
                     }
 
                     if (opts.hasProperty(rt, "body")) {
                         Value bodyVal = opts.getProperty(rt, "body");
                         if (bodyVal.isString()) {
+                            // Copied twice: JSI only hands out strings as a
+                            // std::string, whose buffer can't be adopted
                             std::string bodyStr = bodyVal.asString(rt).utf8(rt);
-                            bodyData.assign(bodyStr.begin(), bodyStr.end());
+                            request->body = FetchBody(reinterpret_cast<const uint8_t*>(bodyStr.data()), bodyStr.size());
                         } else if (bodyVal.isObject() && bodyVal.asObject(rt).isArrayBuffer(rt)) {
                             auto arrayBuffer = bodyVal.asObject(rt).getArrayBuffer(rt);
-                            uint8_t* data = arrayBuffer.data(rt);
-                            size_t size = arrayBuffer.size(rt);
-                            bodyData.assign(data, data + size);
+                            request->body = FetchBody(arrayBuffer.data(rt), arrayBuffer.size(rt));
                         }
                     }
                 }
 
-                std::string requestId = std::to_string(self->nextRequestId_++);
+                request->requestId = std::to_string(self->nextRequestId_++);
 
-                auto promiseCtor = rt.global().getPropertyAsFunction(rt, "Promise");
-                return promiseCtor.callAsConstructor(rt, Function::createFromHostFunction(rt, PropNameID::forAscii(rt, "executor"), 2,
-                    [self, requestId, url, method, headers, bodyData, timeout, redirect](Runtime& rt, const Value&, const Value* args, size_t) -> Value {
+                if (!self->promiseConstructor_) return Value::undefined();
+                return self->promiseConstructor_->callAsConstructor(rt, Function::createFromHostFunction(rt, PropNameID::forAscii(rt, "executor"), 2,
+                    [self, request](Runtime& rt, const Value&, const Value* args, size_t) -> Value {
                         auto resolve = std::make_shared<Value>(rt, args[0]);
                         auto reject = std::make_shared<Value>(rt, args[1]);
 
-                        self->pendingFetches_[requestId] = {resolve, reject};
+                        uint64_t traceId = WEBWORKER_TRACE_NEW_ID();
+                        WEBWORKER_TRACE_ASYNC_BEGIN("WebWorker fetch", traceId);
+                        self->pendingFetches_[request->requestId] = {resolve, reject, traceId, self->runningJob_};
+                        self->stats_.setPendingFetches(self->pendingFetches_.size());
 
                         if (self->fetchCallback_) {
-                            FetchRequest req;
-                            req.requestId = requestId;
-                            req.url = url;
-                            req.method = method;
-                            req.headers = headers;
-                            req.body = bodyData;
-                            req.timeout = timeout;
-                            req.redirect = redirect;
-                            self->fetchCallback_(self->workerId_, req);
+                            self->fetchCallback_(self->workerId_, *request);
                         }
                         return Value::undefined();
                     }
@@ -561,31 +1329,233 @@ void WorkerRuntime::installNativeFunctions() {
         );
         runtime.global().setProperty(runtime, "__nativeFetch", fetchFunc);
 
+        // __nativeDecodeUtf8(arrayBuffer): string, what Response.text() does
+        // with a streamed body. Workers have no TextDecoder to do it in JS.
+        auto decodeUtf8Func = Function::createFromHostFunction(
+            runtime,
+            PropNameID::forAscii(runtime, "__nativeDecodeUtf8"),
+            1,
+            [](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+                if (count < 1 || !args[0].isObject() || !args[0].asObject(rt).isArrayBuffer(rt)) {
+                    throw JSError(rt, "__nativeDecodeUtf8: expected an ArrayBuffer");
+                }
+                auto arrayBuffer = args[0].asObject(rt).getArrayBuffer(rt);
+                const uint8_t* data = arrayBuffer.data(rt);
+                size_t size = arrayBuffer.size(rt);
+
+                // Like TextDecoder, drop a byte order mark
+                if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF) {
+                    data += 3;
+                    size -= 3;
+                }
+                if (size == 0) return String::createFromAscii(rt, "");
+                return String::createFromUtf8(rt, data, size);
+            }
+        );
+        runtime.global().setProperty(runtime, "__nativeDecodeUtf8", decodeUtf8Func);
+
         // Fetch API Polyfill
-        std::string fetchScript = R"(
+        constexpr const char* fetchScript = R"(
+            // Minimal pull-based ReadableStream: the source is only pulled
+            // while a read is waiting, which is what throttles downloads
+            if (typeof self.ReadableStream === 'undefined') {
+                var ReadableStream = function(source) {
+                    var stream = this;
+                    this._source = source || {};
+                    this._queue = [];
+                    this._reads = [];
+                    this._state = 'readable';
+                    this._error = undefined;
+                    this._pulling = false;
+                    this.locked = false;
+                    this._controller = {
+                        enqueue: function(chunk) {
+                            if (stream._state !== 'readable') return;
+                            var read = stream._reads.shift();
+                            if (read) read.resolve({ value: chunk, done: false });
+                            else stream._queue.push(chunk);
+                        },
+                        close: function() {
+                            if (stream._state !== 'readable') return;
+                            stream._state = 'closed';
+                            stream._settle();
+                        },
+                        error: function(error) {
+                            if (stream._state !== 'readable') return;
+                            stream._state = 'errored';
+                            stream._error = error;
+                            stream._queue = [];
+                            stream._settle();
+                        }
+                    };
+                    if (this._source.start) this._source.start(this._controller);
+                };
+                ReadableStream.prototype._settle = function() {
+                    if (this._queue.length) return;
+                    var reads = this._reads;
+                    this._reads = [];
+                    for (var i = 0; i < reads.length; i++) {
+                        if (this._state === 'errored') reads[i].reject(this._error);
+                        else reads[i].resolve({ value: undefined, done: true });
+                    }
+                };
+                ReadableStream.prototype._pull = function() {
+                    var stream = this;
+                    if (this._pulling || this._state !== 'readable' || !this._source.pull) return;
+                    this._pulling = true;
+                    Promise.resolve()
+                        .then(function() { return stream._source.pull(stream._controller); })
+                        .then(function() {
+                            stream._pulling = false;
+                            if (stream._reads.length) stream._pull();
+                        }, function(error) {
+                            stream._pulling = false;
+                            stream._controller.error(error);
+                        });
+                };
+                ReadableStream.prototype._read = function() {
+                    var stream = this;
+                    if (this._queue.length) {
+                        var chunk = this._queue.shift();
+                        if (!this._queue.length && this._state !== 'readable') this._settle();
+                        return Promise.resolve({ value: chunk, done: false });
+                    }
+                    if (this._state === 'closed') return Promise.resolve({ value: undefined, done: true });
+                    if (this._state === 'errored') return Promise.reject(this._error);
+                    return new Promise(function(resolve, reject) {
+                        stream._reads.push({ resolve: resolve, reject: reject });
+                        stream._pull();
+                    });
+                };
+                ReadableStream.prototype.cancel = function(reason) {
+                    if (this._state === 'readable') {
+                        this._state = 'closed';
+                        this._queue = [];
+                        this._settle();
+                        if (this._source.cancel) this._source.cancel(reason);
+                    }
+                    return Promise.resolve();
+                };
+                ReadableStream.prototype.getReader = function() {
+                    if (this.locked) throw new TypeError('ReadableStream is locked');
+                    var stream = this;
+                    this.locked = true;
+                    return {
+                        read: function() { return stream._read(); },
+                        cancel: function(reason) { return stream.cancel(reason); },
+                        releaseLock: function() { stream.locked = false; }
+                    };
+                };
+                if (typeof Symbol !== 'undefined' && Symbol.asyncIterator) {
+                    ReadableStream.prototype[Symbol.asyncIterator] = function() {
+                        var reader = this.getReader();
+                        return {
+                            next: function() { return reader.read(); },
+                            // Leaving the loop early cancels the stream and unlocks it
+                            return: function() {
+                                return reader.cancel().then(function() {
+                                    reader.releaseLock();
+                                    return { value: undefined, done: true };
+                                });
+                            }
+                        };
+                    };
+                }
+                self.ReadableStream = ReadableStream;
+            }
+
+            function bodyStream(nativeResponse, onPull) {
+                return new ReadableStream({
+                    pull: function(controller) {
+                        if (onPull) onPull();
+                        return new Promise(function(resolve) {
+                            nativeResponse.read(function(error, chunk) {
+                                if (error) controller.error(new TypeError(error));
+                                else if (chunk === undefined) controller.close();
+                                else controller.enqueue(new Uint8Array(chunk));
+                                resolve();
+                            });
+                        });
+                    },
+                    cancel: function() { nativeResponse.cancel(); }
+                });
+            }
+
+            function readAll(stream) {
+                var reader = stream.getReader();
+                var chunks = [];
+                var length = 0;
+                function next() {
+                    return reader.read().then(function(result) {
+                        if (!result.done) {
+                            chunks.push(result.value);
+                            length += result.value.byteLength;
+                            return next();
+                        }
+                        if (chunks.length === 1 && chunks[0].byteLength === chunks[0].buffer.byteLength) {
+                            return chunks[0].buffer;
+                        }
+                        var bytes = new Uint8Array(length);
+                        var offset = 0;
+                        for (var i = 0; i < chunks.length; i++) {
+                            bytes.set(chunks[i], offset);
+                            offset += chunks[i].byteLength;
+                        }
+                        return bytes.buffer;
+                    });
+                }
+                return next();
+            }
+
             self.fetch = async function(url, options) {
                 options = options || {};
                 var nativeResponse = await __nativeFetch(url, options);
-                
+                var body = null;
+                var bodyUsed = false;
+
+                function consume() {
+                    if (bodyUsed) return Promise.reject(new TypeError('Body has already been consumed'));
+                    bodyUsed = true;
+                    return null;
+                }
+                function buffer() {
+                    var used = consume();
+                    if (used) return used;
+                    if (body || nativeResponse.streaming) {
+                        return readAll(body || bodyStream(nativeResponse));
+                    }
+                    return Promise.resolve(nativeResponse.arrayBuffer());
+                }
+                function text() {
+                    if (!nativeResponse.streaming && !body) {
+                        var used = consume();
+                        if (used) return used;
+                        return Promise.resolve(nativeResponse.text());
+                    }
+                    return buffer().then(__nativeDecodeUtf8);
+                }
+
                 return {
                     status: nativeResponse.status,
                     ok: nativeResponse.status >= 200 && nativeResponse.status < 300,
                     headers: nativeResponse.headers,
-                    text: function() { return Promise.resolve(nativeResponse.text()); },
-                    json: function() { 
-                        return Promise.resolve(nativeResponse.text()).then(function(txt) {
-                            return JSON.parse(txt);
-                        });
+                    get body() {
+                        if (!body) {
+                            body = bodyUsed
+                                ? new ReadableStream({ start: function(controller) { controller.close(); } })
+                                : bodyStream(nativeResponse, function() { bodyUsed = true; });
+                        }
+                        return body;
                     },
-                    arrayBuffer: function() { return Promise.resolve(nativeResponse.arrayBuffer()); }
+                    get bodyUsed() { return bodyUsed; },
+                    text: text,
+                    json: function() { return text().then(function(txt) { return JSON.parse(txt); }); },
+                    arrayBuffer: buffer
                 };
             };
         )";
 
-        runtime.evaluateJavaScript(
-            std::make_shared<StringBuffer>(fetchScript),
-            "worker-fetch.js"
-        );
+        evaluatePrelude(runtime, "worker-fetch.js", fetchScript);
 
     } catch (const std::exception& e) {
         if (errorCallback_) {
@@ -601,56 +1571,23 @@ void WorkerRuntime::installTimerFunctions() {
         Runtime& runtime = *hermesRuntime_;
         auto* self = this;
 
-        // __nativeScheduleTimer
+        // __nativeScheduleTimer(delay, repeating, callback): timerId
         auto scheduleTimerFunc = Function::createFromHostFunction(
             runtime,
             PropNameID::forAscii(runtime, "__nativeScheduleTimer"),
-            4,
+            3,
             [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
-                if (count < 4) return Value::undefined();
+                if (count < 3) return Value::undefined();
 
-                uint64_t timerId = static_cast<uint64_t>(args[0].asNumber());
-                int64_t delay = static_cast<int64_t>(args[1].asNumber());
-                bool repeating = args[2].getBool();
+                int64_t delay = args[0].isNumber() ? static_cast<int64_t>(args[0].asNumber()) : 0;
+                bool repeating = args[1].getBool();
                 if (delay < 0) delay = 0;
 
-                auto callback = std::make_shared<Value>(rt, args[3]);
-                auto callbackHolder = std::make_shared<std::function<void()>>();
-
-                *callbackHolder = [self, callback, timerId, delay, repeating, callbackHolder]() {
-                    if (!self->hermesRuntime_ || !self->running_.load()) return;
-                    {
-                        std::lock_guard<std::mutex> lock(self->cancelledTimersMutex_);
-                        if (self->cancelledTimers_.count(timerId) > 0) return;
-                    }
-
-                    Runtime& rt = *self->hermesRuntime_;
-                    try {
-                        if (callback->isObject() && callback->asObject(rt).isFunction(rt)) {
-                            callback->asObject(rt).asFunction(rt).call(rt);
-                        }
-                    } catch (const JSError& e) {
-                        if (self->errorCallback_) self->errorCallback_(self->workerId_, "JSError in timer: " + e.getMessage());
-                    }
-
-                    if (repeating) {
-                        std::lock_guard<std::mutex> lock(self->cancelledTimersMutex_);
-                        if (self->cancelledTimers_.count(timerId) == 0) {
-                            Task nextTask;
-                            nextTask.type = TaskType::Timer;
-                            nextTask.id = timerId;
-                            nextTask.execute = *callbackHolder;
-                            self->taskQueue_.enqueueDelayed(std::move(nextTask), std::chrono::milliseconds(delay));
-                        }
-                    }
-                };
-
-                Task task;
-                task.type = TaskType::Timer;
-                task.id = timerId;
-                task.execute = *callbackHolder;
-                self->taskQueue_.enqueueDelayed(std::move(task), std::chrono::milliseconds(delay));
-                return Value::undefined();
+                ActiveTimer timer;
+                timer.jsCallback = std::make_shared<Value>(rt, args[2]);
+                timer.delay = std::chrono::milliseconds(delay);
+                timer.repeating = repeating;
+                return static_cast<double>(self->startTimer(std::move(timer)));
             }
         );
         runtime.global().setProperty(runtime, "__nativeScheduleTimer", scheduleTimerFunc);
@@ -670,19 +1607,44 @@ void WorkerRuntime::installTimerFunctions() {
         );
         runtime.global().setProperty(runtime, "__nativeCancelTimer", cancelTimerFunc);
 
+        // __nativeSetImmediate(callback): immediateId
+        auto setImmediateFunc = Function::createFromHostFunction(
+            runtime,
+            PropNameID::forAscii(runtime, "__nativeSetImmediate"),
+            1,
+            [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+                if (count < 1 || !args[0].isObject() || !args[0].getObject(rt).isFunction(rt)) {
+                    throw JSError(rt, "setImmediate: callback must be a function");
+                }
+                return static_cast<double>(self->setImmediate(std::make_shared<Value>(rt, args[0])));
+            }
+        );
+        runtime.global().setProperty(runtime, "__nativeSetImmediate", setImmediateFunc);
+
+        // __nativeClearImmediate(immediateId)
+        auto clearImmediateFunc = Function::createFromHostFunction(
+            runtime,
+            PropNameID::forAscii(runtime, "__nativeClearImmediate"),
+            1,
+            [self](Runtime& rt, const Value& thisVal, const Value* args, size_t count) -> Value {
+                if (count > 0 && args[0].isNumber()) {
+                    self->immediates_.erase(static_cast<uint64_t>(args[0].asNumber()));
+                }
+                return Value::undefined();
+            }
+        );
+        runtime.global().setProperty(runtime, "__nativeClearImmediate", clearImmediateFunc);
+
         // Timers JS wrapper
-        std::string timerScript = R"(
-            var __nextTimerId = 1;
+        constexpr const char* timerScript = R"(
             self.setTimeout = function(callback, delay) {
                 if (typeof callback !== 'function') {
                     if (typeof callback === 'string') callback = new Function(callback);
                     else return 0;
                 }
-                var timerId = __nextTimerId++;
                 var args = Array.prototype.slice.call(arguments, 2);
                 var wrappedCallback = function() { callback.apply(null, args); };
-                __nativeScheduleTimer(timerId, delay || 0, false, wrappedCallback);
-                return timerId;
+                return __nativeScheduleTimer(delay || 0, false, wrappedCallback);
             };
             self.clearTimeout = function(timerId) { if(timerId) __nativeCancelTimer(timerId); };
             self.setInterval = function(callback, delay) {
@@ -690,20 +1652,20 @@ void WorkerRuntime::installTimerFunctions() {
                     if (typeof callback === 'string') callback = new Function(callback);
                     else return 0;
                 }
-                var timerId = __nextTimerId++;
                 var args = Array.prototype.slice.call(arguments, 2);
                 var wrappedCallback = function() { callback.apply(null, args); };
-                __nativeScheduleTimer(timerId, delay || 0, true, wrappedCallback);
-                return timerId;
+                return __nativeScheduleTimer(delay || 0, true, wrappedCallback);
             };
             self.clearInterval = function(timerId) { self.clearTimeout(timerId); };
             self.setImmediate = function(callback) {
+                if (arguments.length < 2) return __nativeSetImmediate(callback);
                 var args = Array.prototype.slice.call(arguments, 1);
-                return self.setTimeout(function() { callback.apply(null, args); }, 0);
+                return __nativeSetImmediate(function() { callback.apply(null, args); });
             };
-            self.clearImmediate = function(timerId) { self.clearTimeout(timerId); };
+            self.clearImmediate = function(immediateId) { if(immediateId) __nativeClearImmediate(immediateId); };
+
         )";
-        runtime.evaluateJavaScript(std::make_shared<StringBuffer>(timerScript), "worker-timers.js");
+        evaluatePrelude(runtime, "worker-timers.js", timerScript);
 
     } catch (const std::exception& e) {
         if (errorCallback_) {
@@ -717,23 +1679,132 @@ uint64_t WorkerRuntime::scheduleTimer(
     std::chrono::milliseconds delay,
     bool repeating
 ) {
+    ActiveTimer timer;
+    timer.nativeCallback = std::move(callback);
+    timer.delay = delay;
+    timer.repeating = repeating;
+    return startTimer(std::move(timer));
+}
+
+uint64_t WorkerRuntime::startTimer(ActiveTimer timer) {
     uint64_t timerId = nextTimerId_++;
+    auto delay = timer.delay;
+    activeTimers_.emplace(timerId, std::move(timer));
+    enqueueTimer(timerId, delay);
+    return timerId;
+}
 
+void WorkerRuntime::enqueueTimer(uint64_t timerId, std::chrono::milliseconds delay) {
+    // The task only names the timer: callbacks stay in activeTimers_, so
+    // nothing in the queue outlives the runtime or keeps itself alive
     Task task;
     task.type = TaskType::Timer;
     task.id = timerId;
-    task.execute = std::move(callback);
-
+    task.jobId = runningJob_;
+    task.execute = [this, timerId]() { fireTimer(timerId); };
     taskQueue_.enqueueDelayed(std::move(task), delay);
-    return timerId;
+}
+
+void WorkerRuntime::fireTimer(uint64_t timerId) {
+    if (!hermesRuntime_ || !running_.load()) return;
+
+    auto it = activeTimers_.find(timerId);
+    if (it == activeTimers_.end()) return;
+
+    // One-shot timers are done; intervals stay so they can be cleared from
+    // their own callback
+    ActiveTimer oneShot;
+    ActiveTimer* timer = &it->second;
+    if (!timer->repeating) {
+        oneShot = std::move(it->second);
+        activeTimers_.erase(it);
+        timer = &oneShot;
+    }
+
+    // Keep the callback alive even if the interval clears itself
+    std::shared_ptr<Value> jsCallback = timer->jsCallback;
+    std::function<void()> nativeCallback = timer->nativeCallback;
+    auto delay = timer->delay;
+    bool repeating = timer->repeating;
+
+    Runtime& rt = *hermesRuntime_;
+    try {
+        if (nativeCallback) {
+            nativeCallback();
+        } else if (jsCallback && jsCallback->isObject() && jsCallback->asObject(rt).isFunction(rt)) {
+            jsCallback->asObject(rt).asFunction(rt).call(rt);
+        }
+    } catch (const JSError& e) {
+        reportTaskError("JSError in timer: " + e.getMessage());
+    }
+
+    if (repeating && activeTimers_.count(timerId) > 0) {
+        enqueueTimer(timerId, delay);
+    }
+}
+
+uint64_t WorkerRuntime::setImmediate(std::shared_ptr<Value> callback) {
+    uint64_t immediateId = nextTimerId_++;
+    immediates_.emplace(immediateId, std::move(callback));
+
+    Task task;
+    task.type = TaskType::Immediate;
+    task.id = immediateId;
+    task.jobId = runningJob_;
+    task.execute = [this, immediateId]() { runImmediate(immediateId); };
+    taskQueue_.enqueueLocal(std::move(task));
+    return immediateId;
+}
+
+void WorkerRuntime::runImmediate(uint64_t immediateId) {
+    if (!hermesRuntime_ || !running_.load()) return;
+
+    auto it = immediates_.find(immediateId);
+    if (it == immediates_.end()) return; // Cleared
+
+    std::shared_ptr<Value> callback = std::move(it->second);
+    immediates_.erase(it);
+
+    Runtime& rt = *hermesRuntime_;
+    try {
+        callback->asObject(rt).asFunction(rt).call(rt);
+    } catch (const JSError& e) {
+        reportTaskError("JSError in immediate: " + e.getMessage());
+    }
 }
 
 void WorkerRuntime::cancelTimer(uint64_t timerId) {
-    {
-        std::lock_guard<std::mutex> lock(cancelledTimersMutex_);
-        cancelledTimers_.insert(timerId);
+    if (activeTimers_.erase(timerId) > 0) {
+        taskQueue_.cancel(timerId);
     }
-    taskQueue_.cancel(timerId);
+}
+
+void WorkerRuntime::collectGarbage() {
+    if (!running_.load() || gcRequested_.exchange(true)) return;
+
+    Task task;
+    task.type = TaskType::Message;
+    task.id = nextTaskId_++;
+    task.execute = [this]() {
+        gcRequested_ = false;
+        if (hermesRuntime_) {
+            hermesRuntime_->instrumentation().collectGarbage("memory pressure");
+        }
+    };
+    taskQueue_.enqueue(std::move(task));
+}
+
+void WorkerRuntime::setThreadOptions(ThreadOptions options) {
+    if (!running_.load()) return;
+
+    Task task;
+    task.type = TaskType::Message;
+    task.id = nextTaskId_++;
+    task.execute = [this, options = std::move(options)]() {
+        applyThreadOptions(options);
+        recordThreadOptions();
+    };
+    taskQueue_.enqueue(std::move(task));
 }
 
 void WorkerRuntime::requestClose() {
@@ -741,53 +1812,176 @@ void WorkerRuntime::requestClose() {
     taskQueue_.shutdown();
 }
 
-void WorkerRuntime::handlePostMessageToHost(const std::string& message) {
+void WorkerRuntime::cacheGlobalHandles() {
+    if (!hermesRuntime_) return;
+
+    try {
+        Runtime& runtime = *hermesRuntime_;
+        Object global = runtime.global();
+
+        handleMessageFunction_ = std::make_unique<Function>(
+            global.getPropertyAsFunction(runtime, "__handleMessage"));
+
+        // Captured before any user code runs, so replacing the globals later
+        // doesn't affect native code, just like a browser's intrinsics
+        promiseConstructor_ = std::make_unique<Function>(
+            global.getPropertyAsFunction(runtime, "Promise"));
+        jsonStringify_ = std::make_unique<Function>(
+            global.getPropertyAsObject(runtime, "JSON").getPropertyAsFunction(runtime, "stringify"));
+    } catch (const std::exception& e) {
+        if (errorCallback_) {
+            errorCallback_(workerId_, "Exception caching global functions: " + std::string(e.what()));
+        }
+    }
+}
+
+void WorkerRuntime::installAtomics() {
+    if (!hermesRuntime_) return;
+
+    try {
+        // Atomics.waitAsync promises are settled as tasks on this event loop
+        atomicsContext_ = AtomicsContext::install(*hermesRuntime_, true,
+            [this](std::function<void(Runtime&)> settle) {
+                Task task;
+                task.type = TaskType::Message;
+                task.id = nextTaskId_++;
+                task.execute = [this, settle = std::move(settle)]() {
+                    if (!hermesRuntime_) return;
+                    settle(*hermesRuntime_);
+                };
+                taskQueue_.enqueue(std::move(task));
+            });
+    } catch (const std::exception& e) {
+        if (errorCallback_) {
+            errorCallback_(workerId_, "Exception installing Atomics: " + std::string(e.what()));
+        }
+    }
+}
+
+void WorkerRuntime::installMessagePorts() {
+    if (!hermesRuntime_) return;
+
+    try {
+        portContext_ = MessagePortContext::install(*hermesRuntime_,
+            [this](std::function<void(Runtime&)> deliver) {
+                Task task;
+                task.id = nextTaskId_++;
+                task.execute = [this, deliver = std::move(deliver)]() {
+                    if (!hermesRuntime_) return;
+                    deliver(*hermesRuntime_);
+                };
+                // A port posting to its other end in this worker stays on the
+                // setImmediate lane, behind the immediates scheduled before it
+                if (tCurrentWorker == this) {
+                    task.type = TaskType::Immediate;
+                    task.jobId = runningJob_;
+                    taskQueue_.enqueueLocal(std::move(task));
+                } else {
+                    task.type = TaskType::Message;
+                    taskQueue_.enqueue(std::move(task));
+                }
+            });
+    } catch (const std::exception& e) {
+        if (errorCallback_) {
+            errorCallback_(workerId_, "Exception installing MessageChannel: " + std::string(e.what()));
+        }
+    }
+}
+
+void WorkerRuntime::handlePostMessageToHost(std::shared_ptr<SerializedMessage> message) {
+    WEBWORKER_TRACE_SECTION("WebWorker self.postMessage");
+    stats_.messageOut(message->data.size());
+    if (currentJob_ && runningJob_ == currentJob_ && jobCallback_) {
+        uint64_t jobId = *currentJob_;
+        currentJob_.reset();
+        jobCallback_(jobId, std::move(message), "");
+        return;
+    }
     if (messageCallback_) {
-        messageCallback_(workerId_, message);
+        messageCallback_(workerId_, std::move(message));
     }
 }
 
-void WorkerRuntime::handleConsoleLog(const std::string& level, const std::string& message) {
-    if (consoleCallback_) {
-        consoleCallback_(workerId_, level, message);
+void WorkerRuntime::handleConsoleLog(ConsoleLevel level, std::string message) {
+    if (consoleBuffer_) {
+        consoleLogger_->log(*consoleBuffer_, level, std::move(message));
     }
 }
 
-void WorkerRuntime::handleFetchResponse(const FetchResponse& response) {
+void WorkerRuntime::handleFetchResponse(FetchResponse response) {
     if (!running_.load()) return;
 
     Task task;
     task.type = TaskType::Message; // Reusing Message type for generic immediate execution
     task.id = nextTaskId_++;
     
-    // Copy response data to be captured by lambda
-    FetchResponse resp = response;
+    // Tasks must be copyable, share the response instead of its body
+    auto resp = std::make_shared<FetchResponse>(std::move(response));
+
+    // Registered right away, chunks may come before the task runs
+    std::shared_ptr<FetchStream> stream;
+    if (resp->streaming && resp->error.empty()) {
+        stream = std::make_shared<FetchStream>();
+        std::lock_guard<std::mutex> lock(fetchStreamsMutex_);
+        fetchStreams_[resp->requestId] = stream;
+        stats_.setStreamingFetches(fetchStreams_.size());
+    }
 
-    task.execute = [this, resp]() {
+    task.execute = [this, resp, stream]() {
         if (!hermesRuntime_) return;
         Runtime& rt = *hermesRuntime_;
 
-        auto it = pendingFetches_.find(resp.requestId);
+        auto it = pendingFetches_.find(resp->requestId);
         if (it == pendingFetches_.end()) {
+            if (stream) stream->cancel();
             return; // Request not found or already cancelled
         }
+        WEBWORKER_TRACE_ASYNC_END("WebWorker fetch", it->second.traceId);
+        // Answers the job that asked, and so does reading the body
+        auto jobId = it->second.jobId;
+        runningJob_ = jobId;
 
         auto resolve = it->second.resolve;
         auto reject = it->second.reject;
 
         try {
-            if (!resp.error.empty()) {
+            if (!resp->error.empty()) {
                 // Reject
                  if (reject->isObject() && reject->asObject(rt).isFunction(rt)) {
-                    reject->asObject(rt).asFunction(rt).call(rt, String::createFromUtf8(rt, resp.error));
+                    reject->asObject(rt).asFunction(rt).call(rt, String::createFromUtf8(rt, resp->error));
                 }
             } else {
                 // Resolve with HostObject
-                auto hostObject = std::make_shared<ResponseHostObject>(
-                    resp.status,
-                    resp.headers,
-                    resp.body
-                );
+                std::shared_ptr<ResponseHostObject> hostObject;
+                if (stream) {
+                    hostObject = std::make_shared<ResponseHostObject>(
+                        resp->status,
+                        std::move(resp->headers),
+                        stream,
+                        [this, jobId](std::function<void(Runtime&)> fn) {
+                            Task readTask;
+                            readTask.type = TaskType::Message;
+                            readTask.id = nextTaskId_++;
+                            readTask.jobId = jobId;
+                            readTask.execute = [this, fn]() {
+                                if (hermesRuntime_) fn(*hermesRuntime_);
+                            };
+                            taskQueue_.enqueue(std::move(readTask));
+                        }
+                    );
+
+                    streamedResponses_.erase(
+                        std::remove_if(streamedResponses_.begin(), streamedResponses_.end(),
+                                       [](const std::weak_ptr<ResponseHostObject>& weak) { return weak.expired(); }),
+                        streamedResponses_.end());
+                    streamedResponses_.push_back(hostObject);
+                } else {
+                    hostObject = std::make_shared<ResponseHostObject>(
+                        resp->status,
+                        std::move(resp->headers),
+                        std::move(resp->body)
+                    );
+                }
                 
                 Object responseObj = Object::createFromHostObject(rt, hostObject);
                 
@@ -800,24 +1994,42 @@ void WorkerRuntime::handleFetchResponse(const FetchResponse& response) {
         }
 
         pendingFetches_.erase(it);
+        stats_.setPendingFetches(pendingFetches_.size());
     };
 
     taskQueue_.enqueue(std::move(task));
 }
 
+bool WorkerRuntime::handleFetchChunk(FetchChunk chunk) {
+    std::shared_ptr<FetchStream> stream;
+    {
+        std::lock_guard<std::mutex> lock(fetchStreamsMutex_);
+        auto it = fetchStreams_.find(chunk.requestId);
+        if (it == fetchStreams_.end()) return false;
+        stream = it->second;
+    }
 
-bool WorkerRuntime::loadScript(const std::string& script) {
-    if (!running_.load() && !initialized_.load()) {
-        while (!initialized_.load()) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
-        }
+    bool wanted = chunk.data.empty() || stream->push(std::move(chunk.data));
+    if (chunk.done || !chunk.error.empty() || !wanted) {
+        // Finish before unregistering, so terminate() still finds and
+        // cancels the stream while it's in use
+        stream->finish(chunk.error);
+        std::lock_guard<std::mutex> lock(fetchStreamsMutex_);
+        fetchStreams_.erase(chunk.requestId);
+        stats_.setStreamingFetches(fetchStreams_.size());
     }
+    return wanted;
+}
+
+bool WorkerRuntime::loadScript(std::shared_ptr<const Buffer> script, std::shared_ptr<ScriptCache> cache) {
+    waitUntilInitialized();
 
     if (!running_.load()) return false;
 
     {
         std::lock_guard<std::mutex> lock(pendingScriptMutex_);
-        pendingScript_ = script;
+        pendingScript_ = std::move(script);
+        pendingScriptCache_ = std::move(cache);
         hasPendingScript_ = true;
         scriptExecuted_ = false;
     }
@@ -833,68 +2045,275 @@ bool WorkerRuntime::loadScript(const std::string& script) {
     return scriptExecuted_;
 }
 
-bool WorkerRuntime::postMessage(const std::string& message) {
+bool WorkerRuntime::postMessage(std::shared_ptr<SerializedMessage> message) {
+    return enqueueMessage(message->data.size(), [message](Runtime& runtime) {
+        return deserializeValue(runtime, *message);
+    });
+}
+
+bool WorkerRuntime::postMessage(const std::string& jsonMessage) {
+    return enqueueMessage(jsonMessage.size(), [jsonMessage](Runtime& runtime) -> Value {
+        try {
+            return Value::createFromJsonUtf8(
+                runtime,
+                reinterpret_cast<const uint8_t*>(jsonMessage.data()),
+                jsonMessage.size()
+            );
+        } catch (const JSIException&) {
+            // Not JSON, deliver the raw string
+            return String::createFromUtf8(runtime, jsonMessage);
+        }
+    });
+}
+
+bool WorkerRuntime::postJob(uint64_t jobId, std::shared_ptr<SerializedMessage> payload) {
+    size_t bytes = payload->data.size();
+    return enqueueMessage(bytes, [payload](Runtime& runtime) {
+        return deserializeValue(runtime, *payload);
+    }, jobId);
+}
+
+void WorkerRuntime::setJobCallback(JobCallback callback) {
+    jobCallback_ = std::move(callback);
+}
+
+bool WorkerRuntime::enqueueMessage(
+    size_t bytes,
+    std::function<Value(Runtime&)> decode,
+    std::optional<uint64_t> jobId
+) {
     if (!running_.load()) return false;
 
+    // From the sender's thread to the task picking the message up
+    uint64_t traceId = WEBWORKER_TRACE_NEW_ID();
+    WEBWORKER_TRACE_ASYNC_BEGIN("WebWorker postMessage", traceId);
+
     Task task;
     task.type = TaskType::Message;
     task.id = nextTaskId_++;
-    task.execute = [this, message]() {
+    task.jobId = jobId;
+    task.execute = [this, decode = std::move(decode), traceId, jobId]() {
+        WEBWORKER_TRACE_ASYNC_END("WebWorker postMessage", traceId);
         if (!hermesRuntime_ || !running_.load()) return;
+        if (!handleMessageFunction_) return;
         Runtime& runtime = *hermesRuntime_;
-        auto handleMessageProp = runtime.global().getProperty(runtime, "__handleMessage");
-        if (handleMessageProp.isObject() && handleMessageProp.asObject(runtime).isFunction(runtime)) {
-            handleMessageProp.asObject(runtime).asFunction(runtime).call(runtime, String::createFromUtf8(runtime, message));
-        }
+        if (jobId) currentJob_ = jobId;
+        Value returned = handleMessageFunction_->call(runtime, decode(runtime));
+        if (jobId) watchJobPromise(runtime, *jobId, returned);
     };
 
     taskQueue_.enqueue(std::move(task));
+    stats_.messageIn(bytes);
     return true;
 }
 
-std::string WorkerRuntime::evalScript(const std::string& script) {
-    if (!hermesRuntime_ || !running_.load()) throw std::runtime_error("Runtime not available");
+void WorkerRuntime::evalScript(const std::string& script, EvalCallback callback) {
+    enqueueWithCallback(std::move(callback), [this, script](EvalCallback callback) {
+        if (!hermesRuntime_ || !running_.load()) {
+            callback("", "Runtime not available");
+            return;
+        }
+        Runtime& runtime = *hermesRuntime_;
 
-    std::lock_guard<std::mutex> lock(runtimeMutex_);
-    Runtime& runtime = *hermesRuntime_;
+        std::string result;
+        try {
+            Value value = runtime.evaluateJavaScript(std::make_shared<StringBuffer>(script), "eval.js");
+            static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get())->drainMicrotasks();
+            result = stringifyResult(runtime, value);
+        } catch (const JSError& e) {
+            callback("", "JSError: " + e.getMessage());
+            return;
+        } catch (const std::exception& e) {
+            callback("", "Exception: " + std::string(e.what()));
+            return;
+        }
+        callback(result, "");
+    });
+}
+
+void WorkerRuntime::enqueueWithCallback(EvalCallback callback, std::function<void(EvalCallback)> run) {
+    uint64_t evalId = nextTaskId_++;
+    bool accepted = false;
+    {
+        std::lock_guard<std::mutex> lock(pendingEvalsMutex_);
+        if (running_.load() && !closeRequested_.load()) {
+            pendingEvals_[evalId] = callback;
+            accepted = true;
+        }
+    }
+    if (!accepted) {
+        callback("", "Runtime not available");
+        return;
+    }
+
+    Task task;
+    task.type = TaskType::Message;
+    task.id = evalId;
+    task.execute = [this, evalId, run = std::move(run)]() {
+        EvalCallback callback;
+        {
+            std::lock_guard<std::mutex> lock(pendingEvalsMutex_);
+            auto it = pendingEvals_.find(evalId);
+            if (it == pendingEvals_.end()) return;
+            callback = std::move(it->second);
+            pendingEvals_.erase(it);
+        }
+        run(std::move(callback));
+    };
+
+    taskQueue_.enqueue(std::move(task));
+}
+
+// ============================================================================
+// Sampling profiler
+// ============================================================================
+
+namespace {
+
+// Sampling is switched on for the whole process; registered runtimes are
+// the ones sampled. Count them so the last one to stop turns it off.
+std::mutex gProfilerMutex;
+size_t gProfiledRuntimes = 0;
+
+void retainSamplingProfiler() {
+    std::lock_guard<std::mutex> lock(gProfilerMutex);
+    if (gProfiledRuntimes++ == 0) {
+        facebook::hermes::HermesRuntime::enableSamplingProfiler();
+    }
+}
+
+void releaseSamplingProfiler() {
+    std::lock_guard<std::mutex> lock(gProfilerMutex);
+    if (gProfiledRuntimes > 0 && --gProfiledRuntimes == 0) {
+        facebook::hermes::HermesRuntime::disableSamplingProfiler();
+    }
+}
+
+} // namespace
+
+void WorkerRuntime::startProfiling(EvalCallback callback) {
+    enqueueWithCallback(std::move(callback), [this](EvalCallback callback) {
+        if (!hermesRuntime_) {
+            callback("", "Runtime not available");
+            return;
+        }
+        if (profiling_) {
+            callback("", "Worker is already being profiled");
+            return;
+        }
+
+        try {
+            // Samples this thread from now on
+            static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get())->registerForProfiling();
+            retainSamplingProfiler();
+        } catch (const std::exception& e) {
+            callback("", "Exception starting profiler: " + std::string(e.what()));
+            return;
+        }
+        profiling_ = true;
+        callback("", "");
+    });
+}
+
+void WorkerRuntime::stopProfiling(const std::string& path, EvalCallback callback) {
+    enqueueWithCallback(std::move(callback), [this, path](EvalCallback callback) {
+        if (!hermesRuntime_ || !profiling_) {
+            callback("", "Worker is not being profiled");
+            return;
+        }
+        auto* hermes = static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get());
+
+        std::string error;
+        try {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (out) hermes->sampledTraceToStreamInDevToolsFormat(out);
+            if (!out) error = "Could not write profile to " + path;
+        } catch (const std::exception& e) {
+            error = "Exception writing profile: " + std::string(e.what());
+        }
+        endProfiling();
+        callback(error.empty() ? path : "", error);
+    });
+}
 
+void WorkerRuntime::endProfiling() {
+    if (!profiling_) return;
+    profiling_ = false;
     try {
-        Value result = runtime.evaluateJavaScript(std::make_shared<StringBuffer>(script), "eval.js");
-        static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get())->drainMicrotasks();
-
-        if (result.isString()) return result.asString(runtime).utf8(runtime);
-        else if (result.isNumber()) {
-            double num = result.asNumber();
-            if (num == static_cast<int64_t>(num)) return std::to_string(static_cast<int64_t>(num));
-            return std::to_string(num);
-        } else if (result.isBool()) return result.getBool() ? "true" : "false";
-        else if (result.isNull()) return "null";
-        else if (result.isUndefined()) return "undefined";
-        else if (result.isObject()) {
-            try {
-                auto JSON = runtime.global().getPropertyAsObject(runtime, "JSON");
-                auto stringify = JSON.getPropertyAsFunction(runtime, "stringify");
-                auto stringified = stringify.call(runtime, result);
-                if (stringified.isString()) return stringified.asString(runtime).utf8(runtime);
-            } catch (...) {}
-            return "[object Object]";
-        }
-        return "[unknown]";
-    } catch (const JSError& e) {
-        throw std::runtime_error("JSError: " + e.getMessage());
+        static_cast<facebook::hermes::HermesRuntime*>(hermesRuntime_.get())->unregisterForProfiling();
+    } catch (const std::exception&) {
+        // The runtime goes away or stays unsampled either way
+    }
+    releaseSamplingProfiler();
+}
+
+std::string WorkerRuntime::stringifyResult(Runtime& runtime, const Value& result) {
+    if (result.isString()) return result.asString(runtime).utf8(runtime);
+    else if (result.isNumber()) {
+        double num = result.asNumber();
+        if (num == static_cast<int64_t>(num)) return std::to_string(static_cast<int64_t>(num));
+        return std::to_string(num);
+    } else if (result.isBool()) return result.getBool() ? "true" : "false";
+    else if (result.isNull()) return "null";
+    else if (result.isUndefined()) return "undefined";
+    else if (result.isObject()) {
+        if (!jsonStringify_) return "[object Object]";
+        try {
+            auto stringified = jsonStringify_->call(runtime, result);
+            if (stringified.isString()) return stringified.asString(runtime).utf8(runtime);
+        } catch (...) {}
+        return "[object Object]";
+    }
+    return "[unknown]";
+}
+
+void WorkerRuntime::failPendingEvals(const std::string& error) {
+    std::unordered_map<uint64_t, EvalCallback> evals;
+    {
+        std::lock_guard<std::mutex> lock(pendingEvalsMutex_);
+        evals.swap(pendingEvals_);
+    }
+    for (auto& pair : evals) {
+        pair.second("", error);
     }
 }
 
 void WorkerRuntime::terminate() {
     if (!running_.exchange(false)) return;
     closeRequested_ = true;
+    if (atomicsContext_) atomicsContext_->close();
+    if (portContext_) portContext_->close();
     taskQueue_.shutdown();
     pendingScriptCondition_.notify_all();
+    {
+        // Unblock downloads waiting for the reader
+        std::lock_guard<std::mutex> lock(fetchStreamsMutex_);
+        for (auto& pair : fetchStreams_) {
+            pair.second->cancel();
+        }
+        fetchStreams_.clear();
+        stats_.setStreamingFetches(0);
+    }
     if (workerThread_ && workerThread_->joinable()) workerThread_->join();
+    if (consoleLogger_) consoleLogger_->detach(consoleBuffer_);
     {
         std::lock_guard<std::mutex> lock(runtimeMutex_);
+        // Every JSI handle must go before the runtime that owns it
+        for (auto& weak : streamedResponses_) {
+            if (auto response = weak.lock()) response->release();
+        }
+        streamedResponses_.clear();
+        handleMessageFunction_.reset();
+        promiseConstructor_.reset();
+        jsonStringify_.reset();
+        activeTimers_.clear();
+        immediates_.clear();
+        pendingFetches_.clear();
+        stats_.setPendingFetches(0);
+        if (hermesRuntime_) endProfiling();
         hermesRuntime_.reset();
     }
+    failPendingEvals("Worker terminated");
 }
 
 } // namespace webworker
\ No newline at end of file
@@ -11,9 +11,23 @@
 #include <atomic>
 #include <functional>
 #include <queue>
+#include <deque>
+#include <vector>
+#include <optional>
 #include <condition_variable>
 
 #include "TaskQueue.h"
+#include "Atomics.h"
+#include "MessagePort.h"
+#include "WorkerThread.h"
+#include "ConsoleLogger.h"
+#include "DeliveryThread.h"
+#include "MappedBuffer.h"
+#include "ScriptCache.h"
+#include "WorkerRegistry.h"
+#include "WorkerStats.h"
+#include "StructuredClone.h"
+#include "networking/FetchCache.h"
 #include "networking/FetchTypes.h"
 
 namespace webworker {
@@ -21,32 +35,108 @@ namespace webworker {
 using namespace facebook::jsi;
 
 class WorkerRuntime;
+class WorkerPool;
+class FetchStream;
+class ResponseHostObject;
 
 /**
- * Callback type for messages sent from worker to host
+ * Callback type for messages sent from worker to host.
+ * The message is structured-cloned and is decoded in the host runtime.
  */
-using MessageCallback = std::function<void(const std::string& workerId, const std::string& message)>;
+using MessageCallback = std::function<void(const std::string& workerId, std::shared_ptr<SerializedMessage> message)>;
 
 /**
- * Callback type for console output from workers
+ * Callback type for worker errors
  */
-using ConsoleCallback = std::function<void(const std::string& workerId, const std::string& level, const std::string& message)>;
+using ErrorCallback = std::function<void(const std::string& workerId, const std::string& error)>;
 
 /**
- * Callback type for worker errors
+ * Callback type for WorkerPool jobs, see WorkerRuntime::postJob.
+ * `result` is null if the job failed with `error`.
  */
-using ErrorCallback = std::function<void(const std::string& workerId, const std::string& error)>;
+using JobCallback = std::function<void(uint64_t jobId, std::shared_ptr<SerializedMessage> result, const std::string& error)>;
 
 /**
  * Callback type for network requests
  */
 using FetchCallback = std::function<void(const std::string& workerId, const FetchRequest& request)>;
 
+/**
+ * Callback type for evalScript results.
+ * `error` is empty when the script ran, `result` holds its stringified value.
+ */
+using EvalCallback = std::function<void(const std::string& result, const std::string& error)>;
+
+/**
+ * Callback type for WorkerPool job completion.
+ * `result` is null and `error` is set when the job failed.
+ */
+using PoolResultCallback = std::function<void(const std::string& poolId,
+                                              uint64_t jobId,
+                                              std::shared_ptr<SerializedMessage> result,
+                                              const std::string& error)>;
+
+/**
+ * Hermes heap and thread settings for one worker. Zero sizes, GCMode::Default
+ * and default ThreadOptions keep the platform defaults.
+ */
+struct WorkerConfig {
+    enum class GCMode {
+        Default,
+        Compact,    // Return unused memory to the OS after every collection
+        Throughput, // Keep unused memory mapped for reuse
+    };
+
+    uint32_t maxHeapSizeMB{0};
+    uint32_t initialHeapSizeMB{0};
+    GCMode gcMode{GCMode::Default};
+
+    // Worker thread stack, fixed once the thread runs
+    uint32_t stackSizeKB{0};
+
+    // Applied when the worker starts, see WorkerRuntime::setThreadOptions
+    ThreadOptions thread;
+
+    /**
+     * True for the settings warm runtimes are built with. The thread
+     * options don't count: a warm runtime applies them right before it
+     * runs the script.
+     */
+    bool isDefault() const {
+        return maxHeapSizeMB == 0 && initialHeapSizeMB == 0 && gcMode == GCMode::Default &&
+               stackSizeKB == 0;
+    }
+
+    /**
+     * "compact" or "throughput"; anything else is GCMode::Default.
+     */
+    static GCMode parseGCMode(const std::string& name);
+};
+
+/**
+ * How hard the platform asks us to give memory back.
+ */
+enum class MemoryPressure {
+    Moderate, // Collect garbage in every worker
+    Critical, // Also drop the warm pool until the next createWorker, the
+              // fetch responses cached in memory and the compiled scripts
+};
+
 /**
  * WebWorkerCore - Platform-independent worker manager
  *
  * This is the shared C++ core that manages all web workers.
  * Both iOS and Android use this same implementation.
+ *
+ * Workers live in a WorkerRegistry under compact integer handles. Posting
+ * by handle is a wait-free lookup; string ids are mapped to handles under
+ * workersMutex_, which callers on hot paths resolve once with
+ * getWorkerHandle. No lock is held while talking to a worker, so a slow
+ * script in one worker never stalls calls to the others.
+ *
+ * Going the other way, errors and network requests from workers reach the
+ * platform callbacks through a DeliveryThread, and console output through
+ * a ConsoleLogger, never on the worker's own thread.
  */
 class WebWorkerCore {
 public:
@@ -54,35 +144,215 @@ public:
     ~WebWorkerCore();
 
     // Worker lifecycle
-    std::string createWorker(const std::string& workerId, const std::string& script);
+    std::string createWorker(const std::string& workerId,
+                             const std::string& script,
+                             const WorkerConfig& config = WorkerConfig());
+
+    /**
+     * Same as above with the script, source or Hermes bytecode, in a buffer
+     * that is used as is. Workers running identical scripts share one
+     * compiled copy.
+     */
+    std::string createWorker(const std::string& workerId,
+                             std::shared_ptr<const Buffer> script,
+                             const WorkerConfig& config = WorkerConfig());
+
+    /**
+     * Same as above with the script file at `path`, source or Hermes
+     * bytecode. Bytecode is mapped rather than read (see MappedBuffer).
+     * @throws std::runtime_error if the file can't be mapped
+     */
+    std::string createWorkerFromFile(const std::string& workerId,
+                                     const std::string& path,
+                                     const WorkerConfig& config = WorkerConfig());
     bool terminateWorker(const std::string& workerId);
     void terminateAll();
 
+    /**
+     * Resolve a worker id to its handle, 0 if there is no such worker.
+     * The handle stays valid, and unique, until the worker is terminated.
+     */
+    WorkerHandle getWorkerHandle(const std::string& workerId) const;
+
     // Communication
-    bool postMessage(const std::string& workerId, const std::string& message);
+    bool postMessage(WorkerHandle handle, std::shared_ptr<SerializedMessage> message);
+    bool postMessage(const std::string& workerId, std::shared_ptr<SerializedMessage> message);
+    bool postMessage(const std::string& workerId, const std::string& jsonMessage);
+
+    /**
+     * Run `script` as a task on the worker's event loop. `callback` is
+     * invoked on the worker thread, or right away if the worker is gone.
+     * Evaluations still pending when the worker terminates fail.
+     */
+    void evalScriptAsync(const std::string& workerId, const std::string& script, EvalCallback callback);
+
+    /**
+     * Blocking variant of evalScriptAsync. Only the calling thread waits.
+     * @throws std::runtime_error if the worker is missing or the script threw
+     */
     std::string evalScript(const std::string& workerId, const std::string& script);
 
+    // Profiling
+    /**
+     * Start the Hermes sampling profiler on the worker's thread. `callback`
+     * gets an empty error once it runs; it is invoked like evalScriptAsync's.
+     */
+    void startProfiling(const std::string& workerId, EvalCallback callback);
+
+    /**
+     * Stop profiling the worker and write the samples to `path` as a
+     * .cpuprofile (Chrome DevTools format). `callback` gets the path.
+     */
+    void stopProfiling(const std::string& workerId, const std::string& path, EvalCallback callback);
+
+    // Worker pools
+    /**
+     * Start a WorkerPool of `size` workers (0 = one per hardware thread).
+     * @return the number of workers started
+     * @throws std::runtime_error if the id is taken or a worker fails to start
+     */
+    size_t createPool(const std::string& poolId, const std::string& script, size_t size);
+    size_t createPool(const std::string& poolId, std::shared_ptr<const Buffer> script, size_t size);
+    size_t createPoolFromFile(const std::string& poolId, const std::string& path, size_t size);
+    bool submitPoolJob(const std::string& poolId, uint64_t jobId, std::shared_ptr<SerializedMessage> payload);
+    /** See WorkerPool::cancel. */
+    bool cancelPoolJob(const std::string& poolId, uint64_t jobId);
+    bool broadcastPool(const std::string& poolId, std::shared_ptr<SerializedMessage> message);
+    bool terminatePool(const std::string& poolId);
+
     // Callbacks
     void setMessageCallback(MessageCallback callback);
+    /**
+     * Console output is delivered from a logging thread, in batches, never
+     * on the worker's own thread.
+     */
     void setConsoleCallback(ConsoleCallback callback);
+
+    /**
+     * Drop console output below `minimum` inside the workers, before it's
+     * formatted. Defaults to ConsoleLevel::Log, everything.
+     */
+    void setConsoleLevel(ConsoleLevel minimum);
     void setErrorCallback(ErrorCallback callback);
+    /**
+     * Errors also go to the JSI binding, after the platform. Replaced, not
+     * chained, when the binding is installed again on a reload.
+     */
+    void setBindingErrorCallback(ErrorCallback callback);
     void setFetchCallback(FetchCallback callback);
+    void setPoolResultCallback(PoolResultCallback callback);
 
     // Networking
-    void handleFetchResponse(const std::string& workerId, const FetchResponse& response);
+    /**
+     * Deliver a response to a request made through the fetch callback.
+     * Requests may come from the shared FetchCache, under
+     * FetchCache::kWorkerId, rather than from a worker.
+     */
+    void handleFetchResponse(const std::string& workerId, FetchResponse response);
+
+    /**
+     * Hand over the next piece of a body announced with
+     * FetchResponse::streaming. Blocks while the worker is too far behind
+     * reading it, which is how the download is throttled.
+     * @return false if the body isn't wanted anymore; stop downloading
+     */
+    bool handleFetchChunk(const std::string& workerId, FetchChunk chunk);
+
+    /**
+     * Persist cacheable fetch responses in `path`, shared by all workers
+     * and kept across launches. Without it they are only cached in memory.
+     */
+    void setFetchCacheDirectory(const std::string& path);
+
+    /**
+     * Ask every live worker, pooled ones included, to collect garbage on its
+     * own thread. Safe to call from any thread; returns without waiting.
+     */
+    void onMemoryPressure(MemoryPressure level);
 
     // Query
     bool hasWorker(const std::string& workerId) const;
     bool isWorkerRunning(const std::string& workerId) const;
 
+    /**
+     * What the worker has been doing, read without stopping it.
+     * @return nullopt if there is no such worker
+     */
+    std::optional<WorkerStats> getWorkerStats(const std::string& workerId) const;
+
+    /**
+     * Time one task in `interval` in every worker, 0 to only count them.
+     * Defaults to WorkerStatsRecorder::kDefaultSampleInterval.
+     */
+    void setStatsSampleInterval(uint32_t interval);
+
+    /**
+     * Bytes of a streamed response body downloaded ahead of the reader, for
+     * responses from now on. Defaults to FetchStream::kDefaultHighWaterMark.
+     */
+    void setFetchHighWaterMark(size_t bytes);
+
+    /**
+     * Change the priority, CPU affinity or name of a worker's thread, e.g.
+     * to demote it while its screen is in the background. Takes effect
+     * once the worker is done with its current task.
+     * @return false if there is no such worker
+     */
+    bool setWorkerThreadOptions(const std::string& workerId, const ThreadOptions& options);
+
+    /**
+     * Keep up to `size` initialized, script-less runtimes ready in the
+     * background. createWorker takes one from the pool and only has to run the
+     * user script; the pool is refilled off the calling thread. 0 disables it.
+     * Callbacks should be set before the pool is enabled. Workers created
+     * with non-default heap or stack settings always get a fresh runtime.
+     */
+    void setWarmPoolSize(size_t size);
+    size_t getWarmPoolSize() const;
+
 private:
-    std::unordered_map<std::string, std::unique_ptr<WorkerRuntime>> workers_;
+    std::shared_ptr<WorkerRuntime> findWorker(const std::string& workerId) const;
+    std::unique_ptr<WorkerRuntime> takeWarmRuntime();
+    void clearWarmPool();
+    void warmPoolThreadMain();
+
+    // What workers report errors to: errorCallback_ and
+    // bindingErrorCallback_, on the delivery thread
+    ErrorCallback workerErrorCallback() const;
+
+    // Hand fetch results to the worker they're for
+    void deliverFetchResponse(const std::string& workerId, FetchResponse response);
+    bool deliverFetchChunk(const std::string& workerId, FetchChunk chunk);
+
+    WorkerRegistry registry_;
+    std::unordered_map<std::string, WorkerHandle> workerHandles_;
+    std::unordered_set<std::string> startingWorkers_; // Ids reserved by createWorker
     mutable std::mutex workersMutex_;
 
+    std::unordered_map<std::string, std::shared_ptr<WorkerPool>> pools_;
+    mutable std::mutex poolsMutex_;
+
+    // Warm pool
+    std::deque<std::unique_ptr<WorkerRuntime>> warmRuntimes_;
+    size_t warmPoolSize_{0};
+    bool warmPoolStopping_{false};
+    bool warmPoolSuspended_{false}; // Set by critical memory pressure
+    mutable std::mutex warmPoolMutex_;
+    std::condition_variable warmPoolCondition_;
+    std::thread warmPoolThread_;
+
     MessageCallback messageCallback_;
-    ConsoleCallback consoleCallback_;
+    std::shared_ptr<ConsoleLogger> consoleLogger_;
     ErrorCallback errorCallback_;
-    FetchCallback fetchCallback_;
+    ErrorCallback bindingErrorCallback_;
+    FetchCallback fetchCallback_; // What workers call, goes through fetchCache_
+    PoolResultCallback poolResultCallback_;
+
+    std::unique_ptr<FetchCache> fetchCache_;
+    std::shared_ptr<ScriptCache> scriptCache_;
+
+    // Declared last so it's destroyed first, once workers are gone
+    std::unique_ptr<DeliveryThread> delivery_;
 };
 
 /**
@@ -92,74 +362,171 @@ class WorkerRuntime {
 public:
     WorkerRuntime(const std::string& workerId,
                   MessageCallback messageCallback,
-                  ConsoleCallback consoleCallback,
+                  std::shared_ptr<ConsoleLogger> consoleLogger,
                   ErrorCallback errorCallback,
-                  FetchCallback fetchCallback);
+                  FetchCallback fetchCallback,
+                  const WorkerConfig& config = WorkerConfig());
     ~WorkerRuntime();
 
     // Script execution
-    bool loadScript(const std::string& script);
-    std::string evalScript(const std::string& script);
+    /**
+     * Run `script` once the runtime is up and wait for it. With a `cache`,
+     * the compiled script is shared with other workers running the same.
+     */
+    bool loadScript(std::shared_ptr<const Buffer> script, std::shared_ptr<ScriptCache> cache = nullptr);
+    void evalScript(const std::string& script, EvalCallback callback);
+
+    // Sampling profiler, see WebWorkerCore::startProfiling
+    void startProfiling(EvalCallback callback);
+    void stopProfiling(const std::string& path, EvalCallback callback);
 
     // Messaging
-    bool postMessage(const std::string& message);
+    bool postMessage(std::shared_ptr<SerializedMessage> message);
+    bool postMessage(const std::string& jsonMessage);
+
+    /**
+     * Post a WorkerPool job. Timers, immediates, local MessagePort messages
+     * and fetches started while a job's task runs belong to the job too,
+     * and so do the tasks they start in turn. The first message posted from
+     * the current job's tasks or their microtasks is its result, and goes
+     * to the job callback instead of the message callback. The job fails
+     * instead if one of those tasks throws first, or if `onmessage` returns
+     * a promise that rejects. Messages and errors from other tasks, such as
+     * a leftover timer of an earlier job, never settle it.
+     */
+    bool postJob(uint64_t jobId, std::shared_ptr<SerializedMessage> payload);
+    /** Set before the first postJob. */
+    void setJobCallback(JobCallback callback);
 
     // Networking
-    void handleFetchResponse(const FetchResponse& response);
+    void handleFetchResponse(FetchResponse response);
+    bool handleFetchChunk(FetchChunk chunk);
 
     // Lifecycle
     void terminate();
 
+    /**
+     * Run a full collection on the worker thread once the current task is
+     * done. Requests made while one is pending are merged.
+     */
+    void collectGarbage();
+
+    /**
+     * Apply `options` on the worker thread once the current task is done.
+     * Also used to adapt a pre-warmed runtime to its WorkerConfig.
+     */
+    void setThreadOptions(ThreadOptions options);
+
+    /**
+     * Give a pre-warmed runtime its identity and thread options. Must happen
+     * before loadScript; the options are applied right before the script
+     * runs.
+     */
+    void assignId(const std::string& workerId, ThreadOptions thread);
+
     // State
     const std::string& getId() const { return workerId_; }
     bool isRunning() const { return running_.load(); }
+    WorkerStats getStats() const;
 
 private:
     // Thread management
     void workerThreadMain();
+    void markInitialized();
+    void waitUntilInitialized();
+    void recordThreadOptions(); // Worker thread only, after applyThreadOptions
 
     // Event loop
     void eventLoop();
-    void processTask(Task& task);
+    void processTasks(std::vector<Task>& tasks);
+    void sampleHeap();
 
     // Runtime setup
     void setupGlobalScope();
     void installNativeFunctions();
     void installTimerFunctions();
+    void installAtomics();
+    void installMessagePorts();
+    void cacheGlobalHandles();
 
     // Message handling
-    void handlePostMessageToHost(const std::string& message);
-    void handleConsoleLog(const std::string& level, const std::string& message);
+    bool enqueueMessage(size_t bytes, std::function<Value(Runtime&)> decode,
+                        std::optional<uint64_t> jobId = std::nullopt);
+    void reportTaskError(const std::string& error);
+    void watchJobPromise(Runtime& runtime, uint64_t jobId, const Value& returned);
+    void failJob(uint64_t jobId, const std::string& error);
+    void handlePostMessageToHost(std::shared_ptr<SerializedMessage> message);
+    void handleConsoleLog(ConsoleLevel level, std::string message);
+
+    // Timer management (worker thread only)
+    struct ActiveTimer {
+        std::shared_ptr<Value> jsCallback;
+        std::function<void()> nativeCallback;
+        std::chrono::milliseconds delay{0};
+        bool repeating{false};
+    };
 
-    // Timer management
     uint64_t scheduleTimer(std::function<void()> callback,
                            std::chrono::milliseconds delay,
                            bool repeating);
+    uint64_t startTimer(ActiveTimer timer);
+    void enqueueTimer(uint64_t timerId, std::chrono::milliseconds delay);
+    void fireTimer(uint64_t timerId);
     void cancelTimer(uint64_t timerId);
 
+    // setImmediate (worker thread only)
+    uint64_t setImmediate(std::shared_ptr<Value> callback);
+    void runImmediate(uint64_t immediateId);
+
     // Close handling
     void requestClose();
 
+    // Eval support
+    std::string stringifyResult(Runtime& runtime, const Value& result);
+    void failPendingEvals(const std::string& error);
+
+    // Run `run` as a task, handing it `callback`; fails it on terminate instead
+    void enqueueWithCallback(EvalCallback callback, std::function<void(EvalCallback)> run);
+
+    // Stop sampling this runtime, worker thread (or terminate) only
+    void endProfiling();
+
     std::string workerId_;
+    WorkerConfig config_;
     std::unique_ptr<Runtime> hermesRuntime_;
-    std::unique_ptr<std::thread> workerThread_;
+    std::unique_ptr<WorkerThread> workerThread_;
     std::atomic<bool> running_{false};
     std::atomic<bool> initialized_{false};
     std::atomic<bool> closeRequested_{false};
+    std::atomic<bool> gcRequested_{false};
+    bool profiling_{false}; // Worker thread only
     std::mutex runtimeMutex_;
+    std::mutex initMutex_;
+    std::condition_variable initCondition_;
 
     // Task queue for event loop
     TaskQueue taskQueue_;
+
+    // Upper bound on tasks run under one runtimeMutex_ acquisition, so a
+    // flood of messages can't hold off evalScript for long
+    static constexpr size_t kMaxTaskBatch = 64;
+    std::vector<Task> taskBatch_; // Worker thread only
     std::atomic<uint64_t> nextTaskId_{1};
     std::atomic<uint64_t> nextTimerId_{1};
     std::atomic<uint64_t> nextRequestId_{1}; // For fetch requests
 
-    // Track cancelled timers
-    std::unordered_set<uint64_t> cancelledTimers_;
-    std::mutex cancelledTimersMutex_;
+    WorkerStatsRecorder stats_;
+
+    // Live timers by id; cleared timers are erased, so this stays bounded
+    std::unordered_map<uint64_t, ActiveTimer> activeTimers_;
+
+    // Pending setImmediate callbacks; clearImmediate just erases the entry
+    std::unordered_map<uint64_t, std::shared_ptr<Value>> immediates_;
 
     // Script to execute after initialization
-    std::string pendingScript_;
+    std::shared_ptr<const Buffer> pendingScript_;
+    std::shared_ptr<ScriptCache> pendingScriptCache_;
+    ThreadOptions pendingThreadOptions_; // From assignId
     std::mutex pendingScriptMutex_;
     std::condition_variable pendingScriptCondition_;
     bool hasPendingScript_{false};
@@ -167,16 +534,44 @@ private:
 
     // Callbacks
     MessageCallback messageCallback_;
-    ConsoleCallback consoleCallback_;
+    std::shared_ptr<ConsoleLogger> consoleLogger_;
+    std::shared_ptr<ConsoleBuffer> consoleBuffer_;
     ErrorCallback errorCallback_;
     FetchCallback fetchCallback_;
+    JobCallback jobCallback_;
+    std::optional<uint64_t> currentJob_; // Awaiting its result, worker thread only
+    std::optional<uint64_t> runningJob_; // Job of the task running right now
+
+    // Hot functions resolved once by cacheGlobalHandles (worker thread only)
+    std::unique_ptr<Function> handleMessageFunction_;
+    std::unique_ptr<Function> promiseConstructor_;
+    std::unique_ptr<Function> jsonStringify_;
+
+    // SharedArrayBuffer / Atomics, closed on terminate to wake Atomics.wait
+    std::shared_ptr<AtomicsContext> atomicsContext_;
+
+    // MessageChannel ports owned by this worker, closed on terminate
+    std::shared_ptr<MessagePortContext> portContext_;
+
+    // Evaluations queued on the event loop, failed on terminate
+    std::unordered_map<uint64_t, EvalCallback> pendingEvals_;
+    std::mutex pendingEvalsMutex_;
 
     // Fetch promises
     struct FetchPromise {
         std::shared_ptr<Value> resolve;
         std::shared_ptr<Value> reject;
+        uint64_t traceId{0}; // Trace interval until the response, 0 if none
+        std::optional<uint64_t> jobId; // Job that started it, see postJob
     };
     std::unordered_map<std::string, FetchPromise> pendingFetches_;
+
+    // Bodies still being downloaded, by request id
+    std::unordered_map<std::string, std::shared_ptr<FetchStream>> fetchStreams_;
+    std::mutex fetchStreamsMutex_;
+
+    // Streamed responses handed to JS, released before the runtime (worker thread only)
+    std::vector<std::weak_ptr<ResponseHostObject>> streamedResponses_;
 };
 
 } // namespace webworker
\ No newline at end of file
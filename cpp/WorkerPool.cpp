@@ -0,0 +1,245 @@
+#include "WorkerPool.h"
+
+#include <stdexcept>
+#include <thread>
+
+namespace webworker {
+
+WorkerPool::WorkerPool(
+    const std::string& poolId,
+    std::shared_ptr<const Buffer> script,
+    std::shared_ptr<ScriptCache> scriptCache,
+    size_t size,
+    std::shared_ptr<ConsoleLogger> consoleLogger,
+    ErrorCallback errorCallback,
+    FetchCallback fetchCallback,
+    PoolResultCallback resultCallback
+)
+    : poolId_(poolId)
+    , slots_(size > 0 ? size : defaultSize())
+    , errorCallback_(errorCallback)
+    , resultCallback_(resultCallback) {
+
+    // Runtime startup dominates pool creation, so start all workers at once
+    std::vector<std::thread> starters;
+    std::vector<char> started(slots_.size(), 0);
+    for (size_t i = 0; i < slots_.size(); i++) {
+        starters.emplace_back([&, i]() {
+            std::string workerId = poolId_ + "#" + std::to_string(i);
+            // Anything the worker posts besides job results is dropped
+            auto runtime = std::make_unique<WorkerRuntime>(
+                workerId,
+                nullptr,
+                consoleLogger,
+                errorCallback_,
+                fetchCallback
+            );
+            runtime->setJobCallback([this, i](uint64_t jobId, std::shared_ptr<SerializedMessage> result,
+                                              const std::string& error) {
+                onJobDone(i, jobId, std::move(result), error);
+            });
+            started[i] = runtime->loadScript(script, scriptCache);
+            slots_[i].runtime = std::move(runtime);
+        });
+    }
+    for (auto& starter : starters) {
+        starter.join();
+    }
+
+    for (size_t i = 0; i < slots_.size(); i++) {
+        if (!started[i]) {
+            terminate();
+            throw std::runtime_error("Failed to load script for pool: " + poolId_);
+        }
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    terminate();
+}
+
+size_t WorkerPool::defaultSize() {
+    unsigned int concurrency = std::thread::hardware_concurrency();
+    return concurrency > 0 ? concurrency : 1;
+}
+
+bool WorkerPool::submit(uint64_t jobId, std::shared_ptr<SerializedMessage> payload) {
+    std::vector<uint64_t> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (terminated_) return false;
+
+        // Prefer an idle worker, otherwise the shortest backlog, round-robin on ties
+        std::optional<size_t> target;
+        for (size_t n = 0; n < slots_.size(); n++) {
+            size_t i = (nextSlot_ + n) % slots_.size();
+            const Slot& slot = slots_[i];
+            if (slot.stopped) continue;
+            if (!slot.current && slot.jobs.empty()) {
+                target = i;
+                break;
+            }
+            if (!target || slot.jobs.size() < slots_[*target].jobs.size()) {
+                target = i;
+            }
+        }
+
+        if (target) {
+            nextSlot_ = (*target + 1) % slots_.size();
+            slots_[*target].jobs.push_back({jobId, std::move(payload)});
+            dispatchLocked(*target, failed);
+        } else {
+            failed.push_back(jobId);
+        }
+    }
+
+    reportFailed(failed);
+    return true;
+}
+
+bool WorkerPool::cancel(uint64_t jobId) {
+    std::vector<uint64_t> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (terminated_) return false;
+
+        bool found = false;
+        for (size_t i = 0; i < slots_.size() && !found; i++) {
+            Slot& slot = slots_[i];
+            if (slot.current == jobId) {
+                // The runtime drops the job's late result, see onJobDone
+                slot.current.reset();
+                dispatchLocked(i, failed);
+                found = true;
+                continue;
+            }
+            for (auto it = slot.jobs.begin(); it != slot.jobs.end(); ++it) {
+                if (it->id == jobId) {
+                    slot.jobs.erase(it);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) return false;
+    }
+
+    reportFailed(failed);
+    return true;
+}
+
+void WorkerPool::broadcast(std::shared_ptr<SerializedMessage> message) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (terminated_) return;
+
+    for (auto& slot : slots_) {
+        slot.runtime->postMessage(message);
+    }
+}
+
+void WorkerPool::collectGarbage() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (terminated_) return;
+
+    for (auto& slot : slots_) {
+        slot.runtime->collectGarbage();
+    }
+}
+
+void WorkerPool::dispatchLocked(size_t index, std::vector<uint64_t>& failed) {
+    Slot& slot = slots_[index];
+    if (terminated_ || slot.stopped || slot.current) return;
+
+    Job job;
+    if (!slot.jobs.empty()) {
+        job = std::move(slot.jobs.front());
+        slot.jobs.pop_front();
+    } else {
+        // Steal the most recently queued job of the longest backlog
+        Slot* victim = nullptr;
+        for (auto& other : slots_) {
+            if (!other.jobs.empty() && (!victim || other.jobs.size() > victim->jobs.size())) {
+                victim = &other;
+            }
+        }
+        if (!victim) return;
+
+        job = std::move(victim->jobs.back());
+        victim->jobs.pop_back();
+    }
+
+    slot.current = job.id;
+    if (!slot.runtime->postJob(job.id, std::move(job.payload))) {
+        // The runtime is gone: fail the job, the others steal its backlog
+        slot.current.reset();
+        slot.stopped = true;
+        failed.push_back(job.id);
+    }
+}
+
+void WorkerPool::onJobDone(
+    size_t index,
+    uint64_t jobId,
+    std::shared_ptr<SerializedMessage> result,
+    const std::string& error
+) {
+    std::vector<uint64_t> failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot& slot = slots_[index];
+        if (slot.current != jobId) return; // Abandoned by terminate() or cancel()
+
+        slot.current.reset();
+        dispatchLocked(index, failed);
+    }
+
+    if (resultCallback_) {
+        resultCallback_(poolId_, jobId, std::move(result), error);
+    }
+    reportFailed(failed);
+}
+
+void WorkerPool::reportFailed(const std::vector<uint64_t>& failed) {
+    if (!resultCallback_) return;
+    for (uint64_t jobId : failed) {
+        resultCallback_(poolId_, jobId, nullptr, "Pool worker is not running");
+    }
+}
+
+void WorkerPool::terminate() {
+    std::vector<uint64_t> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (terminated_) return;
+        terminated_ = true;
+
+        for (auto& slot : slots_) {
+            if (slot.current) abandoned.push_back(*slot.current);
+            slot.current.reset();
+            for (const auto& job : slot.jobs) abandoned.push_back(job.id);
+            slot.jobs.clear();
+        }
+    }
+
+    // Outside the lock: worker threads take it to report results
+    for (auto& slot : slots_) {
+        if (slot.runtime) slot.runtime->terminate();
+    }
+
+    if (resultCallback_) {
+        for (uint64_t jobId : abandoned) {
+            resultCallback_(poolId_, jobId, nullptr, "WorkerPool terminated");
+        }
+    }
+}
+
+WorkerRuntime* WorkerPool::findWorker(const std::string& workerId) const {
+    for (const auto& slot : slots_) {
+        if (slot.runtime && slot.runtime->getId() == workerId) {
+            return slot.runtime.get();
+        }
+    }
+    return nullptr;
+}
+
+} // namespace webworker
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "WebWorkerCore.h"
+
+namespace webworker {
+
+/**
+ * WorkerPool - A fixed set of identical workers processing a stream of jobs
+ *
+ * Every worker runs the same script. A job is delivered to the worker's
+ * `onmessage` like any message, and the first message the job's tasks post
+ * back completes it (see WorkerRuntime::postJob); further ones are dropped.
+ * A job fails if one of its tasks throws first or its async handler
+ * rejects; errors from other tasks are only reported. Each worker has
+ * exactly one job in flight, so its own TaskQueue stays free for timers and
+ * fetch completions. A job that never answers holds its worker until
+ * cancel() gives up on it.
+ *
+ * Jobs are spread over per-worker deques as they are submitted. A worker that
+ * finishes takes the next job from the front of its own deque, and once that
+ * runs dry it steals from the back of the longest other deque, so a slow job
+ * never leaves the rest of a backlog stuck behind it.
+ */
+class WorkerPool {
+public:
+    /**
+     * Start `size` workers (0 = one per hardware thread) running `script`.
+     * Workers start in parallel; this returns once all of them ran the script,
+     * which `scriptCache` lets them compile only once.
+     *
+     * @throws std::runtime_error if a worker fails to start
+     */
+    WorkerPool(const std::string& poolId,
+               std::shared_ptr<const Buffer> script,
+               std::shared_ptr<ScriptCache> scriptCache,
+               size_t size,
+               std::shared_ptr<ConsoleLogger> consoleLogger,
+               ErrorCallback errorCallback,
+               FetchCallback fetchCallback,
+               PoolResultCallback resultCallback);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /**
+     * Queue a job. Its result is reported through the PoolResultCallback.
+     * @return false if the pool was terminated
+     */
+    bool submit(uint64_t jobId, std::shared_ptr<SerializedMessage> payload);
+
+    /**
+     * Give up on a job: drop it if it's still queued, or free its worker
+     * for the next job if it's running. Whatever the job still posts is
+     * dropped, and no result is reported for it.
+     * @return false if the job already finished or isn't known
+     */
+    bool cancel(uint64_t jobId);
+
+    /**
+     * Post a message to every worker, outside of the job bookkeeping.
+     * Workers must not reply to it, a reply would complete their current job.
+     */
+    void broadcast(std::shared_ptr<SerializedMessage> message);
+
+    /**
+     * Stop every worker. Queued and running jobs fail with an error.
+     */
+    void terminate();
+
+    /**
+     * Ask every worker to collect garbage, see WorkerRuntime::collectGarbage.
+     */
+    void collectGarbage();
+
+    /**
+     * Find one of the pool's workers, for routing fetch responses.
+     */
+    WorkerRuntime* findWorker(const std::string& workerId) const;
+
+    size_t size() const { return slots_.size(); }
+
+    /**
+     * Number of workers used when no size is given.
+     */
+    static size_t defaultSize();
+
+private:
+    struct Job {
+        uint64_t id;
+        std::shared_ptr<SerializedMessage> payload;
+    };
+
+    struct Slot {
+        std::unique_ptr<WorkerRuntime> runtime;
+        std::deque<Job> jobs;            // Owner pops the front, thieves the back
+        std::optional<uint64_t> current; // Job running on the runtime
+        bool stopped{false};             // The runtime refused a job
+    };
+
+    // Called on the slot's worker thread
+    void onJobDone(size_t index, uint64_t jobId, std::shared_ptr<SerializedMessage> result,
+                   const std::string& error);
+
+    // Requires mutex_. Start the next job on `index` if it's idle; jobs the
+    // runtime refuses are added to `failed`.
+    void dispatchLocked(size_t index, std::vector<uint64_t>& failed);
+
+    // Without mutex_
+    void reportFailed(const std::vector<uint64_t>& failed);
+
+    std::string poolId_;
+    std::vector<Slot> slots_;
+    size_t nextSlot_{0};
+    bool terminated_{false};
+    mutable std::mutex mutex_;
+
+    ErrorCallback errorCallback_;
+    PoolResultCallback resultCallback_;
+};
+
+} // namespace webworker
@@ -0,0 +1,83 @@
+#include "WorkerRegistry.h"
+
+#include <thread>
+
+namespace webworker {
+
+WorkerRegistry::~WorkerRegistry() {
+    for (auto& chunk : chunks_) {
+        delete chunk.load();
+    }
+}
+
+WorkerRegistry::Slot* WorkerRegistry::slotFor(WorkerHandle handle) const {
+    if (handle == 0) return nullptr;
+    return slotAt(handle & kIndexMask);
+}
+
+WorkerRegistry::Slot* WorkerRegistry::slotAt(uint32_t index) const {
+    Chunk* chunk = chunks_[index / kChunkSize].load(std::memory_order_acquire);
+    return chunk ? &(*chunk)[index % kChunkSize] : nullptr;
+}
+
+WorkerHandle WorkerRegistry::insert(std::shared_ptr<WorkerRuntime> worker) {
+    std::lock_guard<std::mutex> lock(writerMutex_);
+
+    uint32_t index;
+    if (!freeSlots_.empty()) {
+        index = freeSlots_.back();
+        freeSlots_.pop_back();
+    } else {
+        if (slotCount_ > kIndexMask) return 0;
+        index = static_cast<uint32_t>(slotCount_++);
+
+        auto& chunk = chunks_[index / kChunkSize];
+        if (!chunk.load(std::memory_order_relaxed)) {
+            chunk.store(new Chunk(), std::memory_order_release);
+        }
+    }
+
+    Slot& slot = *slotAt(index);
+
+    // Skip generation 0 on wrap-around so no handle is ever 0
+    slot.generation = (slot.generation + 1) & (UINT32_MAX >> kIndexBits);
+    if (slot.generation == 0) slot.generation = 1;
+
+    WorkerHandle handle = (slot.generation << kIndexBits) | index;
+    slot.worker = std::move(worker);
+    slot.handle.store(handle);
+    return handle;
+}
+
+std::shared_ptr<WorkerRuntime> WorkerRegistry::remove(WorkerHandle handle) {
+    Slot* slot = slotFor(handle);
+    if (!slot) return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(writerMutex_);
+        if (slot->handle.load() != handle) return nullptr;
+        slot->handle.store(0);
+    }
+
+    // Readers that saw the handle before it was unpublished are still inside
+    while (slot->readers.load() > 0) {
+        std::this_thread::yield();
+    }
+
+    std::shared_ptr<WorkerRuntime> worker = std::move(slot->worker);
+
+    std::lock_guard<std::mutex> lock(writerMutex_);
+    freeSlots_.push_back(handle & kIndexMask);
+    return worker;
+}
+
+std::shared_ptr<WorkerRuntime> WorkerRegistry::find(WorkerHandle handle) const {
+    Slot* slot = slotFor(handle);
+    if (!slot) return nullptr;
+
+    ReadGuard guard(*slot);
+    if (slot->handle.load() != handle) return nullptr;
+    return slot->worker;
+}
+
+} // namespace webworker
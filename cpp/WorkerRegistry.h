@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace webworker {
+
+class WorkerRuntime;
+
+/**
+ * Compact worker handle. 0 is never a valid handle.
+ * The low bits select a registry slot, the high bits are the slot's
+ * generation, so a stale handle never reaches a newer worker.
+ */
+using WorkerHandle = uint32_t;
+
+/**
+ * WorkerRegistry - Handle-indexed table of live workers
+ *
+ * Lookups take no lock: a reader announces itself on the slot, checks the
+ * handle is still published and uses the worker in place. remove() first
+ * unpublishes the handle, then waits for the readers that got in before it,
+ * so a worker is never released under a reader. Insert and remove are rare
+ * and serialize on a writer mutex.
+ *
+ * Slots live in chunks that are allocated on demand and kept until the
+ * registry is destroyed, so a slot never moves while it is being read.
+ */
+class WorkerRegistry {
+public:
+    WorkerRegistry() = default;
+    ~WorkerRegistry();
+
+    WorkerRegistry(const WorkerRegistry&) = delete;
+    WorkerRegistry& operator=(const WorkerRegistry&) = delete;
+
+    /**
+     * Publish a worker.
+     * @return Its handle, or 0 if every slot is taken
+     */
+    WorkerHandle insert(std::shared_ptr<WorkerRuntime> worker);
+
+    /**
+     * Unpublish a worker and wait until no reader uses it anymore.
+     * @return The worker, or nullptr if the handle isn't live
+     */
+    std::shared_ptr<WorkerRuntime> remove(WorkerHandle handle);
+
+    /**
+     * Take a reference to a worker, for callers that hold on to it.
+     */
+    std::shared_ptr<WorkerRuntime> find(WorkerHandle handle) const;
+
+    /**
+     * Run `fn(WorkerRuntime&)` if the handle is live. Wait-free; `fn` must be
+     * short and must not remove workers.
+     * @return false if the handle isn't live
+     */
+    template <typename Fn>
+    bool withWorker(WorkerHandle handle, Fn&& fn) const {
+        Slot* slot = slotFor(handle);
+        if (!slot) return false;
+
+        ReadGuard guard(*slot);
+        if (slot->handle.load() != handle) return false;
+        fn(*slot->worker);
+        return true;
+    }
+
+private:
+    static constexpr uint32_t kIndexBits = 12;
+    static constexpr uint32_t kIndexMask = (1u << kIndexBits) - 1;
+    static constexpr size_t kChunkSize = 64;
+    static constexpr size_t kMaxChunks = (kIndexMask + 1) / kChunkSize;
+
+    struct Slot {
+        std::atomic<WorkerHandle> handle{0}; // Published handle, 0 when free
+        std::atomic<uint32_t> readers{0};
+        std::shared_ptr<WorkerRuntime> worker; // Written only while unpublished
+        uint32_t generation{0};                // Writer only
+    };
+
+    using Chunk = std::array<Slot, kChunkSize>;
+
+    struct ReadGuard {
+        explicit ReadGuard(Slot& slot) : slot_(slot) { slot_.readers.fetch_add(1); }
+        ~ReadGuard() { slot_.readers.fetch_sub(1); }
+        Slot& slot_;
+    };
+
+    Slot* slotFor(WorkerHandle handle) const;
+    Slot* slotAt(uint32_t index) const;
+
+    std::array<std::atomic<Chunk*>, kMaxChunks> chunks_{};
+    size_t slotCount_{0};            // Slots handed out so far, writer only
+    std::vector<uint32_t> freeSlots_; // Writer only
+    std::mutex writerMutex_;
+};
+
+} // namespace webworker
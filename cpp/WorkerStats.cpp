@@ -0,0 +1,132 @@
+#include "WorkerStats.h"
+
+#include <algorithm>
+
+namespace webworker {
+
+namespace {
+
+std::atomic<uint32_t> gSampleInterval{WorkerStatsRecorder::kDefaultSampleInterval};
+
+// Single writer: a load and a store instead of a locked increment
+inline void bump(std::atomic<uint64_t>& counter, uint64_t by = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// ============================================================================
+// LatencyHistogram
+// ============================================================================
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration) {
+    auto micros = static_cast<uint64_t>(
+        std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(duration).count()));
+
+    size_t bucket = 0;
+    for (uint64_t rest = micros; rest > 0 && bucket < kBuckets - 1; rest >>= 1) {
+        bucket++;
+    }
+
+    bump(buckets_[bucket]);
+    bump(totalMicros_, micros);
+    if (micros > maxMicros_.load(std::memory_order_relaxed)) {
+        maxMicros_.store(micros, std::memory_order_relaxed);
+    }
+    // Last, so a snapshot's count never runs ahead of its buckets by much
+    count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+    Snapshot result;
+    result.count = count_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < kBuckets; i++) {
+        result.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    result.totalMicros = totalMicros_.load(std::memory_order_relaxed);
+    result.maxMicros = maxMicros_.load(std::memory_order_relaxed);
+    return result;
+}
+
+uint64_t LatencyHistogram::Snapshot::percentile(double p) const {
+    uint64_t total = 0;
+    for (uint64_t bucket : buckets) total += bucket;
+    if (total == 0) return 0;
+
+    auto rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets - 1; i++) {
+        seen += buckets[i];
+        if (seen > rank) return std::min(uint64_t{1} << i, maxMicros);
+    }
+    return maxMicros;
+}
+
+// ============================================================================
+// WorkerStatsRecorder
+// ============================================================================
+
+void WorkerStatsRecorder::setSampleInterval(uint32_t interval) {
+    gSampleInterval.store(interval, std::memory_order_relaxed);
+}
+
+uint32_t WorkerStatsRecorder::sampleInterval() {
+    return gSampleInterval.load(std::memory_order_relaxed);
+}
+
+bool WorkerStatsRecorder::beginTask() {
+    uint64_t run = tasksRun_.load(std::memory_order_relaxed);
+    tasksRun_.store(run + 1, std::memory_order_relaxed);
+
+    uint32_t interval = sampleInterval();
+    return interval != 0 && run % interval == 0;
+}
+
+void WorkerStatsRecorder::recordTask(std::chrono::steady_clock::time_point queuedAt,
+                                     std::chrono::steady_clock::time_point started,
+                                     std::chrono::steady_clock::time_point executed,
+                                     std::chrono::steady_clock::time_point drained) {
+    taskLatency_.record(started - queuedAt);
+    taskDuration_.record(executed - started);
+    microtaskDrain_.record(drained - executed);
+}
+
+bool WorkerStatsRecorder::heapSampleDue(std::chrono::steady_clock::time_point now) const {
+    // heapSampledAt_ is only written by this same thread
+    return now - heapSampledAt_ >= kHeapSampleInterval;
+}
+
+void WorkerStatsRecorder::setHeap(std::unordered_map<std::string, int64_t> heap,
+                                  std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> lock(heapMutex_);
+    heap_ = std::move(heap);
+    heapSampledAt_ = now;
+}
+
+void WorkerStatsRecorder::setThread(std::string name, std::string priority) {
+    std::lock_guard<std::mutex> lock(heapMutex_);
+    threadName_ = std::move(name);
+    threadPriority_ = std::move(priority);
+}
+
+void WorkerStatsRecorder::snapshot(WorkerStats& stats) const {
+    stats.tasksRun = tasksRun_.load(std::memory_order_relaxed);
+    stats.taskLatency = taskLatency_.snapshot();
+    stats.taskDuration = taskDuration_.snapshot();
+    stats.microtaskDrain = microtaskDrain_.snapshot();
+
+    stats.messagesIn = messagesIn_.load(std::memory_order_relaxed);
+    stats.messagesOut = messagesOut_.load(std::memory_order_relaxed);
+    stats.bytesIn = bytesIn_.load(std::memory_order_relaxed);
+    stats.bytesOut = bytesOut_.load(std::memory_order_relaxed);
+
+    stats.pendingFetches = pendingFetches_.load(std::memory_order_relaxed);
+    stats.streamingFetches = streamingFetches_.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(heapMutex_);
+    stats.heap = heap_;
+    stats.threadName = threadName_;
+    stats.threadPriority = threadPriority_;
+}
+
+} // namespace webworker
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace webworker {
+
+/**
+ * LatencyHistogram - Durations in power-of-two microsecond buckets
+ *
+ * Bucket 0 counts anything under 1us, bucket i durations in
+ * [2^(i-1), 2^i) us, and the last bucket everything longer.
+ *
+ * One thread records, any thread may take a snapshot. Recording is a
+ * handful of relaxed stores, no read-modify-write.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t kBuckets = 24; // The last one starts at ~4.2s
+
+    struct Snapshot {
+        std::array<uint64_t, kBuckets> buckets{};
+        uint64_t count{0};
+        uint64_t totalMicros{0};
+        uint64_t maxMicros{0};
+
+        /** Upper bound of the bucket holding the `p` quantile (0..1), in us */
+        uint64_t percentile(double p) const;
+    };
+
+    /** Recording thread only */
+    void record(std::chrono::nanoseconds duration);
+
+    Snapshot snapshot() const;
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> totalMicros_{0};
+    std::atomic<uint64_t> maxMicros_{0};
+};
+
+/**
+ * What a worker has been doing, as returned by WebWorkerCore::getWorkerStats.
+ * Timings only cover the sampled tasks, see WorkerStatsRecorder.
+ */
+struct WorkerStats {
+    // Waiting in the TaskQueue right now
+    size_t immediateTasks{0}; // Messages, fetch results, evals
+    size_t localTasks{0};     // setImmediate, MessageChannel
+    size_t delayedTasks{0};   // Timers
+
+    uint64_t tasksRun{0};
+    LatencyHistogram::Snapshot taskLatency;   // Enqueued (or due) until started
+    LatencyHistogram::Snapshot taskDuration;  // The task itself
+    LatencyHistogram::Snapshot microtaskDrain; // Microtasks run after it
+
+    uint64_t messagesIn{0};
+    uint64_t messagesOut{0};
+    uint64_t bytesIn{0};
+    uint64_t bytesOut{0};
+
+    size_t pendingFetches{0};
+    size_t streamingFetches{0}; // Bodies still downloading
+
+    // Read back from the platform after the last change, see
+    // currentThreadOptions in WorkerThread.h
+    std::string threadName;
+    std::string threadPriority;
+
+    // Hermes heap, as of the last sample (instrumentation().getHeapInfo)
+    std::unordered_map<std::string, int64_t> heap;
+};
+
+/**
+ * WorkerStatsRecorder - The counters behind one worker's WorkerStats
+ *
+ * Message counters are bumped by whichever thread sends; everything else
+ * is written by the worker thread alone. Every counter can be read from
+ * any thread at any time, without stopping the worker.
+ *
+ * Counting is always on. Timing costs clock reads, so only one task in
+ * sampleInterval() is timed; 0 turns timing off.
+ */
+class WorkerStatsRecorder {
+public:
+    static constexpr uint32_t kDefaultSampleInterval = 1;
+
+    /** How often the heap is sampled, at most */
+    static constexpr std::chrono::milliseconds kHeapSampleInterval{1000};
+
+    /** Shared by every worker */
+    static void setSampleInterval(uint32_t interval);
+    static uint32_t sampleInterval();
+
+    void messageIn(size_t bytes) {
+        messagesIn_.fetch_add(1, std::memory_order_relaxed);
+        bytesIn_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void messageOut(size_t bytes) {
+        messagesOut_.fetch_add(1, std::memory_order_relaxed);
+        bytesOut_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Worker thread only
+
+    /** Count a task about to run. True if it should be timed. */
+    bool beginTask();
+
+    void recordTask(std::chrono::steady_clock::time_point queuedAt,
+                    std::chrono::steady_clock::time_point started,
+                    std::chrono::steady_clock::time_point executed,
+                    std::chrono::steady_clock::time_point drained);
+
+    void setPendingFetches(size_t count) { pendingFetches_.store(count, std::memory_order_relaxed); }
+
+    // Any thread, under the lock of the stream registry
+    void setStreamingFetches(size_t count) { streamingFetches_.store(count, std::memory_order_relaxed); }
+
+    /** True once kHeapSampleInterval passed since the last setHeap */
+    bool heapSampleDue(std::chrono::steady_clock::time_point now) const;
+    void setHeap(std::unordered_map<std::string, int64_t> heap, std::chrono::steady_clock::time_point now);
+
+    void setThread(std::string name, std::string priority);
+
+    /** Everything but the queue depths, which live in the TaskQueue */
+    void snapshot(WorkerStats& stats) const;
+
+private:
+    std::atomic<uint64_t> messagesIn_{0};
+    std::atomic<uint64_t> messagesOut_{0};
+    std::atomic<uint64_t> bytesIn_{0};
+    std::atomic<uint64_t> bytesOut_{0};
+
+    std::atomic<uint64_t> tasksRun_{0};
+    LatencyHistogram taskLatency_;
+    LatencyHistogram taskDuration_;
+    LatencyHistogram microtaskDrain_;
+
+    std::atomic<size_t> pendingFetches_{0};
+    std::atomic<size_t> streamingFetches_{0};
+
+    // Rarely written, a lock is fine
+    std::unordered_map<std::string, int64_t> heap_;
+    std::chrono::steady_clock::time_point heapSampledAt_{};
+    std::string threadName_;
+    std::string threadPriority_;
+    mutable std::mutex heapMutex_; // Also guards the thread fields
+};
+
+} // namespace webworker
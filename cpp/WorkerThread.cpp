@@ -0,0 +1,202 @@
+#include "WorkerThread.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <system_error>
+
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <pthread/qos.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace webworker {
+
+namespace {
+
+#if defined(__APPLE__)
+
+qos_class_t qosClass(ThreadOptions::Priority priority) {
+    switch (priority) {
+        case ThreadOptions::Priority::Background: return QOS_CLASS_BACKGROUND;
+        case ThreadOptions::Priority::Utility: return QOS_CLASS_UTILITY;
+        case ThreadOptions::Priority::UserInitiated: return QOS_CLASS_USER_INITIATED;
+        case ThreadOptions::Priority::UserInteractive: return QOS_CLASS_USER_INTERACTIVE;
+        case ThreadOptions::Priority::Default: break;
+    }
+    return QOS_CLASS_DEFAULT;
+}
+
+// MAXTHREADNAMESIZE, with the terminator
+constexpr size_t kMaxNameLength = 63;
+
+#elif defined(__linux__)
+
+// Android's THREAD_PRIORITY_* constants are nice values
+int niceValue(ThreadOptions::Priority priority) {
+    switch (priority) {
+        case ThreadOptions::Priority::Background: return 10;     // THREAD_PRIORITY_BACKGROUND
+        case ThreadOptions::Priority::Utility: return 5;
+        case ThreadOptions::Priority::UserInitiated: return -2;  // THREAD_PRIORITY_FOREGROUND
+        case ThreadOptions::Priority::UserInteractive: return -4; // THREAD_PRIORITY_DISPLAY
+        case ThreadOptions::Priority::Default: break;
+    }
+    return 0;
+}
+
+// TASK_COMM_LEN, with the terminator
+constexpr size_t kMaxNameLength = 15;
+
+#endif
+
+} // namespace
+
+ThreadOptions::Priority ThreadOptions::parsePriority(const std::string& name) {
+    if (name == "background") return Priority::Background;
+    if (name == "utility") return Priority::Utility;
+    if (name == "userInitiated") return Priority::UserInitiated;
+    if (name == "userInteractive") return Priority::UserInteractive;
+    return Priority::Default;
+}
+
+const char* ThreadOptions::priorityName(Priority priority) {
+    switch (priority) {
+        case Priority::Background: return "background";
+        case Priority::Utility: return "utility";
+        case Priority::UserInitiated: return "userInitiated";
+        case Priority::UserInteractive: return "userInteractive";
+        case Priority::Default: break;
+    }
+    return "default";
+}
+
+bool setThreadName(const std::string& name) {
+#if defined(__APPLE__)
+    return pthread_setname_np(name.substr(0, kMaxNameLength).c_str()) == 0;
+#elif defined(__linux__)
+    return pthread_setname_np(pthread_self(), name.substr(0, kMaxNameLength).c_str()) == 0;
+#else
+    return false;
+#endif
+}
+
+bool applyThreadOptions(const ThreadOptions& options) {
+    bool applied = options.name.empty() || setThreadName(options.name);
+
+#if defined(__APPLE__)
+    applied &= pthread_set_qos_class_self_np(qosClass(options.priority), 0) == 0;
+#elif defined(__linux__)
+    // Per thread on Linux, which is what this wants. Android lets apps raise
+    // their threads above the default, desktop Linux may need privileges.
+    auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    applied &= setpriority(PRIO_PROCESS, tid, niceValue(options.priority)) == 0;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    long cores = std::min<long>(sysconf(_SC_NPROCESSORS_CONF), CPU_SETSIZE);
+    for (long core = 0; core < cores; core++) {
+        if (options.cpuAffinityMask == 0 || (core < 64 && (options.cpuAffinityMask >> core) & 1)) {
+            CPU_SET(core, &cpus);
+        }
+    }
+    applied &= sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+    applied &= options.priority == ThreadOptions::Priority::Default && options.cpuAffinityMask == 0;
+#endif
+
+    return applied;
+}
+
+ThreadOptions currentThreadOptions() {
+    ThreadOptions options;
+#if defined(__APPLE__)
+    char name[kMaxNameLength + 1] = {};
+    if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) {
+        options.name = name;
+    }
+#elif defined(__linux__)
+    // pthread_getname_np needs API 26 on Android
+    char name[kMaxNameLength + 1] = {};
+    if (prctl(PR_GET_NAME, name) == 0) {
+        options.name = name;
+    }
+#endif
+
+    [[maybe_unused]] constexpr ThreadOptions::Priority kPriorities[] = {
+        ThreadOptions::Priority::Background,
+        ThreadOptions::Priority::Utility,
+        ThreadOptions::Priority::UserInitiated,
+        ThreadOptions::Priority::UserInteractive,
+    };
+#if defined(__APPLE__)
+    qos_class_t current = qos_class_self();
+    for (auto priority : kPriorities) {
+        if (qosClass(priority) == current) options.priority = priority;
+    }
+#elif defined(__linux__)
+    // -1 is also a valid nice value, errno tells them apart
+    auto tid = static_cast<id_t>(syscall(SYS_gettid));
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, tid);
+    if (errno == 0) {
+        for (auto priority : kPriorities) {
+            if (niceValue(priority) == nice) options.priority = priority;
+        }
+    }
+#endif
+
+    return options;
+}
+
+// ============================================================================
+// WorkerThread
+// ============================================================================
+
+WorkerThread::WorkerThread(size_t stackSize, std::function<void()> body)
+    : body_(std::move(body)) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+
+    if (stackSize > 0) {
+        // Darwin rejects sizes that aren't a multiple of the page size
+        auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        stackSize = std::max<size_t>(stackSize, PTHREAD_STACK_MIN);
+        stackSize = (stackSize + page - 1) / page * page;
+        pthread_attr_setstacksize(&attributes, stackSize);
+    }
+
+    int error = pthread_create(&thread_, &attributes, &WorkerThread::threadMain, this);
+    pthread_attr_destroy(&attributes);
+    if (error != 0) {
+        throw std::system_error(error, std::generic_category(), "Cannot start worker thread");
+    }
+    joinable_ = true;
+}
+
+WorkerThread::~WorkerThread() {
+    if (joinable_) {
+        join();
+    }
+}
+
+void WorkerThread::join() {
+    if (!joinable_) {
+        throw std::system_error(std::make_error_code(std::errc::invalid_argument),
+                                "Worker thread is not joinable");
+    }
+    pthread_join(thread_, nullptr);
+    joinable_ = false;
+}
+
+void* WorkerThread::threadMain(void* self) {
+    static_cast<WorkerThread*>(self)->body_();
+    return nullptr;
+}
+
+} // namespace webworker
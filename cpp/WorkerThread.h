@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <pthread.h>
+
+namespace webworker {
+
+/**
+ * Scheduling settings of a worker thread that can change while it runs.
+ * The defaults leave the thread as the platform created it.
+ */
+struct ThreadOptions {
+    /**
+     * iOS QoS classes. Android maps them to nice values between
+     * THREAD_PRIORITY_BACKGROUND and THREAD_PRIORITY_DISPLAY.
+     */
+    enum class Priority {
+        Default,
+        Background,      // Prefetching, indexing: may only get the little cores
+        Utility,         // Long-running work the user isn't waiting on
+        UserInitiated,   // Results the user is waiting for
+        UserInteractive, // Frame-critical work
+    };
+
+    Priority priority{Priority::Default};
+
+    // Bit n allows core n, 0 allows every core. Ignored on iOS, which has
+    // no affinity API: use the priority to keep work off the big cores.
+    uint64_t cpuAffinityMask{0};
+
+    // Shown by profilers and debuggers, truncated to 15 bytes on Android.
+    // Empty keeps the current name.
+    std::string name;
+
+    bool isDefault() const {
+        return priority == Priority::Default && cpuAffinityMask == 0 && name.empty();
+    }
+
+    /**
+     * "background", "utility", "userInitiated" or "userInteractive";
+     * anything else is Priority::Default.
+     */
+    static Priority parsePriority(const std::string& name);
+
+    /** The inverse of parsePriority, "default" for Priority::Default */
+    static const char* priorityName(Priority priority);
+};
+
+/** Name the calling thread, see ThreadOptions::name. */
+bool setThreadName(const std::string& name);
+
+/**
+ * Apply `options` to the calling thread, Priority::Default and an empty mask
+ * resetting what an earlier call changed. iOS only sets a thread's QoS
+ * class from the thread itself, so neither platform does it from outside.
+ *
+ * @return false if the platform refused part of it, e.g. a mask naming
+ *         no online core. The rest is still applied.
+ */
+bool applyThreadOptions(const ThreadOptions& options);
+
+/**
+ * Read the calling thread's name and priority back from the platform, to
+ * see what applyThreadOptions actually did. A priority that matches no
+ * Priority reads as Default; the affinity mask is always 0.
+ */
+ThreadOptions currentThreadOptions();
+
+/**
+ * WorkerThread - A joinable thread with a chosen stack size
+ *
+ * Same as std::thread, which has no way to set the stack size.
+ */
+class WorkerThread {
+public:
+    /**
+     * Start running `body`.
+     * @param stackSize In bytes, rounded up to whole pages; 0 for the
+     *                  platform default
+     * @throws std::system_error if the thread can't be created
+     */
+    WorkerThread(size_t stackSize, std::function<void()> body);
+
+    /** Joins the thread if that didn't happen yet. */
+    ~WorkerThread();
+
+    WorkerThread(const WorkerThread&) = delete;
+    WorkerThread& operator=(const WorkerThread&) = delete;
+
+    bool joinable() const { return joinable_; }
+    void join();
+
+private:
+    static void* threadMain(void* self);
+
+    std::function<void()> body_;
+    pthread_t thread_{};
+    bool joinable_{false};
+};
+
+} // namespace webworker
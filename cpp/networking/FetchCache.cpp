@@ -0,0 +1,673 @@
+#include "FetchCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+namespace webworker {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char* kDiskMagic = "WWFC1";
+constexpr size_t kMaxDiskString = 1 << 20;
+
+int64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+std::string toLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+std::string trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t");
+    if (start == std::string::npos) return "";
+    size_t end = value.find_last_not_of(" \t");
+    return value.substr(start, end - start + 1);
+}
+
+// Header names are case-insensitive and platforms disagree on their case
+const std::string* findHeader(const FetchCache::Headers& headers, const char* name) {
+    for (const auto& pair : headers) {
+        if (toLower(pair.first) == name) return &pair.second;
+    }
+    return nullptr;
+}
+
+std::string headerValue(const FetchCache::Headers& headers, const char* name) {
+    const std::string* value = findHeader(headers, name);
+    return value ? *value : "";
+}
+
+struct CacheControl {
+    bool noStore{false};
+    bool noCache{false};
+    int64_t maxAge{-1};
+};
+
+CacheControl parseCacheControl(const std::string& value) {
+    CacheControl result;
+    size_t start = 0;
+    while (start <= value.size()) {
+        size_t end = value.find(',', start);
+        if (end == std::string::npos) end = value.size();
+        std::string directive = toLower(trim(value.substr(start, end - start)));
+
+        if (directive == "no-store") {
+            result.noStore = true;
+        } else if (directive == "no-cache") {
+            result.noCache = true;
+        } else if (directive.compare(0, 8, "max-age=") == 0) {
+            std::string seconds = directive.substr(8);
+            seconds.erase(std::remove(seconds.begin(), seconds.end(), '"'), seconds.end());
+            char* parsedEnd = nullptr;
+            long long parsed = std::strtoll(seconds.c_str(), &parsedEnd, 10);
+            if (parsedEnd != seconds.c_str() && parsed >= 0) result.maxAge = parsed;
+        }
+        start = end + 1;
+    }
+    return result;
+}
+
+uint64_t fnv1a(const std::string& value) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : value) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void writeString(std::ostream& out, const std::string& value) {
+    out << value.size() << '\n';
+    out.write(value.data(), static_cast<std::streamsize>(value.size()));
+}
+
+bool readString(std::istream& in, std::string& value) {
+    size_t size = 0;
+    if (!(in >> size) || in.get() != '\n' || size > kMaxDiskString) return false;
+    value.resize(size);
+    return size == 0 || in.read(&value[0], static_cast<std::streamsize>(size));
+}
+
+template <typename T>
+bool readNumber(std::istream& in, T& value) {
+    return (in >> value) && in.get() == '\n';
+}
+
+} // namespace
+
+FetchCache::FetchCache(ResponseSink deliverResponse, ChunkSink deliverChunk)
+    : deliverResponse_(std::move(deliverResponse))
+    , deliverChunk_(std::move(deliverChunk)) {
+}
+
+void FetchCache::setFetcher(Fetcher fetcher) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fetcher_ = std::move(fetcher);
+}
+
+void FetchCache::setDirectory(const std::string& path, size_t maxBytes) {
+    if (!path.empty()) {
+        io_.post([path]() {
+            std::error_code error;
+            fs::create_directories(path, error);
+        });
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = path;
+    diskBudget_ = maxBytes;
+}
+
+void FetchCache::trimMemory() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    memory_.clear();
+    memoryBytes_ = 0;
+}
+
+// ============================================================================
+// Policy
+// ============================================================================
+
+bool FetchCache::isCacheable(const FetchRequest& request) {
+    if (toLower(request.method) != "get" || !request.body.empty()) return false;
+    if (request.cache == "no-store") return false;
+
+    // The caller manages these itself
+    static const char* const kBypass[] = {
+        "range", "if-none-match", "if-modified-since", "if-match", "if-unmodified-since", "if-range",
+    };
+    for (const auto& pair : request.headers) {
+        std::string name = toLower(pair.first);
+        for (const char* bypass : kBypass) {
+            if (name == bypass) return false;
+        }
+        if (name == "cache-control" && parseCacheControl(pair.second).noStore) return false;
+    }
+    return true;
+}
+
+std::string FetchCache::cacheKey(const FetchRequest& request) {
+    std::map<std::string, std::string> headers;
+    for (const auto& pair : request.headers) {
+        headers[toLower(pair.first)] = pair.second;
+    }
+
+    std::string key = request.redirect + " " + request.url + "\n";
+    for (const auto& pair : headers) {
+        key += pair.first + ": " + pair.second + "\n";
+    }
+    return key;
+}
+
+bool FetchCache::isFresh(const Entry& entry, int64_t now) {
+    if (entry.noCache || entry.maxAge < 0) return false;
+    return now - entry.storedAt < entry.maxAge * 1000;
+}
+
+bool FetchCache::describe(Entry& entry, int status, Headers headers) {
+    entry.status = status;
+    entry.headers = std::move(headers);
+    entry.storedAt = nowMs();
+    entry.etag = headerValue(entry.headers, "etag");
+    entry.lastModified = headerValue(entry.headers, "last-modified");
+
+    CacheControl control = parseCacheControl(headerValue(entry.headers, "cache-control"));
+    entry.noCache = control.noCache;
+    entry.maxAge = control.maxAge;
+    if (entry.maxAge > 0) {
+        // Time already spent in caches upstream
+        long long age = std::atoll(headerValue(entry.headers, "age").c_str());
+        entry.maxAge = std::max<int64_t>(0, entry.maxAge - age);
+    }
+
+    if (status != 200 || control.noStore) return false;
+
+    // Only responses that don't vary by anything but compression
+    const std::string* vary = findHeader(entry.headers, "vary");
+    if (vary && !vary->empty() && toLower(trim(*vary)) != "accept-encoding") return false;
+
+    return entry.maxAge >= 0 || !entry.etag.empty() || !entry.lastModified.empty();
+}
+
+FetchResponse FetchCache::responseFrom(const Entry& entry, const std::string& requestId) {
+    FetchResponse response;
+    response.requestId = requestId;
+    response.status = entry.status;
+    response.headers = entry.headers;
+    response.body = entry.body.share();
+    return response;
+}
+
+// ============================================================================
+// Requests
+// ============================================================================
+
+void FetchCache::fetch(const std::string& workerId, const FetchRequest& request) {
+    Fetcher fetcher;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fetcher = fetcher_;
+    }
+    if (!fetcher) return;
+
+    if (!isCacheable(request)) {
+        fetcher(workerId, request);
+        return;
+    }
+
+    std::string key = cacheKey(request);
+    if (request.cache == "reload") {
+        fetchWith(workerId, request, key, nullptr, fetcher);
+        return;
+    }
+
+    std::shared_ptr<Entry> entry = lookup(key);
+    std::string directory;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        directory = directory_;
+    }
+    if (entry || directory.empty()) {
+        fetchWith(workerId, request, key, std::move(entry), fetcher);
+        return;
+    }
+
+    // Continue on the I/O thread rather than read the disk on a JS thread.
+    // Cacheable requests have no body, so everything else is copied.
+    auto copy = std::make_shared<FetchRequest>();
+    copy->requestId = request.requestId;
+    copy->url = request.url;
+    copy->method = request.method;
+    copy->headers = request.headers;
+    copy->timeout = request.timeout;
+    copy->redirect = request.redirect;
+    copy->cache = request.cache;
+    io_.post([this, workerId, copy, key, directory, fetcher]() {
+        // An identical request queued ahead of this one may have loaded it
+        auto entry = lookup(key);
+        if (!entry) {
+            entry = readFromDisk(directory, key);
+            if (entry) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                remember(entry);
+            }
+        }
+        fetchWith(workerId, *copy, key, std::move(entry), fetcher);
+    });
+}
+
+void FetchCache::fetchWith(
+    const std::string& workerId,
+    const FetchRequest& request,
+    const std::string& key,
+    std::shared_ptr<Entry> entry,
+    const Fetcher& fetcher
+) {
+    if (entry) {
+        bool anyAge = request.cache == "force-cache" || request.cache == "only-if-cached";
+        bool usable = anyAge || (request.cache != "no-cache" && isFresh(*entry, nowMs()));
+        if (usable) {
+            deliverResponse_(workerId, responseFrom(*entry, request.requestId));
+            return;
+        }
+        if (entry->etag.empty() && entry->lastModified.empty()) {
+            entry.reset();
+        }
+    }
+    if (request.cache == "only-if-cached") {
+        deliverError({{workerId, request.requestId}}, "only-if-cached: no cached response for " + request.url);
+        return;
+    }
+
+    FetchRequest outgoing;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = joinable_.find(key);
+        if (it != joinable_.end()) {
+            it->second->waiters.push_back({workerId, request.requestId});
+            return;
+        }
+
+        auto flight = std::make_shared<Flight>();
+        flight->key = key;
+        flight->waiters.push_back({workerId, request.requestId});
+        flight->stale = entry;
+
+        outgoing.requestId = "cache-" + std::to_string(nextRequestId_++);
+        joinable_[key] = flight;
+        flights_[outgoing.requestId] = flight;
+    }
+
+    outgoing.url = request.url;
+    outgoing.method = request.method;
+    outgoing.headers = request.headers;
+    outgoing.timeout = request.timeout;
+    outgoing.redirect = request.redirect;
+    outgoing.cache = request.cache;
+    if (entry) {
+        if (!entry->etag.empty()) outgoing.headers["If-None-Match"] = entry->etag;
+        if (!entry->lastModified.empty()) outgoing.headers["If-Modified-Since"] = entry->lastModified;
+    }
+
+    fetcher(kWorkerId, outgoing);
+}
+
+void FetchCache::handleResponse(FetchResponse response) {
+    std::shared_ptr<Flight> flight;
+    std::vector<Waiter> waiters;
+    bool revalidated = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = flights_.find(response.requestId);
+        if (it == flights_.end()) return;
+        flight = it->second;
+
+        // From here on the flight is only touched on this thread
+        auto joinable = joinable_.find(flight->key);
+        if (joinable != joinable_.end() && joinable->second == flight) {
+            joinable_.erase(joinable);
+        }
+        waiters = flight->waiters;
+
+        revalidated = response.error.empty() && response.status == 304 && flight->stale;
+        // The 304's body, if any, is refused in handleChunk
+        if (!response.streaming || !response.error.empty() || revalidated) {
+            flights_.erase(it);
+        }
+    }
+
+    if (!response.error.empty()) {
+        deliverError(waiters, response.error);
+        return;
+    }
+
+    if (revalidated) {
+        // Still good: keep the body, take the new headers and freshness
+        auto entry = std::make_shared<Entry>();
+        entry->key = flight->key;
+        entry->body = flight->stale->body.share();
+        Headers headers = flight->stale->headers;
+        for (auto& pair : response.headers) {
+            if (toLower(pair.first) == "content-length") continue;
+            for (auto it = headers.begin(); it != headers.end(); ++it) {
+                if (toLower(it->first) == toLower(pair.first)) {
+                    headers.erase(it);
+                    break;
+                }
+            }
+            headers[pair.first] = pair.second;
+        }
+        bool storable = describe(*entry, flight->stale->status, std::move(headers));
+
+        for (const auto& waiter : waiters) {
+            deliverResponse_(waiter.workerId, responseFrom(*entry, waiter.requestId));
+        }
+        if (storable) store(entry);
+        return;
+    }
+
+    if (!response.streaming) {
+        auto entry = std::make_shared<Entry>();
+        entry->key = flight->key;
+        entry->body = std::move(response.body);
+        bool storable = describe(*entry, response.status, std::move(response.headers))
+            && entry->body.size() <= kMaxEntrySize;
+
+        for (const auto& waiter : waiters) {
+            deliverResponse_(waiter.workerId, responseFrom(*entry, waiter.requestId));
+        }
+        if (storable) store(entry);
+        return;
+    }
+
+    // Streaming: pass the head on now, the body as it arrives
+    Entry head;
+    flight->storable = describe(head, response.status, response.headers);
+    const std::string* length = findHeader(response.headers, "content-length");
+    if (length && std::strtoull(length->c_str(), nullptr, 10) > kMaxEntrySize) {
+        flight->storable = false;
+    }
+    flight->status = response.status;
+    flight->headers = std::move(response.headers);
+
+    for (const auto& waiter : waiters) {
+        FetchResponse copy;
+        copy.requestId = waiter.requestId;
+        copy.status = flight->status;
+        copy.headers = flight->headers;
+        copy.streaming = true;
+        deliverResponse_(waiter.workerId, std::move(copy));
+    }
+}
+
+bool FetchCache::handleChunk(FetchChunk chunk) {
+    std::shared_ptr<Flight> flight;
+    bool last = chunk.done || !chunk.error.empty();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = flights_.find(chunk.requestId);
+        if (it == flights_.end()) return false;
+        flight = it->second;
+        if (last) flights_.erase(it);
+    }
+
+    if (flight->storable && !chunk.data.empty()) {
+        flight->size += chunk.data.size();
+        if (flight->size > kMaxEntrySize) {
+            flight->storable = false;
+            flight->chunks.clear();
+        } else {
+            flight->chunks.push_back(chunk.data.share());
+        }
+    }
+
+    // Every waiter gets the same bytes; one that stops reading drops out
+    std::vector<Waiter> remaining;
+    for (const auto& waiter : flight->waiters) {
+        FetchChunk piece;
+        piece.requestId = waiter.requestId;
+        piece.data = chunk.data.share();
+        piece.done = chunk.done;
+        piece.error = chunk.error;
+        if (deliverChunk_(waiter.workerId, std::move(piece))) {
+            remaining.push_back(waiter);
+        }
+    }
+    flight->waiters = std::move(remaining);
+
+    if (last) {
+        if (chunk.error.empty() && flight->storable) {
+            auto entry = std::make_shared<Entry>();
+            entry->key = flight->key;
+            if (flight->chunks.size() == 1) {
+                entry->body = std::move(flight->chunks.front());
+            } else {
+                std::vector<uint8_t> bytes;
+                bytes.reserve(flight->size);
+                for (const auto& piece : flight->chunks) {
+                    bytes.insert(bytes.end(), piece.data(), piece.data() + piece.size());
+                }
+                entry->body = FetchBody(std::move(bytes));
+            }
+            flight->chunks.clear();
+            describe(*entry, flight->status, std::move(flight->headers));
+            store(entry);
+        }
+        return true;
+    }
+
+    if (flight->waiters.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flights_.erase(chunk.requestId);
+        return false;
+    }
+    return true;
+}
+
+void FetchCache::deliverError(const std::vector<Waiter>& waiters, const std::string& error) {
+    for (const auto& waiter : waiters) {
+        FetchResponse response;
+        response.requestId = waiter.requestId;
+        response.status = 0;
+        response.error = error;
+        deliverResponse_(waiter.workerId, std::move(response));
+    }
+}
+
+// ============================================================================
+// Storage
+// ============================================================================
+
+std::shared_ptr<FetchCache::Entry> FetchCache::lookup(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = memory_.find(key);
+    if (it == memory_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return *it->second;
+}
+
+void FetchCache::store(std::shared_ptr<Entry> entry) {
+    std::string directory;
+    size_t budget;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        remember(entry);
+        directory = directory_;
+        budget = diskBudget_;
+    }
+    if (!directory.empty()) {
+        // Entries are immutable once stored, the body is shared
+        io_.post([this, directory, budget, entry]() {
+            writeToDisk(directory, budget, *entry);
+        });
+    }
+}
+
+void FetchCache::remember(std::shared_ptr<Entry> entry) {
+    auto it = memory_.find(entry->key);
+    if (it != memory_.end()) {
+        memoryBytes_ -= (*it->second)->body.size();
+        lru_.erase(it->second);
+        memory_.erase(it);
+    }
+
+    // One entry shouldn't push out everything else
+    if (entry->body.size() > memoryBudget_ / 4) return;
+
+    lru_.push_front(entry);
+    memory_[entry->key] = lru_.begin();
+    memoryBytes_ += entry->body.size();
+
+    while (memoryBytes_ > memoryBudget_ && !lru_.empty()) {
+        auto& oldest = lru_.back();
+        memoryBytes_ -= oldest->body.size();
+        memory_.erase(oldest->key);
+        lru_.pop_back();
+    }
+}
+
+std::string FetchCache::pathFor(const std::string& directory, const std::string& key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.entry", static_cast<unsigned long long>(fnv1a(key)));
+    return (fs::path(directory) / name).string();
+}
+
+// File layout: magic, numbers one per line, then length-prefixed strings
+// (key, validators, headers) and the body
+std::shared_ptr<FetchCache::Entry> FetchCache::readFromDisk(const std::string& directory,
+                                                            const std::string& key) const {
+    std::ifstream in(pathFor(directory, key), std::ios::binary);
+    if (!in) return nullptr;
+
+    auto entry = std::make_shared<Entry>();
+    std::string magic;
+    int noCache = 0;
+    size_t headerCount = 0;
+    size_t bodySize = 0;
+    if (!std::getline(in, magic) || magic != kDiskMagic) return nullptr;
+    if (!readString(in, entry->key) || entry->key != key) return nullptr; // Hash collision
+    if (!readNumber(in, entry->status) || !readNumber(in, entry->storedAt) ||
+        !readNumber(in, entry->maxAge) || !readNumber(in, noCache) ||
+        !readString(in, entry->etag) || !readString(in, entry->lastModified) ||
+        !readNumber(in, headerCount)) {
+        return nullptr;
+    }
+    entry->noCache = noCache != 0;
+
+    for (size_t i = 0; i < headerCount; i++) {
+        std::string name;
+        std::string value;
+        if (!readString(in, name) || !readString(in, value)) return nullptr;
+        entry->headers[name] = value;
+    }
+
+    if (!readNumber(in, bodySize) || bodySize > kMaxEntrySize) return nullptr;
+    std::vector<uint8_t> body(bodySize);
+    if (bodySize > 0 && !in.read(reinterpret_cast<char*>(body.data()), static_cast<std::streamsize>(bodySize))) {
+        return nullptr;
+    }
+    entry->body = FetchBody(std::move(body));
+    return entry;
+}
+
+void FetchCache::writeToDisk(const std::string& directory, size_t budget, const Entry& entry) {
+    std::string path = pathFor(directory, entry.key);
+    // Written aside and renamed, readers never see half an entry
+    std::string temp = path + "." + std::to_string(nextRequestId_++) + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) return;
+
+        out << kDiskMagic << '\n';
+        writeString(out, entry.key);
+        out << entry.status << '\n' << entry.storedAt << '\n' << entry.maxAge << '\n'
+            << (entry.noCache ? 1 : 0) << '\n';
+        writeString(out, entry.etag);
+        writeString(out, entry.lastModified);
+        out << entry.headers.size() << '\n';
+        for (const auto& pair : entry.headers) {
+            writeString(out, pair.first);
+            writeString(out, pair.second);
+        }
+        out << entry.body.size() << '\n';
+        out.write(reinterpret_cast<const char*>(entry.body.data()), static_cast<std::streamsize>(entry.body.size()));
+        if (!out) {
+            out.close();
+            std::error_code error;
+            fs::remove(temp, error);
+            return;
+        }
+    }
+
+    if (directory != diskDirectory_) {
+        scanDisk(directory);
+    }
+
+    std::error_code error;
+    uintmax_t replaced = fs::file_size(path, error);
+    if (error) replaced = 0;
+    fs::rename(temp, path, error);
+    if (error) {
+        fs::remove(temp, error);
+        return;
+    }
+    uintmax_t written = fs::file_size(path, error);
+    diskBytes_ = diskBytes_ - std::min(diskBytes_, replaced) + (error ? 0 : written);
+
+    if (diskBytes_ > budget) {
+        evictFromDisk(directory, budget);
+    }
+}
+
+void FetchCache::scanDisk(const std::string& directory) {
+    diskDirectory_ = directory;
+    diskBytes_ = 0;
+
+    std::error_code error;
+    for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() != ".entry") continue;
+        std::error_code fileError;
+        uintmax_t size = it->file_size(fileError);
+        if (!fileError) diskBytes_ += size;
+    }
+}
+
+void FetchCache::evictFromDisk(const std::string& directory, size_t budget) {
+    // Least recently written entries go first, down to 3/4 of the budget so
+    // the next few stores don't list the directory again
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    uintmax_t total = 0;
+    std::error_code error;
+    for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        if (it->path().extension() != ".entry") continue;
+        std::error_code fileError;
+        uintmax_t size = it->file_size(fileError);
+        if (fileError) continue;
+        total += size;
+        files.emplace_back(it->last_write_time(fileError), it->path());
+    }
+
+    uintmax_t target = budget / 4 * 3;
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files) {
+        if (total <= target) break;
+        std::error_code fileError;
+        uintmax_t size = fs::file_size(file.second, fileError);
+        if (fs::remove(file.second, fileError) && !fileError) total -= size;
+    }
+    diskBytes_ = total;
+}
+
+} // namespace webworker
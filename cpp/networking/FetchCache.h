@@ -0,0 +1,172 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "DeliveryThread.h"
+#include "FetchTypes.h"
+
+namespace webworker {
+
+/**
+ * FetchCache - HTTP cache and request coalescing shared by all workers
+ *
+ * Sits between the workers' fetch() and the platform. Requests that can't
+ * be cached (anything but a plain GET, conditional or range requests,
+ * `cache: 'no-store'`) go straight through. For the others:
+ *
+ * - A fresh cached response (max-age) is answered right away, without
+ *   touching the network.
+ * - A stale one with an ETag or Last-Modified is revalidated; a 304 answers
+ *   with the cached body.
+ * - An identical request still waiting for its response head joins that
+ *   request instead of starting another. Its timeout is the first one's.
+ *
+ * The cache makes its own platform requests, under kWorkerId, and fans the
+ * response out to everyone waiting. Bodies and chunks are shared between
+ * them and the cache, not copied.
+ *
+ * Entries live in memory (LRU, bounded) and, once setDirectory() was
+ * called, on disk so they outlive the app process. The disk is only touched
+ * on the cache's own I/O thread: a request missing memory continues there,
+ * and stores are written there after the waiters were answered.
+ *
+ * Thread-safe. fetch() runs on worker threads, handleResponse/handleChunk
+ * on whichever thread the platform delivers on. Responses may be delivered
+ * from any of them or the I/O thread.
+ */
+class FetchCache {
+public:
+    using Headers = std::unordered_map<std::string, std::string>;
+    using Fetcher = std::function<void(const std::string& workerId, const FetchRequest& request)>;
+    using ResponseSink = std::function<void(const std::string& workerId, FetchResponse response)>;
+    using ChunkSink = std::function<bool(const std::string& workerId, FetchChunk chunk)>;
+
+    /** Worker id the cache's own requests are made under */
+    static constexpr const char* kWorkerId = "#fetch-cache";
+
+    static constexpr size_t kDefaultMemoryBudget = 32 << 20;
+    static constexpr size_t kDefaultDiskBudget = 64 << 20;
+
+    /** Larger bodies are passed through but not kept */
+    static constexpr size_t kMaxEntrySize = 8 << 20;
+
+    /**
+     * @param deliverResponse hands a response to a worker
+     * @param deliverChunk hands a body chunk to a worker, false if unwanted
+     */
+    FetchCache(ResponseSink deliverResponse, ChunkSink deliverChunk);
+
+    FetchCache(const FetchCache&) = delete;
+    FetchCache& operator=(const FetchCache&) = delete;
+
+    /** The platform's fetch, used for misses and pass-through requests */
+    void setFetcher(Fetcher fetcher);
+
+    /**
+     * Keep entries in `path` as well, up to `maxBytes`. The directory is
+     * created if needed; an empty path turns the disk cache off.
+     */
+    void setDirectory(const std::string& path, size_t maxBytes = kDefaultDiskBudget);
+
+    /** Drop the in-memory entries. The disk cache is kept. */
+    void trimMemory();
+
+    /** Answer `request` for `workerId`, from the cache or the network */
+    void fetch(const std::string& workerId, const FetchRequest& request);
+
+    // Platform side, for responses to kWorkerId
+    void handleResponse(FetchResponse response);
+    bool handleChunk(FetchChunk chunk);
+
+private:
+    struct Entry {
+        std::string key;
+        int status{0};
+        Headers headers;
+        FetchBody body;
+        int64_t storedAt{0}; // Wall clock ms, entries survive restarts
+        int64_t maxAge{-1};  // Seconds, -1 if the response gave none
+        bool noCache{false};
+        std::string etag;
+        std::string lastModified;
+    };
+
+    struct Waiter {
+        std::string workerId;
+        std::string requestId;
+    };
+
+    // A request the cache has in flight
+    struct Flight {
+        std::string key;
+        std::vector<Waiter> waiters;
+        std::shared_ptr<Entry> stale; // Being revalidated
+
+        // The body collected for storing, once the head arrived
+        int status{0};
+        Headers headers;
+        bool storable{false};
+        std::vector<FetchBody> chunks;
+        size_t size{0};
+    };
+
+    static bool isCacheable(const FetchRequest& request);
+    static std::string cacheKey(const FetchRequest& request);
+    static bool isFresh(const Entry& entry, int64_t now);
+
+    // Fill in status/headers/freshness. False if the response can't be stored.
+    static bool describe(Entry& entry, int status, Headers headers);
+
+    static FetchResponse responseFrom(const Entry& entry, const std::string& requestId);
+
+    // From the memory cache, or null
+    std::shared_ptr<Entry> lookup(const std::string& key);
+    // Answer from `entry` (may be null) or start a request, see fetch()
+    void fetchWith(const std::string& workerId, const FetchRequest& request, const std::string& key,
+                   std::shared_ptr<Entry> entry, const Fetcher& fetcher);
+    void store(std::shared_ptr<Entry> entry);
+    void remember(std::shared_ptr<Entry> entry); // Memory only, needs mutex_
+    void deliverError(const std::vector<Waiter>& waiters, const std::string& error);
+
+    // Disk cache, I/O thread only
+    std::string pathFor(const std::string& directory, const std::string& key) const;
+    std::shared_ptr<Entry> readFromDisk(const std::string& directory, const std::string& key) const;
+    void writeToDisk(const std::string& directory, size_t budget, const Entry& entry);
+    void scanDisk(const std::string& directory);
+    void evictFromDisk(const std::string& directory, size_t budget);
+
+    ResponseSink deliverResponse_;
+    ChunkSink deliverChunk_;
+    Fetcher fetcher_;
+
+    std::list<std::shared_ptr<Entry>> lru_; // Most recently used first
+    std::unordered_map<std::string, std::list<std::shared_ptr<Entry>>::iterator> memory_;
+    size_t memoryBytes_{0};
+    size_t memoryBudget_{kDefaultMemoryBudget};
+
+    std::string directory_;
+    size_t diskBudget_{kDefaultDiskBudget};
+
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights_;  // By our request id
+    std::unordered_map<std::string, std::shared_ptr<Flight>> joinable_; // By key, until the head arrives
+    std::atomic<uint64_t> nextRequestId_{1};
+    std::mutex mutex_;
+
+    // Running size of the .entry files in diskDirectory_, so stores don't
+    // list the directory until it's over budget. I/O thread only.
+    std::string diskDirectory_;
+    uintmax_t diskBytes_{0};
+
+    // Last, so queued reads and writes finish before the rest goes away
+    DeliveryThread io_;
+};
+
+} // namespace webworker
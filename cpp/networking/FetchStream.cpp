@@ -0,0 +1,89 @@
+#include "FetchStream.h"
+
+namespace webworker {
+
+namespace {
+
+std::atomic<size_t> gDefaultHighWaterMark{FetchStream::kDefaultHighWaterMark};
+
+} // namespace
+
+void FetchStream::setDefaultHighWaterMark(size_t bytes) {
+    // 0 would block push() for good
+    gDefaultHighWaterMark.store(bytes > 0 ? bytes : 1, std::memory_order_relaxed);
+}
+
+size_t FetchStream::defaultHighWaterMark() {
+    return gDefaultHighWaterMark.load(std::memory_order_relaxed);
+}
+
+bool FetchStream::push(FetchBody chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this] { return cancelled_ || buffered_ < highWaterMark_; });
+    if (cancelled_ || finished_) return !cancelled_;
+    if (chunk.empty()) return true;
+
+    buffered_ += chunk.size();
+    chunks_.push_back(std::move(chunk));
+
+    // Called under the lock so that cancel() can't return while it runs
+    if (notify_) {
+        auto notify = std::move(notify_);
+        notify_ = nullptr;
+        notify();
+    }
+    return true;
+}
+
+void FetchStream::finish(const std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_ || cancelled_) return;
+
+    finished_ = true;
+    error_ = error;
+    if (notify_) {
+        auto notify = std::move(notify_);
+        notify_ = nullptr;
+        notify();
+    }
+}
+
+FetchStream::Read FetchStream::read() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!chunks_.empty()) {
+        Read result{State::Data, std::move(chunks_.front()), ""};
+        chunks_.pop_front();
+        buffered_ -= result.data.size();
+        drained_.notify_all();
+        return result;
+    }
+    if (cancelled_) return {State::Done, FetchBody(), ""};
+    if (finished_) {
+        return error_.empty() ? Read{State::Done, FetchBody(), ""} : Read{State::Error, FetchBody(), error_};
+    }
+    return {State::Pending, FetchBody(), ""};
+}
+
+void FetchStream::notifyWhenReadable(std::function<void()> notify) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (readableLocked()) {
+        notify_ = nullptr;
+        notify();
+        return;
+    }
+    notify_ = std::move(notify);
+}
+
+void FetchStream::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancelled_ = true;
+        chunks_.clear();
+        buffered_ = 0;
+        notify_ = nullptr;
+    }
+    drained_.notify_all();
+}
+
+} // namespace webworker
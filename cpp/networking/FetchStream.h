@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include "FetchTypes.h"
+
+namespace webworker {
+
+/**
+ * FetchStream - Response body handed over from the network in chunks
+ *
+ * The platform pushes chunks as they arrive; the worker reads them from its
+ * own thread. push() blocks while more than `highWaterMark` bytes are
+ * waiting to be read, so a slow reader holds back the download instead of
+ * buffering all of it.
+ *
+ * The reader never blocks: read() returns State::Pending when nothing is
+ * buffered yet, and notifyWhenReadable() arranges a one-shot callback, made
+ * on the producer's thread, for when that changes.
+ */
+class FetchStream {
+public:
+    static constexpr size_t kDefaultHighWaterMark = 1 << 20;
+
+    /** For streams created from now on, shared by every worker. At least 1. */
+    static void setDefaultHighWaterMark(size_t bytes);
+    static size_t defaultHighWaterMark();
+
+    explicit FetchStream(size_t highWaterMark = defaultHighWaterMark())
+        : highWaterMark_(highWaterMark) {}
+
+    FetchStream(const FetchStream&) = delete;
+    FetchStream& operator=(const FetchStream&) = delete;
+
+    // Producer side
+
+    /**
+     * Append a chunk, waiting while the reader is behind.
+     * @return false once the stream was cancelled; stop downloading then
+     */
+    bool push(FetchBody chunk);
+
+    /**
+     * End the stream, with an error if `error` is not empty.
+     */
+    void finish(const std::string& error = "");
+
+    // Consumer side
+
+    enum class State {
+        Pending, // Nothing buffered yet
+        Data,
+        Done,
+        Error,
+    };
+
+    struct Read {
+        State state;
+        FetchBody data;
+        std::string error;
+    };
+
+    /**
+     * Take the next chunk, or report why there is none.
+     */
+    Read read();
+
+    /**
+     * Call `notify` once the next read() would not be Pending. Runs right
+     * away if that's already the case. Replaces an earlier request.
+     */
+    void notifyWhenReadable(std::function<void()> notify);
+
+    /**
+     * Drop buffered data and make push() fail. Pending notifications are
+     * discarded, so the consumer may go away after this returns.
+     */
+    void cancel();
+
+private:
+    bool readableLocked() const {
+        return !chunks_.empty() || finished_ || cancelled_;
+    }
+
+    const size_t highWaterMark_;
+    std::deque<FetchBody> chunks_;
+    size_t buffered_{0};
+    bool finished_{false};
+    bool cancelled_{false};
+    std::string error_;
+    std::function<void()> notify_;
+    std::mutex mutex_;
+    std::condition_variable drained_;
+};
+
+} // namespace webworker
@@ -1,27 +1,87 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 namespace webworker {
 
+/**
+ * FetchBody - Bytes of a request or response body
+ *
+ * Move-only handle on reference-counted storage, so a body goes from the
+ * network layer to JS without being copied on the way. share() hands out
+ * another reference explicitly, for readers that need the same bytes.
+ */
+class FetchBody {
+public:
+    FetchBody() = default;
+    explicit FetchBody(std::vector<uint8_t> bytes)
+        : bytes_(std::make_shared<std::vector<uint8_t>>(std::move(bytes))) {}
+    FetchBody(const uint8_t* data, size_t size)
+        : FetchBody(std::vector<uint8_t>(data, data + size)) {}
+
+    FetchBody(FetchBody&&) noexcept = default;
+    FetchBody& operator=(FetchBody&&) noexcept = default;
+    FetchBody(const FetchBody&) = delete;
+    FetchBody& operator=(const FetchBody&) = delete;
+
+    FetchBody share() const {
+        FetchBody body;
+        body.bytes_ = bytes_;
+        return body;
+    }
+
+    const uint8_t* data() const { return bytes_ ? bytes_->data() : nullptr; }
+    size_t size() const { return bytes_ ? bytes_->size() : 0; }
+    bool empty() const { return size() == 0; }
+
+    /**
+     * Take the bytes out, leaving this empty. They are moved if nobody else
+     * shares them and copied otherwise.
+     */
+    std::vector<uint8_t> release() {
+        auto bytes = std::move(bytes_);
+        if (!bytes) return {};
+        if (bytes.use_count() == 1) return std::move(*bytes);
+        return *bytes;
+    }
+
+private:
+    std::shared_ptr<std::vector<uint8_t>> bytes_;
+};
+
 struct FetchRequest {
     std::string requestId;
     std::string url;
     std::string method;
     std::unordered_map<std::string, std::string> headers;
-    std::vector<uint8_t> body;
+    FetchBody body;
     double timeout;      // Request timeout in milliseconds (0 = default/no timeout)
     std::string redirect; // "follow", "error", "manual"
+    std::string cache;    // fetch()'s `cache` option, "default" if not given
 };
 
 struct FetchResponse {
     std::string requestId;
     int status;
     std::unordered_map<std::string, std::string> headers;
-    std::vector<uint8_t> body;
+    FetchBody body;
     std::string error; // Non-empty if request failed
+    bool streaming{false}; // Body follows through handleFetchChunk, `body` is unused
+};
+
+/**
+ * A piece of a streamed response body. The last one has `done` set, or an
+ * error if the download broke off.
+ */
+struct FetchChunk {
+    std::string requestId;
+    FetchBody data;
+    bool done{false};
+    std::string error;
 };
 
 } // namespace webworker
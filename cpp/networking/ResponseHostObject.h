@@ -4,18 +4,59 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
-#include <cstring>
+#include <functional>
+#include <memory>
+
+#include "NativeArrayBuffer.h"
+#include "FetchStream.h"
+#include "FetchTypes.h"
 
 namespace webworker {
 
 using namespace facebook::jsi;
 
-class ResponseHostObject : public HostObject {
+/**
+ * The JS side of a fetch response.
+ *
+ * The body is either buffered (`body`) or arrives through a FetchStream.
+ * `read(callback)` works for both and calls `callback(error, chunk)` with
+ * one ArrayBuffer per chunk, then with an undefined chunk at the end; the
+ * fetch polyfill builds `Response.body` on top of it. `text()` and
+ * `arrayBuffer()` only exist for buffered bodies.
+ */
+class ResponseHostObject : public HostObject,
+                           public std::enable_shared_from_this<ResponseHostObject> {
 public:
-    ResponseHostObject(int status, 
-                       const std::unordered_map<std::string, std::string>& headers,
-                       std::vector<uint8_t> data)
-        : status_(status), headers_(headers), data_(std::move(data)) {}
+    /**
+     * Runs a function on the worker thread, used to finish a read that had
+     * to wait for the network.
+     */
+    using Poster = std::function<void(std::function<void(Runtime&)>)>;
+
+    ResponseHostObject(int status,
+                       std::unordered_map<std::string, std::string> headers,
+                       FetchBody body)
+        : status_(status), headers_(std::move(headers)), body_(std::move(body)) {}
+
+    ResponseHostObject(int status,
+                       std::unordered_map<std::string, std::string> headers,
+                       std::shared_ptr<FetchStream> stream,
+                       Poster post)
+        : status_(status), headers_(std::move(headers)), stream_(std::move(stream)), post_(std::move(post)) {}
+
+    ~ResponseHostObject() override {
+        // Nobody can read the rest anymore, let the download stop
+        if (stream_) stream_->cancel();
+    }
+
+    /**
+     * Forget the pending read and stop the download. Must happen before the
+     * runtime that owns the read callback is destroyed.
+     */
+    void release() {
+        pendingRead_.reset();
+        if (stream_) stream_->cancel();
+    }
 
     Value get(Runtime& rt, const PropNameID& name) override {
         std::string prop = name.utf8(rt);
@@ -32,26 +73,56 @@ public:
             return headersObj;
         }
 
+        if (prop == "streaming") {
+            return stream_ != nullptr;
+        }
+
+        if (prop == "read") {
+            return Function::createFromHostFunction(rt, name, 1,
+                [this](Runtime& rt, const Value&, const Value* args, size_t count) {
+                    if (count < 1 || !args[0].isObject() || !args[0].asObject(rt).isFunction(rt)) {
+                        throw JSError(rt, "read: callback must be a function");
+                    }
+                    if (pendingRead_) {
+                        throw JSError(rt, "read: a read is already pending");
+                    }
+                    pendingRead_ = std::make_shared<Value>(rt, args[0]);
+                    deliver(rt);
+                    return Value::undefined();
+                });
+        }
+
+        if (prop == "cancel") {
+            return Function::createFromHostFunction(rt, name, 0,
+                [this](Runtime& rt, const Value&, const Value*, size_t) {
+                    if (stream_) stream_->cancel();
+                    body_ = FetchBody();
+                    bufferedRead_ = true;
+                    return Value::undefined();
+                });
+        }
+
+        if (stream_) {
+            return Value::undefined();
+        }
+
+        // The fetch polyfill consumes a body once, through one of these
+
         if (prop == "text") {
             return Function::createFromHostFunction(rt, name, 0,
                 [this](Runtime& rt, const Value&, const Value*, size_t) {
-                    std::string textStr(data_.begin(), data_.end());
-                    return String::createFromUtf8(rt, textStr);
+                    // Decoded straight from the body, no intermediate string
+                    if (body_.empty()) return String::createFromAscii(rt, "");
+                    return String::createFromUtf8(rt, body_.data(), body_.size());
                 });
         }
 
         if (prop == "arrayBuffer") {
             return Function::createFromHostFunction(rt, name, 0,
                 [this](Runtime& rt, const Value&, const Value*, size_t) {
-                    auto arrayBuffer = rt.global().getPropertyAsFunction(rt, "ArrayBuffer")
-                                               .callAsConstructor(rt, (int)data_.size())
-                                               .getObject(rt).getArrayBuffer(rt);
-                    
-                    if (data_.size() > 0) {
-                        memcpy(arrayBuffer.data(rt), data_.data(), data_.size());
-                    }
-                    
-                    return arrayBuffer;
+                    // Native-backed, so it can later be transferred without a
+                    // copy. Takes over the body's storage unless it's shared.
+                    return ArrayBuffer(rt, NativeArrayBuffer::adopt(body_.release()));
                 });
         }
 
@@ -59,9 +130,55 @@ public:
     }
 
 private:
+    // Answer the pending read if there's something to answer it with
+    void deliver(Runtime& rt) {
+        if (!pendingRead_) return;
+
+        FetchStream::Read read{FetchStream::State::Done, FetchBody(), ""};
+        if (stream_) {
+            read = stream_->read();
+        } else if (!bufferedRead_) {
+            bufferedRead_ = true;
+            read = {FetchStream::State::Data, std::move(body_), ""};
+        }
+
+        if (read.state == FetchStream::State::Pending) {
+            std::weak_ptr<ResponseHostObject> weak = shared_from_this();
+            Poster post = post_;
+            stream_->notifyWhenReadable([weak, post]() {
+                post([weak](Runtime& rt) {
+                    if (auto self = weak.lock()) self->deliver(rt);
+                });
+            });
+            return;
+        }
+
+        auto callback = std::move(pendingRead_);
+        pendingRead_.reset();
+        Function fn = callback->asObject(rt).asFunction(rt);
+
+        switch (read.state) {
+            case FetchStream::State::Data:
+                fn.call(rt, Value::null(),
+                        ArrayBuffer(rt, NativeArrayBuffer::adopt(read.data.release())));
+                break;
+            case FetchStream::State::Error:
+                fn.call(rt, String::createFromUtf8(rt, read.error));
+                break;
+            default:
+                fn.call(rt, Value::null(), Value::undefined());
+                break;
+        }
+    }
+
     int status_;
     std::unordered_map<std::string, std::string> headers_;
-    std::vector<uint8_t> data_;
+    FetchBody body_;
+    bool bufferedRead_{false}; // `body_` was handed out through read()
+
+    std::shared_ptr<FetchStream> stream_;
+    Poster post_;
+    std::shared_ptr<Value> pendingRead_;
 };
 
 } // namespace webworker
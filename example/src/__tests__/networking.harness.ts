@@ -1,5 +1,5 @@
 import { describe, it, expect, afterEach } from 'react-native-harness';
-import { Worker } from 'react-native-webworker';
+import { Worker, setFetchHighWaterMark } from 'react-native-webworker';
 
 // Helper to prevent tests from hanging indefinitely
 function withTimeout<T>(
@@ -312,4 +312,281 @@ describe('Worker Networking', () => {
     expect(typeof result).toBe('string');
     expect(result).not.toBe('Did not catch error');
   });
+
+  // FetchCache tests: `body` runs in a worker with a fresh `nonce`, so
+  // entries cached by earlier runs don't answer
+  const fetchTestScript = (body: string) => `
+    self.onmessage = async function(event) {
+      try {
+        const nonce = event.data;
+        ${body}
+      } catch (e) {
+        self.postMessage({ status: 'error', error: e.toString() });
+      }
+    };
+  `;
+
+  const runFetchTest = async (body: string, ms: number, msg: string) => {
+    worker = new Worker({ script: fetchTestScript(body) });
+
+    const responsePromise = new Promise<any>((resolve, reject) => {
+      worker.onmessage = (event) => {
+        if (event.data.status === 'error') {
+          reject(new Error(event.data.error));
+        } else {
+          resolve(event.data);
+        }
+      };
+      worker.onerror = reject;
+    });
+
+    await worker.postMessage(`${Date.now()}-${Math.random()}`);
+    return withTimeout(responsePromise, ms, msg);
+  };
+
+  it('should share one request between concurrent identical GETs', async () => {
+    // /uuid answers every request it gets with a new id
+    const result = await runFetchTest(
+      `
+        const url = 'https://httpbin.org/uuid?nonce=' + nonce;
+        const responses = await Promise.all(
+          [0, 1, 2, 3].map(function() { return fetch(url); })
+        );
+        const bodies = await Promise.all(
+          responses.map(function(response) { return response.json(); })
+        );
+        self.postMessage({
+          status: 'ok',
+          ids: bodies.map(function(body) { return body.uuid; }),
+        });
+      `,
+      10000,
+      'Concurrent GETs timed out'
+    );
+
+    expect(result.ids.length).toBe(4);
+    expect(new Set(result.ids).size).toBe(1);
+  });
+
+  it('should answer a fresh max-age response from the cache', async () => {
+    // A network response would carry a later Date
+    const result = await runFetchTest(
+      `
+        const url = 'https://httpbin.org/response-headers?Cache-Control=max-age%3D60&nonce=' + nonce;
+        const first = await fetch(url);
+        await first.text();
+        await new Promise(function(resolve) { setTimeout(resolve, 1100); });
+        const second = await fetch(url);
+        await second.text();
+        const date = function(response) {
+          return response.headers['date'] || response.headers['Date'];
+        };
+        self.postMessage({
+          status: 'ok',
+          statuses: [first.status, second.status],
+          dates: [date(first), date(second)],
+        });
+      `,
+      10000,
+      'max-age test timed out'
+    );
+
+    expect(result.statuses).toEqual([200, 200]);
+    expect(result.dates[0]).toBeDefined();
+    expect(result.dates[1]).toBe(result.dates[0]);
+  });
+
+  it('should revalidate a cached response with its ETag', async () => {
+    // /etag/{etag} answers If-None-Match with a 304, which the cache turns
+    // back into the stored 200
+    const result = await runFetchTest(
+      `
+        const url = 'https://httpbin.org/etag/' + encodeURIComponent(nonce);
+        const first = await fetch(url);
+        const firstBody = await first.text();
+        const second = await fetch(url);
+        const secondBody = await second.text();
+        self.postMessage({
+          status: 'ok',
+          statuses: [first.status, second.status],
+          same: firstBody.length > 0 && firstBody === secondBody,
+          etag: second.headers['etag'] || second.headers['ETag'],
+        });
+      `,
+      10000,
+      'ETag test timed out'
+    );
+
+    expect(result.statuses).toEqual([200, 200]);
+    expect(result.same).toBe(true);
+    expect(result.etag).toBeDefined();
+  });
+
+  // Streaming tests read /photos, about 1 MB of JSON, and compare what they
+  // read with the whole body fetched again
+  const streamTestScript = (body: string) => `
+    var resume;
+    self.onmessage = async function(event) {
+      if (event.data === 'resume') {
+        resume();
+        return;
+      }
+      try {
+        const url = 'https://jsonplaceholder.typicode.com/photos';
+        const pause = function() {
+          return new Promise(function(resolve) {
+            resume = resolve;
+            self.postMessage({ status: 'paused' });
+          });
+        };
+        // The chunks, in order, are the start of the body
+        const matches = async function(chunks) {
+          const response = await fetch(url, { cache: 'no-store' });
+          const expected = new Uint8Array(await response.arrayBuffer());
+          let offset = 0;
+          let inOrder = true;
+          for (const chunk of chunks) {
+            for (let i = 0; i < chunk.length; i++, offset++) {
+              if (chunk[i] !== expected[offset]) inOrder = false;
+            }
+          }
+          return { inOrder: inOrder, length: offset, expectedLength: expected.length };
+        };
+        ${body}
+      } catch (e) {
+        self.postMessage({ status: 'error', error: e.toString() });
+      }
+    };
+  `;
+
+  // Runs `body`, answering each pause with the worker's stats at that point
+  const runStreamTest = async (body: string, ms: number, msg: string) => {
+    worker = new Worker({ script: streamTestScript(body) });
+    const paused: any[] = [];
+
+    const responsePromise = new Promise<any>((resolve, reject) => {
+      worker.onmessage = (event) => {
+        if (event.data.status === 'error') {
+          reject(new Error(event.data.error));
+        } else if (event.data.status === 'paused') {
+          paused.push(worker.getStats());
+          worker.postMessage('resume');
+        } else {
+          resolve(event.data);
+        }
+      };
+      worker.onerror = reject;
+    });
+
+    await worker.postMessage('start');
+    const result = await withTimeout(responsePromise, ms, msg);
+    return { result, paused };
+  };
+
+  it('should stream a large body in order, holding the download back', async () => {
+    // A small buffer, so the paused reader stops the download long before
+    // the end of the body
+    setFetchHighWaterMark(1024);
+    try {
+      const { result, paused } = await runStreamTest(
+        `
+          const response = await fetch(url, { cache: 'no-store' });
+          const reader = response.body.getReader();
+          const chunks = [];
+          let read = await reader.read();
+          chunks.push(read.value);
+
+          // Time for the download to run ahead, if it could
+          await new Promise(function(resolve) { setTimeout(resolve, 1000); });
+          await pause();
+
+          while (!(read = await reader.read()).done) {
+            chunks.push(read.value);
+          }
+          const check = await matches(chunks);
+          self.postMessage({
+            status: 'ok',
+            chunks: chunks.length,
+            inOrder: check.inOrder,
+            length: check.length,
+            expectedLength: check.expectedLength,
+          });
+        `,
+        30000,
+        'Streaming test timed out'
+      );
+
+      expect(paused.length).toBe(1);
+      expect(paused[0].streamingFetches).toBe(1);
+      expect(result.chunks).toBeGreaterThan(1);
+      expect(result.inOrder).toBe(true);
+      expect(result.length).toBe(result.expectedLength);
+      expect(result.length).toBeGreaterThan(512 * 1024);
+      expect(worker.getStats()!.streamingFetches).toBe(0);
+    } finally {
+      setFetchHighWaterMark(1024 * 1024);
+    }
+  });
+
+  it('should stop the download when a stream is cancelled part-way', async () => {
+    setFetchHighWaterMark(1024);
+    try {
+      const { result, paused } = await runStreamTest(
+        `
+          const response = await fetch(url, { cache: 'no-store' });
+          const chunks = [];
+          for await (const chunk of response.body) {
+            chunks.push(chunk);
+            if (chunks.length === 2) break; // Cancels the stream
+          }
+          await new Promise(function(resolve) { setTimeout(resolve, 200); });
+          await pause();
+
+          const after = await response.body.getReader().read();
+          const check = await matches(chunks);
+          self.postMessage({
+            status: 'ok',
+            chunks: chunks.length,
+            inOrder: check.inOrder,
+            partial: check.length < check.expectedLength,
+            doneAfterCancel: after.done,
+            bodyUsed: response.bodyUsed,
+          });
+        `,
+        30000,
+        'Cancel test timed out'
+      );
+
+      expect(result.chunks).toBe(2);
+      expect(result.inOrder).toBe(true);
+      expect(result.partial).toBe(true);
+      expect(result.doneAfterCancel).toBe(true);
+      expect(result.bodyUsed).toBe(true);
+      // The download was held back, only the cancel can have ended it
+      expect(paused[0].streamingFetches).toBe(0);
+    } finally {
+      setFetchHighWaterMark(1024 * 1024);
+    }
+  });
+
+  it('should decode streamed bodies as UTF-8', async () => {
+    // /base64/{value} answers with the decoded bytes: a byte order mark,
+    // then multi-byte characters, and a JSON document
+    const result = await runFetchTest(
+      `
+        const text = await fetch('https://httpbin.org/base64/77u_aMOpbGxvIOKIriDml6XmnKwg8J-YgA==?nonce=' + nonce);
+        const json = await fetch('https://httpbin.org/base64/eyJ3b3JkIjoi5pel5pysIn0=?nonce=' + nonce);
+        self.postMessage({
+          status: 'ok',
+          text: await text.text(),
+          json: await json.json(),
+        });
+      `,
+      10000,
+      'UTF-8 test timed out'
+    );
+
+    expect(result.text).toBe('h\u00e9llo \u222e \u65e5\u672c \ud83d\ude00');
+    expect(result.json).toEqual({ word: '\u65e5\u672c' });
+  });
 });
@@ -1,5 +1,10 @@
 import { describe, it, expect, afterEach } from 'react-native-harness';
-import { Worker } from 'react-native-webworker';
+import {
+  MessageChannel,
+  Worker,
+  WorkerPool,
+  setWarmPoolSize,
+} from 'react-native-webworker';
 
 // Helper to prevent tests from hanging indefinitely
 function withTimeout<T>(
@@ -86,6 +91,696 @@ describe('WebWorker', () => {
     expect(response.modified).toBe(true);
   });
 
+  it('should structured-clone Map, Set, Date, typed arrays and cycles', async () => {
+    worker = new Worker({
+      script: `
+        self.onmessage = function(event) {
+          const data = event.data;
+          self.postMessage({
+            mapValue: data.map.get('key'),
+            hasInSet: data.set.has(2),
+            year: data.date.getUTCFullYear(),
+            sum: data.bytes.reduce(function(a, b) { return a + b; }, 0),
+            isCyclic: data.self === data,
+            echo: data,
+          });
+        };
+      `,
+    });
+
+    const payload: any = {
+      map: new Map([['key', 'value']]),
+      set: new Set([1, 2, 3]),
+      date: new Date(Date.UTC(2024, 0, 1)),
+      bytes: new Uint8Array([1, 2, 3, 4]),
+    };
+    payload.self = payload;
+
+    const responsePromise = new Promise<any>((resolve, reject) => {
+      worker.onmessage = (event) => resolve(event.data);
+      worker.onerror = reject;
+    });
+
+    await worker.postMessage(payload);
+
+    const response = await withTimeout(
+      responsePromise,
+      1000,
+      'Worker did not handle cloned payload'
+    );
+
+    expect(response.mapValue).toBe('value');
+    expect(response.hasInSet).toBe(true);
+    expect(response.year).toBe(2024);
+    expect(response.sum).toBe(10);
+    expect(response.isCyclic).toBe(true);
+    expect(response.echo.bytes instanceof Uint8Array).toBe(true);
+    expect(response.echo.self).toBe(response.echo);
+  });
+
+  it('should transfer ArrayBuffers to and from the worker', async () => {
+    worker = new Worker({
+      script: `
+        self.onmessage = function(event) {
+          const bytes = new Uint8Array(event.data.buffer);
+          for (let i = 0; i < bytes.length; i++) {
+            bytes[i] = bytes[i] * 2;
+          }
+          self.postMessage({ buffer: event.data.buffer }, [event.data.buffer]);
+        };
+      `,
+    });
+
+    const source = new Uint8Array([1, 2, 3, 4]).buffer;
+
+    const responsePromise = new Promise<any>((resolve, reject) => {
+      worker.onmessage = (event) => resolve(event.data);
+      worker.onerror = reject;
+    });
+
+    await worker.postMessage({ buffer: source }, [source]);
+
+    const response = await withTimeout(
+      responsePromise,
+      1000,
+      'Worker did not return transferred buffer'
+    );
+
+    expect(Array.from(new Uint8Array(response.buffer))).toEqual([2, 4, 6, 8]);
+    if (typeof (ArrayBuffer.prototype as any).transfer === 'function') {
+      // The sender's buffer is detached
+      expect(source.byteLength).toBe(0);
+    } else {
+      // Hermes can't detach: the buffer was copied and the sender's is intact
+      expect(source.byteLength).toBe(4);
+      expect(Array.from(new Uint8Array(source))).toEqual([1, 2, 3, 4]);
+    }
+  });
+
+  it('should share a SharedArrayBuffer between the host and workers', async () => {
+    const script = `
+      self.onmessage = function(event) {
+        const counters = new Int32Array(event.data);
+        for (let i = 0; i < 1000; i++) {
+          Atomics.add(counters, 0, 1);
+        }
+        Atomics.add(counters, 1, 1);
+        Atomics.notify(counters, 1);
+      };
+    `;
+    const workers = [new Worker({ script }), new Worker({ script })];
+
+    try {
+      const shared = new SharedArrayBuffer(8);
+      const counters = new Int32Array(shared);
+
+      await Promise.all(workers.map((w) => w.postMessage(shared)));
+
+      const deadline = Date.now() + 2000;
+      while (Atomics.load(counters, 1) < workers.length && Date.now() < deadline) {
+        const result = Atomics.waitAsync(
+          counters,
+          1,
+          Atomics.load(counters, 1),
+          100
+        );
+        if (result.async) {
+          await result.value;
+        }
+      }
+
+      expect(Atomics.load(counters, 1)).toBe(2);
+      expect(Atomics.load(counters, 0)).toBe(2000);
+    } finally {
+      await Promise.all(workers.map((w) => w.terminate()));
+    }
+  });
+
+  it('should deliver bursts of messages in order', async () => {
+    worker = new Worker({
+      script: `
+        let received = 0;
+        self.onmessage = function(event) {
+          if (event.data !== received) {
+            self.postMessage({ error: 'out of order', expected: received, got: event.data });
+          }
+          received++;
+          // Microtasks still run between messages of a batch
+          Promise.resolve().then(function() {
+            if (received === 500) {
+              for (let i = 0; i < 500; i++) {
+                self.postMessage(i);
+              }
+            }
+          });
+        };
+      `,
+    });
+
+    const received: unknown[] = [];
+    const donePromise = new Promise<void>((resolve, reject) => {
+      worker.onmessage = (event) => {
+        received.push(event.data);
+        if (received.length === 500) {
+          resolve();
+        }
+      };
+      worker.onerror = reject;
+    });
+
+    for (let i = 0; i < 500; i++) {
+      worker.postMessage(i);
+    }
+
+    await withTimeout(donePromise, 3000, 'Burst was not echoed back');
+
+    expect(received).toEqual(Array.from({ length: 500 }, (_, i) => i));
+  });
+
+  it('should keep delivering messages when user code replaces globals', async () => {
+    worker = new Worker({
+      script: `
+        try {
+          self.__handleMessage = function() {};
+        } catch (e) {}
+        JSON.stringify = function() { return 'replaced'; };
+        self.onmessage = function(event) {
+          self.postMessage(event.data + 1);
+        };
+      `,
+    });
+
+    const responsePromise = new Promise<any>((resolve, reject) => {
+      worker.onmessage = (event) => resolve(event.data);
+      worker.onerror = reject;
+    });
+
+    await worker.postMessage(41);
+
+    const response = await withTimeout(
+      responsePromise,
+      1000,
+      'Worker stopped receiving messages'
+    );
+    expect(response).toBe(42);
+    expect(await worker.eval('({ a: 1 })')).toBe('{"a":1}');
+  });
+
+  it('should deliver messages only to the worker that posted them', async () => {
+    const script = `
+      self.onmessage = function(event) {
+        self.postMessage(event.data);
+      };
+    `;
+    worker = new Worker({ script });
+    const other = new Worker({ script });
+
+    try {
+      const received: string[] = [];
+      const otherReceived: string[] = [];
+      const bothDone = Promise.all([
+        new Promise<void>((resolve) => {
+          worker.onmessage = (event) => {
+            received.push(event.data as string);
+            resolve();
+          };
+        }),
+        new Promise<void>((resolve) => {
+          other.onmessage = (event) => {
+            otherReceived.push(event.data as string);
+            resolve();
+          };
+        }),
+      ]);
+
+      await worker.postMessage('first');
+      await other.postMessage('second');
+      await withTimeout(bothDone, 1000, 'Workers did not reply');
+
+      expect(received).toEqual(['first']);
+      expect(otherReceived).toEqual(['second']);
+    } finally {
+      await other.terminate();
+    }
+  });
+
+  it('should evaluate in one worker while another is busy', async () => {
+    worker = new Worker({
+      script: `
+        self.onmessage = function() {
+          var end = Date.now() + 1500;
+          while (Date.now() < end) {}
+          self.postMessage('done');
+        };
+      `,
+    });
+    const other = new Worker({ script: 'var answer = 42;' });
+
+    try {
+      const busyDone = new Promise<void>((resolve) => {
+        worker.onmessage = () => resolve();
+      });
+      await worker.postMessage('spin');
+
+      const started = Date.now();
+      expect(await other.eval('answer')).toBe('42');
+      expect(Date.now() - started).toBeLessThan(1000);
+
+      await withTimeout(busyDone, 3000, 'Busy worker did not finish');
+    } finally {
+      await other.terminate();
+    }
+  });
+
+  it('should run, clear and repeat timers', async () => {
+    worker = new Worker({
+      script: `
+        var fired = [];
+        for (var i = 0; i < 1000; i++) {
+          clearTimeout(setTimeout(function() { fired.push('cleared'); }, 5));
+        }
+        setTimeout(function() { fired.push('b'); }, 20);
+        setTimeout(function() { fired.push('a'); }, 10);
+        var ticks = 0;
+        var interval = setInterval(function() {
+          ticks++;
+          if (ticks === 3) {
+            clearInterval(interval);
+            setTimeout(function() { self.postMessage({ fired: fired, ticks: ticks }); }, 30);
+          }
+        }, 5);
+      `,
+    });
+
+    const result = await withTimeout(
+      new Promise<any>((resolve, reject) => {
+        worker.onmessage = (event) => resolve(event.data);
+        worker.onerror = reject;
+      }),
+      1000,
+      'Timers did not fire'
+    );
+
+    expect(result.fired).toEqual(['a', 'b']);
+    expect(result.ticks).toBe(3);
+  });
+
+  it('should run immediates and MessageChannel messages in order', async () => {
+    worker = new Worker({
+      script: `
+        var order = [];
+        setImmediate(function(tag) { order.push(tag); }, 'first');
+        clearImmediate(setImmediate(function() { order.push('cleared'); }));
+        setImmediate(function() { order.push('second'); });
+        var channel = new MessageChannel();
+        channel.port1.onmessage = function(event) {
+          order.push(event.data);
+          if (event.data === 'port-2') {
+            self.postMessage(order);
+          }
+        };
+        channel.port2.postMessage('port-1');
+        channel.port2.postMessage('port-2');
+      `,
+    });
+
+    const result = await withTimeout(
+      new Promise<any>((resolve, reject) => {
+        worker.onmessage = (event) => resolve(event.data);
+        worker.onerror = reject;
+      }),
+      1000,
+      'Immediates did not run'
+    );
+
+    expect(result).toEqual(['first', 'second', 'port-1', 'port-2']);
+  });
+
+  it('should run immediates during a flood of messages', async () => {
+    worker = new Worker({
+      script: `
+        var received = 0;
+        var ranAfter = -1;
+        self.onmessage = function() {
+          received++;
+          if (received === 1) {
+            setImmediate(function() { ranAfter = received; });
+          }
+          if (received === 2000) {
+            self.postMessage(ranAfter);
+          }
+        };
+      `,
+    });
+
+    const ranAfter = new Promise<number>((resolve, reject) => {
+      worker.onmessage = (event) => resolve(event.data as number);
+      worker.onerror = reject;
+    });
+
+    for (let i = 0; i < 2000; i++) {
+      worker.postMessage(i);
+    }
+
+    // Run within a batch or two of messages, not after all of them
+    const result = await withTimeout(ranAfter, 3000, 'Flood was not handled');
+    expect(result).toBeGreaterThan(0);
+    expect(result).toBeLessThan(500);
+  });
+
+  it('should keep running when console output overflows', async () => {
+    worker = new Worker({
+      script: `
+        for (var i = 0; i < 5000; i++) {
+          console.log('line', i, { index: i }, [i]);
+        }
+        console.info();
+        self.postMessage('done');
+      `,
+    });
+
+    const result = await withTimeout(
+      new Promise<any>((resolve, reject) => {
+        worker.onmessage = (event) => resolve(event.data);
+        worker.onerror = reject;
+      }),
+      5000,
+      'Worker stalled while logging'
+    );
+
+    expect(result).toBe('done');
+  });
+
+  it('should report worker stats', async () => {
+    worker = new Worker({
+      script: `
+        self.onmessage = function(event) {
+          Promise.resolve().then(function() {
+            self.postMessage(event.data);
+          });
+        };
+      `,
+    });
+
+    const replies = new Promise<void>((resolve, reject) => {
+      let count = 0;
+      worker.onmessage = () => {
+        if (++count === 10) resolve();
+      };
+      worker.onerror = reject;
+    });
+    for (let i = 0; i < 10; i++) {
+      await worker.postMessage({ index: i });
+    }
+    await withTimeout(replies, 3000, 'Worker did not echo every message');
+
+    const stats = worker.getStats();
+    expect(stats).not.toBeNull();
+    expect(stats!.messagesIn).toBe(10);
+    expect(stats!.messagesOut).toBe(10);
+    expect(stats!.bytesIn).toBeGreaterThan(0);
+    expect(stats!.tasksRun).toBeGreaterThanOrEqual(10);
+    expect(stats!.taskDuration.count).toBeGreaterThanOrEqual(10);
+    expect(stats!.microtaskDrain.max).toBeGreaterThanOrEqual(0);
+    expect(stats!.queue.immediate).toBe(0);
+    expect(stats!.pendingFetches).toBe(0);
+    expect(stats!.heap.hermes_allocatedBytes).toBeGreaterThan(0);
+  });
+
+  it('should write a cpuprofile for a worker', async () => {
+    worker = new Worker({
+      script: `
+        function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+        self.onmessage = function(event) {
+          self.postMessage(fib(event.data));
+        };
+      `,
+    });
+
+    await worker.startProfiling();
+    const result = await withTimeout(
+      new Promise<any>((resolve, reject) => {
+        worker.onmessage = (event) => resolve(event.data);
+        worker.onerror = reject;
+        worker.postMessage(25);
+      }),
+      5000,
+      'Worker did not finish computing'
+    );
+    const path = await worker.stopProfiling();
+
+    expect(result).toBe(75025);
+    expect(path).toMatch(/\.cpuprofile$/);
+
+    // Stopped already
+    let error: Error | null = null;
+    await worker.stopProfiling().catch((e: Error) => {
+      error = e;
+    });
+    expect(error).not.toBeNull();
+  });
+
+  it('should keep state separate in workers sharing a script', async () => {
+    const script = `
+      var count = 0;
+      self.onmessage = function() {
+        count++;
+        self.postMessage(count);
+      };
+    `;
+    const workers = [new Worker({ script }), new Worker({ script })];
+
+    try {
+      const ask = (target: Worker) =>
+        withTimeout(
+          new Promise<any>((resolve, reject) => {
+            target.onmessage = (event) => resolve(event.data);
+            target.onerror = reject;
+            target.postMessage(null);
+          }),
+          3000,
+          'Worker did not reply'
+        );
+
+      expect(await ask(workers[0]!)).toBe(1);
+      expect(await ask(workers[0]!)).toBe(2);
+      expect(await ask(workers[1]!)).toBe(1);
+    } finally {
+      await Promise.all(workers.map((w) => w.terminate()));
+    }
+  });
+
+  it('should connect two workers through a MessageChannel', async () => {
+    worker = new Worker({
+      script: `
+        self.onmessage = function(event) {
+          event.data.port.postMessage({ values: new Uint8Array([1, 2, 3]) });
+        };
+      `,
+    });
+    const other = new Worker({
+      script: `
+        self.onmessage = function(event) {
+          var port = event.data.port;
+          port.onmessage = function(message) {
+            self.postMessage(Array.from(message.data.values));
+            port.close();
+          };
+        };
+      `,
+    });
+
+    try {
+      const received = new Promise<any>((resolve, reject) => {
+        other.onmessage = (event) => resolve(event.data);
+        other.onerror = reject;
+      });
+
+      // The producer may post before the consumer listens, the port queues
+      const channel = new MessageChannel();
+      await worker.postMessage({ port: channel.port1 }, [channel.port1]);
+      await other.postMessage({ port: channel.port2 }, [channel.port2]);
+
+      expect(
+        await withTimeout(received, 2000, 'Channel message not received')
+      ).toEqual([1, 2, 3]);
+    } finally {
+      await other.terminate();
+    }
+  });
+
+  it('should keep running when its thread options change', async () => {
+    worker = new Worker({
+      script: `
+        self.onmessage = function(event) {
+          self.postMessage(event.data * 2);
+        };
+      `,
+      stackSizeKB: 2048,
+      thread: { priority: 'background', name: 'prefetch' },
+    });
+
+    const ask = (value: number) =>
+      withTimeout(
+        new Promise<any>((resolve, reject) => {
+          worker.onmessage = (event) => resolve(event.data);
+          worker.onerror = reject;
+          worker.postMessage(value);
+        }),
+        2000,
+        'Worker did not reply'
+      );
+
+    expect(await ask(1)).toBe(2);
+    expect(worker.getStats()!.thread).toEqual({
+      name: 'prefetch',
+      priority: 'background',
+    });
+
+    // Queued ahead of the message, so in effect once it is answered
+    await worker.setThreadOptions({ priority: 'userInitiated' });
+    expect(await ask(2)).toBe(4);
+    expect(worker.getStats()!.thread).toEqual({
+      name: 'prefetch',
+      priority: 'userInitiated',
+    });
+  });
+
+  it('should run jobs on a native worker pool', async () => {
+    const pool = new WorkerPool<number, number>({
+      size: 3,
+      script: `
+        self.onmessage = function(event) {
+          if (event.data < 0) {
+            throw new Error('negative input');
+          }
+          self.postMessage(event.data * 2);
+        };
+      `,
+    });
+
+    try {
+      const tasks = Array.from({ length: 50 }, (_, i) => i);
+      const results = await withTimeout(
+        pool.map(tasks),
+        3000,
+        'Pool jobs did not complete'
+      );
+      expect(results).toEqual(tasks.map((i) => i * 2));
+      expect(pool.getSize()).toBe(3);
+
+      let error: Error | null = null;
+      await pool.submit(-1).catch((e: Error) => {
+        error = e;
+      });
+      expect(error).not.toBeNull();
+      expect(await pool.submit(21)).toBe(42);
+    } finally {
+      await pool.terminate();
+    }
+  });
+
+  it('should match pool results to their own jobs', async () => {
+    // Extra replies, a throw after replying and a failing timer must not
+    // shift the results of later jobs
+    const pool = new WorkerPool<number, number>({
+      size: 1,
+      script: `
+        self.onmessage = function(event) {
+          self.postMessage(event.data * 2);
+          self.postMessage(-1);
+          setTimeout(function() { throw new Error('late timer'); }, 0);
+          throw new Error('after reply');
+        };
+      `,
+    });
+
+    try {
+      const tasks = Array.from({ length: 10 }, (_, i) => i);
+      const results = await withTimeout(
+        pool.map(tasks),
+        3000,
+        'Pool jobs did not complete'
+      );
+      expect(results).toEqual(tasks.map((i) => i * 2));
+    } finally {
+      await pool.terminate();
+    }
+  });
+
+  it('should match async pool results to their own jobs', async () => {
+    // Leftover timers and broadcast replies land while later jobs wait,
+    // and a rejected handler must fail only its own job
+    const pool = new WorkerPool<number | string, number>({
+      size: 1,
+      script: `
+        self.onmessage = async function(event) {
+          if (event.data === 'ping') {
+            self.postMessage(-2);
+            return;
+          }
+          var value = event.data;
+          setTimeout(function() { self.postMessage(-1); }, 30);
+          await new Promise(function(resolve) {
+            setTimeout(resolve, 10 + (value % 3) * 10);
+          });
+          if (value === 3) {
+            throw new Error('rejected job');
+          }
+          self.postMessage(value * 2);
+        };
+      `,
+    });
+
+    try {
+      const tasks = Array.from({ length: 8 }, (_, i) => i);
+      const jobs = Promise.allSettled(tasks.map((i) => pool.submit(i)));
+      await pool.broadcast('ping');
+      const results = await withTimeout(jobs, 5000, 'Pool jobs did not settle');
+
+      results.forEach((result, i) => {
+        if (i === 3) {
+          expect(result.status).toBe('rejected');
+          expect(String((result as PromiseRejectedResult).reason)).toContain(
+            'rejected job'
+          );
+        } else {
+          expect(result).toEqual({ status: 'fulfilled', value: i * 2 });
+        }
+      });
+    } finally {
+      await pool.terminate();
+    }
+  });
+
+  it('should give up on pool jobs after jobTimeout', async () => {
+    const pool = new WorkerPool<number, number>({
+      size: 1,
+      jobTimeout: 200,
+      script: `
+        self.onmessage = function(event) {
+          if (event.data !== 0) {
+            self.postMessage(event.data);
+          }
+        };
+      `,
+    });
+
+    try {
+      const silent = pool.submit(0);
+      const next = pool.submit(1);
+
+      let error: Error | null = null;
+      await silent.catch((e: Error) => {
+        error = e;
+      });
+      expect(String(error)).toContain('timed out');
+      expect(await withTimeout(next, 1000, 'Worker did not move on')).toBe(1);
+    } finally {
+      await pool.terminate();
+    }
+  });
+
   it('should handle errors from worker', async () => {
     worker = new Worker({
       script: `
@@ -113,6 +808,71 @@ describe('WebWorker', () => {
     expect(errorMsg.includes('Test Error')).toBe(true);
   });
 
+  it('should run workers taken from the warm pool', async () => {
+    setWarmPoolSize(2);
+    try {
+      // Give the pool a moment to warm up
+      await new Promise((resolve) => setTimeout(resolve, 200));
+
+      worker = new Worker({
+        script: `
+          self.onmessage = function(event) {
+            self.postMessage('pooled: ' + event.data);
+          };
+        `,
+      });
+
+      const responsePromise = new Promise<string>((resolve, reject) => {
+        worker.onmessage = (event) => resolve(event.data as string);
+        worker.onerror = reject;
+      });
+
+      await worker.postMessage('hello');
+
+      const response = await withTimeout(
+        responsePromise,
+        2000,
+        'Pooled worker did not respond'
+      );
+
+      expect(response).toBe('pooled: hello');
+    } finally {
+      setWarmPoolSize(0);
+    }
+  });
+
+  it('should apply thread options to a worker from the warm pool', async () => {
+    setWarmPoolSize(1);
+    try {
+      await new Promise((resolve) => setTimeout(resolve, 200));
+
+      worker = new Worker({
+        script: `
+          self.onmessage = function(event) {
+            self.postMessage(event.data);
+          };
+        `,
+        thread: { priority: 'utility', name: 'warm-utility' },
+      });
+
+      const reply = new Promise<any>((resolve, reject) => {
+        worker.onmessage = (event) => resolve(event.data);
+        worker.onerror = reject;
+      });
+      await worker.postMessage('ping');
+      expect(
+        await withTimeout(reply, 2000, 'Pooled worker did not reply')
+      ).toBe('ping');
+
+      expect(worker.getStats()!.thread).toEqual({
+        name: 'warm-utility',
+        priority: 'utility',
+      });
+    } finally {
+      setWarmPoolSize(0);
+    }
+  });
+
   it('should throw when posting to terminated worker', async () => {
     worker = new Worker({
       script: 'self.onmessage = function() {}',
@@ -10,11 +10,13 @@
 #import "WebWorkerCore.h"
 #endif
 
+#import <ReactCommon/RCTTurboModuleWithJSIBindings.h>
 #import <WebworkerSpec/WebworkerSpec.h>
 
 NS_ASSUME_NONNULL_BEGIN
 
-@interface Webworker : NativeWebworkerSpecBase <NativeWebworkerSpec>
+@interface Webworker
+    : NativeWebworkerSpecBase <NativeWebworkerSpec, RCTTurboModuleWithJSIBindings>
 
 @end
 
@@ -6,13 +6,220 @@
 //
 
 #import "Webworker.h"
+#import "WebWorkerBinding.h"
 #import "WebWorkerCore.h"
 #import "networking/FetchTypes.h"
+#import <UIKit/UIKit.h>
 #import <memory>
 
+@class WebworkerFetchRouter;
+
 @interface Webworker () {
   std::shared_ptr<webworker::WebWorkerCore> _core;
+  NSURLSession *_fetchSession;
+  WebworkerFetchRouter *_fetchRouter;
+}
+@end
+
+// Streams one response body into the core, on its own serial queue.
+// Blocking there while the worker catches up only holds back this download:
+// the task is suspended instead of the session's delegate queue.
+@interface WebworkerFetchState : NSObject {
+  std::weak_ptr<webworker::WebWorkerCore> _core;
+  std::string _workerId;
+  std::string _requestId;
+  dispatch_queue_t _queue;
+  NSUInteger _pendingChunks; // Guarded by @synchronized(self)
+  BOOL _suspended;
+  BOOL _finished; // Only touched on _queue
 }
+- (instancetype)initWithCore:(std::weak_ptr<webworker::WebWorkerCore>)core
+                    workerId:(const std::string &)workerId
+                   requestId:(const std::string &)requestId;
+- (void)task:(NSURLSessionDataTask *)dataTask
+    didReceiveResponse:(NSURLResponse *)response
+     completionHandler:
+         (void (^)(NSURLSessionResponseDisposition))completionHandler;
+- (void)task:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data;
+- (void)task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error;
+@end
+
+// Chunks queued for the worker beyond which the download is suspended
+static const NSUInteger kMaxPendingChunks = 4;
+
+@implementation WebworkerFetchState
+
+- (instancetype)initWithCore:(std::weak_ptr<webworker::WebWorkerCore>)core
+                    workerId:(const std::string &)workerId
+                   requestId:(const std::string &)requestId {
+  if (self = [super init]) {
+    _core = core;
+    _workerId = workerId;
+    _requestId = requestId;
+    _queue = dispatch_queue_create("webworker.fetch", DISPATCH_QUEUE_SERIAL);
+  }
+  return self;
+}
+
+- (void)task:(NSURLSessionDataTask *)dataTask
+    didReceiveResponse:(NSURLResponse *)response
+     completionHandler:
+         (void (^)(NSURLSessionResponseDisposition))completionHandler {
+  dispatch_async(_queue, ^{
+    auto core = self->_core.lock();
+    if (!core) {
+      completionHandler(NSURLSessionResponseCancel);
+      return;
+    }
+
+    webworker::FetchResponse fetchResponse;
+    fetchResponse.requestId = self->_requestId;
+    fetchResponse.streaming = true;
+
+    NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+    fetchResponse.status = (int)httpResponse.statusCode;
+    for (NSString *key in httpResponse.allHeaderFields) {
+      NSString *value = httpResponse.allHeaderFields[key];
+      fetchResponse.headers[[key UTF8String]] = [value UTF8String];
+    }
+
+    core->handleFetchResponse(self->_workerId, std::move(fetchResponse));
+    completionHandler(NSURLSessionResponseAllow);
+  });
+}
+
+- (void)task:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+  @synchronized(self) {
+    if (++_pendingChunks > kMaxPendingChunks && !_suspended) {
+      _suspended = YES;
+      [dataTask suspend];
+    }
+  }
+
+  dispatch_async(_queue, ^{
+    [self deliverData:data task:dataTask];
+
+    @synchronized(self) {
+      if (--self->_pendingChunks <= kMaxPendingChunks / 2 && self->_suspended) {
+        self->_suspended = NO;
+        [dataTask resume];
+      }
+    }
+  });
+}
+
+- (void)deliverData:(NSData *)data task:(NSURLSessionDataTask *)dataTask {
+  if (_finished) return;
+  auto core = _core.lock();
+
+  // NSData may be made of several regions
+  __block std::vector<uint8_t> bytes;
+  bytes.reserve(data.length);
+  [data enumerateByteRangesUsingBlock:^(const void *region, NSRange byteRange,
+                                        BOOL *stop) {
+    const uint8_t *start = (const uint8_t *)region;
+    bytes.insert(bytes.end(), start, start + byteRange.length);
+  }];
+
+  webworker::FetchChunk chunk;
+  chunk.requestId = _requestId;
+  chunk.data = webworker::FetchBody(std::move(bytes));
+
+  if (!core || !core->handleFetchChunk(_workerId, std::move(chunk))) {
+    // Nobody is reading anymore
+    _finished = YES;
+    [dataTask cancel];
+  }
+}
+
+- (void)task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+  dispatch_async(_queue, ^{
+    auto core = self->_core.lock();
+    if (!core || self->_finished) return;
+    self->_finished = YES;
+
+    if (error && task.response == nil) {
+      // Failed before any response arrived
+      webworker::FetchResponse fetchResponse;
+      fetchResponse.requestId = self->_requestId;
+      fetchResponse.error = [error.localizedDescription UTF8String];
+      core->handleFetchResponse(self->_workerId, std::move(fetchResponse));
+      return;
+    }
+
+    webworker::FetchChunk chunk;
+    chunk.requestId = self->_requestId;
+    chunk.done = true;
+    if (error) {
+      chunk.error = [error.localizedDescription UTF8String];
+    }
+    core->handleFetchChunk(self->_workerId, std::move(chunk));
+  });
+}
+
+@end
+
+// Delegate of the one session all fetches share, so connections are kept
+// alive and reused. Hands every callback to the task's WebworkerFetchState.
+@interface WebworkerFetchRouter : NSObject <NSURLSessionDataDelegate> {
+  NSMutableDictionary<NSNumber *, WebworkerFetchState *> *_states;
+}
+- (void)addTask:(NSURLSessionTask *)task state:(WebworkerFetchState *)state;
+@end
+
+@implementation WebworkerFetchRouter
+
+- (instancetype)init {
+  if (self = [super init]) {
+    _states = [NSMutableDictionary dictionary];
+  }
+  return self;
+}
+
+- (void)addTask:(NSURLSessionTask *)task state:(WebworkerFetchState *)state {
+  @synchronized(self) {
+    _states[@(task.taskIdentifier)] = state;
+  }
+}
+
+- (WebworkerFetchState *)stateForTask:(NSURLSessionTask *)task remove:(BOOL)remove {
+  @synchronized(self) {
+    NSNumber *key = @(task.taskIdentifier);
+    WebworkerFetchState *state = _states[key];
+    if (remove) {
+      [_states removeObjectForKey:key];
+    }
+    return state;
+  }
+}
+
+- (void)URLSession:(NSURLSession *)session
+              dataTask:(NSURLSessionDataTask *)dataTask
+    didReceiveResponse:(NSURLResponse *)response
+     completionHandler:
+         (void (^)(NSURLSessionResponseDisposition))completionHandler {
+  WebworkerFetchState *state = [self stateForTask:dataTask remove:NO];
+  if (!state) {
+    completionHandler(NSURLSessionResponseCancel);
+    return;
+  }
+  [state task:dataTask
+      didReceiveResponse:response
+       completionHandler:completionHandler];
+}
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+    didReceiveData:(NSData *)data {
+  [[self stateForTask:dataTask remove:NO] task:dataTask didReceiveData:data];
+}
+
+- (void)URLSession:(NSURLSession *)session
+                    task:(NSURLSessionTask *)task
+    didCompleteWithError:(NSError *)error {
+  [[self stateForTask:task remove:YES] task:task didCompleteWithError:error];
+}
+
 @end
 
 @implementation Webworker
@@ -21,28 +228,47 @@
   if (self = [super init]) {
     _core = std::make_shared<webworker::WebWorkerCore>();
     [self setupCallbacks];
+
+    [[NSNotificationCenter defaultCenter]
+        addObserver:self
+           selector:@selector(handleMemoryWarning)
+               name:UIApplicationDidReceiveMemoryWarningNotification
+             object:nil];
   }
   return self;
 }
 
+- (void)handleMemoryWarning {
+  if (_core) {
+    _core->onMemoryPressure(webworker::MemoryPressure::Critical);
+  }
+}
+
+static webworker::WorkerConfig
+makeWorkerConfig(double maxHeapSizeMB, double initialHeapSizeMB,
+                 NSString *gcMode, double stackSizeKB, NSString *priority,
+                 double cpuAffinityMask, NSString *threadName) {
+  webworker::WorkerConfig config;
+  config.maxHeapSizeMB = maxHeapSizeMB > 0 ? (uint32_t)maxHeapSizeMB : 0;
+  config.initialHeapSizeMB =
+      initialHeapSizeMB > 0 ? (uint32_t)initialHeapSizeMB : 0;
+  config.gcMode = webworker::WorkerConfig::parseGCMode(
+      gcMode ? [gcMode UTF8String] : "");
+  config.stackSizeKB = stackSizeKB > 0 ? (uint32_t)stackSizeKB : 0;
+  config.thread.priority = webworker::ThreadOptions::parsePriority(
+      priority ? [priority UTF8String] : "");
+  // Kept for symmetry with Android, iOS has no affinity API
+  config.thread.cpuAffinityMask =
+      cpuAffinityMask > 0 ? (uint64_t)cpuAffinityMask : 0;
+  config.thread.name = threadName ? [threadName UTF8String] : "";
+  return config;
+}
+
 - (void)setupCallbacks {
   __weak Webworker *weakSelf = self;
 
-  // Message callback - called when worker posts a message to host
-  _core->setMessageCallback([weakSelf](const std::string &workerId,
-                                       const std::string &message) {
-    Webworker *strongSelf = weakSelf;
-    if (strongSelf) {
-      NSString *workerIdStr = [NSString stringWithUTF8String:workerId.c_str()];
-      NSString *messageStr = [NSString stringWithUTF8String:message.c_str()];
-      dispatch_async(dispatch_get_main_queue(), ^{
-        [strongSelf emitOnWorkerMessage:@{
-          @"workerId" : workerIdStr,
-          @"message" : messageStr
-        }];
-      });
-    }
-  });
+  // Messages are delivered by WebWorkerBinding straight into the JS runtime,
+  // see installJSIBindingsWithRuntime:callInvoker:
 
   // Console callback - called for worker console.log/error/etc
   _core->setConsoleCallback([weakSelf](const std::string &workerId,
@@ -92,6 +318,15 @@
         [strongSelf performFetch:request workerId:workerId];
     }
   });
+
+  // Cacheable responses are kept on disk too, shared by all workers
+  NSString *cachesDir = NSSearchPathForDirectoriesInDomains(
+      NSCachesDirectory, NSUserDomainMask, YES).firstObject;
+  if (cachesDir) {
+    NSString *fetchCacheDir =
+        [cachesDir stringByAppendingPathComponent:@"webworker-fetch"];
+    _core->setFetchCacheDirectory([fetchCacheDir UTF8String]);
+  }
 }
 
 - (void)performFetch:(const webworker::FetchRequest &)request workerId:(std::string)workerId {
@@ -110,57 +345,60 @@
     
     // Body
     if (!request.body.empty()) {
-        urlRequest.HTTPBody = [NSData dataWithBytes:request.body.data() length:request.body.size()];
+        // Hold a reference to the body for as long as the NSData lives
+        // instead of copying it
+        auto body = std::make_shared<webworker::FetchBody>(request.body.share());
+        urlRequest.HTTPBody =
+            [[NSData alloc] initWithBytesNoCopy:(void *)body->data()
+                                         length:body->size()
+                                    deallocator:^(void *bytes, NSUInteger length) {
+                                      (void)body;
+                                    }];
     }
 
     // Timeout
     if (request.timeout > 0) {
         urlRequest.timeoutInterval = request.timeout / 1000.0;
     }
-    
-    std::string requestIdStr = request.requestId;
-    std::string workerIdStr = workerId;
-    
-    NSURLSession *session = [NSURLSession sharedSession];
 
-    // Handle redirect behavior via delegate if needed, but for now using shared session
-    // sharedSession automatically follows redirects. 
-    // If 'error' or 'manual' is requested, we would need a custom session delegate.
-    // For this MVP, we will only respect the timeout.
-    // TODO: Implement custom session delegate for redirect control if strictly required.
-    
-    NSURLSessionDataTask *task = [session dataTaskWithRequest:urlRequest completionHandler:^(NSData * _Nullable data, NSURLResponse * _Nullable response, NSError * _Nullable error) {
-        
-        webworker::FetchResponse fetchResponse;
-        fetchResponse.requestId = requestIdStr;
-        
-        if (error) {
-            fetchResponse.error = [error.localizedDescription UTF8String];
-        } else {
-            NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
-            fetchResponse.status = (int)httpResponse.statusCode;
-            
-            // Headers
-            for (NSString *key in httpResponse.allHeaderFields) {
-                NSString *value = httpResponse.allHeaderFields[key];
-                fetchResponse.headers[[key UTF8String]] = [value UTF8String];
-            }
-            
-            // Body
-            if (data) {
-                const uint8_t *bytes = (const uint8_t *)[data bytes];
-                fetchResponse.body.assign(bytes, bytes + [data length]);
-            }
-        }
-        
-        if (self->_core) {
-            self->_core->handleFetchResponse(workerIdStr, fetchResponse);
-        }
-    }];
+    // The core's FetchCache already did the caching and revalidation
+    if (workerId == webworker::FetchCache::kWorkerId) {
+        urlRequest.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+    }
     
+    WebworkerFetchState *state =
+        [[WebworkerFetchState alloc] initWithCore:_core
+                                         workerId:workerId
+                                        requestId:request.requestId];
+
+    NSURLSessionDataTask *task = [[self fetchSession] dataTaskWithRequest:urlRequest];
+    [_fetchRouter addTask:task state:state];
     [task resume];
 }
 
+// Created on first use and kept until invalidate, so requests to the same
+// host reuse its connections instead of paying a handshake each.
+- (NSURLSession *)fetchSession {
+  @synchronized(self) {
+    if (!_fetchSession) {
+      _fetchRouter = [[WebworkerFetchRouter alloc] init];
+
+      // Delegate calls only route to WebworkerFetchState, which does the
+      // blocking on its own queue, so a serial one keeps them in order
+      NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+      delegateQueue.maxConcurrentOperationCount = 1;
+
+      // sharedSession's configuration, but our own delegate. Redirects are
+      // followed; 'error' and 'manual' would need willPerformHTTPRedirection.
+      _fetchSession = [NSURLSession
+          sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]
+                          delegate:_fetchRouter
+                     delegateQueue:delegateQueue];
+    }
+    return _fetchSession;
+  }
+}
+
 + (NSString *)moduleName {
   return @"Webworker";
 }
@@ -170,44 +408,63 @@
 }
 
 - (void)invalidate {
+  [[NSNotificationCenter defaultCenter] removeObserver:self];
   if (_core) {
     _core->terminateAll();
   }
+  // The session keeps its delegate alive until it is invalidated
+  @synchronized(self) {
+    [_fetchSession invalidateAndCancel];
+    _fetchSession = nil;
+  }
 }
 
 // MARK: - TurboModule Methods
 
 RCT_EXPORT_METHOD(createWorker : (NSString *)workerId scriptPath : (NSString *)
-                      scriptPath resolve : (RCTPromiseResolveBlock)
-                          resolve reject : (RCTPromiseRejectBlock)reject) {
-
-  // For scriptPath, we need to load the file content
-  NSError *error = nil;
-  NSString *scriptContent =
-      [NSString stringWithContentsOfFile:scriptPath
-                                encoding:NSUTF8StringEncoding
-                                   error:&error];
-
-  if (error) {
-    reject(@"FILE_ERROR",
-           [NSString stringWithFormat:@"Failed to read script file: %@",
-                                      error.localizedDescription],
-           error);
-    return;
-  }
+                      scriptPath maxHeapSizeMB : (double)
+                          maxHeapSizeMB initialHeapSizeMB : (double)
+                              initialHeapSizeMB gcMode : (NSString *)
+                                  gcMode stackSizeKB : (double)
+                                      stackSizeKB priority : (NSString *)
+                                          priority cpuAffinityMask : (double)
+                                              cpuAffinityMask threadName : (NSString *)
+                                                  threadName resolve : (RCTPromiseResolveBlock)
+                                                      resolve reject : (RCTPromiseRejectBlock)
+                                                          reject) {
+
+  // Source or Hermes bytecode; bytecode is mapped rather than read
+  std::string path = [scriptPath UTF8String];
+  std::string workerIdStr = [workerId UTF8String];
+  webworker::WorkerConfig config =
+      makeWorkerConfig(maxHeapSizeMB, initialHeapSizeMB, gcMode, stackSizeKB,
+                       priority, cpuAffinityMask, threadName);
 
   dispatch_async(
       dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        @try {
-          std::string resultId = self->_core->createWorker(
-              [workerId UTF8String], [scriptContent UTF8String]);
+        std::shared_ptr<const facebook::jsi::Buffer> script;
+        try {
+          script = webworker::MappedBuffer::openScript(path);
+        } catch (const std::exception &e) {
+          NSString *errorMsg = [NSString
+              stringWithFormat:@"Failed to read script file: %s", e.what()];
+          dispatch_async(dispatch_get_main_queue(), ^{
+            reject(@"FILE_ERROR", errorMsg, nil);
+          });
+          return;
+        }
+
+        try {
+          std::string resultId =
+              self->_core->createWorker(workerIdStr, script, config);
 
           dispatch_async(dispatch_get_main_queue(), ^{
             resolve([NSString stringWithUTF8String:resultId.c_str()]);
           });
-        } @catch (NSException *exception) {
+        } catch (const std::exception &e) {
+          NSString *errorMsg = [NSString stringWithUTF8String:e.what()];
           dispatch_async(dispatch_get_main_queue(), ^{
-            reject(@"WORKER_ERROR", exception.reason, nil);
+            reject(@"WORKER_ERROR", errorMsg, nil);
           });
         }
       });
@@ -215,14 +472,25 @@ RCT_EXPORT_METHOD(createWorker : (NSString *)workerId scriptPath : (NSString *)
 
 RCT_EXPORT_METHOD(createWorkerWithScript : (NSString *)
                       workerId scriptContent : (NSString *)
-                          scriptContent resolve : (RCTPromiseResolveBlock)
-                              resolve reject : (RCTPromiseRejectBlock)reject) {
+                          scriptContent maxHeapSizeMB : (double)
+                              maxHeapSizeMB initialHeapSizeMB : (double)
+                                  initialHeapSizeMB gcMode : (NSString *)
+                                      gcMode stackSizeKB : (double)
+                                          stackSizeKB priority : (NSString *)
+                                              priority cpuAffinityMask : (double)
+                                                  cpuAffinityMask threadName : (NSString *)
+                                                      threadName resolve : (RCTPromiseResolveBlock)
+                                                          resolve reject : (RCTPromiseRejectBlock)
+                                                              reject) {
 
   dispatch_async(
       dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
         try {
           std::string resultId = self->_core->createWorker(
-              [workerId UTF8String], [scriptContent UTF8String]);
+              [workerId UTF8String], [scriptContent UTF8String],
+              makeWorkerConfig(maxHeapSizeMB, initialHeapSizeMB, gcMode,
+                               stackSizeKB, priority, cpuAffinityMask,
+                               threadName));
 
           dispatch_async(dispatch_get_main_queue(), ^{
             resolve([NSString stringWithUTF8String:resultId.c_str()]);
@@ -275,24 +543,165 @@ RCT_EXPORT_METHOD(evalScript : (NSString *)workerId script : (NSString *)
                       script resolve : (RCTPromiseResolveBlock)
                           resolve reject : (RCTPromiseRejectBlock)reject) {
 
+  // Runs as a task on the worker's event loop, no thread waits for it
+  _core->evalScriptAsync(
+      [workerId UTF8String], [script UTF8String],
+      [resolve, reject](const std::string &result, const std::string &error) {
+        if (error.empty()) {
+          resolve([NSString stringWithUTF8String:result.c_str()]);
+        } else {
+          reject(@"EVAL_ERROR", [NSString stringWithUTF8String:error.c_str()],
+                 nil);
+        }
+      });
+}
+
+RCT_EXPORT_METHOD(startProfiling : (NSString *)workerId resolve : (
+    RCTPromiseResolveBlock)resolve reject : (RCTPromiseRejectBlock)reject) {
+
+  _core->startProfiling(
+      [workerId UTF8String],
+      [resolve, reject](const std::string &, const std::string &error) {
+        if (error.empty()) {
+          resolve(nil);
+        } else {
+          reject(@"PROFILER_ERROR",
+                 [NSString stringWithUTF8String:error.c_str()], nil);
+        }
+      });
+}
+
+RCT_EXPORT_METHOD(stopProfiling : (NSString *)workerId resolve : (
+    RCTPromiseResolveBlock)resolve reject : (RCTPromiseRejectBlock)reject) {
+
+  NSCharacterSet *unsafe =
+      [[NSCharacterSet alphanumericCharacterSet] invertedSet];
+  NSString *name = [[workerId componentsSeparatedByCharactersInSet:unsafe]
+      componentsJoinedByString:@"_"];
+  NSString *fileName = [NSString
+      stringWithFormat:@"%@-%lld.cpuprofile", name,
+                       (long long)([[NSDate date] timeIntervalSince1970] * 1000)];
+  NSString *path =
+      [NSTemporaryDirectory() stringByAppendingPathComponent:fileName];
+
+  _core->stopProfiling(
+      [workerId UTF8String], [path UTF8String],
+      [resolve, reject](const std::string &result, const std::string &error) {
+        if (error.empty()) {
+          resolve([NSString stringWithUTF8String:result.c_str()]);
+        } else {
+          reject(@"PROFILER_ERROR",
+                 [NSString stringWithUTF8String:error.c_str()], nil);
+        }
+      });
+}
+
+RCT_EXPORT_METHOD(createPool : (NSString *)poolId scriptPath : (NSString *)
+                      scriptPath size : (double)size resolve : (
+                          RCTPromiseResolveBlock)resolve reject : (
+                              RCTPromiseRejectBlock)reject) {
+
+  std::string path = [scriptPath UTF8String];
+  std::string poolIdStr = [poolId UTF8String];
+  size_t poolSize = size > 0 ? static_cast<size_t>(size) : 0;
+
+  dispatch_async(
+      dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        std::shared_ptr<const facebook::jsi::Buffer> script;
+        try {
+          script = webworker::MappedBuffer::openScript(path);
+        } catch (const std::exception &e) {
+          NSString *errorMsg = [NSString
+              stringWithFormat:@"Failed to read script file: %s", e.what()];
+          dispatch_async(dispatch_get_main_queue(), ^{
+            reject(@"FILE_ERROR", errorMsg, nil);
+          });
+          return;
+        }
+
+        try {
+          size_t started = self->_core->createPool(poolIdStr, script, poolSize);
+
+          dispatch_async(dispatch_get_main_queue(), ^{
+            resolve(@(started));
+          });
+        } catch (const std::exception &e) {
+          NSString *errorMsg = [NSString stringWithUTF8String:e.what()];
+          dispatch_async(dispatch_get_main_queue(), ^{
+            reject(@"WORKER_ERROR", errorMsg, nil);
+          });
+        }
+      });
+}
+
+RCT_EXPORT_METHOD(createPoolWithScript : (NSString *)
+                      poolId scriptContent : (NSString *)
+                          scriptContent size : (double)
+                              size resolve : (RCTPromiseResolveBlock)
+                                  resolve reject : (RCTPromiseRejectBlock)reject) {
+  [self createPool:poolId
+     scriptContent:scriptContent
+              size:size
+           resolve:resolve
+            reject:reject];
+}
+
+- (void)createPool:(NSString *)poolId
+     scriptContent:(NSString *)scriptContent
+              size:(double)size
+           resolve:(RCTPromiseResolveBlock)resolve
+            reject:(RCTPromiseRejectBlock)reject {
+  size_t poolSize = size > 0 ? static_cast<size_t>(size) : 0;
+
   dispatch_async(
       dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
         try {
-          std::string result = self->_core->evalScript([workerId UTF8String],
-                                                       [script UTF8String]);
+          size_t started = self->_core->createPool(
+              [poolId UTF8String], [scriptContent UTF8String], poolSize);
 
           dispatch_async(dispatch_get_main_queue(), ^{
-            resolve([NSString stringWithUTF8String:result.c_str()]);
+            resolve(@(started));
           });
         } catch (const std::exception &e) {
           NSString *errorMsg = [NSString stringWithUTF8String:e.what()];
           dispatch_async(dispatch_get_main_queue(), ^{
-            reject(@"EVAL_ERROR", errorMsg, nil);
+            reject(@"WORKER_ERROR", errorMsg, nil);
           });
         }
       });
 }
 
+RCT_EXPORT_METHOD(terminatePool : (NSString *)poolId resolve : (
+    RCTPromiseResolveBlock)resolve reject : (RCTPromiseRejectBlock)reject) {
+
+  dispatch_async(
+      dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        bool success = self->_core->terminatePool([poolId UTF8String]);
+
+        dispatch_async(dispatch_get_main_queue(), ^{
+          resolve(@(success));
+        });
+      });
+}
+
+RCT_EXPORT_METHOD(setWarmPoolSize : (double)size) {
+  _core->setWarmPoolSize(size > 0 ? static_cast<size_t>(size) : 0);
+}
+
+RCT_EXPORT_METHOD(setConsoleLevel : (NSString *)level) {
+  _core->setConsoleLevel(
+      webworker::parseConsoleLevel(level ? [level UTF8String] : ""));
+}
+
+// MARK: - JSI Bindings
+
+- (void)installJSIBindingsWithRuntime:(facebook::jsi::Runtime &)runtime
+                          callInvoker:
+                              (const std::shared_ptr<facebook::react::CallInvoker> &)
+                                  callInvoker {
+  webworker::WebWorkerBinding::install(runtime, _core, callInvoker);
+}
+
 // MARK: - TurboModule Support
 
 - (std::shared_ptr<facebook::react::TurboModule>)getTurboModule:
@@ -1,7 +1,10 @@
 const fs = require('fs');
 const path = require('path');
+const os = require('os');
+const { execFileSync } = require('child_process');
 
 const bundlePath = path.join(__dirname, '..', 'dist', 'polyfills.bundle.js');
+const bytecodePath = path.join(__dirname, '..', 'dist', 'polyfills.hbc');
 const headerPath = path.join(__dirname, '..', 'dist', 'Polyfills.h');
 const cppTargetPath = path.join(
   __dirname,
@@ -14,19 +17,118 @@ const cppTargetPath = path.join(
 
 const bundleContent = fs.readFileSync(bundlePath, 'utf-8');
 
+// Locate a Hermes compiler. HERMESC_PATH wins, otherwise look into the
+// packages React Native ships hermesc with.
+function findHermesc() {
+  if (process.env.HERMESC_PATH) {
+    return process.env.HERMESC_PATH;
+  }
+
+  const osBin = {
+    darwin: 'osx-bin',
+    linux: 'linux64-bin',
+    win32: 'win64-bin',
+  }[os.platform()];
+  if (!osBin) {
+    return null;
+  }
+  const binary = os.platform() === 'win32' ? 'hermesc.exe' : 'hermesc';
+
+  const candidates = [
+    ['hermes-compiler', 'hermesc'],
+    ['react-native', 'sdks', 'hermesc'],
+  ];
+
+  for (const [pkg, ...rest] of candidates) {
+    try {
+      const pkgRoot = path.dirname(
+        require.resolve(`${pkg}/package.json`, {
+          paths: [path.join(__dirname, '..'), path.join(__dirname, '..', '..', '..')],
+        })
+      );
+      const candidate = path.join(pkgRoot, ...rest, osBin, binary);
+      if (fs.existsSync(candidate)) {
+        return candidate;
+      }
+    } catch {
+      // Package not installed, try the next one
+    }
+  }
+
+  return null;
+}
+
+// Compile the bundle to Hermes bytecode. Returns null when no compiler is
+// available or it fails; the runtime then falls back to compiling the source
+// once.
+function compileBytecode() {
+  const hermesc = findHermesc();
+  if (!hermesc) {
+    console.warn('hermesc not found, emitting source-only header');
+    return null;
+  }
+
+  try {
+    execFileSync(hermesc, [
+      '-emit-binary',
+      '-O',
+      '-out',
+      bytecodePath,
+      bundlePath,
+    ]);
+  } catch (error) {
+    console.warn(
+      `hermesc failed (${hermesc}), emitting source-only header: ${error.message}`
+    );
+    return null;
+  }
+  console.log(`Bytecode created: dist/polyfills.hbc (${hermesc})`);
+  return fs.readFileSync(bytecodePath);
+}
+
+function formatBytecode(bytecode) {
+  if (!bytecode || bytecode.length === 0) {
+    return `constexpr const unsigned char* kPolyfillBytecode = nullptr;
+constexpr size_t kPolyfillBytecodeSize = 0;`;
+  }
+
+  const lines = [];
+  for (let i = 0; i < bytecode.length; i += 16) {
+    const chunk = Array.from(bytecode.subarray(i, i + 16))
+      .map((byte) => `0x${byte.toString(16).padStart(2, '0')}`)
+      .join(', ');
+    lines.push(`    ${chunk},`);
+  }
+
+  return `alignas(8) constexpr unsigned char kPolyfillBytecode[] = {
+${lines.join('\n')}
+};
+constexpr size_t kPolyfillBytecodeSize = sizeof(kPolyfillBytecode);`;
+}
+
+const bytecode = compileBytecode();
+
 // Use a delimiter that won't appear in the minified JS bundle
 // R"POLYFILL(...)POLYFILL" allows the content to contain )" sequences
+//
+// kPolyfillBytecode is only usable when the Hermes version linked into the app
+// understands its bytecode version; the runtime checks that and falls back to
+// kPolyfillScript otherwise.
 const header = `// Auto-generated file - DO NOT EDIT
 // Generated by: packages/polyfills/scripts/generate-header.js
 
 #pragma once
 
+#include <cstddef>
+
 namespace webworker {
 
 constexpr const char* kPolyfillScript = R"POLYFILL(
 ${bundleContent}
 )POLYFILL";
 
+${formatBytecode(bytecode)}
+
 } // namespace webworker
 `;
 
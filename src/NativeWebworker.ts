@@ -2,11 +2,8 @@ import type { TurboModule, CodegenTypes } from 'react-native';
 import { TurboModuleRegistry } from 'react-native';
 
 // Event payload types
-export type WorkerMessageEvent = {
-  workerId: string;
-  message: string;
-};
-
+// Worker messages don't use an event: they go through the JSI binding,
+// see WebWorkerBinding.ts
 export type WorkerConsoleEvent = {
   workerId: string;
   level: string;
@@ -20,16 +17,35 @@ export type WorkerErrorEvent = {
 
 export interface Spec extends TurboModule {
   /**
-   * Create a worker from a script file path
+   * Create a worker from a script file path.
+   * Heap sizes of 0 and an empty gcMode keep the Hermes defaults. A stack
+   * size of 0, an empty priority, mask or name keep the platform's.
    */
-  createWorker(workerId: string, scriptPath: string): Promise<string>;
+  createWorker(
+    workerId: string,
+    scriptPath: string,
+    maxHeapSizeMB: number,
+    initialHeapSizeMB: number,
+    gcMode: string,
+    stackSizeKB: number,
+    priority: string,
+    cpuAffinityMask: number,
+    threadName: string
+  ): Promise<string>;
 
   /**
    * Create a worker from inline script content
    */
   createWorkerWithScript(
     workerId: string,
-    scriptContent: string
+    scriptContent: string,
+    maxHeapSizeMB: number,
+    initialHeapSizeMB: number,
+    gcMode: string,
+    stackSizeKB: number,
+    priority: string,
+    cpuAffinityMask: number,
+    threadName: string
   ): Promise<string>;
 
   /**
@@ -38,7 +54,7 @@ export interface Spec extends TurboModule {
   terminateWorker(workerId: string): Promise<boolean>;
 
   /**
-   * Post a message to a worker
+   * Post a JSON-encoded message to a worker
    */
   postMessage(workerId: string, message: string): Promise<boolean>;
 
@@ -48,9 +64,47 @@ export interface Spec extends TurboModule {
   evalScript(workerId: string, script: string): Promise<string>;
 
   /**
-   * Event emitted when a worker posts a message to the host
+   * Start the Hermes sampling profiler on a worker's thread
+   */
+  startProfiling(workerId: string): Promise<void>;
+
+  /**
+   * Stop profiling a worker. Resolves to the path of the written
+   * .cpuprofile (Chrome DevTools format).
+   */
+  stopProfiling(workerId: string): Promise<string>;
+
+  /**
+   * Start a native WorkerPool of `size` workers running a script file.
+   * 0 starts one worker per hardware thread. Resolves to the pool size.
+   */
+  createPool(poolId: string, scriptPath: string, size: number): Promise<number>;
+
+  /**
+   * Start a native WorkerPool of `size` workers running inline script content
+   */
+  createPoolWithScript(
+    poolId: string,
+    scriptContent: string,
+    size: number
+  ): Promise<number>;
+
+  /**
+   * Terminate a WorkerPool. Its unfinished jobs fail.
+   */
+  terminatePool(poolId: string): Promise<boolean>;
+
+  /**
+   * Keep `size` pre-initialized worker runtimes ready so that creating a
+   * worker only has to run its script. 0 disables the pool.
+   */
+  setWarmPoolSize(size: number): void;
+
+  /**
+   * Drop worker console output below `level` ('log', 'info', 'warn',
+   * 'error' or 'none') before it leaves the worker.
    */
-  readonly onWorkerMessage: CodegenTypes.EventEmitter<WorkerMessageEvent>;
+  setConsoleLevel(level: string): void;
 
   /**
    * Event emitted when a worker logs to console
@@ -58,7 +112,8 @@ export interface Spec extends TurboModule {
   readonly onWorkerConsole: CodegenTypes.EventEmitter<WorkerConsoleEvent>;
 
   /**
-   * Event emitted when a worker encounters an error
+   * Event emitted when a worker encounters an error.
+   * Worker instances get their errors through the JSI binding instead.
    */
   readonly onWorkerError: CodegenTypes.EventEmitter<WorkerErrorEvent>;
 }
@@ -0,0 +1,189 @@
+// Loading the TurboModule installs the binding
+import './NativeWebworker';
+import type { MessagePort, Transferable } from './index';
+
+/** Durations of the timed tasks, in microseconds */
+export interface LatencyStats {
+  count: number;
+  mean: number;
+  /** Percentiles are the upper bound of a power-of-two bucket */
+  p50: number;
+  p90: number;
+  p99: number;
+  max: number;
+}
+
+/** What a worker has been doing, see Worker.getStats() */
+export interface WorkerStats {
+  /** Tasks waiting to run */
+  queue: {
+    /** Messages, fetch results, evaluations */
+    immediate: number;
+    /** setImmediate, MessageChannel */
+    local: number;
+    /** Timers */
+    delayed: number;
+  };
+  tasksRun: number;
+  /** From being queued, or a timer being due, until the task started */
+  taskLatency: LatencyStats;
+  /** Running the task itself */
+  taskDuration: LatencyStats;
+  /** Running the microtasks queued by the task */
+  microtaskDrain: LatencyStats;
+  messagesIn: number;
+  messagesOut: number;
+  /** Serialized size of the messages */
+  bytesIn: number;
+  bytesOut: number;
+  pendingFetches: number;
+  /** Response bodies still downloading */
+  streamingFetches: number;
+  /**
+   * The worker thread as the platform reports it after the last change of
+   * its thread options. A priority the platform doesn't map back reads as
+   * 'default'; names are truncated to 15 characters on Android.
+   */
+  thread: {
+    name: string;
+    priority: string;
+  };
+  /** Hermes heap info as of the last sample, taken at most once a second */
+  heap: Record<string, number>;
+}
+
+/**
+ * JSI binding installed into this runtime by the native module.
+ * Messages are structured-cloned natively, so they may contain Map, Set,
+ * Date, typed arrays and cyclic references.
+ */
+export interface WebWorkerBinding {
+  /**
+   * Resolve a worker id to its native handle, 0 if there is no such worker.
+   * Posting by handle skips the id lookup on every message.
+   */
+  resolveWorker(workerId: string): number;
+
+  /**
+   * Post a message to a worker, by handle or id. ArrayBuffers and
+   * MessagePorts in `transfer` are moved instead of copied.
+   * @returns false if the worker doesn't exist or isn't running
+   */
+  postMessage(
+    worker: number | string,
+    message: unknown,
+    transfer?: Transferable[]
+  ): boolean;
+
+  /**
+   * Set the function receiving the messages posted by one worker.
+   * Messages of a worker without a handler are dropped undecoded.
+   */
+  setWorkerMessageHandler(
+    workerId: string,
+    handler: ((data: unknown) => void) | null
+  ): void;
+
+  /**
+   * Set the function receiving the uncaught errors of one worker
+   */
+  setWorkerErrorHandler(
+    workerId: string,
+    handler: ((error: string) => void) | null
+  ): void;
+
+  /**
+   * Queue a job on a native WorkerPool. The result arrives through the
+   * pool result handler under the same `jobId`.
+   * @returns false if the pool doesn't exist or was terminated
+   */
+  submitPoolJob(
+    poolId: string,
+    jobId: number,
+    data: unknown,
+    transfer?: Transferable[]
+  ): boolean;
+
+  /**
+   * Give up on a pool job: it is dropped if still queued, or its worker
+   * moves on to the next job. No result is reported for it.
+   * @returns false if the job already finished or the pool doesn't exist
+   */
+  cancelPoolJob(poolId: string, jobId: number): boolean;
+
+  /**
+   * Post a message to every worker of a pool
+   * @returns false if the pool doesn't exist
+   */
+  broadcastPool(poolId: string, message: unknown): boolean;
+
+  /**
+   * Set the function receiving every pool job result.
+   * `error` is null when the job succeeded.
+   */
+  setPoolResultHandler(
+    handler:
+      | ((
+          poolId: string,
+          jobId: number,
+          error: string | null,
+          data: unknown
+        ) => void)
+      | null
+  ): void;
+
+  /**
+   * Counters and timings of one worker, read without interrupting it
+   * @returns null if the worker doesn't exist
+   */
+  getWorkerStats(workerId: string): WorkerStats | null;
+
+  /**
+   * Time one task in `interval` in every worker. 0 only counts tasks.
+   */
+  setStatsSampleInterval(interval: number): void;
+
+  /**
+   * Bytes of a streamed response body buffered ahead of the reader, for
+   * responses from now on.
+   */
+  setFetchHighWaterMark(bytes: number): void;
+
+  /**
+   * Apply thread options to a running worker, on its own thread.
+   * An empty name keeps the current one.
+   * @returns false if the worker doesn't exist
+   */
+  setWorkerThreadOptions(
+    workerId: string,
+    priority: string,
+    cpuAffinityMask: number,
+    threadName: string
+  ): boolean;
+
+  /**
+   * Create a MessageChannel whose ports can be transferred to workers
+   */
+  createMessageChannel(): [MessagePort, MessagePort];
+
+  /** Number of workers a pool starts when no size is given */
+  readonly hardwareConcurrency: number;
+}
+
+declare global {
+  // eslint-disable-next-line no-var
+  var __WebWorkerBinding: WebWorkerBinding | undefined;
+}
+
+/**
+ * Get the JSI binding. It is installed when the native module is loaded.
+ */
+export function getBinding(): WebWorkerBinding {
+  const binding = globalThis.__WebWorkerBinding;
+  if (!binding) {
+    throw new Error(
+      'react-native-webworker: JSI binding is not installed. Make sure the New Architecture is enabled.'
+    );
+  }
+  return binding;
+}
@@ -1,8 +1,6 @@
-import NativeWebworker, {
-  type WorkerMessageEvent,
-  type WorkerErrorEvent,
-} from './NativeWebworker';
-import type { EventSubscription } from 'react-native';
+import NativeWebworker from './NativeWebworker';
+import { getBinding } from './WebWorkerBinding';
+import type { WorkerStats } from './WebWorkerBinding';
 
 // Types
 export interface WorkerOptions {
@@ -12,8 +10,47 @@ export interface WorkerOptions {
   scriptPath?: string;
   /** Optional name for the worker */
   name?: string;
+  /** Upper bound of the worker's Hermes heap, in megabytes */
+  maxHeapSizeMB?: number;
+  /** Heap the worker starts with, in megabytes */
+  initialHeapSizeMB?: number;
+  /**
+   * 'compact' returns freed memory to the OS after every collection,
+   * 'throughput' keeps it around for reuse. Defaults to Hermes' own policy.
+   */
+  gcMode?: 'default' | 'compact' | 'throughput';
+  /** Stack size of the worker thread, in kilobytes */
+  stackSizeKB?: number;
+  /** Scheduling of the worker thread, see `worker.setThreadOptions()` */
+  thread?: WorkerThreadOptions;
+}
+
+/**
+ * Scheduling of a worker's thread. Unset fields keep the platform defaults.
+ */
+export interface WorkerThreadOptions {
+  /**
+   * iOS QoS class of the thread. Android maps it to a nice value, from
+   * THREAD_PRIORITY_BACKGROUND for 'background' to THREAD_PRIORITY_DISPLAY
+   * for 'userInteractive'.
+   */
+  priority?: ThreadPriority;
+  /**
+   * Cores the thread may run on, bit n standing for core n (Android only).
+   * 0 allows every core.
+   */
+  cpuAffinityMask?: number;
+  /** Thread name shown by profilers, truncated to 15 bytes on Android */
+  name?: string;
 }
 
+export type ThreadPriority =
+  | 'default'
+  | 'background'
+  | 'utility'
+  | 'userInitiated'
+  | 'userInteractive';
+
 export interface MessageEvent<T = unknown> {
   data: T;
   type: 'message';
@@ -21,24 +58,62 @@ export interface MessageEvent<T = unknown> {
 
 export type MessageHandler<T = unknown> = (event: MessageEvent<T>) => void;
 
+/**
+ * One end of a MessageChannel. Inside a worker, `MessagePort` is a global.
+ * Like in a browser, setting `onmessage` starts the port, while listeners
+ * added with `addEventListener` wait for `start()`.
+ */
+export interface MessagePort<T = unknown> {
+  onmessage: MessagePortHandler<T> | null;
+  postMessage(
+    message: T,
+    transfer?: Transferable[] | StructuredSerializeOptions
+  ): void;
+  start(): void;
+  close(): void;
+  addEventListener(type: 'message', listener: MessagePortHandler<T>): void;
+  removeEventListener(type: 'message', listener: MessagePortHandler<T>): void;
+}
+
+export type MessagePortHandler<T = unknown> = (
+  event: MessageEvent<T> & { target: MessagePort<T> }
+) => void;
+
+/** Objects whose ownership can be moved to a worker instead of being copied */
+export type Transferable = ArrayBuffer | MessagePort;
+
+export interface StructuredSerializeOptions {
+  transfer?: Transferable[];
+}
+
 /**
  * High-level Worker class that wraps the native WebWorker module.
  * Provides a Web Worker-like API for React Native.
  */
 export class Worker<TIn = unknown, TOut = unknown> {
   private workerId: string;
+  private handle: number = 0;
   private isTerminated: boolean = false;
   private messageHandlers: Set<MessageHandler<TOut>> = new Set();
   private _onmessage: MessageHandler<TOut> | null = null;
   private _onerror: ((error: Error) => void) | null = null;
+  private threadOptions: WorkerThreadOptions;
   private initPromise: Promise<void>;
-  private messageSubscription: EventSubscription | null = null;
-  private errorSubscription: EventSubscription | null = null;
 
   constructor(options: WorkerOptions) {
-    const { script, scriptPath, name } = options;
+    const {
+      script,
+      scriptPath,
+      name,
+      maxHeapSizeMB = 0,
+      initialHeapSizeMB = 0,
+      gcMode = 'default',
+      stackSizeKB = 0,
+      thread = {},
+    } = options;
     this.workerId =
       name || `worker-${Date.now()}-${Math.random().toString(36).substr(2, 9)}`;
+    this.threadOptions = { ...thread };
 
     // Setup event listeners for this worker
     this.setupEventListeners();
@@ -46,12 +121,26 @@ export class Worker<TIn = unknown, TOut = unknown> {
     if (script) {
       this.initPromise = NativeWebworker.createWorkerWithScript(
         this.workerId,
-        script
+        script,
+        maxHeapSizeMB,
+        initialHeapSizeMB,
+        gcMode,
+        stackSizeKB,
+        thread.priority ?? 'default',
+        thread.cpuAffinityMask ?? 0,
+        thread.name ?? ''
       ).then(() => {});
     } else if (scriptPath) {
       this.initPromise = NativeWebworker.createWorker(
         this.workerId,
-        scriptPath
+        scriptPath,
+        maxHeapSizeMB,
+        initialHeapSizeMB,
+        gcMode,
+        stackSizeKB,
+        thread.priority ?? 'default',
+        thread.cpuAffinityMask ?? 0,
+        thread.name ?? ''
       ).then(() => {});
     } else {
       throw new Error('Either script or scriptPath must be provided');
@@ -59,42 +148,25 @@ export class Worker<TIn = unknown, TOut = unknown> {
   }
 
   private setupEventListeners(): void {
-    // Listen for messages from this worker using CodegenTypes.EventEmitter
-    this.messageSubscription = NativeWebworker.onWorkerMessage(
-      (event: WorkerMessageEvent) => {
-        if (event.workerId === this.workerId && !this.isTerminated) {
-          try {
-            const data = JSON.parse(event.message) as TOut;
-            this.dispatchMessage(data);
-          } catch {
-            // If parsing fails, dispatch the raw message
-            this.dispatchMessage(event.message as unknown as TOut);
-          }
-        }
+    // The JSI binding calls this worker's handlers directly on the JS
+    // thread, with messages already deserialized
+    const binding = getBinding();
+    binding.setWorkerMessageHandler(this.workerId, (data) => {
+      if (!this.isTerminated) {
+        this.dispatchMessage(data as TOut);
       }
-    );
-
-    // Listen for errors from this worker using CodegenTypes.EventEmitter
-    this.errorSubscription = NativeWebworker.onWorkerError(
-      (event: WorkerErrorEvent) => {
-        if (event.workerId === this.workerId && !this.isTerminated) {
-          if (this._onerror) {
-            this._onerror(new Error(event.error));
-          }
-        }
+    });
+    binding.setWorkerErrorHandler(this.workerId, (error) => {
+      if (!this.isTerminated && this._onerror) {
+        this._onerror(new Error(error));
       }
-    );
+    });
   }
 
   private cleanupEventListeners(): void {
-    if (this.messageSubscription) {
-      this.messageSubscription.remove();
-      this.messageSubscription = null;
-    }
-    if (this.errorSubscription) {
-      this.errorSubscription.remove();
-      this.errorSubscription = null;
-    }
+    const binding = getBinding();
+    binding.setWorkerMessageHandler(this.workerId, null);
+    binding.setWorkerErrorHandler(this.workerId, null);
   }
 
   /**
@@ -138,17 +210,28 @@ export class Worker<TIn = unknown, TOut = unknown> {
   }
 
   /**
-   * Post a message to the worker
+   * Post a message to the worker.
+   * The message is copied with the structured clone algorithm, except for
+   * the ArrayBuffers and MessagePorts listed in `transfer`, which are moved
+   * to the worker. Hermes can't detach ArrayBuffers, so there they are
+   * copied too and the sender keeps its own.
    */
-  async postMessage(message: TIn): Promise<void> {
+  async postMessage(
+    message: TIn,
+    transfer?: Transferable[] | StructuredSerializeOptions
+  ): Promise<void> {
     if (this.isTerminated) {
       throw new Error('Worker has been terminated');
     }
 
     await this.initPromise;
 
-    const serialized = JSON.stringify(message);
-    await NativeWebworker.postMessage(this.workerId, serialized);
+    const transferList = Array.isArray(transfer) ? transfer : transfer?.transfer;
+    const binding = getBinding();
+    if (this.handle === 0) {
+      this.handle = binding.resolveWorker(this.workerId);
+    }
+    binding.postMessage(this.handle || this.workerId, message, transferList);
   }
 
   /**
@@ -164,6 +247,56 @@ export class Worker<TIn = unknown, TOut = unknown> {
     return await NativeWebworker.evalScript(this.workerId, script);
   }
 
+  /**
+   * Start sampling the worker's JavaScript with the Hermes profiler
+   */
+  async startProfiling(): Promise<void> {
+    if (this.isTerminated) {
+      throw new Error('Worker has been terminated');
+    }
+
+    await this.initPromise;
+
+    await NativeWebworker.startProfiling(this.workerId);
+  }
+
+  /**
+   * Stop profiling and write what was sampled to a .cpuprofile file, which
+   * Chrome DevTools can open.
+   * @returns the path of the file
+   */
+  async stopProfiling(): Promise<string> {
+    if (this.isTerminated) {
+      throw new Error('Worker has been terminated');
+    }
+
+    await this.initPromise;
+
+    return await NativeWebworker.stopProfiling(this.workerId);
+  }
+
+  /**
+   * Change the priority, CPU affinity or name of the worker's thread, e.g.
+   * to demote it while its screen is in the background. Fields left out
+   * keep their current value. Applied once the worker is done with its
+   * current task.
+   */
+  async setThreadOptions(options: WorkerThreadOptions): Promise<void> {
+    if (this.isTerminated) {
+      throw new Error('Worker has been terminated');
+    }
+
+    await this.initPromise;
+
+    this.threadOptions = { ...this.threadOptions, ...options };
+    getBinding().setWorkerThreadOptions(
+      this.workerId,
+      this.threadOptions.priority ?? 'default',
+      this.threadOptions.cpuAffinityMask ?? 0,
+      this.threadOptions.name ?? ''
+    );
+  }
+
   /**
    * Terminate the worker
    */
@@ -187,6 +320,14 @@ export class Worker<TIn = unknown, TOut = unknown> {
     return this.workerId;
   }
 
+  /**
+   * Queue depths, task timings, message counts and heap usage of the
+   * worker. Null until the worker has started and after it terminated.
+   */
+  getStats(): WorkerStats | null {
+    return getBinding().getWorkerStats(this.workerId);
+  }
+
   /**
    * Dispatch a message event to all handlers
    * (Called internally when receiving messages from the worker)
@@ -219,119 +360,188 @@ export class Worker<TIn = unknown, TOut = unknown> {
   }
 }
 
+/**
+ * A pair of entangled ports. Transfer them to two workers to let them talk
+ * directly: their messages never go through the JS thread.
+ *
+ * @example
+ * const channel = new MessageChannel();
+ * producer.postMessage({ port: channel.port1 }, [channel.port1]);
+ * consumer.postMessage({ port: channel.port2 }, [channel.port2]);
+ */
+export class MessageChannel<T = unknown> {
+  readonly port1: MessagePort<T>;
+  readonly port2: MessagePort<T>;
+
+  constructor() {
+    const [port1, port2] = getBinding().createMessageChannel();
+    this.port1 = port1 as MessagePort<T>;
+    this.port2 = port2 as MessagePort<T>;
+  }
+}
+
 /**
  * Options for creating a WorkerPool
  */
 export interface WorkerPoolOptions {
-  /** Number of workers in the pool */
-  size: number;
+  /** Number of workers in the pool, defaults to one per hardware thread */
+  size?: number;
   /** Inline script content for all workers */
   script?: string;
   /** Path to the script file */
   scriptPath?: string;
-  /** Optional name prefix for workers */
+  /** Optional name for the pool */
   name?: string;
+  /**
+   * Milliseconds a job may take before it is rejected and its worker moves
+   * on, e.g. for a handler that never posts. Defaults to no limit.
+   */
+  jobTimeout?: number;
+}
+
+type PendingJob = {
+  resolve: (value: unknown) => void;
+  reject: (error: Error) => void;
+  timer?: ReturnType<typeof setTimeout>;
+};
+
+// Routes job results from the JSI binding to the WorkerPool they belong to
+const poolRoutes = new Map<
+  string,
+  (jobId: number, error: string | null, data: unknown) => void
+>();
+let poolResultHandlerInstalled = false;
+
+function routePoolResults(): void {
+  if (poolResultHandlerInstalled) {
+    return;
+  }
+  getBinding().setPoolResultHandler((poolId, jobId, error, data) => {
+    poolRoutes.get(poolId)?.(jobId, error, data);
+  });
+  poolResultHandlerInstalled = true;
 }
 
 /**
  * WorkerPool for parallel processing using multiple workers.
- * Distributes tasks across workers and aggregates results.
+ *
+ * Scheduling happens natively: every worker has a queue of jobs and idle
+ * workers steal from busy ones, so results don't wait on the JS thread.
+ * Each job is delivered to the worker's `onmessage`, and the first message
+ * the worker posts back is the job's result.
  */
 export class WorkerPool<TIn = unknown, TOut = unknown> {
-  private workers: Worker<TIn, TOut>[] = [];
+  private poolId: string;
   private size: number;
   private isTerminated: boolean = false;
+  private nextJobId: number = 1;
+  private pendingJobs: Map<number, PendingJob> = new Map();
+  private jobTimeout: number | undefined;
+  private initPromise: Promise<void>;
+
+  constructor(options: WorkerPoolOptions = {}) {
+    const { script, scriptPath, name } = options;
+    this.jobTimeout = options.jobTimeout;
+    this.poolId =
+      name || `pool-${Date.now()}-${Math.random().toString(36).substr(2, 9)}`;
+    this.size = options.size ?? getBinding().hardwareConcurrency;
+
+    routePoolResults();
+    poolRoutes.set(this.poolId, (jobId, error, data) =>
+      this.settleJob(jobId, error, data)
+    );
 
-  constructor(options: WorkerPoolOptions) {
-    const { size, script, scriptPath, name } = options;
-    this.size = size;
-
-    for (let i = 0; i < size; i++) {
-      const workerName = name ? `${name}-${i}` : undefined;
-      this.workers.push(
-        new Worker<TIn, TOut>({
-          script,
-          scriptPath,
-          name: workerName,
-        })
-      );
+    if (script) {
+      this.initPromise = NativeWebworker.createPoolWithScript(
+        this.poolId,
+        script,
+        this.size
+      ).then((size) => {
+        this.size = size;
+      });
+    } else if (scriptPath) {
+      this.initPromise = NativeWebworker.createPool(
+        this.poolId,
+        scriptPath,
+        this.size
+      ).then((size) => {
+        this.size = size;
+      });
+    } else {
+      poolRoutes.delete(this.poolId);
+      throw new Error('Either script or scriptPath must be provided');
     }
   }
 
   /**
-   * Run tasks in parallel across all workers.
-   * Each task is sent to a worker, and results are collected.
+   * Run one task on the next available worker.
+   * The task is copied with the structured clone algorithm, except for the
+   * ArrayBuffers and MessagePorts listed in `transfer`, which are moved to
+   * the worker. Hermes can't detach ArrayBuffers, so there they are copied
+   * too and the sender keeps its own.
    */
-  async run(tasks: TIn[]): Promise<TOut[]> {
+  async submit(task: TIn, transfer?: Transferable[]): Promise<TOut> {
     if (this.isTerminated) {
       throw new Error('WorkerPool has been terminated');
     }
 
-    const results: TOut[] = new Array(tasks.length);
-    const taskQueue = tasks.map((task, index) => ({ task, index }));
-    const availableWorkers = [...this.workers];
-
-    const processTask = async (
-      worker: Worker<TIn, TOut>,
-      task: TIn,
-      index: number
-    ): Promise<void> => {
-      return new Promise((resolve, reject) => {
-        const handler = (event: MessageEvent<TOut>) => {
-          results[index] = event.data;
-          worker.removeEventListener('message', handler);
-          availableWorkers.push(worker);
-          processNextTask();
-          resolve();
-        };
-
-        worker.addEventListener('message', handler);
-        worker.postMessage(task).catch(reject);
-      });
-    };
-
-    let currentTaskIndex = 0;
-    const runningTasks: Promise<void>[] = [];
-
-    const processNextTask = () => {
-      if (currentTaskIndex >= taskQueue.length) return;
-
-      const worker = availableWorkers.pop();
-      if (!worker) return;
-
-      const { task, index } = taskQueue[currentTaskIndex]!;
-      currentTaskIndex++;
+    await this.initPromise;
 
-      const taskPromise = processTask(worker, task, index);
-      runningTasks.push(taskPromise);
-    };
+    const jobId = this.nextJobId++;
+    return new Promise<TOut>((resolve, reject) => {
+      const job: PendingJob = {
+        resolve: resolve as (value: unknown) => void,
+        reject,
+      };
+      this.pendingJobs.set(jobId, job);
+      if (!getBinding().submitPoolJob(this.poolId, jobId, task, transfer)) {
+        this.pendingJobs.delete(jobId);
+        reject(new Error('WorkerPool has been terminated'));
+        return;
+      }
 
-    // Start initial batch
-    const initialBatchSize = Math.min(this.size, taskQueue.length);
-    for (let i = 0; i < initialBatchSize; i++) {
-      processNextTask();
-    }
+      const timeout = this.jobTimeout;
+      if (timeout !== undefined) {
+        job.timer = setTimeout(() => {
+          this.pendingJobs.delete(jobId);
+          getBinding().cancelPoolJob(this.poolId, jobId);
+          reject(new Error(`Job timed out after ${timeout}ms`));
+        }, timeout);
+      }
+    });
+  }
 
-    await Promise.all(runningTasks);
+  /**
+   * Run tasks in parallel across all workers.
+   * Results are returned in the order of `tasks`.
+   */
+  async map(tasks: TIn[]): Promise<TOut[]> {
+    return Promise.all(tasks.map((task) => this.submit(task)));
+  }
 
-    return results;
+  /**
+   * Run tasks in parallel across all workers. Same as map().
+   */
+  async run(tasks: TIn[]): Promise<TOut[]> {
+    return this.map(tasks);
   }
 
   /**
-   * Execute a function on all workers
+   * Post a message to all workers. Workers must not reply to it,
+   * a reply would be taken as the result of their current job.
    */
   async broadcast(message: TIn): Promise<void> {
     if (this.isTerminated) {
       throw new Error('WorkerPool has been terminated');
     }
 
-    await Promise.all(
-      this.workers.map((worker) => worker.postMessage(message))
-    );
+    await this.initPromise;
+
+    getBinding().broadcastPool(this.poolId, message);
   }
 
   /**
-   * Terminate all workers in the pool
+   * Terminate all workers in the pool. Unfinished jobs are rejected.
    */
   async terminate(): Promise<void> {
     if (this.isTerminated) {
@@ -339,8 +549,16 @@ export class WorkerPool<TIn = unknown, TOut = unknown> {
     }
 
     this.isTerminated = true;
-    await Promise.all(this.workers.map((worker) => worker.terminate()));
-    this.workers = [];
+
+    await this.initPromise.catch(() => {});
+    await NativeWebworker.terminatePool(this.poolId);
+
+    poolRoutes.delete(this.poolId);
+    this.pendingJobs.forEach((job) => {
+      clearTimeout(job.timer);
+      job.reject(new Error('WorkerPool terminated'));
+    });
+    this.pendingJobs.clear();
   }
 
   /**
@@ -349,31 +567,63 @@ export class WorkerPool<TIn = unknown, TOut = unknown> {
   getSize(): number {
     return this.size;
   }
+
+  private settleJob(jobId: number, error: string | null, data: unknown): void {
+    const job = this.pendingJobs.get(jobId);
+    if (!job) {
+      return;
+    }
+    this.pendingJobs.delete(jobId);
+    clearTimeout(job.timer);
+
+    if (error !== null) {
+      job.reject(new Error(error));
+    } else {
+      job.resolve(data);
+    }
+  }
 }
 
 // Export native module for direct access if needed
 export { NativeWebworker };
 
 // Re-export event types
-export type {
-  WorkerMessageEvent,
-  WorkerErrorEvent,
-  WorkerConsoleEvent,
-} from './NativeWebworker';
+export type { WorkerErrorEvent, WorkerConsoleEvent } from './NativeWebworker';
+export type { WorkerStats, LatencyStats } from './WebWorkerBinding';
 
 // Export convenience functions
 export async function createWorker(
   workerId: string,
   scriptPath: string
 ): Promise<string> {
-  return NativeWebworker.createWorker(workerId, scriptPath);
+  return NativeWebworker.createWorker(
+    workerId,
+    scriptPath,
+    0,
+    0,
+    '',
+    0,
+    '',
+    0,
+    ''
+  );
 }
 
 export async function createWorkerWithScript(
   workerId: string,
   scriptContent: string
 ): Promise<string> {
-  return NativeWebworker.createWorkerWithScript(workerId, scriptContent);
+  return NativeWebworker.createWorkerWithScript(
+    workerId,
+    scriptContent,
+    0,
+    0,
+    '',
+    0,
+    '',
+    0,
+    ''
+  );
 }
 
 export async function terminateWorker(workerId: string): Promise<boolean> {
@@ -393,3 +643,40 @@ export async function evalScript(
 ): Promise<string> {
   return NativeWebworker.evalScript(workerId, script);
 }
+
+/**
+ * Keep `size` pre-initialized worker runtimes warm in the background.
+ * New workers take a runtime from the pool and only run their script.
+ * Pass 0 to disable the pool.
+ */
+export function setWarmPoolSize(size: number): void {
+  NativeWebworker.setWarmPoolSize(size);
+}
+
+export type ConsoleLevel = 'log' | 'info' | 'warn' | 'error' | 'none';
+
+/**
+ * Only forward worker console output at `level` or above. Filtered calls
+ * return right away inside the worker, without formatting their arguments.
+ */
+export function setConsoleLevel(level: ConsoleLevel): void {
+  NativeWebworker.setConsoleLevel(level);
+}
+
+/**
+ * Time one task in `interval` in every worker for their stats. Counting is
+ * always on; 0 turns timing off. Defaults to 1, every task.
+ */
+export function setStatsSampleInterval(interval: number): void {
+  getBinding().setStatsSampleInterval(interval);
+}
+
+/**
+ * How many bytes of a streamed response body are downloaded ahead of the
+ * worker reading it, per response. A reader that falls behind holds the
+ * download back once that much is buffered. Defaults to 1 MiB and applies
+ * to responses from now on.
+ */
+export function setFetchHighWaterMark(bytes: number): void {
+  getBinding().setFetchHighWaterMark(bytes);
+}